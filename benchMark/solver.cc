@@ -13,8 +13,8 @@ enum {
 };
 
 void launch_solver_tasks
-(int rank, int treelvl, int launchlvl, int niter, bool tracing,
- Context ctx, HighLevelRuntime *runtime) {
+(int rank, int treelvl, int launchlvl, int nRhs, int niter, bool tracing,
+ int size, Context ctx, HighLevelRuntime *runtime) {
 
   // The number of processors should be 8 * #machines, i.e., 2^launchlvl
   // and the number of partitioning, i.e., the number of leaf nodes
@@ -24,22 +24,25 @@ void launch_solver_tasks
   // ======= Problem configuration =======
   // solve: A x = b where A = U * V' + D
   // =====================================
+  // any number of rows; leaves differ by at most one row
   int    base = 400, n = rank;
+  int    nLeaf = pow(2, treelvl);
+  int    N = (size > 0 ? size : base*nLeaf);
   bool   has_entry = false; //true;
-  Matrix VMat(base, treelvl, n, has_entry); VMat.rand();
-  Matrix UMat(base, treelvl, n, has_entry); UMat.rand();
-  Matrix Rhs(base, treelvl, 1, has_entry);  Rhs.rand();
-  Vector DVec(base, treelvl, has_entry);    DVec.rand(1e3);
+  Matrix VMat(N, n, has_entry);
+  Matrix UMat(N, n, has_entry);
+  Matrix Rhs (N, nRhs, has_entry);
+  Vector DVec(N, has_entry);
 
   // ================================================
   // generate random matrices, which is
   //  done in parallel
   // ================================================
-  VMat.rand();
-  UMat.rand();
-  Rhs.rand();
+  VMat.rand(nLeaf);
+  UMat.rand(nLeaf);
+  Rhs.rand(nLeaf);
   int mean = 1e3;
-  DVec.rand(mean);
+  DVec.rand(nLeaf, mean);
 
   // ========================================================
   // fast solver for a simple matrix U * V' + D
@@ -48,65 +51,47 @@ void launch_solver_tasks
   // ========================================================
 
   // init tree
-  UTree uTree; uTree.init( UMat );
-  VTree vTree; vTree.init( VMat );
-  KTree kTree; kTree.init( UMat, VMat, DVec );
-
-  // data partition
-  uTree.partition( launchlvl, ctx, runtime );
-  vTree.partition( launchlvl, ctx, runtime );
-  kTree.partition( launchlvl, ctx, runtime );
-  
-  // init rhs
-  uTree.init_rhs(Rhs, ctx, runtime, true/*wait*/);
-
+  int nProc = pow(2, launchlvl);
+  HMatrix hMat(nProc, launchlvl);
+  hMat.init( UMat, VMat, DVec, ctx, runtime, nRhs );
 
+  // everything independent of the right hand side
+  //  is done once
+#ifdef SOLVER_RESIDULE
+  // shift() keeps the unfactored leaf blocks and u columns
+  //  for the product in the residual below
+  hMat.shift( 0.0, ctx, runtime );
+#else
+  hMat.factor( ctx, runtime );
+#endif
+  
   TraceID tID = 321;
   for (int it=0; it<niter; it++) {
     if (tracing) runtime->begin_trace(ctx, tID);
     
-    // leaf solve: U = dense \ U
-    kTree.solve( uTree.leaf(), vTree.leaf(), ctx, runtime );  
-
-    for (int i=launchlvl; i>0; i--) {
-      LMatrix& V = vTree.level(i);
-      LMatrix& u = uTree.uMat_level(i);
-      LMatrix& d = uTree.dMat_level(i);    
-    
-      // reduction operation
-      int rows = pow(2, i)*V.cols();
-      LMatrix VTu(rows, u.cols(), i-1, ctx, runtime);
-      LMatrix VTd(rows, d.cols(), i-1, ctx, runtime);
-      VTu.two_level_partition(ctx, runtime);
-      VTd.two_level_partition(ctx, runtime);
-
-      LMatrix::gemmRed('t', 'n', 1.0, V, u, 0.0, VTu, ctx, runtime );
-      LMatrix::gemmRed('t', 'n', 1.0, V, d, 0.0, VTd, ctx, runtime );
-
-      // form and solve the small linear system
-      VTu.node_solve( VTd, ctx, runtime );
-      
-      // broadcast operation
-      // d -= u * VTd
-      if (it==0 && i==1) {
-	LMatrix::gemmBro('n', 'n', -1.0, u, VTd, 1.0, d, ctx, runtime,
-			 true/*wait*/ );
-      } else {
-	LMatrix::gemmBro('n', 'n', -1.0, u, VTd, 1.0, d, ctx, runtime );
-      }
-      std::cout<<"launched solver tasks at level: "<<i<<std::endl;
-    }
+    // leaf solve and upward pass with the stored factors
+    hMat.solve( Rhs, ctx, runtime );
+    std::cout<<"launched solver tasks for iteration: "<<it<<std::endl;
 
     if (tracing) runtime->end_trace(ctx, tID);
   }
   
 #ifdef SOLVER_RESIDULE
-  // compute residule
-  Matrix x = uTree.solution(ctx, runtime);
-  Matrix err = Rhs - ( UMat * (VMat.T() * x) + DVec.multiply(x) );
+  // compute residule with the distributed product
+  LMatrix b  (N, nRhs, launchlvl, ctx, runtime);
+  LMatrix Ax (N, nRhs, launchlvl, ctx, runtime);
+  LMatrix err(N, nRhs, launchlvl, ctx, runtime);
+  b.init_data( Rhs, ctx, runtime );
+  hMat.multiply( 'n', hMat.rhs_mat(), Ax, ctx, runtime );
+  LMatrix::add( 1.0, b, -1.0, Ax, err, ctx, runtime );
   //err.display("err");
-  std::cout << "Relative residual: " << err.norm() / Rhs.norm()
+  std::cout << "Relative residual: "
+	    << err.to_matrix(ctx, runtime).norm() /
+               b.to_matrix(ctx, runtime).norm()
 	    << std::endl;
+  b.clear(ctx, runtime);
+  Ax.clear(ctx, runtime);
+  err.clear(ctx, runtime);
 #endif
 
   std::cout<<"Launching solver tasks complete."<<std::endl;
@@ -119,7 +104,9 @@ void top_level_task(const Task *task,
   int rank = 100;
   int matrixlvl = 3;
   int tasklvl = 3;
+  int nrhs = 1;
   int niter = 1;
+  int size = 0;
   bool tracing = false;
   const InputArgs &command_args = HighLevelRuntime::get_input_args();
   if (command_args.argc > 1) {
@@ -130,13 +117,19 @@ void top_level_task(const Task *task,
 	matrixlvl = atoi(command_args.argv[++i]);
       if (!strcmp(command_args.argv[i],"-tasklvl"))
 	tasklvl = atoi(command_args.argv[++i]);
+      if (!strcmp(command_args.argv[i],"-nrhs"))
+	nrhs = atoi(command_args.argv[++i]);
       if (!strcmp(command_args.argv[i],"-niter"))
 	niter = atoi(command_args.argv[++i]);
+      if (!strcmp(command_args.argv[i],"-size"))
+	size = atoi(command_args.argv[++i]);
       if (!strcmp(command_args.argv[i],"-tracing"))
 	if (atoi(command_args.argv[++i]) != 0)
 	  tracing = true;
     }
     assert(niter     > 0);
+    assert(size      >= 0);
+    assert(nrhs      > 0);
     assert(rank      > 0);
     assert(tasklvl   > 0);
     assert(matrixlvl >= tasklvl);
@@ -146,12 +139,15 @@ void top_level_task(const Task *task,
 	   <<"\noff-diagonal rank: "<<rank
 	   <<"\ntask-tree level: "<<tasklvl
 	   <<"\nmatrix level: "<<matrixlvl
+	   <<"\nmatrix size: "<<(size > 0 ? size : 400*(int)pow(2, matrixlvl))
+	   <<"\nright hand sides: "<<nrhs
 	   <<"\niteration number: "<<niter
 	   <<"\nlegion tracing: "<<std::boolalpha<<tracing
            <<"\n========================\n"
 	   <<std::endl;
 
-  launch_solver_tasks(rank,matrixlvl,tasklvl,niter,tracing,ctx,runtime);
+  launch_solver_tasks(rank,matrixlvl,tasklvl,nrhs,niter,tracing,size,
+		      ctx,runtime);
 }
 
 int main(int argc, char *argv[]) {
@@ -1,9 +1,17 @@
 #ifndef _hmatrix_hpp
 #define _hmatrix_hpp
 
+#include <vector>
+
 #include "matrix.hpp" // for  Matrix class
 #include "tree.hpp"   // for UTree, VTree and KTree
 
+// black-box product Y = op(A)*X with trans 'n' or 't', where
+//  X and Y are partitioned like the right hand side (see
+//  HMatrix::init() from a matvec); Y is overwritten
+typedef void (*MatvecFunc)
+(char trans, const LMatrix& X, LMatrix& Y, Context, HighLevelRuntime*);
+
 // the hierarchical tree is balanced
 class HMatrix {
 public:
@@ -11,26 +19,315 @@ public:
 
   HMatrix(int nProc, int level);
 
-  // build U * V' + D
+  // build U * V' + D, solved with nRhs right hand sides at once;
+  //  the off-diagonal blocks at depth k use the first ranks[k]
+  //  columns of U and V (all columns by default)
   void init
   (const Matrix& U, const Matrix& V, const Vector& D,
+   Context, HighLevelRuntime*, int nRhs=1,
+   const std::vector<int>& ranks=std::vector<int>());
+
+  // build the symmetric positive definite U * U' + D with D > 0;
+  //  factor() then uses Cholesky leaves and symmetric node
+  //  systems, and V = U is only kept until the end of factor()
+  void init
+  (const Matrix& U, const Vector& D,
+   Context, HighLevelRuntime*, int nRhs=1,
+   const std::vector<int>& ranks=std::vector<int>());
+
+  // build a general HODLR matrix: the two off-diagonal blocks of
+  //  a node at depth k are U[k]*V[k]' restricted to the rows of
+  //  its children (so every node has its own bases), and the leaf
+  //  blocks are K + diag(D), with the leaf in the leading columns
+  //  of K
+  void init
+  (const std::vector<Matrix>& U, const std::vector<Matrix>& V,
+   const Matrix& K, const Vector& D,
+   Context, HighLevelRuntime*, int nRhs=1);
+
+  // build an N x N matrix from its entries (see
+  //  register_entry_func()): the leaf blocks are evaluated and
+  //  every off-diagonal block at depth k is compressed by ACA
+  //  to relative tolerance tol with rank at most ranks[k]
+  void init
+  (int func, int N, const std::vector<int>& ranks, double tol,
+   Context, HighLevelRuntime*, int nRhs=1);
+
+  // build an N x N matrix from products with A and A' only:
+  //  the off-diagonal blocks are recovered level by level from
+  //  random sketches (peeling), with rank ranks[k] at depth k,
+  //  and the leaf blocks from identity sketches in the end
+  void init
+  (MatvecFunc matvec, int N, const std::vector<int>& ranks,
+   Context, HighLevelRuntime*, int nRhs=1);
+
+  // build a batch of 2^t independent systems U[s] * V[s]' + D[s]
+  //  with the same size and tree: they are stacked along the rows
+  //  into the regions of one tree that is t levels deeper, whose
+  //  nodes above depth t have rank zero, so every index launch
+  //  covers the partitions of all systems and the runtime cost is
+  //  paid once per batch. The launch level of the constructor
+  //  counts from the root of every system. The right hand sides
+  //  of solve() are stacked the same way (see Matrix::stack()),
+  //  and log_determinant() is the sum over the systems
+  void init_batch
+  (const std::vector<Matrix>& U, const std::vector<Matrix>& V,
+   const std::vector<Vector>& D, Context, HighLevelRuntime*, int nRhs=1,
+   const std::vector<int>& ranks=std::vector<int>());
+
+  // order the rows of the matrix by perm, i.e., row i of the
+  //  matrix is row perm[i] of the problem (see cluster_order()):
+  //  the build from an entry function evaluates the entries in
+  //  this order (the other builds are given in it), and the right
+  //  hand sides and the solutions stay in the problem order, as
+  //  they are permuted by index launches over the row partitions
+  //  (see LMatrix::permute()). Call it before init(); not for a
+  //  batch
+  void set_permutation
+  (const std::vector<int>& perm, Context, HighLevelRuntime*);
+
+  // truncate the rank of every depth to what its off-diagonal
+  //  blocks need for the relative tolerance tol: every block is
+  //  recompressed by QR and SVD in its own task, every depth keeps
+  //  the largest rank of its blocks, and the regions are rebuilt
+  //  with the new ranks (see rank_profile()). Call it after init()
+  //  and before factor(); not for the symmetric build
+  void recompress(double tol, Context, HighLevelRuntime*);
+
+  // the rank of every depth, root first
+  const std::vector<int>& rank_profile() const;
+
+  // factorize the matrix once; the leaf LU factors, V'*u
+  //  and the LU factors of the node systems stay in regions.
+  //  With single, the leaf blocks and the node systems are
+  //  factorized in single precision (see solve() with
+  //  refinement), the factors are kept in float regions, and
+  //  solve() runs the leaf and node solves, gemmRed and gemmBro
+  //  in float on single precision copies of the u columns and
+  //  V; solve_transpose() and inverse_diagonal() move the
+  //  factors back to double
+  void factor(Context, HighLevelRuntime*, bool single=false);
+
+  // factorize A = W*W' for the symmetric positive definite
+  //  matrix instead (see multiply_sqrt()): the leaf blocks are
+  //  Cholesky factorized, and every node is W = diag(W0, W1) *
+  //  (I + u*X*u') with the u columns of the children solved by
+  //  W0 and W1, so applying W costs about as much as a solve.
+  //  log_determinant() is available as after factor(), but the
+  //  factors do not solve
+  void factor_sqrt(Context, HighLevelRuntime*);
+
+  // factorize A + sigma*I instead, where A is the matrix from
+  //  init(), so the shifts do not add up. Only the diagonal of
+  //  the leaf blocks changes: the first call keeps the blocks
+  //  and the u columns, which the factorization overwrites, and
+  //  every call resets them and factorizes again in the same
+  //  regions. Call it instead of factor() for the first time.
+  void shift
+  (double sigma, Context, HighLevelRuntime*, bool single=false);
+
+  // add delta[k] to the diagonal entry of rows[k] (in the problem
+  //  order, see set_permutation()) of the matrix from init(), so
+  //  the changes add up, and factorize again: only the leaf
+  //  blocks holding these rows and the node systems on their
+  //  paths to the root are factorized, while the other blocks
+  //  keep their factors and regions, which solve the u columns
+  //  again. Like shift(), it keeps the unfactored data at the
+  //  first call, which factorizes everything and comes instead
+  //  of factor(), possibly without rows; a later shift() keeps
+  //  the changes. The kept factors have the precision of the
+  //  call that computed them, but with single all factors are
+  //  stored in float (see factor())
+  void add_diagonal
+  (const std::vector<int>& rows, const std::vector<double>& delta,
+   Context, HighLevelRuntime*, bool single=false);
+
+  // solve (A + sigma[k]*I) x_k = b for up to MAX_SHIFTS shifts
+  //  in one pass with the matrix from init(), i.e., before
+  //  factor(), and no factors are kept: the leaf solves of all
+  //  shifts run in one index launch, and since V does not
+  //  depend on the shift, every level reduces V'*u and V'*d
+  //  once for all shifts. See shift_solution().
+  void solve_shifts
+  (const Matrix& b, const std::vector<double>& sigma,
+   Context, HighLevelRuntime*);
+
+  // the solution for sigma[k] of the last solve_shifts()
+  Matrix shift_solution(int k, Context, HighLevelRuntime*);
+  
+  // fast solver with the stored factors,
+  //  which only touches the right hand side columns
+  void solve(const Matrix& b, Context, HighLevelRuntime*);
+
+  // solve A'*x = b with the same factors, see solution()
+  void solve_transpose(const Matrix& b, Context, HighLevelRuntime*);
+
+  // the diagonal of inv(A) from the factors, or with blocks its
+  //  diagonal blocks at the leaves, in a new region partitioned
+  //  like the right hand side (see rhs_mat()), which the caller
+  //  clears: the diagonal is one column in the problem order (see
+  //  set_permutation()), and leaf i takes its rows of the tree
+  //  order (see block_begin()) and the leading columns of the
+  //  widest leaf. One leaf task per partition adds up the
+  //  corrections of all levels, so it costs about a solve with
+  //  as many right hand sides as the u columns, rather than N
+  //  solves
+  LMatrix inverse_diagonal
+  (bool blocks, Context, HighLevelRuntime*);
+
+  // solve followed by nRefine steps of iterative refinement
+  //  in double precision, x += A \ (b - A*x), where matvec
+  //  applies the matrix (see MatvecFunc); this recovers full
+  //  accuracy from single precision factors
+  void solve
+  (const Matrix& b, MatvecFunc matvec, int nRefine,
+   Context, HighLevelRuntime*);
+
+  // Krylov solvers with this (factored) matrix as the
+  //  preconditioner for the operator given by matvec, which
+  //  may be more accurate, e.g., a HODLR matrix with higher
+  //  ranks (see multiply()). The vectors live in regions
+  //  partitioned like the right hand side, and only the inner
+  //  products go to the host. They stop when the residual
+  //  drops below tol*|b| or after maxIt products with the
+  //  operator, whose number they return; the solution is
+  //  left in the right hand side columns (see solution()).
+  //  Only one right hand side and one system (no batch) are
+  //  supported.
+
+  // conjugate gradient for a symmetric positive definite
+  //  operator and preconditioner
+  int cg
+  (const Matrix& b, MatvecFunc matvec, double tol, int maxIt,
    Context, HighLevelRuntime*);
 
-  // fast solver
-  Vector solve(const Matrix& b, Context, HighLevelRuntime*);
+  // GMRES restarted every restart steps, preconditioned
+  //  from the right, so the residual is that of A*x = b
+  int gmres
+  (const Matrix& b, MatvecFunc matvec, double tol, int restart,
+   int maxIt, Context, HighLevelRuntime*);
+
+  // return the solution of the last solve
+  Matrix solution(Context, HighLevelRuntime*);
+
+  // the solution of system s of a batch (see init_batch())
+  Matrix solution(int s, Context, HighLevelRuntime*);
+
+  // the right hand side columns, which hold the solution
+  //  after solve()
+  LMatrix& rhs_mat();
+
+  // Y = op(A)*X with trans 'n' or 't' on the distributed data,
+  //  where X and Y are partitioned like the right hand side; it
+  //  needs the matrix before factor(), which overwrites it, or
+  //  the copies kept by shift() and add_diagonal(), and then A is
+  //  the shifted matrix that the factors solve
+  void multiply
+  (char trans, const LMatrix& X, LMatrix& Y, Context, HighLevelRuntime*);
+
+  // Y = W*X, or W'*X for trans='t', with the factors of
+  //  factor_sqrt(), where X and Y are partitioned like the right
+  //  hand side and are in the order of the tree; e.g., Y = W*Z
+  //  for a standard normal Z samples the Gaussian with
+  //  covariance A
+  void multiply_sqrt
+  (char trans, const LMatrix& X, LMatrix& Y, Context, HighLevelRuntime*);
+
+  // log|det A| (a double) from the factors of the leaf blocks
+  //  and the node systems
+  Future log_determinant() const;
 
   // destructor
   void destroy(Context, HighLevelRuntime*);
   
+private:
+
+  // factorize the leaf blocks i with update[i] and the node
+  //  systems above them, or all blocks if update is empty; the
+  //  other blocks keep the factors of the last call
+  void refactor
+  (const std::vector<bool>& update, Context, HighLevelRuntime*,
+   bool single);
+
+  // move the factors to regions of type (see factor())
+  void set_factor_type(ScalarType, Context, HighLevelRuntime*);
+
+  // overwrite the right hand side columns with the solution
+  void solve_rhs(Context, HighLevelRuntime*);
+
+  // load b into the right hand side columns in the order of the
+  //  tree (see set_permutation())
+  void init_rhs(const Matrix& b, Context, HighLevelRuntime*);
+
+  // B = b in the order of the tree, and the inverse for X, which
+  //  is partitioned like the right hand side
+  void to_tree_order
+  (const Matrix& b, LMatrix& B, Context, HighLevelRuntime*);
+  Matrix to_problem_order
+  (const LMatrix& X, Context, HighLevelRuntime*);
+
+  // the leading cols columns of the region in the problem order
+  //  that the permutations go through (see orderPart)
+  LMatrix order_region(int cols, Context, HighLevelRuntime*);
+
+  // z = A \ r with the factors, where r and z are in other
+  //  regions partitioned like the right hand side
+  void precondition
+  (const LMatrix& r, LMatrix& z, Context, HighLevelRuntime*);
+
+  // Y += alpha*op(A)*X for the off-diagonal blocks above the
+  //  given depth and, with dense, the dense leaf blocks
+  void apply_offdiag
+  (char trans, double alpha, int depth, bool dense, const LMatrix& X,
+   LMatrix& Y, Context, HighLevelRuntime*);
+
 private:
 
   // level=0 is a dense matrix
   // level=1 means the two off-diagonal blocks are low-rank
   int   nProc;
   int   level;
+  // a batch of 2^top systems (see init_batch()), where the
+  //  levels above depth top are skipped
+  int   top;
+  bool  factored;
+  // built by the symmetric positive definite init()
+  bool  spd;
+  // the unfactored data is kept for shift() and add_diagonal()
+  bool  shifted;
+  // the factors are W of A = W*W' (see factor_sqrt())
+  bool  sqrtFactored;
+  // the factors are in float regions (see factor())
+  bool  singleFactors;
   UTree uTree;
   VTree vTree;
   KTree kTree;
+
+  // the row of the problem for every row of the tree, see
+  //  set_permutation()
+  bool    permuted;
+  LMatrix permMat;
+  // the row of the tree for every row of the problem
+  std::vector<int> treeRow;
+  // the right hand sides and solutions in the problem order, and
+  //  its rows of every tree block, made by set_permutation()
+  LMatrix orderMat;
+  LogicalPartition orderPart;
+
+  // the right hand side and the u columns of every shift side
+  //  by side, see solve_shifts()
+  int    nShift;
+  LMatrix shiftMat;
+
+  // for every launch level (index i-1 for level i):
+  //  V'*u, factors of the node systems and
+  //  workspace for V'*d
+  std::vector<LMatrix> VTu_vec;
+  std::vector<LMatrix> SFac_vec;
+  std::vector<LMatrix> VTd_vec;
+
+  // log|det A|, available after factor()
+  Future logdet;
 };
 
 #endif
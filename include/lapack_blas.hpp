@@ -25,6 +25,13 @@
  * also included in the Intel and AMD versions.
  */
 
+#include <complex>
+#include <stdio.h>  // for fprintf()
+#include <stdlib.h> // for abort()
+
+typedef std::complex<float>  complex_float;
+typedef std::complex<double> complex_double;
+
 namespace blas {
   extern "C" {
     // Declaration for BLAS matrix-vector multiply
@@ -32,6 +39,45 @@ namespace blas {
     void dgemm_(char *transa, char *transb, int *m, int *n, int *k, double *alpha,
 		double *A, int *lda, double *B, int *ldb, double *beta,
 		double *C, int *ldc);
+
+    // the same in single precision and complex arithmetic
+    void sgemm_(char *transa, char *transb, int *m, int *n, int *k, float *alpha,
+		float *A, int *lda, float *B, int *ldb, float *beta,
+		float *C, int *ldc);
+    void cgemm_(char *transa, char *transb, int *m, int *n, int *k,
+		complex_float *alpha, complex_float *A, int *lda,
+		complex_float *B, int *ldb, complex_float *beta,
+		complex_float *C, int *ldc);
+    void zgemm_(char *transa, char *transb, int *m, int *n, int *k,
+		complex_double *alpha, complex_double *A, int *lda,
+		complex_double *B, int *ldb, complex_double *beta,
+		complex_double *C, int *ldc);
+
+    // B = alpha*op(A)*B (trmm) or B = alpha*op(A)\B (trsm) for
+    //  a triangular A on the side given by side
+    void dtrmm_(char *side, char *uplo, char *transa, char *diag, int *m,
+		int *n, double *alpha, double *A, int *lda, double *B,
+		int *ldb);
+    void dtrsm_(char *side, char *uplo, char *transa, char *diag, int *m,
+		int *n, double *alpha, double *A, int *lda, double *B,
+		int *ldb);
+
+    void strmm_(char *side, char *uplo, char *transa, char *diag, int *m,
+		int *n, float *alpha, float *A, int *lda, float *B, int *ldb);
+    void ctrmm_(char *side, char *uplo, char *transa, char *diag, int *m,
+		int *n, complex_float *alpha, complex_float *A, int *lda,
+		complex_float *B, int *ldb);
+    void ztrmm_(char *side, char *uplo, char *transa, char *diag, int *m,
+		int *n, complex_double *alpha, complex_double *A, int *lda,
+		complex_double *B, int *ldb);
+    void strsm_(char *side, char *uplo, char *transa, char *diag, int *m,
+		int *n, float *alpha, float *A, int *lda, float *B, int *ldb);
+    void ctrsm_(char *side, char *uplo, char *transa, char *diag, int *m,
+		int *n, complex_float *alpha, complex_float *A, int *lda,
+		complex_float *B, int *ldb);
+    void ztrsm_(char *side, char *uplo, char *transa, char *diag, int *m,
+		int *n, complex_double *alpha, complex_double *A, int *lda,
+		complex_double *B, int *ldb);
   }
 }
 
@@ -49,13 +95,277 @@ namespace lapack {
     void dgetrf_(int *M, int *N, double *A, int *LDA, int *IPIV,
 		 int *INFO);
 
+    // single precision LU factorize
+    void sgetrf_(int *M, int *N, float *A, int *LDA, int *IPIV,
+		 int *INFO);
+
     // LU solve (with existing factorization)
     void dgetrs_(char *TRANS, int *N, int *NRHS, double *A, int *LDA,
 		 int *IPIV, double *B, int *LDB, int *INFO);
-    
+
+    // Cholesky factorize A = L*L' (UPLO='L') of a symmetric
+    //  positive definite matrix
+    void dpotrf_(char *UPLO, int *N, double *A, int *LDA, int *INFO);
+
+    // single precision Cholesky factorize
+    void spotrf_(char *UPLO, int *N, float *A, int *LDA, int *INFO);
+
+    // Cholesky solve (with existing factorization)
+    void dpotrs_(char *UPLO, int *N, int *NRHS, double *A, int *LDA,
+		 double *B, int *LDB, int *INFO);
+
+    // symmetric indefinite factorize A = L*D*L' (Bunch-Kaufman)
+    void dsytrf_(char *UPLO, int *N, double *A, int *LDA, int *IPIV,
+		 double *WORK, int *LWORK, int *INFO);
+
+    // single precision symmetric indefinite factorize
+    void ssytrf_(char *UPLO, int *N, float *A, int *LDA, int *IPIV,
+		 float *WORK, int *LWORK, int *INFO);
+
+    // symmetric indefinite solve (with existing factorization)
+    void dsytrs_(char *UPLO, int *N, int *NRHS, double *A, int *LDA,
+		 int *IPIV, double *B, int *LDB, int *INFO);
+
+    // QR factorize; R is in the upper triangle and the
+    //  reflectors below it
+    void dgeqrf_(int *M, int *N, double *A, int *LDA, double *TAU,
+		 double *WORK, int *LWORK, int *INFO);
+
+    // form the first N columns of Q from dgeqrf_()
+    void dorgqr_(int *M, int *N, int *K, double *A, int *LDA,
+		 double *TAU, double *WORK, int *LWORK, int *INFO);
+
+    // singular value decomposition A = U*S*VT by divide and
+    //  conquer; A is destroyed
+    void dgesdd_(char *JOBZ, int *M, int *N, double *A, int *LDA,
+		 double *S, double *U, int *LDU, double *VT, int *LDVT,
+		 double *WORK, int *LWORK, int *IWORK, int *INFO);
+
+    // the routines above for the other scalar types; the complex
+    //  Cholesky factorization is for Hermitian matrices and the
+    //  complex LDL' for complex symmetric ones
+    void sgesv_(int *N, int *NRHS, float *A, int *LDA, int *IPIV,
+		float *B, int *LDB, int *INFO);
+    void cgesv_(int *N, int *NRHS, complex_float *A, int *LDA, int *IPIV,
+		complex_float *B, int *LDB, int *INFO);
+    void zgesv_(int *N, int *NRHS, complex_double *A, int *LDA, int *IPIV,
+		complex_double *B, int *LDB, int *INFO);
+
+    void cgetrf_(int *M, int *N, complex_float *A, int *LDA, int *IPIV,
+		 int *INFO);
+    void zgetrf_(int *M, int *N, complex_double *A, int *LDA, int *IPIV,
+		 int *INFO);
+
+    void sgetrs_(char *TRANS, int *N, int *NRHS, float *A, int *LDA,
+		 int *IPIV, float *B, int *LDB, int *INFO);
+    void cgetrs_(char *TRANS, int *N, int *NRHS, complex_float *A, int *LDA,
+		 int *IPIV, complex_float *B, int *LDB, int *INFO);
+    void zgetrs_(char *TRANS, int *N, int *NRHS, complex_double *A, int *LDA,
+		 int *IPIV, complex_double *B, int *LDB, int *INFO);
+
+    void cpotrf_(char *UPLO, int *N, complex_float *A, int *LDA, int *INFO);
+    void zpotrf_(char *UPLO, int *N, complex_double *A, int *LDA, int *INFO);
+
+    void spotrs_(char *UPLO, int *N, int *NRHS, float *A, int *LDA,
+		 float *B, int *LDB, int *INFO);
+    void cpotrs_(char *UPLO, int *N, int *NRHS, complex_float *A, int *LDA,
+		 complex_float *B, int *LDB, int *INFO);
+    void zpotrs_(char *UPLO, int *N, int *NRHS, complex_double *A, int *LDA,
+		 complex_double *B, int *LDB, int *INFO);
+
+    void csytrf_(char *UPLO, int *N, complex_float *A, int *LDA, int *IPIV,
+		 complex_float *WORK, int *LWORK, int *INFO);
+    void zsytrf_(char *UPLO, int *N, complex_double *A, int *LDA, int *IPIV,
+		 complex_double *WORK, int *LWORK, int *INFO);
+
+    void ssytrs_(char *UPLO, int *N, int *NRHS, float *A, int *LDA,
+		 int *IPIV, float *B, int *LDB, int *INFO);
+    void csytrs_(char *UPLO, int *N, int *NRHS, complex_float *A, int *LDA,
+		 int *IPIV, complex_float *B, int *LDB, int *INFO);
+    void zsytrs_(char *UPLO, int *N, int *NRHS, complex_double *A, int *LDA,
+		 int *IPIV, complex_double *B, int *LDB, int *INFO);
+
+    void sgeqrf_(int *M, int *N, float *A, int *LDA, float *TAU,
+		 float *WORK, int *LWORK, int *INFO);
+    void cgeqrf_(int *M, int *N, complex_float *A, int *LDA,
+		 complex_float *TAU, complex_float *WORK, int *LWORK,
+		 int *INFO);
+    void zgeqrf_(int *M, int *N, complex_double *A, int *LDA,
+		 complex_double *TAU, complex_double *WORK, int *LWORK,
+		 int *INFO);
+
+    void sorgqr_(int *M, int *N, int *K, float *A, int *LDA,
+		 float *TAU, float *WORK, int *LWORK, int *INFO);
+    void cungqr_(int *M, int *N, int *K, complex_float *A, int *LDA,
+		 complex_float *TAU, complex_float *WORK, int *LWORK,
+		 int *INFO);
+    void zungqr_(int *M, int *N, int *K, complex_double *A, int *LDA,
+		 complex_double *TAU, complex_double *WORK, int *LWORK,
+		 int *INFO);
   }
 }
 
+// Compile-time dispatch on the scalar type: the overloads below
+//  have the same arguments as the routines without the prefix, so
+//  templated kernels call blas::gemm() or lapack::getrf() and the
+//  compiler picks s, d, c or z.
+#define BLAS_DISPATCH(name, T, routine, params, args)	\
+  inline void name params { routine args; }
+
+// The Cray build (-DNETLIB_BLAS, see spmd_benchMark/Makefile) links
+//  only the double routines in netlib_blas/, so the overloads of
+//  the other routines stop there instead of calling them, and the
+//  solver runs in double without symmetric factors, recompress()
+//  or factor_sqrt().
+#ifdef NETLIB_BLAS
+inline void netlib_missing(const char *routine) {
+  fprintf(stderr, "%s is not in netlib_blas/\n", routine);
+  abort();
+}
+#define BLAS_EXTRA(name, T, routine, params, args)	\
+  inline void name params { netlib_missing(#routine); }
+#else
+#define BLAS_EXTRA BLAS_DISPATCH
+#endif
+
+#define GEMM_PARAMS(T)							\
+  (char *transa, char *transb, int *m, int *n, int *k, T *alpha,	\
+   T *A, int *lda, T *B, int *ldb, T *beta, T *C, int *ldc)
+#define GEMM_ARGS (transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc)
+#define TRMM_PARAMS(T)							\
+  (char *side, char *uplo, char *transa, char *diag, int *m, int *n,	\
+   T *alpha, T *A, int *lda, T *B, int *ldb)
+#define TRMM_ARGS (side, uplo, transa, diag, m, n, alpha, A, lda, B, ldb)
+
+namespace blas {
+  BLAS_EXTRA   (gemm, float,          sgemm_, GEMM_PARAMS(float),          GEMM_ARGS)
+  BLAS_DISPATCH(gemm, double,         dgemm_, GEMM_PARAMS(double),         GEMM_ARGS)
+  BLAS_EXTRA   (gemm, complex_float,  cgemm_, GEMM_PARAMS(complex_float),  GEMM_ARGS)
+  BLAS_EXTRA   (gemm, complex_double, zgemm_, GEMM_PARAMS(complex_double), GEMM_ARGS)
+  // trsm has the same arguments as trmm
+  BLAS_EXTRA   (trmm, float,          strmm_, TRMM_PARAMS(float),          TRMM_ARGS)
+  BLAS_EXTRA   (trmm, double,         dtrmm_, TRMM_PARAMS(double),         TRMM_ARGS)
+  BLAS_EXTRA   (trmm, complex_float,  ctrmm_, TRMM_PARAMS(complex_float),  TRMM_ARGS)
+  BLAS_EXTRA   (trmm, complex_double, ztrmm_, TRMM_PARAMS(complex_double), TRMM_ARGS)
+  BLAS_EXTRA   (trsm, float,          strsm_, TRMM_PARAMS(float),          TRMM_ARGS)
+  BLAS_DISPATCH(trsm, double,         dtrsm_, TRMM_PARAMS(double),         TRMM_ARGS)
+  BLAS_EXTRA   (trsm, complex_float,  ctrsm_, TRMM_PARAMS(complex_float),  TRMM_ARGS)
+  BLAS_EXTRA   (trsm, complex_double, ztrsm_, TRMM_PARAMS(complex_double), TRMM_ARGS)
+}
+
+#define GESV_PARAMS(T) \
+  (int *N, int *NRHS, T *A, int *LDA, int *IPIV, T *B, int *LDB, int *INFO)
+#define GESV_ARGS (N, NRHS, A, LDA, IPIV, B, LDB, INFO)
+#define GETRF_PARAMS(T) (int *M, int *N, T *A, int *LDA, int *IPIV, int *INFO)
+#define GETRF_ARGS (M, N, A, LDA, IPIV, INFO)
+#define GETRS_PARAMS(T)						\
+  (char *TRANS, int *N, int *NRHS, T *A, int *LDA, int *IPIV,	\
+   T *B, int *LDB, int *INFO)
+#define GETRS_ARGS (TRANS, N, NRHS, A, LDA, IPIV, B, LDB, INFO)
+#define POTRF_PARAMS(T) (char *UPLO, int *N, T *A, int *LDA, int *INFO)
+#define POTRF_ARGS (UPLO, N, A, LDA, INFO)
+#define POTRS_PARAMS(T)						\
+  (char *UPLO, int *N, int *NRHS, T *A, int *LDA, T *B, int *LDB,	\
+   int *INFO)
+#define POTRS_ARGS (UPLO, N, NRHS, A, LDA, B, LDB, INFO)
+#define SYTRF_PARAMS(T)						\
+  (char *UPLO, int *N, T *A, int *LDA, int *IPIV, T *WORK, int *LWORK,	\
+   int *INFO)
+#define SYTRF_ARGS (UPLO, N, A, LDA, IPIV, WORK, LWORK, INFO)
+#define SYTRS_PARAMS(T)						\
+  (char *UPLO, int *N, int *NRHS, T *A, int *LDA, int *IPIV,	\
+   T *B, int *LDB, int *INFO)
+#define SYTRS_ARGS (UPLO, N, NRHS, A, LDA, IPIV, B, LDB, INFO)
+#define GEQRF_PARAMS(T)						\
+  (int *M, int *N, T *A, int *LDA, T *TAU, T *WORK, int *LWORK, int *INFO)
+#define GEQRF_ARGS (M, N, A, LDA, TAU, WORK, LWORK, INFO)
+#define ORGQR_PARAMS(T)							\
+  (int *M, int *N, int *K, T *A, int *LDA, T *TAU, T *WORK, int *LWORK,	\
+   int *INFO)
+#define ORGQR_ARGS (M, N, K, A, LDA, TAU, WORK, LWORK, INFO)
+#define GESDD_PARAMS(T)							\
+  (char *JOBZ, int *M, int *N, T *A, int *LDA, T *S, T *U, int *LDU,	\
+   T *VT, int *LDVT, T *WORK, int *LWORK, int *IWORK, int *INFO)
+#define GESDD_ARGS (JOBZ, M, N, A, LDA, S, U, LDU, VT, LDVT, WORK, LWORK, IWORK, INFO)
+
+// LAPACK_DISPATCH has the double routine in netlib_blas/ and
+//  LAPACK_EXTRA has not
+#define LAPACK_DISPATCH(name, s, d, c, z, P, A)			\
+  BLAS_EXTRA   (name, float,          s, P(float),          A)	\
+  BLAS_DISPATCH(name, double,         d, P(double),         A)	\
+  BLAS_EXTRA   (name, complex_float,  c, P(complex_float),  A)	\
+  BLAS_EXTRA   (name, complex_double, z, P(complex_double), A)
+#define LAPACK_EXTRA(name, s, d, c, z, P, A)			\
+  BLAS_EXTRA(name, float,          s, P(float),          A)	\
+  BLAS_EXTRA(name, double,         d, P(double),         A)	\
+  BLAS_EXTRA(name, complex_float,  c, P(complex_float),  A)	\
+  BLAS_EXTRA(name, complex_double, z, P(complex_double), A)
+
+namespace lapack {
+  LAPACK_DISPATCH(gesv,  sgesv_,  dgesv_,  cgesv_,  zgesv_,  GESV_PARAMS,  GESV_ARGS)
+  LAPACK_DISPATCH(getrf, sgetrf_, dgetrf_, cgetrf_, zgetrf_, GETRF_PARAMS, GETRF_ARGS)
+  LAPACK_DISPATCH(getrs, sgetrs_, dgetrs_, cgetrs_, zgetrs_, GETRS_PARAMS, GETRS_ARGS)
+  LAPACK_EXTRA   (potrf, spotrf_, dpotrf_, cpotrf_, zpotrf_, POTRF_PARAMS, POTRF_ARGS)
+  LAPACK_EXTRA   (potrs, spotrs_, dpotrs_, cpotrs_, zpotrs_, POTRS_PARAMS, POTRS_ARGS)
+  LAPACK_EXTRA   (sytrf, ssytrf_, dsytrf_, csytrf_, zsytrf_, SYTRF_PARAMS, SYTRF_ARGS)
+  LAPACK_EXTRA   (sytrs, ssytrs_, dsytrs_, csytrs_, zsytrs_, SYTRS_PARAMS, SYTRS_ARGS)
+  LAPACK_EXTRA   (geqrf, sgeqrf_, dgeqrf_, cgeqrf_, zgeqrf_, GEQRF_PARAMS, GEQRF_ARGS)
+  // Q of a complex QR is unitary
+  LAPACK_EXTRA   (orgqr, sorgqr_, dorgqr_, cungqr_, zungqr_, ORGQR_PARAMS, ORGQR_ARGS)
+  // only used in double (see RecompressTask)
+  BLAS_EXTRA     (gesdd, double,  dgesdd_, GESDD_PARAMS(double), GESDD_ARGS)
+}
+
+#undef LAPACK_DISPATCH
+#undef LAPACK_EXTRA
+#undef BLAS_DISPATCH
+#undef BLAS_EXTRA
+#undef GEMM_PARAMS
+#undef GEMM_ARGS
+#undef TRMM_PARAMS
+#undef TRMM_ARGS
+#undef GESV_PARAMS
+#undef GESV_ARGS
+#undef GETRF_PARAMS
+#undef GETRF_ARGS
+#undef GETRS_PARAMS
+#undef GETRS_ARGS
+#undef POTRF_PARAMS
+#undef POTRF_ARGS
+#undef POTRS_PARAMS
+#undef POTRS_ARGS
+#undef SYTRF_PARAMS
+#undef SYTRF_ARGS
+#undef SYTRS_PARAMS
+#undef SYTRS_ARGS
+#undef GEQRF_PARAMS
+#undef GEQRF_ARGS
+#undef ORGQR_PARAMS
+#undef ORGQR_ARGS
+#undef GESDD_PARAMS
+#undef GESDD_ARGS
+
+// properties of the scalar types:
+//  real  - type of the absolute value (and of log|det|)
+//  low   - the single precision type for mixed precision
+template <typename T> struct scalar_traits {
+  typedef T real;
+  typedef float low;
+  static const bool is_complex = false;
+  static T conj(T x) { return x; }
+  static real abs(T x) { return x < 0 ? -x : x; }
+  static real real_part(T x) { return x; }
+};
+
+template <typename T> struct scalar_traits< std::complex<T> > {
+  typedef T real;
+  typedef std::complex<float> low;
+  static const bool is_complex = true;
+  static std::complex<T> conj(std::complex<T> x) { return std::conj(x); }
+  static real abs(std::complex<T> x) { return std::abs(x); }
+  static real real_part(std::complex<T> x) { return x.real(); }
+};
+
 
 
 
@@ -10,11 +10,16 @@ using namespace LegionRuntime::HighLevel;
 #include "matrix.hpp"
 #include "solver_tasks.hpp"
 
-// legion matrix
+// legion matrix; the entries are doubles unless another
+//  scalar type is given when the region is created, which only
+//  the typed tasks support: init_data(), init_dense_blocks(),
+//  scale(), the leaf and node solves, gemmRed() and gemmBro()
+//  (see ScalarType)
 class LMatrix {
 public:
   LMatrix();
-  LMatrix(int, int, int, Context, HighLevelRuntime*);
+  LMatrix(int, int, int, Context, HighLevelRuntime*,
+	  ScalarType type=SCALAR_DOUBLE);
   LMatrix(int, int, LogicalRegion, IndexSpace, FieldSpace);
   LMatrix(LogicalRegion r, int rows, int cols);
 
@@ -27,7 +32,7 @@ public:
   
   int rows() const;
   int cols() const;
-  int rowBlk() const;
+  int rowBlk() const; // only exact if the rows split evenly
   int column_begin() const;
   int num_partition() const;
   int partition_level() const;
@@ -37,15 +42,18 @@ public:
   IndexPartition index_partition() const;
   LogicalPartition logical_partition() const;
   int small_block_parts() const;
+  ScalarType scalar_type() const;
   
   void set_column_size(int);
   void set_column_begin(int);
+  void set_small_block_parts(int);
   void set_logical_region(LogicalRegion);
   void set_parent_region(LogicalRegion);
   void set_logical_partition(LogicalPartition lp);
   
   // create logical region
-  void create(int, int, Context, HighLevelRuntime*);
+  void create(int, int, Context, HighLevelRuntime*,
+	      ScalarType type=SCALAR_DOUBLE);
 
   // set the matrix to value
   void clear
@@ -65,11 +73,19 @@ public:
   (int, int, const Matrix& mat, Context, HighLevelRuntime*,
    bool wait=WAIT_DEFAULT);
   
+  // copy the entries of mat, which needs no seeds, by an
+  //  inline mapping, e.g., the indices of a permutation
+  void init_entries(const Matrix& mat, Context, HighLevelRuntime*);
+
   // output region
   Matrix to_matrix(Context, HighLevelRuntime*);
   Matrix to_matrix(int, int, Context, HighLevelRuntime*);
   Matrix to_matrix(int, int, int, int, Context, HighLevelRuntime*);
 
+  // the columns of this matrix in a region of scalar type T
+  template <typename T>
+  void to_matrix(PtrMatrixT<T>&, Context, HighLevelRuntime*);
+
   // to be removed
   void init_data
   (int, const Matrix& VMat, Context, HighLevelRuntime*,
@@ -86,6 +102,23 @@ public:
   (const Matrix& UMat, const Matrix& VMat, const Vector& DVec,
    Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
 
+  // dense leaf blocks K + diag(D)
+  void init_dense_blocks
+  (const Matrix& KMat, const Vector& DVec,
+   Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
+  // dense leaf blocks from the entry function func
+  //  (see register_entry_func())
+  void init_entry_blocks
+  (int func, Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
+  // the same with the rows in the order of perm, i.e., entry
+  //  (i, j) is func(perm(i), perm(j)), where perm is partitioned
+  //  like this matrix and holds the indices in its first column
+  void init_entry_blocks
+  (int func, const LMatrix& perm, Context, HighLevelRuntime*,
+   bool wait=WAIT_DEFAULT);
+
   void init_dense_blocks
   (int, int, const Matrix& UMat, const Matrix& VMat, const Vector& DVec,
    Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
@@ -114,21 +147,192 @@ public:
   //(int, const Matrix& U, const Matrix& V, const Vector& D,
   //Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
   
-  // solve linear system
+  // solve linear system; ranks is the rank profile of the tree
+  //  and vcols the first column of every level in V. With
+  //  shared, the u columns of every depth are the leading
+  //  columns of one basis, whose leaf solve is done only once
+  //  (see KTree::init()); the same holds for solve_shifts() and
+  //  factor() below. The dense blocks are overwritten by their
+  //  LU factors, unlike with solve_shifts()
   // for KTree::solve()
   void solve
-  (LMatrix&, LMatrix&, Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+  (LMatrix&, LMatrix&, const std::vector<int>& ranks,
+   const std::vector<int>& vcols, bool shared,
+   Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
+  // solve with K + shifts[k]*I for all shifts at once, where
+  //  this matrix is not touched: every shift takes a block of
+  //  W (W.cols()/shifts.size() columns), which is a copy of
+  //  the leading columns of b before the solve
+  // for KTree::solve_shifts()
+  void solve_shifts
+  (const LMatrix& b, LMatrix& W, LMatrix& V, const std::vector<int>& ranks,
+   const std::vector<int>& vcols, bool shared, const std::vector<double>& shifts,
+   Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
+  // solve with the factors from factor(), or with the
+  //  transpose of this matrix for trans
+  // for KTree::solve_factored()
+  void solve
+  (LMatrix&, LMatrix&, LMatrix&, const std::vector<int>& ranks,
+   const std::vector<int>& vcols, bool trans,
+   Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
+  // factorize the dense blocks and the node systems
+  //  below the launch level; with spd, the dense blocks are
+  //  Cholesky factorized and the node systems are symmetric
+  //  (see node_factor()), and with single the factorizations
+  //  are done in single precision; the future holds log|det|
+  //  of all the blocks. Unless update is empty, only the leaves
+  //  i with update[i] and the node systems above them are
+  //  factorized, and the other blocks keep their factors
+  // for KTree::factor()
+  Future factor
+  (LMatrix&, LMatrix&, LMatrix&, const std::vector<int>& ranks,
+   const std::vector<int>& vcols, bool shared, bool spd, bool single,
+   const std::vector<bool>& update,
+   Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
+  // solve with the symmetric factors (factor() with spd), which
+  //  need no V: V'*d is formed as u'*b from the copy of the right
+  //  hand side at column bcol of b
+  // for KTree::solve_factored()
+  void solve_spd
+  (LMatrix& b, LMatrix& S, const std::vector<int>& ranks, int bcol,
+   Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
+  // the diagonal of the inverse (X has one column) or its leaf
+  //  blocks (X has the columns of the widest leaf) from the
+  //  factors of factor(), which start at column U.column_begin()
+  //  of U; Z is the workspace of HMatrix::inverse_diagonal(),
+  //  with the corrections of the levels above the launch level
+  //  at column wcol, and V is not used with spd
+  // for KTree::inverse_diagonal()
+  void inverse_diagonal
+  (const LMatrix& U, const LMatrix& V, LMatrix& S, LMatrix& Z, LMatrix& X,
+   const std::vector<int>& ranks, const std::vector<int>& vcols,
+   int wcol, bool spd, Context, HighLevelRuntime*,
+   bool wait=WAIT_DEFAULT);
+
+  // factorize A = W*W' for the rows of every partition: the
+  //  dense blocks are Cholesky factorized and the node factors
+  //  below the launch level go to S (see LeafSqrtTask); the u
+  //  columns are overwritten and the future holds log|det|
+  // for KTree::factor_sqrt()
+  Future factor_sqrt
+  (LMatrix& U, LMatrix& S, const std::vector<int>& ranks, bool shared,
+   Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
+  // B = W*B, or W'*B for trans='t', with the factors of
+  //  factor_sqrt() for the rows of every partition
+  // for KTree::multiply_sqrt()
+  void multiply_sqrt
+  (char trans, const LMatrix& U, LMatrix& S, const std::vector<int>& ranks,
+   LMatrix& B, Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
+  // random test vectors for the off-diagonal blocks at depth
+  //  level-1 (see SketchTask), or identity leaf blocks if
+  //  rank=0; the columns of this matrix are overwritten
+  void sketch
+  (int level, int rank, Context, HighLevelRuntime*,
+   bool wait=WAIT_DEFAULT);
+
+  // y += alpha*op(A)*x for the part of A inside every partition
+  //  (see LeafMultiplyTask), where this matrix holds the dense
+  //  blocks, which are shifted by sigma*I, and U, V the bases;
+  //  ucols and vcols are the first columns of every level in U
+  //  and V
+  // for KTree::multiply()
+  void multiply
+  (char trans, double alpha, int nlevel, bool dense, double sigma,
+   const LMatrix& U, const LMatrix& V, const std::vector<int>& ranks,
+   const std::vector<int>& ucols, const std::vector<int>& vcols,
+   const LMatrix& X, LMatrix& Y,
+   Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
+  // this = K0 + sigma*I for the dense blocks with nLeaf leaves
+  //  in every partition, where K0 is a copy of the leaf columns
+  // for KTree::shift()
+  void shift_diagonal
+  (double sigma, int nLeaf, const LMatrix& K0,
+   Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
+  // K0 += delta[k] at the diagonal entry of rows[k], and this =
+  //  K0 + sigma*I for the leaf blocks holding one of the rows,
+  //  while the other blocks are not touched
+  // for KTree::add_diagonal()
+  void add_diagonal
+  (const std::vector<int>& rows, const std::vector<double>& delta,
+   double sigma, int nLeaf, LMatrix& K0,
+   Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
 
   // solve node system
   // for HMatrix::solve()
   void node_solve
   (LMatrix&, Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
 
+  // solve the node systems of batch shifts at once: the blocks
+  //  of every shift are side by side in this matrix and in b
+  // for HMatrix::solve_shifts()
+  void node_solve
+  (LMatrix& b, int batch, Context, HighLevelRuntime*,
+   bool wait=WAIT_DEFAULT);
+
+  // factorize node system; with spd (V=u before the solve)
+  //  the symmetric form is factorized instead. The future holds
+  //  logdet plus log|det| of all the node systems. Unless update
+  //  is empty, only the systems i with update[i] are factorized,
+  //  and the others keep their factors
+  // for HMatrix::factor()
+  Future node_factor
+  (LMatrix&, bool spd, bool single, const std::vector<bool>& update,
+   const Future& logdet, Context, HighLevelRuntime*,
+   bool wait=WAIT_DEFAULT);
+
+  // solve node system with the factors from node_factor(),
+  //  or the transposed system with trans (not for spd)
+  // for HMatrix::solve() and HMatrix::solve_transpose()
+  void node_solve_factored
+  (LMatrix&, bool spd, bool trans, Context, HighLevelRuntime*,
+   bool wait=WAIT_DEFAULT);
+
+  // the blocks of the inverse node systems that couple the two
+  //  children, from the factors of node_factor(); R has rank
+  //  rows for every child (see two_level_partition()), which hold
+  //  the block of its sibling (see NodeInverseTask)
+  // for HMatrix::inverse_diagonal()
+  void node_inverse
+  (LMatrix& R, bool spd, Context, HighLevelRuntime*,
+   bool wait=WAIT_DEFAULT);
+
+  // the node factors of A = W*W' from u'*u in this matrix (see
+  //  NodeSqrtTask), stored in S; unless b is NULL, b = Y*b for
+  //  the node part Y of the inverse, which eliminates the u
+  //  columns of this level from the levels above. The future
+  //  holds logdet plus log|det| of the node factors
+  // for HMatrix::factor_sqrt()
+  Future node_sqrt
+  (LMatrix& S, LMatrix* b, const Future& logdet, Context, HighLevelRuntime*,
+   bool wait=WAIT_DEFAULT);
+
+  // b = X*b, or X'*b for trans='t', with the node factors
+  //  of node_sqrt() in this matrix
+  // for HMatrix::multiply_sqrt()
+  void node_multiply_sqrt
+  (LMatrix& b, char trans, Context, HighLevelRuntime*,
+   bool wait=WAIT_DEFAULT);
+
   static void node_solve
   (LMatrix&, LMatrix&, LMatrix&, LMatrix&,
    PhaseBarrier pb_wait, PhaseBarrier pb_ready,
    Context ctx, HighLevelRuntime* runtime, bool wait=WAIT_DEFAULT);
 
+  // the same for batch shifts side by side in all regions
+  static void node_solve
+  (LMatrix&, LMatrix&, LMatrix&, LMatrix&, int batch,
+   PhaseBarrier pb_wait, PhaseBarrier pb_ready,
+   Context ctx, HighLevelRuntime* runtime, bool wait=WAIT_DEFAULT);
+
   // print the values on screen
   // for debugging
   void display
@@ -137,14 +341,33 @@ public:
 
   // free resources
   void clear(Context, HighLevelRuntime*);
+
+  // move the entries to a new region of type, partitioned like
+  //  this matrix, and free the old region (see convert()); this
+  //  matrix is a whole region, and a two level partition has to
+  //  be made again
+  void set_scalar_type(ScalarType, Context, HighLevelRuntime*);
   
   // static methods
-  // matrix subtraction
+  // matrix addition C = alpha*A + beta*B, where C is either
+  //  A or B (the same columns) or not in their regions
   static void add
   (double alpha, const LMatrix&,
    double beta,  const LMatrix&, LMatrix&,
    Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
 
+  // B = A in the scalar type of B, which differs from the one of
+  //  A in precision only, e.g., to keep factors computed in
+  //  single precision in a float region
+  static void convert
+  (const LMatrix& A, LMatrix& B,
+   Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
+  // inner product sum(A.*B) as a future (a double)
+  static Future dot
+  (const LMatrix&, const LMatrix&,
+   Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
   // gemm reduction
   // C = alpha*op(A) * op(B) + beta*C
   static void gemmRed
@@ -152,21 +375,109 @@ public:
    double, LMatrix&, Context, HighLevelRuntime*,
    bool wait=WAIT_DEFAULT);
 
+  // batched products with the same A, e.g., for the shifts
+  //  in HMatrix::solve_shifts(): B is the first of batch
+  //  blocks stride columns apart in its region, and C holds
+  //  the batch results side by side. The same holds for
+  //  the batched gemm() below.
+  static void gemmRed
+  (char, char, double, const LMatrix& A, const LMatrix& B,
+   double, LMatrix& C, int batch, int stride,
+   Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
   static void gemm
   (char, char, double, const LMatrix&, const LMatrix&,
    double, LMatrix&, Context, HighLevelRuntime*,
    bool wait=WAIT_DEFAULT);
 
+  static void gemm
+  (char, char, double, const LMatrix& A, const LMatrix& B,
+   double, LMatrix& C, int batch, int stride,
+   Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
   static void gemm_inplace
   (char, char, double, const LMatrix&, const LMatrix&,
    double, LMatrix&, Context, HighLevelRuntime*,
    bool wait=WAIT_DEFAULT);
 
+  // batched version: A and C are the first of batch blocks
+  //  stride columns apart in their region, and B holds the
+  //  batch blocks side by side. The same holds for the
+  //  batched gemmBro() below.
+  static void gemm_inplace
+  (char, char, double, const LMatrix& A, const LMatrix& B,
+   double, LMatrix& C, int batch, int stride,
+   Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
+  // compress the off-diagonal blocks at depth level from the
+  //  entry function func by ACA: u goes to columns [ucol,
+  //  ucol+rank) of U and v to columns [vcol, vcol+rank) of V
+  static void aca
+  (int func, double tol, int level, int ucol, int vcol, int rank,
+   const LMatrix& U, const LMatrix& V, Context, HighLevelRuntime*,
+   bool wait=WAIT_DEFAULT);
+
+  // the same with the rows in the order of perm (see
+  //  init_entry_blocks())
+  static void aca
+  (int func, double tol, int level, int ucol, int vcol, int rank,
+   const LMatrix& U, const LMatrix& V, const LMatrix& perm,
+   Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
+  // dst(i, :) = src(P(i, pcol), :) for every row i of dst, or
+  //  src(P(i, pcol), :) = dst(i, :) with scatter, where P holds
+  //  row indices of src and is partitioned like dst, and spart is
+  //  the partition of src from permute_partition(); every task
+  //  maps only the rows of src in its part (see PermuteTask)
+  static void permute
+  (const LMatrix& P, int pcol, const LMatrix& src, LogicalPartition spart,
+   LMatrix& dst, bool scatter, Context, HighLevelRuntime*,
+   bool wait=WAIT_DEFAULT);
+
+  // the partition of src for permute(), colored like P, where
+  //  rows holds the indices of P on the host; it is made once
+  //  for all the columns of src and destroyed by the caller
+  static LogicalPartition permute_partition
+  (const std::vector<int>& rows, const LMatrix& P, const LMatrix& src,
+   Context, HighLevelRuntime*);
+
+  // recompress the off-diagonal blocks at depth level, whose u
+  //  and v are in columns [ucol, ucol+rank) of U and [vcol,
+  //  vcol+rank) of V, by QR and SVD (see RecompressTask); the
+  //  columns are rotated in place in the order of the singular
+  //  values, and the largest rank any block needs for the
+  //  relative tolerance tol is returned (the host waits for it)
+  static int recompress
+  (double tol, int level, int ucol, int vcol, int rank,
+   const LMatrix& U, const LMatrix& V, Context, HighLevelRuntime*);
+
+  // copy the samples of the blocks at depth level-1 from Y, the
+  //  product with a sketch, to columns [col, col+rank) of B (see
+  //  PeelBlockTask); with orth they are orthonormalized and also
+  //  written to X as the sketch of the transposed product
+  static void peel
+  (int level, int rank, bool orth, const LMatrix& Y, const LMatrix& B,
+   int col, const LMatrix& X, Context, HighLevelRuntime*,
+   bool wait=WAIT_DEFAULT);
+
   // gemm broadcast
   static void gemmBro
   (char, char, double, const LMatrix&, const LMatrix&,
    double, LMatrix&, Context, HighLevelRuntime*,
    bool wait=WAIT_DEFAULT);
+
+  static void gemmBro
+  (char, char, double, const LMatrix& A, const LMatrix& B,
+   double, LMatrix& C, int batch, int stride,
+   Context, HighLevelRuntime*, bool wait=WAIT_DEFAULT);
+
+  // same as gemmBro(), but every block of A is multiplied with
+  //  the block of the sibling node in B, and C is a different
+  //  region partitioned like A
+  static void gemmSib
+  (char, char, double, const LMatrix&, const LMatrix&,
+   double, LMatrix&, Context, HighLevelRuntime*,
+   bool wait=WAIT_DEFAULT);
   
 private:
 
@@ -178,25 +489,80 @@ private:
   ArgumentMap MapSeed(const Matrix& matrix);
   ArgumentMap MapSeed
   (const Matrix& U, const Matrix& V, const Vector& D);
+  ArgumentMap MapSeed(const Matrix& K, const Vector& D);
   
   // to be removed 
   ArgumentMap MapSeed(int nPart, const Matrix& matrix);
   ArgumentMap MapSeed(int nPart, const Matrix& U, const Matrix& V, const Vector& D);
 
-  // partition the matrix along rows
+  // partition the matrix along rows following the tree
+  //  (see block_begin()), so the blocks may differ by one row
   IndexPartition UniformRowPartition
   (Context ctx, HighLevelRuntime *runtime);
   
   IndexPartition UniformRowPartition
   (int num_subregions, int, int, Context ctx, HighLevelRuntime *runtime);
 
-  /*
+  // the launchers of the typed tasks for scalar type T, which
+  //  the methods above call for the type of the regions
+  template <typename T>
+  void scale
+  (double, Context, HighLevelRuntime*, bool wait);
+
+  template <typename T>
+  void init_data
+  (int, int, const Matrix& mat, Context, HighLevelRuntime*,
+   bool wait);
+
+  template <typename T>
+  void init_dense_blocks
+  (const Matrix& UMat, const Matrix& VMat, const Vector& DVec,
+   Context, HighLevelRuntime*, bool wait);
+
+  template <typename T>
+  void init_dense_blocks
+  (const Matrix& KMat, const Vector& DVec,
+   Context, HighLevelRuntime*, bool wait);
+
   template <typename T>
   void solve
-  (LMatrix& b, Context ctx, HighLevelRuntime *runtime,
-   bool wait=WAIT_DEFAULT);
-  */
+  (LMatrix&, LMatrix&, const std::vector<int>& ranks,
+   const std::vector<int>& vcols, bool shared,
+   Context, HighLevelRuntime*, bool wait);
+
+  template <typename T>
+  void solve
+  (LMatrix&, LMatrix&, LMatrix&, const std::vector<int>& ranks,
+   const std::vector<int>& vcols, bool trans,
+   Context, HighLevelRuntime*, bool wait);
+
+  template <typename T>
+  void solve_spd
+  (LMatrix& b, LMatrix& S, const std::vector<int>& ranks, int bcol,
+   Context, HighLevelRuntime*, bool wait);
+
+  template <typename T>
+  void node_solve
+  (LMatrix& b, int batch, Context, HighLevelRuntime*, bool wait);
+
+  template <typename T>
+  void node_solve_factored
+  (LMatrix&, bool spd, bool trans, Context, HighLevelRuntime*,
+   bool wait);
+
+  template <typename T>
+  static void gemmRed
+  (char, char, double, const LMatrix& A, const LMatrix& B,
+   double, LMatrix& C, int batch, int stride,
+   Context, HighLevelRuntime*, bool wait);
+
+  template <typename T>
+  static void gemmBro
+  (char, char, double, const LMatrix& A, const LMatrix& B,
+   double, LMatrix& C, int batch, int stride,
+   Context, HighLevelRuntime*, bool wait);
   
+
   // ******************
   // private variables
   // ******************
@@ -207,6 +573,7 @@ private:
   int colIdx;   // starting column index in the region
   int smallblk; // number of blocks in every partition,
                 //  used when treelvel != launchlvl
+  ScalarType type; // of the entries, see create()
   
   // number of ranks
   // used to init data
@@ -4,7 +4,28 @@
 #include <vector>
 #include <string>
 
+// first row of block i when nrow rows are split into nblk
+//  (a power of two) blocks by a binary tree, where every node
+//  gives half of its rows (rounded down) to the left child and
+//  the rest to the right child; i=nblk returns nrow
+int block_begin(int nrow, int nblk, int i);
+
+// the block of block_begin() that holds row
+int block_index(int nrow, int nblk, int row);
+
 class Matrix;
+
+// order points (one per row, one coordinate per column) for a
+//  tree with nLevel levels: every node splits its points like
+//  block_begin() splits its rows, the first half (rounded down)
+//  going left, across the widest coordinate (KD tree) or, with
+//  pca, across the principal axis of the points. Row i of the
+//  tree is point perm[i] for the returned perm, so nearby points
+//  share subtrees and the off-diagonal blocks couple separated
+//  clusters (see HMatrix::set_permutation())
+std::vector<int> cluster_order
+(const Matrix& points, int nLevel, bool pca=false);
+
 class Vector {
 public:
   Vector();
@@ -52,6 +73,12 @@ public:
   // static methods
   template <int value>
   static Vector constant(int);
+
+  // the vectors one below the other, e.g., the diagonals of
+  //  independent systems (see HMatrix::init_batch()); their
+  //  number is a power of two and they have the same size,
+  //  partitions and offset
+  static Vector stack(const std::vector<Vector>&);
   
 private:
   int nPart;
@@ -88,7 +115,7 @@ public:
   int num_partition() const;
   
   // random matrix with a random seed for each partition
-  // the partition is horizontal
+  // the partition is horizontal and follows block_begin()
   void rand(int);
   void rand();
 
@@ -129,6 +156,11 @@ public:
   static Matrix constant(int m, int n);
 
   static Matrix identity(int);
+
+  // the matrices one below the other, as the leaves of a deeper
+  //  tree; their number is a power of two and they have the
+  //  same size and partitions (see Vector::stack())
+  static Matrix stack(const std::vector<Matrix>&);
   
 private:
   int  mLevel;
@@ -0,0 +1,50 @@
+#ifndef _node_system_hpp
+#define _node_system_hpp
+
+// The node system of rank r
+// --     --  --    --     --      --
+// |  I  Q |  | eta0 |     | V1'*d1 |
+// |       |  |      |  =  |        |     P = V0'*u0, Q = V1'*u1
+// |  P  I |  | eta1 |     | V0'*d0 |
+// --     --  --    --     --      --
+//  is solved by block elimination with the r x r Schur
+//  complement M = I - Q*P:
+//    eta0 = M \ (V1'*d1 - Q*V0'*d0),  eta1 = V0'*d0 - P*eta0,
+//  so only M is factorized, and det(S) = det(M).
+// The stored node system (see NodeFactorTask and hfactor()) keeps
+//  P and Q in the off-diagonal blocks of the 2r x 2r block, the LU
+//  factors of M in the top left block and the pivots of M (as
+//  scalars) in the first r rows of column 2r.
+// The right hand side is passed in two blocks B0 = V0'*d0 and
+//  B1 = V1'*d1, which are overwritten by eta0 and eta1.
+// T is the scalar type (see PtrMatrixT); the transpose is not
+//  conjugated for complex types, like A = U*V' + D.
+
+#include "lapack_blas.hpp" // for scalar_traits
+
+// form and factorize M in place of the top left block of S;
+//  returns log|det S|
+template <typename T>
+typename scalar_traits<T>::real node_system_factor
+(int r, T *S, int LDS, T *ipiv, bool single=false);
+
+// log|det S| from the factors kept by node_system_factor()
+template <typename T>
+typename scalar_traits<T>::real node_system_log_det
+(int r, const T *S, int LDS);
+
+// solve with the factors from node_system_factor(), or with the
+//  transposed system for trans='t', where B0 = u0'*d0 and
+//  B1 = u1'*d1 (see HMatrix::solve_transpose())
+template <typename T>
+void node_system_solve
+(int r, const T *S, int LDS, const T *ipiv, char trans,
+ int nrhs, T *B0, int LDB0, T *B1, int LDB1);
+
+// solve once without keeping the factors
+template <typename T>
+void node_system_solve
+(int r, const T *P, int LDP, const T *Q, int LDQ,
+ int nrhs, T *B0, int LDB0, T *B1, int LDB1);
+
+#endif
@@ -4,73 +4,137 @@
 #include <iostream>
 #include <string>
 
+#include "lapack_blas.hpp" // for scalar_traits
+
 // The motivation is to encapsulate various matrix interpretation
 //  from pointers.
 // This matrix can work on data by existing pointers and provide
 //  the wrapper for linear algebra operations with blas and lapack.
-class PtrMatrix {
+// The scalar type T is float, double, complex_float or
+//  complex_double (see ptr_matrix.cc); the blas and lapack
+//  routines are picked at compile time (see lapack_blas.hpp).
+// Only these kernels and the Add reduction are typed: Matrix,
+//  LMatrix and the tasks still hold doubles (see TODO).
+template <typename T>
+class PtrMatrixT {
 public:
-  PtrMatrix();
+  // type of log|det| and of norms
+  typedef typename scalar_traits<T>::real real;
+
+  PtrMatrixT();
   // allocate memory constructor
   // used in DenseBlcokTask
-  PtrMatrix(int, int);
+  PtrMatrixT(int, int);
   // init with existing pointer
-  PtrMatrix(int, int, int, double*, char trans='n');
-  ~PtrMatrix();
-  
+  PtrMatrixT(int, int, int, T*, char trans='n');
+  ~PtrMatrixT();
+
   void rand(long seed, int offset=0);
   void display(const std::string&);
 
   int rows() const;
   int cols() const;
   int LD() const;
-  double* pointer() const;
-  double* pointer(int, int);
+  T* pointer() const;
+  T* pointer(int, int);
 
   void set_trans(char);
-  
-  void solve(PtrMatrix&);
+
+  void solve(PtrMatrixT&);
+
+  // LU factorize in place; pivots are stored as scalars
+  //  so that they can live in a region. With single, the
+  //  matrix is rounded to single precision and factorized,
+  //  and the factors are stored back.
+  // All factorizations return log|det| of the matrix.
+  real factor(T *ipiv, bool single=false);
+
+  // solve with the LU factors from factor(), or with
+  //  their transpose for trans='t'
+  void solve(PtrMatrixT&, const T *ipiv, char trans='n');
+
+  // Cholesky factorize in place (lower triangle)
+  //  for symmetric (Hermitian) positive definite matrices
+  real factor_cholesky(bool single=false);
+
+  // solve with the factor from factor_cholesky()
+  void solve_cholesky(PtrMatrixT&);
+
+  // B = L*B or B = L \ B with the lower triangle L of
+  //  factor_cholesky(), or with L' for trans='t'
+  void multiply_triangular(PtrMatrixT&, char trans='n');
+  void solve_triangular(PtrMatrixT&, char trans='n');
+
+  // LDL' factorize a symmetric (indefinite) matrix in place
+  //  using its lower triangle; pivots are stored as scalars
+  real factor_symmetric(T *ipiv, bool single=false);
+
+  // solve with the factors from factor_symmetric()
+  void solve_symmetric(PtrMatrixT&, const T *ipiv);
+
+  // log|det| of the matrix from the factors left in place by
+  //  factor(), factor_cholesky() or factor_symmetric(), for
+  //  factors that are kept rather than computed again
+  real log_det_lu() const;
+  real log_det_cholesky() const;
+  real log_det_symmetric(const T *ipiv) const;
+
+  // overwrite the columns by an orthonormal basis of
+  //  their span (thin QR)
+  void orthonormalize();
 
   // set all entries to value
-  void clear(double value);
+  void clear(T value);
 
   // scale all entries
-  void scale(double value);
-  
+  void scale(T value);
+
   // initialize to identity matrix
   void identity();
 
   // return entry/reference to the matrix entry
-  double  operator()(int, int) const;
-  double& operator()(int, int);
+  T  operator()(int, int) const;
+  T& operator()(int, int);
 
   static void add
-  (double alpha, const PtrMatrix&,
-   double beta,  const PtrMatrix&,
-   PtrMatrix&);
-  
+  (T alpha, const PtrMatrixT&,
+   T beta,  const PtrMatrixT&,
+   PtrMatrixT&);
+
+  // sum of conj(A(i,j))*B(i,j)
+  static T dot(const PtrMatrixT&, const PtrMatrixT&);
+
   static void gemm
-  (const PtrMatrix&, const PtrMatrix&, const PtrMatrix&, PtrMatrix&);
-  
+  (const PtrMatrixT&, const PtrMatrixT&, const PtrMatrixT&, PtrMatrixT&);
+
   static void gemm
-  (double, const PtrMatrix&, const PtrMatrix&, PtrMatrix&);
+  (T, const PtrMatrixT&, const PtrMatrixT&, PtrMatrixT&);
 
   static void gemm
-  (double, const PtrMatrix&, const PtrMatrix&, double, PtrMatrix&);
+  (T, const PtrMatrixT&, const PtrMatrixT&, T, PtrMatrixT&);
 
 private:
 
-  // private variables  
+  typedef typename scalar_traits<T>::low low;
+
+  // copy between the matrix and a packed single precision array
+  void to_single(low *) const;
+  void from_single(const low *);
+
+  // private variables
   int mRows;
   int mCols;
   int leadD; // leading dimension
-  double *ptr;
+  T *ptr;
   bool has_memory;
-  
+
 public:
   // 't' for transpose, 'n' for no transpose
   // used in gemm
-  char trans; 
+  char trans;
 };
 
+// the default scalar type of the regions (see ScalarType)
+typedef PtrMatrixT<double> PtrMatrix;
+
 #endif
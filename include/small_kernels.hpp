@@ -0,0 +1,63 @@
+#ifndef _small_kernels_hpp
+#define _small_kernels_hpp
+
+#include <stddef.h> // for NULL
+
+// Kernels for the node systems of small rank r, i.e., the
+//  r x r LU factorization and solve of the Schur complement
+//  (see node_system.hpp) and the products with r columns in
+//  the node eliminations. They are instantiated
+//  for every rank up to MAX_SMALL_RANK (see small_kernels.cc),
+//  so the loop bounds are known at compile time, and a task
+//  picks them from the rank in its arguments; lapack and blas
+//  are used for larger ranks, where the call overhead does not
+//  matter.
+// The matrices are column major with leading dimensions, and
+//  pivots are stored as doubles like in PtrMatrix::factor().
+// The kernels exist for doubles only: the typed node eliminations
+//  (see node_system.hpp) get NULL from small_kernels<T>() for the
+//  other scalar types and take the blas and lapack path.
+
+const int MAX_SMALL_RANK = 32;
+
+template <typename T>
+struct SmallKernelsT {
+  // LU factorize the r x r matrix A in place with partial
+  //  pivoting, as dgetrf_(); returns log|det A|
+  double (*getrf)(T *A, int LDA, T *ipiv);
+
+  // solve with the factors from getrf(), or with their
+  //  transpose for trans='t', as dgetrs_()
+  void (*getrs)
+  (char trans, const T *A, int LDA, const T *ipiv,
+   int nrhs, T *B, int LDB);
+
+  // C = A'*B, where A is n x r, B is n x nrhs and C is r x nrhs
+  void (*gemm_tn)
+  (int n, int nrhs, const T *A, int LDA, const T *B, int LDB,
+   T *C, int LDC);
+
+  // C -= A*B, where A is n x r, B is r x nrhs and C is n x nrhs
+  void (*gemm_nn_sub)
+  (int n, int nrhs, const T *A, int LDA, const T *B, int LDB,
+   T *C, int LDC);
+};
+
+typedef SmallKernelsT<double> SmallKernels;
+
+// the kernels for rank r, or NULL if r > MAX_SMALL_RANK
+const SmallKernels* small_kernels(int r);
+
+// the same for the scalar type T, which is always NULL
+//  unless T is double
+template <typename T>
+inline const SmallKernelsT<T>* small_kernels(int) {
+  return NULL;
+}
+
+template <>
+inline const SmallKernels* small_kernels<double>(int r) {
+  return small_kernels(r);
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef _aca_block_hpp
+#define _aca_block_hpp
+
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+// compress one off-diagonal block, i.e., the rows of a child
+//  against the columns of its sibling, by adaptive cross
+//  approximation: u goes to the rows of the child and v to the
+//  rows of the sibling (see the SIBLING projection). With two
+//  more regions, the entry indices of the rows of the child and
+//  of the sibling come from a permutation
+class AcaBlockTask : public IndexLauncher {
+public:
+  struct TaskArgs {
+    int    func;  // entry function, see register_entry_func()
+    int    ucol;  // first u column of the depth in U
+    int    vcol;  // first v column of the depth in V
+    int    rank;  // largest rank; unused columns are zero
+    double tol;   // relative tolerance of the approximation
+  };
+  AcaBlockTask(Domain domain,
+	       TaskArgument global_arg,
+	       ArgumentMap arg_map,
+	       MappingTagID tag = 0,
+	       Predicate pred = Predicate::TRUE_PRED,
+	       bool must = false,
+	       MapperID id = 0);
+  
+  static int TASKID;
+
+  static void register_tasks(void);
+
+public:
+  static void
+  cpu_task(const Task *task,
+	   const std::vector<PhysicalRegion> &regions,
+	   Context ctx, HighLevelRuntime *runtime);
+};
+
+#endif
@@ -9,8 +9,9 @@ public:
   struct TaskArgs {
     double alpha;
     double beta;
-    int nrow;
     int cols;
+    // the first columns of A, B and C in their regions
+    int AcolIdx, BcolIdx, CcolIdx;
   };
   AddMatrixTask(Domain domain,
 		TaskArgument global_arg,
@@ -7,8 +7,8 @@ using namespace LegionRuntime::HighLevel;
 class ClearMatrixTask : public IndexLauncher {
 public:
   struct TaskArgs {
-    int rblock;
     int cols;
+    int colIdx;
     double value;
   };
   ClearMatrixTask(Domain domain,
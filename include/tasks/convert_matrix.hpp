@@ -0,0 +1,37 @@
+#ifndef _convert_matrix_hpp
+#define _convert_matrix_hpp
+
+#include "legion.h"
+#include "utility.hpp" // for ScalarType
+using namespace LegionRuntime::HighLevel;
+
+// B = A between regions of different scalar types, which only
+//  differ in precision (see LMatrix::convert())
+class ConvertMatrixTask : public IndexLauncher {
+public:
+  struct TaskArgs {
+    int cols;
+    // the first columns of A and B in their regions
+    int AcolIdx, BcolIdx;
+    ScalarType Atype, Btype;
+  };
+  ConvertMatrixTask(Domain domain,
+		    TaskArgument global_arg,
+		    ArgumentMap arg_map,
+		    Predicate pred = Predicate::TRUE_PRED,
+		    bool must = false,
+		    MapperID id = 0,
+		    MappingTagID tag = 0);
+  
+  static int TASKID;
+
+  static void register_tasks(void);
+
+public:
+  static void
+  cpu_task(const Task *task,
+	   const std::vector<PhysicalRegion> &regions,
+	   Context ctx, HighLevelRuntime *runtime);
+};
+
+#endif
@@ -11,20 +11,24 @@ struct ThreeSeeds {
   long dSeed;
 };
 
-class DenseBlockTask : public IndexLauncher {
+// T is the scalar type of the regions (see ScalarType), and
+//  every type is a task variant of its own
+template <typename T>
+class DenseBlockTaskT : public IndexLauncher {
 public:
   struct TaskArgs {
     int size;
-    int rank;
+    int rank;   // columns of U and V, or of K for dense leaves
     int offset;
+    bool dense; // the leaves are K + diag(D) instead of U*V' + diag(D)
   };
-  DenseBlockTask(Domain domain,
-		 TaskArgument global_arg,
-		 ArgumentMap arg_map,
-		 MappingTagID tag = 0,
-		 Predicate pred = Predicate::TRUE_PRED,
-		 bool must = false,
-		 MapperID id = 0);
+  DenseBlockTaskT(Domain domain,
+		  TaskArgument global_arg,
+		  ArgumentMap arg_map,
+		  MappingTagID tag = 0,
+		  Predicate pred = Predicate::TRUE_PRED,
+		  bool must = false,
+		  MapperID id = 0);
   
   static int TASKID;
 
@@ -37,4 +41,6 @@ public:
 	   Context ctx, HighLevelRuntime *runtime);
 };
 
+typedef DenseBlockTaskT<double> DenseBlockTask;
+
 #endif
@@ -0,0 +1,35 @@
+#ifndef _dot_product_hpp
+#define _dot_product_hpp
+
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+// every point returns its part of the inner product, so the
+//  launch is reduced with REDOP_ADD (see LMatrix::dot())
+class DotProductTask : public IndexLauncher {
+public:
+  struct TaskArgs {
+    int cols;
+    // the first columns of A and B in their regions
+    int AcolIdx, BcolIdx;
+  };
+  DotProductTask(Domain domain,
+		 TaskArgument global_arg,
+		 ArgumentMap arg_map,
+		 Predicate pred = Predicate::TRUE_PRED,
+		 bool must = false,
+		 MapperID id = 0,
+		 MappingTagID tag = 0);
+  
+  static int TASKID;
+
+  static void register_tasks(void);
+
+public:
+  static double
+  cpu_task(const Task *task,
+	   const std::vector<PhysicalRegion> &regions,
+	   Context ctx, HighLevelRuntime *runtime);
+};
+
+#endif
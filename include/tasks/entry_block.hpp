@@ -0,0 +1,35 @@
+#ifndef _entry_block_hpp
+#define _entry_block_hpp
+
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+// evaluate the dense leaf blocks from the matrix entries, with
+//  the entry index of every row from a permutation if the task
+//  has a second region (see LMatrix::init_entry_blocks())
+class EntryBlockTask : public IndexLauncher {
+public:
+  struct TaskArgs {
+    int func; // entry function, see register_entry_func()
+    int nblk; // number of leaves in every partition
+  };
+  EntryBlockTask(Domain domain,
+		 TaskArgument global_arg,
+		 ArgumentMap arg_map,
+		 MappingTagID tag = 0,
+		 Predicate pred = Predicate::TRUE_PRED,
+		 bool must = false,
+		 MapperID id = 0);
+  
+  static int TASKID;
+
+  static void register_tasks(void);
+
+public:
+  static void
+  cpu_task(const Task *task,
+	   const std::vector<PhysicalRegion> &regions,
+	   Context ctx, HighLevelRuntime *runtime);
+};
+
+#endif
@@ -19,6 +19,11 @@ public:
     int Acols;
     int Bcols;
     int Ccols;
+    // batch products with the same A: block k of B starts
+    //  k*stride columns after BcolIdx, and the blocks of C
+    //  are side by side
+    int batch;
+    int stride;
   };
   
   GemmTask(TaskArgument arg,
@@ -4,27 +4,37 @@
 #include "legion.h"
 using namespace LegionRuntime::HighLevel;
 
-class GemmBroTask : public IndexLauncher {
+// T is the scalar type of the regions (see ScalarType), and
+//  every type is a task variant of its own
+template <typename T>
+class GemmBroTaskT : public IndexLauncher {
 public:
   // the first member must be colorSize, which is referenced
   //  in the projector
   struct TaskArgs {
     int colorSize;
     int plevel;
-    double alpha;
+    T alpha;
     char transa, transb;
     int Arblk, Brblk, Crblk;
     int Acols, Bcols, Ccols;
-    int AcolIdx;
+    int AcolIdx, CcolIdx;
+    // B is the block of the sibling node (see
+    //  LMatrix::gemmSib())
+    bool sibling;
+    // batch products: block k of A and C starts k*stride
+    //  columns after their first block, and the blocks of B
+    //  are side by side (see HMatrix::solve_shifts())
+    int batch, stride;
   };
   
-  GemmBroTask(Domain domain,
-	      TaskArgument global_arg,
-	      ArgumentMap arg_map,
-	      MappingTagID tag = 0,
-	      Predicate pred = Predicate::TRUE_PRED,
-	      bool must = false,
-	      MapperID id = 0);
+  GemmBroTaskT(Domain domain,
+	       TaskArgument global_arg,
+	       ArgumentMap arg_map,
+	       MappingTagID tag = 0,
+	       Predicate pred = Predicate::TRUE_PRED,
+	       bool must = false,
+	       MapperID id = 0);
   
   static int TASKID;
 
@@ -37,4 +47,6 @@ public:
 	   Context ctx, HighLevelRuntime *runtime);
 };
 
+typedef GemmBroTaskT<double> GemmBroTask;
+
 #endif
@@ -18,6 +18,11 @@ public:
     int Bcols;
     int Ccols;
     int AcolIdx;
+    // batch products: block k of A and C starts k*stride
+    //  columns after their first block, and the blocks of B
+    //  are side by side
+    int batch;
+    int stride;
   };
   
   GemmInplaceTask
@@ -4,7 +4,10 @@
 #include "legion.h"
 using namespace LegionRuntime::HighLevel;
 
-class GemmRedTask : public IndexLauncher {
+// T is the scalar type of the regions (see ScalarType), and
+//  every type is a task variant of its own
+template <typename T>
+class GemmRedTaskT : public IndexLauncher {
 public:
   // the first member must be colorSize, which is referenced
   //  in the projector
@@ -13,20 +16,24 @@ public:
     int colorSize;
     int plevel;
     // gemm arguments
-    double alpha;
+    T alpha;
     char transa, transb;
     int Arblk, Brblk, Crblk;
     int Acols, Bcols, Ccols;
     int AcolIdx, BcolIdx, CcolIdx;
+    // batch products with the same A: block k of B starts
+    //  k*Bstride columns after BcolIdx, and the blocks of C
+    //  are side by side (see HMatrix::solve_shifts())
+    int batch, Bstride;
   };
   
-  GemmRedTask(Domain domain,
-	      TaskArgument global_arg,
-	      ArgumentMap arg_map,
-	      MappingTagID tag = 0,
-	      Predicate pred = Predicate::TRUE_PRED,
-	      bool must = false,
-	      MapperID id = 0);
+  GemmRedTaskT(Domain domain,
+	       TaskArgument global_arg,
+	       ArgumentMap arg_map,
+	       MappingTagID tag = 0,
+	       Predicate pred = Predicate::TRUE_PRED,
+	       bool must = false,
+	       MapperID id = 0);
 
   static void register_tasks(void);
   
@@ -38,4 +45,6 @@ public:
 	   Context ctx, HighLevelRuntime *runtime);
 };
 
+typedef GemmRedTaskT<double> GemmRedTask;
+
 #endif
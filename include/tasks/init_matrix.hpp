@@ -5,7 +5,10 @@
 using namespace LegionRuntime::HighLevel;
 using namespace LegionRuntime::Accessor;
 
-class InitMatrixTask : public IndexLauncher {
+// T is the scalar type of the regions (see ScalarType), and
+//  every type is a task variant of its own
+template <typename T>
+class InitMatrixTaskT : public IndexLauncher {
 public:
   struct TaskArgs {
     int rblk;
@@ -13,13 +16,13 @@ public:
     int clo;
     int chi;
   };
-  InitMatrixTask(Domain domain,
-		 TaskArgument global_arg,
-		 ArgumentMap arg_map,
-		 MappingTagID tag = 0,
-		 Predicate pred = Predicate::TRUE_PRED,
-		 bool must = false,
-		 MapperID id = 0);
+  InitMatrixTaskT(Domain domain,
+		  TaskArgument global_arg,
+		  ArgumentMap arg_map,
+		  MappingTagID tag = 0,
+		  Predicate pred = Predicate::TRUE_PRED,
+		  bool must = false,
+		  MapperID id = 0);
   
   static int TASKID;
 
@@ -32,4 +35,6 @@ public:
 	   Context ctx, HighLevelRuntime *runtime);
 };
 
+typedef InitMatrixTaskT<double> InitMatrixTask;
+
 #endif
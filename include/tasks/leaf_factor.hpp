@@ -0,0 +1,54 @@
+#ifndef _leaf_factor_hpp
+#define _leaf_factor_hpp
+
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+#include "utility.hpp" // for MAX_TREE_LEVEL
+
+// LU factorize the dense blocks and the node systems below
+//  the launch level; the u columns are overwritten by the
+//  factored solve, i.e., u = K \ u
+class LeafFactorTask : public IndexLauncher {
+public:
+  struct TaskArgs {
+    int colIdx; // first u column in the region
+    int ncol;   // number of u columns above the launch level
+    int nPart;
+    int Srblk;  // rows of node factors in every partition
+    // rank of every level inside a partition,
+    //  starting from the partition root
+    int ranks[MAX_TREE_LEVEL];
+    // first column of every level in V
+    int vcols[MAX_TREE_LEVEL];
+    // Cholesky leaves and symmetric node systems
+    bool spd;
+    // factorize in single precision (see PtrMatrix::factor())
+    bool single;
+    // with a shared basis (see KTree::init()), nShared is the
+    //  depth of the leaves and shared[k] the rank of depth k,
+    //  root first; otherwise nShared is zero
+    int nShared;
+    int shared[MAX_TREE_LEVEL];
+  };
+  LeafFactorTask(Domain domain,
+		 TaskArgument global_arg,
+		 ArgumentMap arg_map,
+		 MappingTagID tag = 0,
+		 Predicate pred = Predicate::TRUE_PRED,
+		 bool must = false,
+		 MapperID id = 0);
+  
+  static int TASKID;
+
+  static void register_tasks(void);
+
+public:
+  // returns log|det| of the factorized blocks
+  static double
+  cpu_task(const Task *task,
+	   const std::vector<PhysicalRegion> &regions,
+	   Context ctx, HighLevelRuntime *runtime);
+};
+
+#endif
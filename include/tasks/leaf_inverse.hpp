@@ -0,0 +1,56 @@
+#ifndef _leaf_inverse_hpp
+#define _leaf_inverse_hpp
+
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+#include "utility.hpp" // for MAX_TREE_LEVEL
+
+// the diagonal of the inverse, or its diagonal leaf blocks, on the
+//  rows of every partition from the factors of LeafFactorTask and
+//  the corrections of the levels above (see
+//  HMatrix::inverse_diagonal())
+class LeafInverseTask : public IndexLauncher {
+public:
+  struct TaskArgs {
+    // u columns above the launch level
+    int ncol;
+    int nPart;
+    // rank of every level inside a partition,
+    //  starting from the partition root
+    int ranks[MAX_TREE_LEVEL];
+    // first column of every level in V
+    int vcols[MAX_TREE_LEVEL];
+    // the u columns start at colIdx, and the node factors
+    //  take Srblk rows in every partition
+    int colIdx;
+    int Srblk;
+    // the corrections of the levels above start at column wcol
+    //  of the workspace
+    int wcol;
+    // symmetric factors: there is no V region and the workspace
+    //  only holds the corrections
+    bool spd;
+    // the leaf blocks rather than the diagonal
+    bool blocks;
+  };
+  LeafInverseTask(Domain domain,
+		  TaskArgument global_arg,
+		  ArgumentMap arg_map,
+		  MappingTagID tag = 0,
+		  Predicate pred = Predicate::TRUE_PRED,
+		  bool must = false,
+		  MapperID id = 0);
+
+  static int TASKID;
+
+  static void register_tasks(void);
+
+public:
+  static void
+  cpu_task(const Task *task,
+	   const std::vector<PhysicalRegion> &regions,
+	   Context ctx, HighLevelRuntime *runtime);
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef _leaf_multiply_hpp
+#define _leaf_multiply_hpp
+
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+#include "utility.hpp" // for MAX_TREE_LEVEL
+
+// y += alpha*op(A)*x for the part of the matrix inside every
+//  partition: the off-diagonal blocks of the first nlevel
+//  levels below the launch level and, optionally, the dense
+//  leaf blocks plus sigma*I
+class LeafMultiplyTask : public IndexLauncher {
+public:
+  struct TaskArgs {
+    char   trans;
+    double alpha;
+    int    nPart;  // leaves in every partition
+    int    nlevel; // levels of off-diagonal blocks
+    bool   dense;  // add the dense leaf blocks
+    double sigma;  // and sigma*I with them
+    int    ncol;   // columns of x and y
+    int    xcol, ycol;
+    // rank and first u/V column of every level inside
+    //  a partition, starting from the partition root
+    int ranks[MAX_TREE_LEVEL];
+    int ucols[MAX_TREE_LEVEL];
+    int vcols[MAX_TREE_LEVEL];
+  };
+  LeafMultiplyTask(Domain domain,
+		   TaskArgument global_arg,
+		   ArgumentMap arg_map,
+		   MappingTagID tag = 0,
+		   Predicate pred = Predicate::TRUE_PRED,
+		   bool must = false,
+		   MapperID id = 0);
+  
+  static int TASKID;
+
+  static void register_tasks(void);
+
+public:
+  static void
+  cpu_task(const Task *task,
+	   const std::vector<PhysicalRegion> &regions,
+	   Context ctx, HighLevelRuntime *runtime);
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef _leaf_shift_hpp
+#define _leaf_shift_hpp
+
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+#include "utility.hpp" // for MAX_TREE_LEVEL and MAX_SHIFTS
+
+// leaf solve of all shifts at once: every partition copies its
+//  right hand side and u columns into one block per shift and
+//  solves the block with the leaf blocks K + sigma*I, while K
+//  is not touched (see HMatrix::solve_shifts())
+class LeafShiftTask : public IndexLauncher {
+public:
+  struct TaskArgs {
+    int ncol;   // columns of one shift block
+    int nPart;
+    // rank of every level inside a partition,
+    //  starting from the partition root
+    int ranks[MAX_TREE_LEVEL];
+    // first column of every level in V
+    int vcols[MAX_TREE_LEVEL];
+    int nShift;
+    double shifts[MAX_SHIFTS];
+    // with a shared basis (see KTree::init()), nShared is the
+    //  depth of the leaves and shared[k] the rank of depth k,
+    //  root first; otherwise nShared is zero
+    int nShared;
+    int shared[MAX_TREE_LEVEL];
+  };
+  LeafShiftTask(Domain domain,
+		TaskArgument global_arg,
+		ArgumentMap arg_map,
+		MappingTagID tag = 0,
+		Predicate pred = Predicate::TRUE_PRED,
+		bool must = false,
+		MapperID id = 0);
+
+  static int TASKID;
+
+  static void register_tasks(void);
+
+public:
+  static void
+  cpu_task(const Task *task,
+	   const std::vector<PhysicalRegion> &regions,
+	   Context ctx, HighLevelRuntime *runtime);
+};
+
+#endif
@@ -4,21 +4,47 @@
 #include "legion.h"
 using namespace LegionRuntime::HighLevel;
 
-class LeafSolveTask : public IndexLauncher {
+#include "utility.hpp" // for MAX_TREE_LEVEL
+
+// T is the scalar type of the regions (see ScalarType), and
+//  every type is a task variant of its own
+template <typename T>
+class LeafSolveTaskT : public IndexLauncher {
 public:
   struct TaskArgs {
-    int nrow;
     int nRhs;
-    int rank;
     int nPart;
+    // rank of every level inside a partition,
+    //  starting from the partition root
+    int ranks[MAX_TREE_LEVEL];
+    // first column of every level in V
+    int vcols[MAX_TREE_LEVEL];
+    // solve with the factors from LeafFactorTask:
+    //  the u columns start at colIdx and the node
+    //  factors take Srblk rows in every partition
+    bool factored;
+    int colIdx;
+    int Srblk;
+    // symmetric factors: there is no V region and V'*d
+    //  is formed as u'*b from the copy of the right hand
+    //  side at column bcol
+    bool spd;
+    int bcol;
+    // solve with the transposed factors (not for spd)
+    bool trans;
+    // unfactored blocks with a shared basis (see KTree::init()):
+    //  nShared is the depth of the leaves and shared[k] the
+    //  rank of depth k, root first; otherwise nShared is zero
+    int nShared;
+    int shared[MAX_TREE_LEVEL];
   };
-  LeafSolveTask(Domain domain,
-		TaskArgument global_arg,
-		ArgumentMap arg_map,
-		MappingTagID tag = 0,
-		Predicate pred = Predicate::TRUE_PRED,
-		bool must = false,
-		MapperID id = 0);
+  LeafSolveTaskT(Domain domain,
+		 TaskArgument global_arg,
+		 ArgumentMap arg_map,
+		 MappingTagID tag = 0,
+		 Predicate pred = Predicate::TRUE_PRED,
+		 bool must = false,
+		 MapperID id = 0);
   
   static int TASKID;
 
@@ -31,4 +57,6 @@ public:
 	   Context ctx, HighLevelRuntime *runtime);
 };
 
+typedef LeafSolveTaskT<double> LeafSolveTask;
+
 #endif
@@ -0,0 +1,55 @@
+#ifndef _leaf_sqrt_hpp
+#define _leaf_sqrt_hpp
+
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+#include "utility.hpp" // for MAX_TREE_LEVEL
+
+// the factor W of A = W*W' for the rows of every partition (see
+//  HMatrix::factor_sqrt()), or its product with a block of vectors
+class LeafSqrtTask : public IndexLauncher {
+public:
+  struct TaskArgs {
+    // 'f' factorizes the leaf blocks and the node systems
+    //  below the launch level, and 'n' or 't' multiply the
+    //  columns of B by W or W'
+    char op;
+    // u columns above the launch level
+    int ncol;
+    int nPart;
+    // rank of every level inside a partition,
+    //  starting from the partition root
+    int ranks[MAX_TREE_LEVEL];
+    // the u columns start at colIdx, and the node
+    //  factors take Srblk rows in every partition
+    int colIdx;
+    int Srblk;
+    // the columns of B are [bcol, bcol+nRhs)
+    int bcol;
+    int nRhs;
+    // shared basis (see LeafSolveTask)
+    int nShared;
+    int shared[MAX_TREE_LEVEL];
+  };
+  LeafSqrtTask(Domain domain,
+	       TaskArgument global_arg,
+	       ArgumentMap arg_map,
+	       MappingTagID tag = 0,
+	       Predicate pred = Predicate::TRUE_PRED,
+	       bool must = false,
+	       MapperID id = 0);
+
+  static int TASKID;
+
+  static void register_tasks(void);
+
+public:
+  // returns log|det| of the factorized blocks for 'f'
+  static double
+  cpu_task(const Task *task,
+	   const std::vector<PhysicalRegion> &regions,
+	   Context ctx, HighLevelRuntime *runtime);
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _node_factor_hpp
+#define _node_factor_hpp
+
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+// form and LU factorize the node systems at one level
+class NodeFactorTask : public IndexLauncher {
+public:
+  struct TaskArgs {
+    int rblock;
+    int Acols;
+    // symmetric node system (see LMatrix::node_factor())
+    bool spd;
+    // factorize in single precision
+    bool single;
+  };
+  NodeFactorTask(Domain domain,
+		 TaskArgument global_arg,
+		 ArgumentMap arg_map,
+		 MappingTagID tag = 0);
+  
+  static int TASKID;
+
+  static void register_tasks(void);
+
+public:
+  // returns log|det| of the factorized blocks
+  static double
+  cpu_task(const Task *task,
+	   const std::vector<PhysicalRegion> &regions,
+	   Context ctx, HighLevelRuntime *runtime);
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef _node_inverse_hpp
+#define _node_inverse_hpp
+
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+// the blocks of the inverse node systems at one level that couple
+//  the two children, from the factors of NodeFactorTask (see
+//  HMatrix::inverse_diagonal())
+class NodeInverseTask : public IndexLauncher {
+public:
+  struct TaskArgs {
+    int rblock;
+    // symmetric node system (see LMatrix::node_factor())
+    bool spd;
+  };
+  NodeInverseTask(Domain domain,
+		  TaskArgument global_arg,
+		  ArgumentMap arg_map,
+		  MappingTagID tag = 0);
+
+  static int TASKID;
+
+  static void register_tasks(void);
+
+public:
+  static void
+  cpu_task(const Task *task,
+	   const std::vector<PhysicalRegion> &regions,
+	   Context ctx, HighLevelRuntime *runtime);
+};
+
+#endif
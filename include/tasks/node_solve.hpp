@@ -4,17 +4,29 @@
 #include "legion.h"
 using namespace LegionRuntime::HighLevel;
 
-class NodeSolveTask : public IndexLauncher {
+// T is the scalar type of the regions (see ScalarType), and
+//  every type is a task variant of its own
+template <typename T>
+class NodeSolveTaskT : public IndexLauncher {
 public:
   struct TaskArgs {
     int rblock;
     int Acols;
     int Bcols;
+    // A holds the LU factors from NodeFactorTask,
+    //  or the LDL' factors of the symmetric system
+    bool factored;
+    bool spd;
+    // solve with the transpose of the LU factors
+    bool trans;
+    // the unfactored systems of batch shifts, whose blocks
+    //  of A and B are side by side (see HMatrix::solve_shifts())
+    int batch;
   };
-  NodeSolveTask(Domain domain,
-		TaskArgument global_arg,
-		ArgumentMap arg_map,
-		MappingTagID tag = 0);
+  NodeSolveTaskT(Domain domain,
+		 TaskArgument global_arg,
+		 ArgumentMap arg_map,
+		 MappingTagID tag = 0);
   
   static int TASKID;
 
@@ -27,4 +39,6 @@ public:
 	   Context ctx, HighLevelRuntime *runtime);
 };
 
+typedef NodeSolveTaskT<double> NodeSolveTask;
+
 #endif
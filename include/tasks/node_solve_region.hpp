@@ -9,6 +9,9 @@ public:
   struct TaskArgs {
     int rank;
     int nRhs;
+    // systems of batch shifts side by side in all regions;
+    //  rank and nRhs are the columns of one block
+    int batch;
   };
   NodeSolveRegionTask(TaskArgument arg,
 		      Predicate pred = Predicate::TRUE_PRED,
@@ -0,0 +1,35 @@
+#ifndef _node_sqrt_hpp
+#define _node_sqrt_hpp
+
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+// the node factors of A = W*W' at one level (see
+//  HMatrix::factor_sqrt()), or their product with V'*d
+class NodeSqrtTask : public IndexLauncher {
+public:
+  struct TaskArgs {
+    int rblock;
+    int Bcols;
+    // 'f' forms the factors from u'*u, and 'n' or 't' apply
+    //  them or their transpose to B
+    char op;
+  };
+  NodeSqrtTask(Domain domain,
+	       TaskArgument global_arg,
+	       ArgumentMap arg_map,
+	       MappingTagID tag = 0);
+
+  static int TASKID;
+
+  static void register_tasks(void);
+
+public:
+  // returns log|det| of the factorized blocks for 'f'
+  static double
+  cpu_task(const Task *task,
+	   const std::vector<PhysicalRegion> &regions,
+	   Context ctx, HighLevelRuntime *runtime);
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef _peel_block_hpp
+#define _peel_block_hpp
+
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+// recover the blocks of a tree level from the product with
+//  a sketch (see SketchTask): the sample of every child goes
+//  to its columns of the destination region, optionally
+//  orthonormalized, in which case the basis also becomes
+//  the sketch for the transposed product
+class PeelBlockTask : public IndexLauncher {
+public:
+  struct TaskArgs {
+    int  rank; // 0 for the dense leaf blocks
+    int  col;  // first destination column
+    bool orth; // orthonormalize and write the next sketch
+  };
+  PeelBlockTask(Domain domain,
+		TaskArgument global_arg,
+		ArgumentMap arg_map,
+		MappingTagID tag = 0,
+		Predicate pred = Predicate::TRUE_PRED,
+		bool must = false,
+		MapperID id = 0);
+  
+  static int TASKID;
+
+  static void register_tasks(void);
+
+public:
+  static void
+  cpu_task(const Task *task,
+	   const std::vector<PhysicalRegion> &regions,
+	   Context ctx, HighLevelRuntime *runtime);
+};
+
+#endif
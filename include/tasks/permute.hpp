@@ -0,0 +1,39 @@
+#ifndef _permute_hpp
+#define _permute_hpp
+
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+// gather rows into the rows of one partition, dst(i, :) =
+//  src(P(i), :), or scatter them back, src(P(i), :) = dst(i, :),
+//  where P holds the row indices of the partition and only the
+//  rows of src in P are mapped (see LMatrix::permute())
+class PermuteTask : public IndexLauncher {
+public:
+  struct TaskArgs {
+    int pcol; // column of the indices in P
+    int scol; // first column of src
+    int dcol; // first column of dst
+    int ncol; // number of columns
+    bool scatter; // write src from dst
+  };
+  PermuteTask(Domain domain,
+	      TaskArgument global_arg,
+	      ArgumentMap arg_map,
+	      MappingTagID tag = 0,
+	      Predicate pred = Predicate::TRUE_PRED,
+	      bool must = false,
+	      MapperID id = 0);
+  
+  static int TASKID;
+
+  static void register_tasks(void);
+
+public:
+  static void
+  cpu_task(const Task *task,
+	   const std::vector<PhysicalRegion> &regions,
+	   Context ctx, HighLevelRuntime *runtime);
+};
+
+#endif
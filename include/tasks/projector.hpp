@@ -5,11 +5,37 @@
 using namespace LegionRuntime::HighLevel;
 
 extern const ProjectionID CONTRACTION;
+extern const ProjectionID SIBLING;
+extern const ProjectionID CONTRACTION_SIBLING;
 
+// with sibling, the block of the sibling node instead
 class Contraction : public ProjectionFunctor {
 public:
   
-  Contraction(HighLevelRuntime *runtime);
+  Contraction(HighLevelRuntime *runtime, bool sibling=false);
+
+  virtual LogicalRegion project(Context ctx, Task *task,
+                                unsigned index,
+                                LogicalRegion upper_bound,
+                                const DomainPoint &point);
+
+  virtual LogicalRegion project(Context ctx, Task *task,
+                                unsigned index,
+                                LogicalPartition upper_bound,
+                                const DomainPoint &point);
+
+  unsigned get_depth() const;
+
+private:
+  bool sibling;
+};
+
+// the subregion of the sibling in a binary tree, i.e.,
+//  color p^1 for point p
+class Sibling : public ProjectionFunctor {
+public:
+  
+  Sibling(HighLevelRuntime *runtime);
 
   virtual LogicalRegion project(Context ctx, Task *task,
                                 unsigned index,
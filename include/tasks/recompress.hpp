@@ -0,0 +1,41 @@
+#ifndef _recompress_hpp
+#define _recompress_hpp
+
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+// recompress one off-diagonal block u*v', i.e., the rows of a
+//  child in U against the rows of its sibling in V (see the
+//  SIBLING projection), by the QR factorizations of u and v and
+//  the SVD of the product of their R factors: the columns are
+//  rotated in place so that u*v' keeps its value and the leading
+//  k columns are the best rank k approximation. The task returns
+//  the number of singular values above tol times the largest one
+class RecompressTask : public IndexLauncher {
+public:
+  struct TaskArgs {
+    int    ucol;  // first u column of the depth in U
+    int    vcol;  // first v column of the depth in V
+    int    rank;  // current rank of the depth
+    double tol;   // relative tolerance of the truncation
+  };
+  RecompressTask(Domain domain,
+		 TaskArgument global_arg,
+		 ArgumentMap arg_map,
+		 MappingTagID tag = 0,
+		 Predicate pred = Predicate::TRUE_PRED,
+		 bool must = false,
+		 MapperID id = 0);
+  
+  static int TASKID;
+
+  static void register_tasks(void);
+
+public:
+  static int
+  cpu_task(const Task *task,
+	   const std::vector<PhysicalRegion> &regions,
+	   Context ctx, HighLevelRuntime *runtime);
+};
+
+#endif
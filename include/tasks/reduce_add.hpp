@@ -1,17 +1,25 @@
 #ifndef _reduce_add_hpp
 #define _reduce_add_hpp
 
+#include <complex>
+
 #include "legion.h"
 using namespace LegionRuntime::HighLevel;
 
-extern const int REDOP_ADD;
+// one reduction operator for every scalar type
+extern const int REDOP_ADD; // double
+extern const int REDOP_ADD_FLOAT;
+extern const int REDOP_ADD_COMPLEX_FLOAT;
+extern const int REDOP_ADD_COMPLEX_DOUBLE;
 
 // Reduction Op
-class Add {
+//  T is float, double, std::complex<float> or std::complex<double>
+template <typename T>
+class AddT {
 public:
-  typedef double LHS;
-  typedef double RHS;
-  static const double identity;
+  typedef T LHS;
+  typedef T RHS;
+  static const T identity;
 
 public:
   template <bool EXCLUSIVE>
@@ -19,6 +27,11 @@ public:
   template <bool EXCLUSIVE>
   static void fold(RHS &rhs1, RHS rhs2);
   static void register_operator();
+  // the id it is registered with, e.g., REDOP_ADD_FLOAT
+  static int redop_id();
 };
 
+// for regions of doubles (see ScalarType)
+typedef AddT<double> Add;
+
 #endif
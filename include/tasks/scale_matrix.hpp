@@ -4,20 +4,23 @@
 #include "legion.h"
 using namespace LegionRuntime::HighLevel;
 
-class ScaleMatrixTask : public IndexLauncher {
+// T is the scalar type of the regions (see ScalarType), and
+//  every type is a task variant of its own
+template <typename T>
+class ScaleMatrixTaskT : public IndexLauncher {
 public:
   struct TaskArgs {
     int rblock;
     int cols;
-    double alpha;
+    T alpha;
   };
-  ScaleMatrixTask(Domain domain,
-		  TaskArgument global_arg,
-		  ArgumentMap arg_map,
-		  MappingTagID tag = 0,
-		  Predicate pred = Predicate::TRUE_PRED,
-		  bool must = false,
-		  MapperID id = 0);
+  ScaleMatrixTaskT(Domain domain,
+		   TaskArgument global_arg,
+		   ArgumentMap arg_map,
+		   MappingTagID tag = 0,
+		   Predicate pred = Predicate::TRUE_PRED,
+		   bool must = false,
+		   MapperID id = 0);
   
   static int TASKID;
 
@@ -30,4 +33,6 @@ public:
 	   Context ctx, HighLevelRuntime *runtime);
 };
 
+typedef ScaleMatrixTaskT<double> ScaleMatrixTask;
+
 #endif
@@ -0,0 +1,46 @@
+#ifndef _shift_diagonal_hpp
+#define _shift_diagonal_hpp
+
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+// K = K0 + sigma*I for the dense leaf blocks of every partition,
+//  where K0 is a copy of the unfactored blocks (see KTree::shift()).
+//  With update, the entries in the local argument are first added
+//  to the diagonal of K0, and only the leaf blocks holding one of
+//  them are written (see KTree::add_diagonal())
+class ShiftDiagonalTask : public IndexLauncher {
+public:
+  struct TaskArgs {
+    double sigma;
+    // leaf blocks in every partition
+    int nPart;
+    // columns of the widest leaf
+    int cols;
+    bool update;
+  };
+  // a change of the diagonal entry in row (of the whole matrix)
+  struct Entry {
+    int row;
+    double delta;
+  };
+  ShiftDiagonalTask(Domain domain,
+		    TaskArgument global_arg,
+		    ArgumentMap arg_map,
+		    Predicate pred = Predicate::TRUE_PRED,
+		    bool must = false,
+		    MapperID id = 0,
+		    MappingTagID tag = 0);
+  
+  static int TASKID;
+
+  static void register_tasks(void);
+
+public:
+  static void
+  cpu_task(const Task *task,
+	   const std::vector<PhysicalRegion> &regions,
+	   Context ctx, HighLevelRuntime *runtime);
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef _sketch_hpp
+#define _sketch_hpp
+
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+// test vectors for the randomized construction (see
+//  HMatrix::init() from a matvec): random columns on every
+//  other child of a tree level, or an identity block on
+//  every leaf
+class SketchTask : public IndexLauncher {
+public:
+  struct TaskArgs {
+    int nchild; // children of the level, for the random seeds
+    int rank;   // 0 for the identity blocks
+    int cols;   // columns of the sketch
+  };
+  SketchTask(Domain domain,
+	     TaskArgument global_arg,
+	     ArgumentMap arg_map,
+	     MappingTagID tag = 0,
+	     Predicate pred = Predicate::TRUE_PRED,
+	     bool must = false,
+	     MapperID id = 0);
+  
+  static int TASKID;
+
+  static void register_tasks(void);
+
+public:
+  static void
+  cpu_task(const Task *task,
+	   const std::vector<PhysicalRegion> &regions,
+	   Context ctx, HighLevelRuntime *runtime);
+};
+
+#endif
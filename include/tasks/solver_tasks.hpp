@@ -3,13 +3,30 @@
 
 #include "init_matrix.hpp"
 #include "dense_block.hpp"
+#include "entry_block.hpp"
 #include "add_matrix.hpp"
+#include "convert_matrix.hpp"
+#include "dot_product.hpp"
+#include "shift_diagonal.hpp"
 #include "clear_matrix.hpp"
 #include "scale_matrix.hpp"
 #include "display_matrix.hpp"
+#include "permute.hpp"
 
 #include "leaf_solve.hpp"
+#include "leaf_factor.hpp"
+#include "leaf_shift.hpp"
+#include "leaf_inverse.hpp"
+#include "leaf_sqrt.hpp"
+#include "aca_block.hpp"
+#include "recompress.hpp"
+#include "sketch.hpp"
+#include "peel_block.hpp"
+#include "leaf_multiply.hpp"
 #include "node_solve.hpp"
+#include "node_factor.hpp"
+#include "node_inverse.hpp"
+#include "node_sqrt.hpp"
 #include "node_solve_region.hpp"
 #include "gemm.hpp"
 #include "gemm_inplace.hpp"
@@ -8,10 +8,25 @@
 class UTree {
 public:
 
-  // init data
-  void init(const Matrix&);
+  // init data with nRhs right hand side columns; ranks[k] is
+  //  the number of u columns used at depth k (all by default)
+  void init(const Matrix&, int nRhs=1,
+	    const std::vector<int>& ranks=std::vector<int>());
+
+  // init data with a different basis at every depth, root
+  //  first; the rank of depth k is the column size of U[k]
+  void init(const std::vector<Matrix>& U, int nRhs=1);
+
+  // regions only; the u columns are written by a builder
+  //  (see HMatrix::init() from the entries)
+  void init(int nrow, const std::vector<int>& ranks, int nRhs=1);
   
-  void init(int, const Matrix&, Context ctx, HighLevelRuntime *runtime);
+  void init(int, const Matrix&, Context ctx, HighLevelRuntime *runtime,
+	    int nRhs=1);
+
+  // keep a copy of the right hand side after the u columns
+  //  (see rhs_copy()); call before partition()
+  void keep_rhs_copy();
   
   // initialize problem right hand side
   void init_rhs
@@ -24,9 +39,11 @@ public:
   // return right hand side (overwritten by solution)
   Vector rhs();
 
-  // create partition
+  // create partition; the region holds entries of type (see
+  //  LMatrix::create())
   void partition
-  (int level, Context ctx, HighLevelRuntime *runtime);
+  (int level, Context ctx, HighLevelRuntime *runtime,
+   ScalarType type=SCALAR_DOUBLE);
   
   void horizontal_partition
   (int level, Context ctx, HighLevelRuntime *runtime);
@@ -43,13 +60,64 @@ public:
   // legion matrices at leaf level
   LMatrix& leaf();
 
+  // right hand side columns and all u columns
+  LMatrix& rhs_mat();
+  LMatrix& uMat();
+
+  // the copy of the right hand side, which is not
+  //  touched by the solve
+  LMatrix& rhs_copy();
+
+  // keep a copy of the u columns, which the factorization
+  //  overwrites, and write it back before factorizing again
+  //  (see HMatrix::shift())
+  void save_u(Context ctx, HighLevelRuntime *runtime);
+  void restore_u(Context ctx, HighLevelRuntime *runtime);
+
+  // the copy of save_u() at one level (see uMat_level()) and for
+  //  all levels, where depth k starts at column_begin(k) minus
+  //  column_begin(0)
+  LMatrix saved_level(int);
+  LMatrix& saved_u();
+
+  // a single precision copy of the region, made or refreshed by
+  //  keep_single(), e.g., with the factored u columns for the
+  //  solves of HMatrix::factor() with single; the columns of
+  //  the views above are at the same place in it
+  void keep_single(Context ctx, HighLevelRuntime *runtime);
+  LMatrix& single_copy();
+
+  // first column of the u columns at depth level
+  int column_begin(int level) const;
+
+  // move the leading ranks[k] u columns of every depth k into
+  //  a new region with these (smaller) ranks, see
+  //  HMatrix::recompress(); the right hand side is not kept
+  void resize
+  (const std::vector<int>& ranks, Context ctx, HighLevelRuntime *runtime);
+
+  // the rank of every level, root first
+  const std::vector<int>& rank_profile() const;
+
   void clear(Context ctx, HighLevelRuntime* runtime);
   
+private:
+  // fill the u columns and set up the column views
+  void init_columns(Context ctx, HighLevelRuntime *runtime);
+
 private:
   int mLevel;
-  int rank;
   int nRhs;
+  // the data comes from the random generators
+  bool generated;
+  // the region has a copy of the right hand side
+  bool copy;
+  // uSaved holds a copy of the u columns
+  bool saved;
+  std::vector<int> ranks;
   Matrix  UMat;
+  // bases of every depth if they are not shared
+  std::vector<Matrix> bases;
 
   // ----------------------
   // legion matrices below
@@ -61,19 +129,39 @@ private:
   // u and d matrices at all levels
   std::vector<LMatrix> uMat_vec;
   std::vector<LMatrix> dMat_vec;
+
+  // column views of U
+  LMatrix bMat_all;
+  LMatrix uMat_all;
+  LMatrix bMat_copy;
+
+  // copy of the u columns, see save_u()
+  LMatrix uSaved;
+
+  // copy of U in single precision, see keep_single()
+  LMatrix uSingle;
 };
 
 class VTree {
 public:
 
-  // init data
-  void init(const Matrix&);
+  // init data; ranks[k] is the number of columns used at depth k
+  void init(const Matrix&,
+	    const std::vector<int>& ranks=std::vector<int>());
+
+  // init data with a different basis at every depth, root first
+  void init(const std::vector<Matrix>& V);
+
+  // regions only, with separate columns for every depth
+  void init(int nrow, const std::vector<int>& ranks);
   
   void init(int, const Matrix&, Context ctx, HighLevelRuntime *runtime);
 
-  // create partition
+  // create partition; the region holds entries of type (see
+  //  LMatrix::create())
   void partition
-  (int level, Context ctx, HighLevelRuntime *runtime);
+  (int level, Context ctx, HighLevelRuntime *runtime,
+   ScalarType type=SCALAR_DOUBLE);
 
   void horizontal_partition
   (int level, Context ctx, HighLevelRuntime *runtime);
@@ -83,16 +171,46 @@ public:
   LMatrix& level(int);
   LMatrix& level_new(int);
 
+  // first column of every depth in the leaf region
+  const std::vector<int>& column_begin() const;
+
+  // a single precision copy of the region (see
+  //  UTree::keep_single())
+  void keep_single(Context ctx, HighLevelRuntime *runtime);
+  LMatrix& single_copy();
+
+  // move the leading ranks[k] columns of every depth k into a
+  //  new region where every depth has its own columns; nothing
+  //  is done if the layout is already that one
+  void resize
+  (const std::vector<int>& ranks, Context ctx, HighLevelRuntime *runtime);
+
   void clear(Context ctx, HighLevelRuntime* runtime);
   
+private:
+  // fill the region and set up the column views of all levels
+  void init_levels(Context ctx, HighLevelRuntime *runtime);
+
 private:
   int mLevel;
+  // all levels use the leading columns of VMat
+  bool shared;
+  std::vector<int> ranks;
+  std::vector<int> vcols;
   Matrix VMat;
+  std::vector<Matrix> bases;
 
-  // for the simple case of U * V' + D,
-  // partition is the same for all levels,
-  // so only one partition is stored
+  // partition is the same for all levels, so only one
+  //  partition is stored; with a shared basis every level
+  //  uses the leading columns of V, otherwise the bases
+  //  are stored side by side
   LMatrix V;
+
+  // columns of V used at every level
+  std::vector<LMatrix> VMat_vec;
+
+  // copy of V in single precision, see keep_single()
+  LMatrix vSingle;
 };
 
 // Dense blocks only exist at the leaf level
@@ -100,30 +218,167 @@ private:
 class KTree {
 public:
   
-  // init data
-  void init(const Matrix& U, const Matrix& V, const Vector& D);
+  // init data; ranks as in UTree::init()
+  void init(const Matrix& U, const Matrix& V, const Vector& D,
+	    const std::vector<int>& ranks=std::vector<int>());
+
+  // general dense leaf blocks K + diag(D) for bases that
+  //  differ at every depth (see VTree::init())
+  void init(const Matrix& K, const Vector& D,
+	    const std::vector<int>& ranks);
+
+  // regions only; see init_entries()
+  void init(int nrow, const std::vector<int>& ranks);
 
   void init(int, const Matrix& U, const Matrix& V, const Vector& D,
 	    Context ctx, HighLevelRuntime *runtime);
 
-  // create partition
+  // create partition; the region holds entries of type (see
+  //  LMatrix::create())
   void partition
-  (int level, Context ctx, HighLevelRuntime *runtime);
+  (int level, Context ctx, HighLevelRuntime *runtime,
+   ScalarType type=SCALAR_DOUBLE);
 
   void horizontal_partition
   (int level, Context ctx, HighLevelRuntime *runtime);
 
+  // evaluate the dense blocks from an entry function
+  //  (see register_entry_func()), with the rows in the order of
+  //  perm unless it is empty (see LMatrix::init_entry_blocks())
+  void init_entries
+  (int func, const LMatrix& perm, Context ctx, HighLevelRuntime *runtime);
+
+  // copy the dense blocks from the product Y = A*X with the
+  //  identity leaf blocks in X (see LMatrix::sketch())
+  void init_blocks(LMatrix& Y, Context ctx, HighLevelRuntime *runtime);
+
+  // y += alpha*op(A)*x for the off-diagonal blocks of the first
+  //  nlevel levels below the launch level and, with dense, the
+  //  dense blocks; ucols as in LMatrix::multiply(). After factor(),
+  //  the dense blocks are K0 + sigma*I (see shift()), and U holds
+  //  a copy of the unfactored u columns
+  void multiply
+  (char trans, double alpha, int nlevel, bool dense, LMatrix& U,
+   LMatrix& V, const std::vector<int>& ucols, const LMatrix& X, LMatrix& Y,
+   Context ctx, HighLevelRuntime *runtime);
+
   // wrapper for legion matrix solve
-  // leaf solve task
+  // leaf solve task, which overwrites the dense blocks
   void solve(LMatrix&, LMatrix&, Context ctx, HighLevelRuntime *runtime);
+
+  // leaf solve of all shifts with the unfactored blocks, see
+  //  LMatrix::solve_shifts()
+  void solve_shifts
+  (const LMatrix& b, LMatrix& W, LMatrix& V, const std::vector<double>& shifts,
+   Context ctx, HighLevelRuntime *runtime);
+
+  // factorize the dense blocks and the node systems below
+  //  the launch level; the u columns are overwritten. With
+  //  spd, the dense blocks are Cholesky factorized and the
+  //  node systems are symmetric (see LMatrix::node_factor());
+  //  with single, the factorizations are in single precision,
+  //  so the factors can be kept in float (see set_factor_type()).
+  //  The future holds log|det| of the blocks below the launch
+  //  level. After the first call, update may flag the leaves
+  //  to factorize again (see add_diagonal()), while the others
+  //  keep their factors
+  Future factor(LMatrix&, LMatrix&, Context ctx, HighLevelRuntime *runtime,
+		bool spd=false, bool single=false,
+		const std::vector<bool>& update=std::vector<bool>());
+
+  // factorize A = W*W' (A is spd and V = U) for the dense
+  //  blocks and the node systems below the launch level, see
+  //  HMatrix::factor_sqrt(); the u columns are overwritten, and
+  //  the future holds log|det| of the blocks below the launch level
+  Future factor_sqrt
+  (LMatrix& U, Context ctx, HighLevelRuntime *runtime);
+
+  // B = W*B or B = W'*B (trans='t') for the rows of every partition
+  //  with the factors of factor_sqrt(), where U holds the factored
+  //  u columns
+  void multiply_sqrt
+  (char trans, const LMatrix& U, LMatrix& B, Context ctx,
+   HighLevelRuntime *runtime);
+
+  // move the factors to regions of type, e.g., float after
+  //  factor() with single, which holds them exactly; the leaf
+  //  solves then take b and V of that type, and the other uses
+  //  of the factors move them back to double
+  void set_factor_type
+  (ScalarType type, Context ctx, HighLevelRuntime *runtime);
+
+  // leaf solve with the stored factors, or with their
+  //  transpose for trans
+  void solve_factored
+  (LMatrix&, LMatrix&, Context ctx, HighLevelRuntime *runtime,
+   bool trans=false);
+
+  // leaf solve with the symmetric factors, where the copy of
+  //  the right hand side starts at column bcol of b
+  void solve_factored
+  (LMatrix& b, int bcol, Context ctx, HighLevelRuntime *runtime);
+
+  // the diagonal of the inverse (blocks=false) or its leaf blocks
+  //  from the factors, in a new region partitioned like the right
+  //  hand side, where U holds the factored u columns and Z the
+  //  workspace of HMatrix::inverse_diagonal() (see
+  //  LMatrix::inverse_diagonal())
+  LMatrix inverse_diagonal
+  (bool blocks, const LMatrix& U, const LMatrix& V, LMatrix& Z, int wcol,
+   Context ctx, HighLevelRuntime *runtime);
+
+  // the rank of every level and the first columns in V after
+  //  the bases are resized (see VTree::resize())
+  void set_rank_profile
+  (const std::vector<int>& ranks, const std::vector<int>& vcols);
+
+  // reset the dense blocks to K0 + sigma*I for the next factor(),
+  //  where K0 are the blocks before the first call, which are
+  //  copied then; the regions of the node factors are reused
+  void shift(double sigma, Context ctx, HighLevelRuntime *runtime);
+
+  // add delta[k] to the diagonal entry of rows[k] in K0 (see
+  //  shift()), which is copied first if needed, and reset the
+  //  leaf blocks holding these rows to K0 + sigma*I for the last
+  //  sigma; returns a flag for every leaf, set for these blocks
+  std::vector<bool> add_diagonal
+  (const std::vector<int>& rows, const std::vector<double>& delta,
+   Context ctx, HighLevelRuntime *runtime);
   
   void clear(Context ctx, HighLevelRuntime* runtime);
 
+private:
+  // copy the unfactored blocks to K0
+  void save_blocks(Context ctx, HighLevelRuntime *runtime);
+
 private:
   int mLevel;
-  Matrix UMat, VMat;
+  bool factored;
+  // symmetric factors
+  bool spd;
+  // the factors are W of A = W*W' (see factor_sqrt())
+  bool sqrtFactor;
+  // leaves come from KMat rather than U*V'
+  bool dense;
+  // the u columns of every depth are the leading columns of
+  //  UMat, so they only differ after the leaf solve
+  bool shared;
+  // the data comes from the random generators
+  bool generated;
+  // K0 holds the blocks before the first shift(), and sigma is
+  //  the last shift
+  bool saved;
+  double sigma;
+  std::vector<int> ranks;
+  std::vector<int> vcols;
+  Matrix UMat, VMat, KMat;
   Vector DVec;
+  // the last column stores the pivots after factor()
   LMatrix K;
+  // factors of the node systems below the launch level
+  LMatrix S;
+  // the unfactored dense blocks without the pivot column
+  LMatrix K0;
 };
 
 #endif
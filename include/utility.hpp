@@ -12,10 +12,62 @@ enum {
   FIELDID_V,
 };
 
+// scalar type of the field FIELDID_V of a region (see
+//  LMatrix::create()); the typed tasks have a variant for every
+//  type, and the other tasks use doubles
+enum ScalarType {
+  SCALAR_DOUBLE,
+  SCALAR_FLOAT,
+  SCALAR_COMPLEX_FLOAT,
+  SCALAR_COMPLEX_DOUBLE,
+};
+
+// the ScalarType of T, e.g., scalar_type_of<float>::value
+template <typename T> struct scalar_type_of;
+template <> struct scalar_type_of<double> {
+  static const ScalarType value = SCALAR_DOUBLE;
+};
+template <> struct scalar_type_of<float> {
+  static const ScalarType value = SCALAR_FLOAT;
+};
+template <> struct scalar_type_of<complex_float> {
+  static const ScalarType value = SCALAR_COMPLEX_FLOAT;
+};
+template <> struct scalar_type_of<complex_double> {
+  static const ScalarType value = SCALAR_COMPLEX_DOUBLE;
+};
+
+// call f<T> args for the scalar type T of type, e.g.,
+//  SCALAR_DISPATCH(C.scalar_type(), gemmRed, (transa, ...))
+#define SCALAR_DISPATCH(type, f, args)				\
+  switch (type) {						\
+  case SCALAR_DOUBLE:         f<double> args;         break;	\
+  case SCALAR_FLOAT:          f<float> args;          break;	\
+  case SCALAR_COMPLEX_FLOAT:  f<complex_float> args;  break;	\
+  case SCALAR_COMPLEX_DOUBLE: f<complex_double> args; break;	\
+  default: assert(false);					\
+  }
+
+// size of an entry of type
+size_t scalar_size(ScalarType type);
+
+// name of the variant of a typed task, e.g., "GemmRed_float"; the
+//  double variant keeps the name, and the string is never freed
+//  since the runtime keeps the pointer
+const char* task_name(const char* name, ScalarType type);
+
 //Realm::Logger log_solver_tasks("solver_tasks");
 
 const bool WAIT_DEFAULT = false; //true; // waiting for tasks
 
+// upper bound of the tree depth,
+//  used for per-level arrays in task arguments
+const int MAX_TREE_LEVEL = 20;
+
+// upper bound of the shifts solved together,
+//  see HMatrix::solve_shifts()
+const int MAX_SHIFTS = 64;
+
 bool is_power_of_two(int x);
 
 double* region_pointer(const PhysicalRegion &region, int, int, int, int);
@@ -27,6 +79,31 @@ PtrMatrix get_raw_pointer
 PtrMatrix reduction_pointer
 (const PhysicalRegion &region, int rlo, int rhi, int clo, int chi);
 
+// the same for a region of scalar type T, e.g.,
+//  get_raw_pointer<float>(...) in the typed tasks
+template <typename T>
+PtrMatrixT<T> get_raw_pointer
+(const PhysicalRegion &region, int rlo, int rhi, int clo, int chi);
+
+template <typename T>
+PtrMatrixT<T> reduction_pointer
+(const PhysicalRegion &region, int rlo, int rhi, int clo, int chi);
+
+// rows and columns of a (sub)region, so tasks do not assume
+//  every partition has the same number of rows
+Rect<2> region_bounds
+(const PhysicalRegion &region, Context ctx, HighLevelRuntime *runtime);
+
+// entry (i, j) of a matrix, for building from the entries only
+typedef double (*EntryFunc)(int i, int j);
+
+// register an entry function on every node (before starting the
+//  runtime, like the tasks); the returned id is used in task
+//  arguments since function pointers may differ across nodes
+int register_entry_func(EntryFunc);
+
+EntryFunc entry_func(int id);
+
 // error message
 #include <cstdlib> // for EXIT_FAILURE
 #include <cassert>
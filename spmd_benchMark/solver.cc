@@ -1,6 +1,7 @@
 #include <iostream>
 #include <math.h>
 #include <unistd.h>
+#include <algorithm> // for std::max()
 
 // legion stuff
 #include "legion.h"
@@ -14,14 +15,14 @@ enum {
   SPMD_TASK_ID = 1,
 };
 
-const int MAX_TREE_LEVEL = 20;
-
 struct SPMDargs {
   PhaseBarrier reduction[MAX_TREE_LEVEL];
   PhaseBarrier node_solve[MAX_TREE_LEVEL];
   int leaf_size;
   int rank;
   int nRhs;
+  // number of shifts solved together, 0 for A itself
+  int nShift;
   int spmd_level;
   int my_matrix_level;
   int my_task_level;
@@ -50,6 +51,14 @@ LMatrix create_legion_matrix(LogicalRegion region, int rows, int cols) {
   return LMatrix(region, rows, cols);
 }
 
+// columns [col, col+ncol) of the first block in W
+LMatrix column_view(const LMatrix& W, int col, int ncol) {
+  LMatrix view = W;
+  view.set_column_begin(col);
+  view.set_column_size(ncol);
+  return view;
+}
+
 void spmd_fast_solver(const Task *task,
 		      const std::vector<PhysicalRegion> &regions,
 		      Context ctx, HighLevelRuntime *runtime) {
@@ -65,6 +74,7 @@ void spmd_fast_solver(const Task *task,
   int leaf_size        = args->leaf_size;
   int rank             = args->rank;
   int nRhs             = args->nRhs;
+  int nShift           = args->nShift;
   int spmd_level       = args->spmd_level;
   int matrix_level     = args->my_matrix_level;
   int task_level       = args->my_task_level;
@@ -87,7 +97,7 @@ void spmd_fast_solver(const Task *task,
 
   // init tree
   int global_tree_level = spmd_level+matrix_level;
-  UTree uTree; uTree.init( global_tree_level, UMat, ctx, runtime );
+  UTree uTree; uTree.init( global_tree_level, UMat, ctx, runtime, nRhs );
   VTree vTree; vTree.init( global_tree_level, VMat, ctx, runtime );
   KTree kTree; kTree.init( matrix_level, UMat, VMat, DVec, ctx, runtime );
   
@@ -99,34 +109,54 @@ void spmd_fast_solver(const Task *task,
   // init rhs and wait
   uTree.init_rhs(Rhs, ctx, runtime, true/*wait*/);
 
+  // with shifts, (A + sigma*I) x = b is solved for every sigma
+  //  in its own block of columns [b, u] (see
+  //  HMatrix::solve_shifts()), and every launch and ghost copy
+  //  below covers all the blocks
+  int nBlock = std::max(nShift, 1);
+  int width  = uTree.column_begin(global_tree_level);
+  LMatrix W  = uTree.leaf();
+  std::vector<double> shifts(nShift);
+  for (int k=0; k<nShift; k++)
+    shifts[k] = k * double(mean) / nShift;
+  if (nShift > 0)
+    W = LMatrix(W.rows(), nShift*width, task_level, ctx, runtime);
+
   // computation starts now
   
   // leaf solve: U = dense \ U
-  kTree.solve( uTree.leaf(), vTree.leaf(), ctx, runtime );  
+  if (nShift > 0)
+    kTree.solve_shifts( uTree.leaf(), W, vTree.leaf(), shifts,
+			ctx, runtime );
+  else
+    kTree.solve( uTree.leaf(), vTree.leaf(), ctx, runtime );  
 
   // solve on every machine
   for (int i=task_level-1; i>=0; i--) {
     int tree_level = i + spmd_level;
     LMatrix& V = vTree.level_new(tree_level);
-    LMatrix& u = uTree.uMat_level_new(tree_level);
-    LMatrix& d = uTree.dMat_level_new(tree_level);
+    LMatrix  u = column_view(W, uTree.column_begin(tree_level), V.cols());
+    LMatrix  d = column_view(W, 0, uTree.column_begin(tree_level));
     
     // reduction operation
     int rows = pow(2, i+1)*V.cols();    
-    LMatrix VTu(rows, u.cols(), i, ctx, runtime);
-    LMatrix VTd(rows, d.cols(), i, ctx, runtime);
+    LMatrix VTu(rows, nBlock*u.cols(), i, ctx, runtime);
+    LMatrix VTd(rows, nBlock*d.cols(), i, ctx, runtime);
     VTu.two_level_partition(ctx, runtime);
     VTd.two_level_partition(ctx, runtime);
 
-    LMatrix::gemmRed('t', 'n', 1.0, V, u, 0.0, VTu, ctx, runtime );
-    LMatrix::gemmRed('t', 'n', 1.0, V, d, 0.0, VTd, ctx, runtime );
+    LMatrix::gemmRed('t', 'n', 1.0, V, u, 0.0, VTu, nBlock, width,
+		     ctx, runtime );
+    LMatrix::gemmRed('t', 'n', 1.0, V, d, 0.0, VTd, nBlock, width,
+		     ctx, runtime );
 
     // form and solve the small linear system
-    VTu.node_solve( VTd, ctx, runtime );
+    VTu.node_solve( VTd, nBlock, ctx, runtime );
       
     // broadcast operation
     // d -= u * VTd
-    LMatrix::gemmBro('n', 'n', -1.0, u, VTd, 1.0, d, ctx, runtime );
+    LMatrix::gemmBro('n', 'n', -1.0, u, VTd, 1.0, d, nBlock, width,
+		     ctx, runtime );
     std::cout<<"launched solver tasks at level: "<<tree_level<<std::endl;
   }
 
@@ -134,17 +164,22 @@ void spmd_fast_solver(const Task *task,
   int ghost_idx = 0;
   for (int l=spmd_level-1; l>=0; l--) {
     LMatrix& V = vTree.level_new(l);
-    LMatrix& u = uTree.uMat_level_new(l);
-    LMatrix& d = uTree.dMat_level_new(l);    
+    LMatrix  u = column_view(W, uTree.column_begin(l), rank);
+    LMatrix  d = column_view(W, 0, uTree.column_begin(l));
 
-    // compute local results
+    // compute local results; the ghost regions hold all the
+    //  blocks, so there is one copy for all shifts
+    int nVTu = nBlock*rank;
+    int nVTd = nBlock*(nRhs+l*rank);
     LogicalRegion VTu_ghost = task->regions[ghost_idx].region;
     LogicalRegion VTd_ghost = task->regions[ghost_idx+1].region;
-    LMatrix VTu = create_local_region(VTu_ghost, rank, rank, ctx, runtime);
-    LMatrix VTd = create_local_region(VTd_ghost, rank, nRhs+l*rank, ctx, runtime);
+    LMatrix VTu = create_local_region(VTu_ghost, rank, nVTu, ctx, runtime);
+    LMatrix VTd = create_local_region(VTd_ghost, rank, nVTd, ctx, runtime);
 
-    LMatrix::gemm('t', 'n', 1.0, V, u, 0.0, VTu, ctx, runtime );
-    LMatrix::gemm('t', 'n', 1.0, V, d, 0.0, VTd, ctx, runtime );
+    LMatrix::gemm('t', 'n', 1.0, V, u, 0.0, VTu, nBlock, width,
+		  ctx, runtime );
+    LMatrix::gemm('t', 'n', 1.0, V, d, 0.0, VTd, nBlock, width,
+		  ctx, runtime );
     
     // copy
     CopyLauncher  cp_VTu;
@@ -169,16 +204,16 @@ void spmd_fast_solver(const Task *task,
     
     // node solve
     if (is_master_task(spmd_point, l, spmd_level)) {
-      LMatrix VTu0 = create_legion_matrix(VTu_ghost,rank,rank);
-      LMatrix VTd0 = create_legion_matrix(VTd_ghost,rank,nRhs+rank*l);
+      LMatrix VTu0 = create_legion_matrix(VTu_ghost,rank,nVTu);
+      LMatrix VTd0 = create_legion_matrix(VTd_ghost,rank,nVTd);
       LogicalRegion VTu1_ghost = task->regions[ghost_idx+2].region;
       LogicalRegion VTd1_ghost = task->regions[ghost_idx+3].region;
-      LMatrix VTu1 = create_legion_matrix(VTu1_ghost,rank,rank);
-      LMatrix VTd1 = create_legion_matrix(VTd1_ghost,rank,nRhs+rank*l);
+      LMatrix VTu1 = create_legion_matrix(VTu1_ghost,rank,nVTu);
+      LMatrix VTd1 = create_legion_matrix(VTd1_ghost,rank,nVTd);
       args->reduction[l] = 
 	runtime->advance_phase_barrier(ctx, args->reduction[l]);
       assert(args->node_solve[l]!=PhaseBarrier());
-      LMatrix::node_solve( VTu0, VTu1, VTd0, VTd1,
+      LMatrix::node_solve( VTu0, VTu1, VTd0, VTd1, nBlock,
 			   args->reduction[l], args->node_solve[l],
 			   ctx, runtime );
       ghost_idx += 4;
@@ -202,20 +237,22 @@ void spmd_fast_solver(const Task *task,
     // local update: d -= u * VTd
     LMatrix VTd_lmtx;
     if (is_master_task(spmd_point, l, spmd_level)) {
-      VTd_lmtx = create_legion_matrix(VTd_ghost,rank,nRhs+rank*l);    
+      VTd_lmtx = create_legion_matrix(VTd_ghost,rank,nVTd);    
     }
     else {
-      VTd_lmtx = create_legion_matrix(VTd_local,rank,nRhs+rank*l);    
+      VTd_lmtx = create_legion_matrix(VTd_local,rank,nVTd);    
     }
 
     bool wait = (l==0 ? true : false);
     LMatrix::gemm_inplace('n', 'n', -1.0, u, VTd_lmtx, 1.0, d,
-			  ctx, runtime, wait );
+			  nBlock, width, ctx, runtime, wait );
     std::cout<<"launched solver tasks at level: "<<l<<std::endl;
   }
   // check residule
 
   // clear resources
+  if (nShift > 0)
+    W.clear(ctx, runtime);
   uTree.clear(ctx, runtime);
   vTree.clear(ctx, runtime);
   kTree.clear(ctx, runtime);
@@ -234,8 +271,11 @@ void top_level_task(const Task *task,
   int leaf_size = 400;
   int matrix_level = 1;
 
-  // right hand side
-  const int nRhs = 1;
+  // number of right hand sides solved together
+  int nRhs = 1;
+
+  // number of shifts solved together (see HMatrix::solve_shifts())
+  int nShift = 0;
 
   // parse input arguments
   const InputArgs &command_args = HighLevelRuntime::get_input_args();
@@ -251,6 +291,10 @@ void top_level_task(const Task *task,
 	leaf_size = atoi(command_args.argv[++i]);
       if (!strcmp(command_args.argv[i],"-mtxlvl"))
 	matrix_level = atoi(command_args.argv[++i]);
+      if (!strcmp(command_args.argv[i],"-nrhs"))
+	nRhs = atoi(command_args.argv[++i]);
+      if (!strcmp(command_args.argv[i],"-nshift"))
+	nShift = atoi(command_args.argv[++i]);
     }
   }
   int spmd_level = (int)log2(num_machines);
@@ -272,6 +316,8 @@ void top_level_task(const Task *task,
 	   <<"\noff-diagonal rank: "<<rank
 	   <<"\nleaf size: "<<leaf_size
 	   <<"\nmatrix level: "<<matrix_level
+	   <<"\n# right hand sides: "<<nRhs
+	   <<"\n# shifts: "<<nShift
            <<"\n========================\n"
 	   <<std::endl;
 
@@ -279,6 +325,8 @@ void top_level_task(const Task *task,
   assert(is_power_of_two(num_cores_per_machine));
   assert(rank         > 0);
   assert(leaf_size    > 0);
+  assert(nRhs         > 0);
+  assert(0 <= nShift && nShift <= MAX_SHIFTS);
   assert(spmd_level<=MAX_TREE_LEVEL);
   
   // create phase barriers
@@ -286,6 +334,7 @@ void top_level_task(const Task *task,
   arg.leaf_size = leaf_size;
   arg.rank = rank;
   arg.nRhs = nRhs;
+  arg.nShift = nShift;
   arg.spmd_level = spmd_level;
   arg.my_matrix_level = matrix_level - spmd_level;
   arg.my_task_level = task_level;
@@ -316,8 +365,10 @@ void top_level_task(const Task *task,
   }
   
   // create ghost regions: VTu0, VTu1(r x r) and VTd0, VTd1(r x .)
+  //  for every shift, side by side
+  int nBlock = std::max(nShift, 1);
   Point<2> lo = make_point(0, 0);
-  Point<2> hi = make_point(rank-1, rank-1);
+  Point<2> hi = make_point(rank-1, nBlock*rank-1);
   Rect<2>  rect(lo, hi);
   IndexSpace VTu_is = runtime->create_index_space
     (ctx, Domain::from_rect<2>(rect));
@@ -348,7 +399,7 @@ void top_level_task(const Task *task,
     }
     // create VTd regions
     Point<2> lo = make_point(0, 0);
-    Point<2> hi = make_point(rank-1, nRhs+l*rank-1);
+    Point<2> hi = make_point(rank-1, nBlock*(nRhs+l*rank)-1);
     Rect<2>  rect(lo, hi);
     IndexSpace VTd_is = runtime->create_index_space
       (ctx, Domain::from_rect<2>(rect));
@@ -1,38 +1,46 @@
 #include <math.h> // for pow()
+#include <algorithm> // for std::max() and std::min()
 
 #include "hmatrix.hpp"
 
-HMatrix::HMatrix() {}
+HMatrix::HMatrix()
+  : top(0), factored(false), spd(false), shifted(false),
+    sqrtFactored(false), singleFactors(false), permuted(false),
+    nShift(0) {}
 
 HMatrix::HMatrix(int nProc_, int level_)
-  : nProc(nProc_), level(level_) {
+  : nProc(nProc_), level(level_), top(0), factored(false), spd(false),
+    shifted(false), sqrtFactored(false), singleFactors(false),
+    permuted(false), nShift(0) {
 
   // ================================================
   // the first step is to have the same number of
   //  partitions as the number of leaves.
   // ================================================
-  // number of partitions
-  // if level=1, the number of partition is 2 for V0 and V1
-  int nPart = pow(2, level);
-  
-  // assume evenly distributed across machines
-  assert( nPart % nProc == 0);
+  // the mapper spreads the pow(2, level) partitions
+  //  over the processors, which need not divide evenly
+  assert( nProc > 0 && level >= 0 );
 }
 
 void HMatrix::init
 (const Matrix& U, const Matrix& V, const Vector& D,
- Context ctx, HighLevelRuntime* runtime) {
+ Context ctx, HighLevelRuntime* runtime, int nRhs,
+ const std::vector<int>& ranks) {
   
   // sanity check
   assert( U.rows() == V.rows() );
   assert( U.rows() == D.rows() );
   assert( U.cols() == V.cols() );
   assert( U.cols()  > 0 );
+  assert( U.levels() >= level );
+  // the smallest leaf (see block_begin()) is larger than the rank
+  assert( U.rows() / (int)pow(2, U.levels()) > U.cols() );
+  assert( nRhs > 0 );
 
   // populate data
-  uTree.init( U);
-  vTree.init( V );
-  kTree.init( U, V, D );
+  uTree.init( U, nRhs, ranks );
+  vTree.init( V, ranks );
+  kTree.init( U, V, D, ranks );
 
   // data partition
   uTree.partition( level, ctx, runtime );
@@ -46,18 +54,894 @@ void HMatrix::init
 #endif
 }
 
-Vector HMatrix::solve
+// The systems are the subtrees at depth top of one tree, whose
+//  nodes above have rank zero. The partitions at the launch
+//  level of every system are those of the stacked regions at
+//  depth top+level, where partition p of system s has color
+//  s*2^level+p, and all the levels below depth top are solved
+//  as usual, only with more partitions in every launch.
+void HMatrix::init_batch
+(const std::vector<Matrix>& U, const std::vector<Matrix>& V,
+ const std::vector<Vector>& D, Context ctx, HighLevelRuntime* runtime,
+ int nRhs, const std::vector<int>& ranks) {
+
+  // sanity check
+  int nSys = U.size();
+  assert( top == 0 && !permuted );
+  assert( nSys > 0 && is_power_of_two(nSys) );
+  assert( int(V.size()) == nSys && int(D.size()) == nSys );
+  int nLevel = U[0].levels();
+  assert( ranks.empty() || int(ranks.size()) == nLevel );
+
+  // zero ranks above the systems
+  this->top = log2(nSys);
+  std::vector<int> profile(top, 0);
+  for (int k=0; k<nLevel; k++)
+    profile.push_back( ranks.empty() ? U[0].cols() : ranks[k] );
+  this->level += top;
+  init( Matrix::stack(U), Matrix::stack(V), Vector::stack(D), ctx, runtime,
+	nRhs, profile );
+}
+
+void HMatrix::init
+(const Matrix& U, const Vector& D,
+ Context ctx, HighLevelRuntime* runtime, int nRhs,
+ const std::vector<int>& ranks) {
+
+  // sanity check
+  assert( U.rows() == D.rows() );
+  assert( U.cols()  > 0 );
+  assert( U.levels() >= level );
+  // the smallest leaf (see block_begin()) is larger than the rank
+  assert( U.rows() / (int)pow(2, U.levels()) > U.cols() );
+  assert( nRhs > 0 );
+
+  // V is generated from the same seeds as U
+  uTree.init( U, nRhs, ranks );
+  uTree.keep_rhs_copy();
+  vTree.init( U, ranks );
+  kTree.init( U, U, D, ranks );
+  this->spd = true;
+
+  // data partition
+  uTree.partition( level, ctx, runtime );
+  vTree.partition( level, ctx, runtime );
+  kTree.partition( level, ctx, runtime );
+}
+
+void HMatrix::init
+(const std::vector<Matrix>& U, const std::vector<Matrix>& V,
+ const Matrix& K, const Vector& D,
+ Context ctx, HighLevelRuntime* runtime, int nRhs) {
+
+  // sanity check
+  assert( U.size() == V.size() );
+  assert( int(U.size()) >= level );
+  assert( K.rows() == D.rows() );
+  // every generator has a random seed for each leaf
+  int nLeaf = pow(2, U.size());
+  assert( K.num_partition() == nLeaf && D.num_partition() == nLeaf );
+  std::vector<int> ranks;
+  for (size_t k=0; k<U.size(); k++) {
+    assert( U[k].rows() == K.rows() && V[k].rows() == K.rows() );
+    assert( U[k].cols() == V[k].cols() );
+    assert( U[k].num_partition() == nLeaf );
+    assert( V[k].num_partition() == nLeaf );
+    // the smallest leaf is larger than the rank
+    assert( K.rows() / nLeaf > U[k].cols() );
+    ranks.push_back( U[k].cols() );
+  }
+  assert( nRhs > 0 );
+
+  // populate data
+  uTree.init( U, nRhs );
+  vTree.init( V );
+  kTree.init( K, D, ranks );
+
+  // data partition
+  uTree.partition( level, ctx, runtime );
+  vTree.partition( level, ctx, runtime );
+  kTree.partition( level, ctx, runtime );
+}
+
+void HMatrix::init
+(int func, int N, const std::vector<int>& ranks, double tol,
+ Context ctx, HighLevelRuntime* runtime, int nRhs) {
+
+  // sanity check
+  assert( int(ranks.size()) >= level );
+  assert( tol > 0.0 );
+  for (size_t k=0; k<ranks.size(); k++) {
+    // the smallest leaf is larger than the rank
+    assert( ranks[k] > 0 && N / (int)pow(2, ranks.size()) > ranks[k] );
+  }
+  assert( nRhs > 0 );
+  assert( !permuted || permMat.rows() == N );
+
+  // create regions
+  uTree.init( N, ranks, nRhs );
+  vTree.init( N, ranks );
+  kTree.init( N, ranks );
+  uTree.partition( level, ctx, runtime );
+  vTree.partition( level, ctx, runtime );
+  kTree.partition( level, ctx, runtime );
+
+  // evaluate the leaves and compress the off-diagonal blocks,
+  //  one index launch per depth, in the order of the tree
+  LMatrix perm = permuted ? permMat : LMatrix();
+  kTree.init_entries( func, perm, ctx, runtime );
+  for (size_t k=0; k<ranks.size(); k++)
+    LMatrix::aca( func, tol, k, uTree.column_begin(k),
+		  vTree.column_begin()[k], ranks[k],
+		  uTree.leaf(), vTree.leaf(), perm, ctx, runtime );
+}
+
+// The off-diagonal blocks at depth k are A(c, c^1) = u_c * V_c^1'
+//  for the children c at depth k+1. With the known levels above
+//  subtracted, the product with a sketch that is random on the
+//  children of one parity only samples A(c, c^1) on the children
+//  of the other parity, which gives an orthonormal u_c; then
+//  V_c^1 = A(c, c^1)' * u_c comes from a product with A'.
+void HMatrix::init
+(MatvecFunc matvec, int N, const std::vector<int>& ranks,
+ Context ctx, HighLevelRuntime* runtime, int nRhs) {
+
+  // sanity check
+  int nLevel = ranks.size();
+  assert( nLevel >= level );
+  int nLeaf  = pow(2, nLevel);
+  int rmax   = 0;
+  for (int k=0; k<nLevel; k++) {
+    // the smallest leaf is larger than the rank
+    assert( ranks[k] > 0 && N / nLeaf > ranks[k] );
+    rmax = std::max(rmax, ranks[k]);
+  }
+  assert( nRhs > 0 );
+
+  // create regions
+  uTree.init( N, ranks, nRhs );
+  vTree.init( N, ranks );
+  kTree.init( N, ranks );
+  uTree.partition( level, ctx, runtime );
+  vTree.partition( level, ctx, runtime );
+  kTree.partition( level, ctx, runtime );
+
+  // workspace for the sketches and the products, wide enough
+  //  for the largest leaf (see block_begin())
+  int width = std::max(2*rmax, (N+nLeaf-1)/nLeaf);
+  LMatrix X(N, width, level, ctx, runtime);
+  LMatrix Y(N, width, level, ctx, runtime);
+  const std::vector<int>& vcols = vTree.column_begin();
+  for (int k=0; k<nLevel; k++) {
+    int r = ranks[k];
+    LMatrix Xk = X;
+    LMatrix Yk = Y;
+    Xk.set_column_size(2*r);
+    Yk.set_column_size(2*r);
+
+    // u of the children, which also become the next sketch
+    Xk.sketch( k+1, r, ctx, runtime );
+    matvec( 'n', Xk, Yk, ctx, runtime );
+    apply_offdiag( 'n', -1.0, k, false, Xk, Yk, ctx, runtime );
+    LMatrix::peel( k+1, r, true, Yk, uTree.leaf(), uTree.column_begin(k),
+		   Xk, ctx, runtime );
+
+    // V of the children
+    matvec( 't', Xk, Yk, ctx, runtime );
+    apply_offdiag( 't', -1.0, k, false, Xk, Yk, ctx, runtime );
+    LMatrix::peel( k+1, r, false, Yk, vTree.leaf(), vcols[k],
+		   Xk, ctx, runtime );
+  }
+
+  // what is left are the dense leaf blocks
+  X.sketch( nLevel, 0, ctx, runtime );
+  matvec( 'n', X, Y, ctx, runtime );
+  apply_offdiag( 'n', -1.0, nLevel, false, X, Y, ctx, runtime );
+  kTree.init_blocks( Y, ctx, runtime );
+  X.clear(ctx, runtime);
+  Y.clear(ctx, runtime);
+}
+
+// The levels above the launch level use the same reduction as
+//  solve(), i.e., W = R'*x for every node, and every child c
+//  takes y_c += alpha * L_c * W_c^1, where L and R are u and V
+//  (swapped for the transpose). The levels below go to the
+//  partitions.
+void HMatrix::apply_offdiag
+(char trans, double alpha, int depth, bool dense, const LMatrix& X,
+ LMatrix& Y, Context ctx, HighLevelRuntime* runtime) {
+
+  assert( trans == 'n' || trans == 't' );
+  // the factors overwrite the u columns, whose copy is kept
+  //  by shift() and add_diagonal()
+  for (int j=top; j<std::min(depth, level); j++) {
+    LMatrix  u = factored ? uTree.saved_level(j+1) : uTree.uMat_level(j+1);
+    LMatrix& V = vTree.level(j+1);
+    LMatrix& L = (trans == 'n' ? u : V);
+    LMatrix& R = (trans == 'n' ? V : u);
+    int rows = pow(2, j+1)*u.cols();
+    LMatrix W(rows, X.cols(), j, ctx, runtime);
+    W.two_level_partition(ctx, runtime);
+    LMatrix::gemmRed('t', 'n', 1.0, R, X, 0.0, W, ctx, runtime );
+    LMatrix::gemmSib('n', 'n', alpha, L, W, 1.0, Y, ctx, runtime );
+    W.clear(ctx, runtime);
+  }
+  if (depth > level || dense) {
+    std::vector<int> ucols;
+    int offset = factored ? uTree.column_begin(0) : 0;
+    for (size_t k=0; k<uTree.rank_profile().size(); k++)
+      ucols.push_back( uTree.column_begin(k) - offset );
+    LMatrix& U = factored ? uTree.saved_u() : uTree.leaf();
+    kTree.multiply( trans, alpha, std::max(depth-level, 0), dense,
+		    U, vTree.leaf(), ucols, X, Y, ctx, runtime );
+  }
+}
+
+// the product follows the tree like the solve: V'*x is reduced
+//  for the nodes above the launch level and broadcast to the
+//  siblings, and the rest is done inside every partition
+void HMatrix::multiply
+(char trans, const LMatrix& X, LMatrix& Y,
+ Context ctx, HighLevelRuntime* runtime) {
+
+  assert( !factored || shifted );
+  assert( trans == 'n' || trans == 't' );
+  assert( X.rows() == Y.rows() && X.cols() == Y.cols() );
+  int nLevel = uTree.rank_profile().size();
+  Y.clear( 0.0, ctx, runtime );
+  apply_offdiag( trans, 1.0, nLevel, true, X, Y, ctx, runtime );
+}
+
+// The indices are exact as doubles; the problem order only goes
+//  through order_region(), so no inverse is stored.
+void HMatrix::set_permutation
+(const std::vector<int>& perm, Context ctx, HighLevelRuntime* runtime) {
+
+  int N = perm.size();
+  assert( N > 0 && top == 0 && !permuted );
+  Matrix P(N, 1);
+  std::vector<bool> seen(N, false);
+  for (int i=0; i<N; i++) {
+    assert( 0 <= perm[i] && perm[i] < N && !seen[perm[i]] );
+    seen[perm[i]] = true;
+    P(i, 0) = perm[i];
+  }
+  permMat = LMatrix(N, 1, level, ctx, runtime);
+  permMat.init_entries( P, ctx, runtime );
+  this->treeRow.resize(N);
+  for (int i=0; i<N; i++)
+    treeRow[perm[i]] = i;
+  this->permuted = true;
+  order_region( 1, ctx, runtime );
+}
+
+// Both directions use the rows perm[i] of the staging region for
+//  the rows i of a tree block, the tree order gathers them and the
+//  problem order is scattered to them, so one partition serves
+//  both; it is only rebuilt for a wider right hand side.
+LMatrix HMatrix::order_region
+(int cols, Context ctx, HighLevelRuntime* runtime) {
+  assert( permuted );
+  if (orderMat.cols() < cols) {
+    if (orderMat.cols() > 0) {
+      runtime->destroy_index_partition(ctx, orderPart.get_index_partition());
+      orderMat.clear(ctx, runtime);
+    }
+    int N = permMat.rows();
+    std::vector<int> perm(N);
+    for (int i=0; i<N; i++)
+      perm[treeRow[i]] = i;
+    orderMat = LMatrix(N, cols, level, ctx, runtime);
+    orderPart = LMatrix::permute_partition( perm, permMat, orderMat,
+					    ctx, runtime );
+  }
+  LMatrix X = orderMat;
+  X.set_column_size(cols);
+  return X;
+}
+
+// Every block u_c * V_c^1' becomes (Q_u*W*S) * (Q_v*Z)', where
+//  u_c = Q_u*R_u, V_c^1 = Q_v*R_v and R_u*R_v' = W*S*Z', so the
+//  leading k columns are its best rank k approximation. The
+//  bases of a depth are rotated independently of the others,
+//  so V is first given separate columns for every depth. The
+//  leaf blocks do not change.
+void HMatrix::recompress
+(double tol, Context ctx, HighLevelRuntime* runtime) {
+
+  assert( !factored && !shifted && !spd );
+  assert( tol > 0.0 );
+  std::vector<int> ranks = uTree.rank_profile();
+  vTree.resize( ranks, ctx, runtime );
+  std::vector<int> vcols = vTree.column_begin();
+  // the zero ranks of a batch stay
+  for (size_t k=top; k<ranks.size(); k++)
+    ranks[k] = LMatrix::recompress( tol, k, uTree.column_begin(k), vcols[k],
+				    ranks[k], uTree.leaf(), vTree.leaf(),
+				    ctx, runtime );
+  uTree.resize( ranks, ctx, runtime );
+  vTree.resize( ranks, ctx, runtime );
+  kTree.set_rank_profile( ranks, vTree.column_begin() );
+}
+
+const std::vector<int>& HMatrix::rank_profile() const {
+  return uTree.rank_profile();
+}
+
+// the nodes at depth with a flagged leaf below, or no flags
+static std::vector<bool> node_update
+(const std::vector<bool>& update, int depth) {
+  std::vector<bool> nodes;
+  if (update.empty())
+    return nodes;
+  int nNode = 1<<depth;
+  int blk   = update.size() / nNode;
+  nodes.assign(nNode, false);
+  for (size_t i=0; i<update.size(); i++)
+    if (update[i])
+      nodes[i/blk] = true;
+  return nodes;
+}
+
+// The factorization is the solve algorithm applied to the
+//  u columns only, i.e., d is replaced by the u columns of
+//  the ancestors. Everything that does not depend on the
+//  right hand side is computed here once.
+// For a symmetric positive definite matrix, the node systems
+//  are permuted into the symmetric form
+//  --              --
+//  | V0'*u0   I      |
+//  |                 |
+//  |   I     V1'*u1  |
+//  --              --
+//  and V is freed at the end, since every child c solves with
+//  a symmetric A_c, so V_c'*d_c = (A_c \ u_c)'*b_c for the
+//  factored u columns and the original right hand side b.
+void HMatrix::factor
+(Context ctx, HighLevelRuntime* runtime, bool single) {
+  assert( !factored );
+  refactor( std::vector<bool>(), ctx, runtime, single );
+}
+
+// Every factor depends only on the blocks below its node, so the
+//  blocks off the paths from the flagged leaves to the root keep
+//  their factors. The factored u columns of a node on a path
+//  change on all of its rows, however, so the u columns are solved
+//  again from the unfactored copy with the kept factors, which
+//  costs a solve rather than a factorization.
+void HMatrix::refactor
+(const std::vector<bool>& update, Context ctx, HighLevelRuntime* runtime,
+ bool single) {
+
+  // the kept factors are read in double
+  set_factor_type( SCALAR_DOUBLE, ctx, runtime );
+
+  // leaf factorization: u = dense \ u
+  logdet = kTree.factor( uTree.uMat(), vTree.leaf(), ctx, runtime, spd,
+			 single, update );
+
+  // the regions of a previous factorization are reused
+  //  (see shift() and add_diagonal())
+  bool reuse = !VTu_vec.empty();
+  VTu_vec.resize(level);
+  SFac_vec.resize(level);
+  VTd_vec.resize(level);
+  int nRhs = uTree.rhs_mat().cols();
+  for (int i=level; i>top; i--) {
+
+    LMatrix& V = vTree.level(i);
+    LMatrix& u = uTree.uMat_level(i);
+    int rank = V.cols();
+    int rows = pow(2, i)*rank;
+
+    // V'*u, the factors of the node systems and the
+    //  workspace for V'*d in solve()
+    if (!reuse) {
+      VTu_vec[i-1]  = LMatrix(rows, rank, i-1, ctx, runtime);
+      SFac_vec[i-1] = LMatrix(rows, 2*rank+1, i-1, ctx, runtime);
+      VTd_vec[i-1]  = LMatrix(rows, nRhs, i-1, ctx, runtime);
+      VTu_vec[i-1].two_level_partition(ctx, runtime);
+      VTd_vec[i-1].two_level_partition(ctx, runtime);
+    }
+    LMatrix& VTu  = VTu_vec[i-1];
+    LMatrix& SFac = SFac_vec[i-1];
+    LMatrix::gemmRed('t', 'n', 1.0, V, u, 0.0, VTu, ctx, runtime );
+    logdet = VTu.node_factor( SFac, spd, single, node_update(update, i-1),
+			      logdet, ctx, runtime );
+
+    // eliminate the u columns of the ancestors
+    if (i > top+1) {
+      LMatrix d = uTree.uMat();
+      d.set_column_size(uTree.column_begin(i-1)-nRhs);
+      LMatrix VTd(rows, d.cols(), i-1, ctx, runtime);
+      VTd.two_level_partition(ctx, runtime);
+      LMatrix::gemmRed('t', 'n', 1.0, V, d, 0.0, VTd, ctx, runtime );
+      SFac.node_solve_factored( VTd, spd, false, ctx, runtime );
+      LMatrix::gemmBro('n', 'n', -1.0, u, VTd, 1.0, d, ctx, runtime );
+      VTd.clear(ctx, runtime);
+    }
+  }
+  if (single)
+    set_factor_type( SCALAR_FLOAT, ctx, runtime );
+  // V is needed again after shift()
+  if (spd && !shifted)
+    vTree.clear(ctx, runtime);
+  this->factored = true;
+}
+
+// The factors of factor() with single are exact in float (see
+//  PtrMatrixT::factor()), so moving them costs no accuracy. The
+//  single precision copies of the trees hold the factored u
+//  columns and V, which the float solves take with the factors.
+void HMatrix::set_factor_type
+(ScalarType type, Context ctx, HighLevelRuntime* runtime) {
+  bool single = (type == SCALAR_FLOAT);
+  if (single == singleFactors)
+    return;
+  kTree.set_factor_type( type, ctx, runtime );
+  for (int i=level; i>top; i--) {
+    SFac_vec[i-1].set_scalar_type( type, ctx, runtime );
+    VTd_vec[i-1].set_scalar_type( type, ctx, runtime );
+    VTd_vec[i-1].two_level_partition( ctx, runtime );
+  }
+  if (single) {
+    uTree.keep_single( ctx, runtime );
+    if (!spd)
+      vTree.keep_single( ctx, runtime );
+  }
+  this->singleFactors = single;
+}
+
+// With V = u, a node is A = diag(A0, A1) + u*[0, I; I, 0]*u', and
+//  for the children A_c = W_c*W_c' and u_c := W_c \ u_c
+//    A = diag(W0, W1) * (I + u*[0, I; I, 0]*u') * diag(W0, W1)',
+//  so W = diag(W0, W1) * (I + u*X*u') if
+//    (I + u*X*u')*(I + u*X'*u') = I + u*[0, I; I, 0]*u'.
+//  NodeSqrtTask solves this with the Cholesky factors of u'*u and
+//  of a 2*rank system, whose determinant gives log|det A| (see
+//  node_sqrt.cc). The inverse of the node part is I - u*Y*u', which
+//  eliminates the u columns of the ancestors, d -= u*Y*(u'*d), like
+//  refactor(), so that the u columns of every level are solved by
+//  the W of their children. V is not needed.
+void HMatrix::factor_sqrt(Context ctx, HighLevelRuntime* runtime) {
+
+  assert( spd && !factored && !shifted );
+  logdet = kTree.factor_sqrt( uTree.uMat(), ctx, runtime );
+
+  VTu_vec.resize(level);
+  SFac_vec.resize(level);
+  VTd_vec.resize(level);
+  int nRhs = uTree.rhs_mat().cols();
+  for (int i=level; i>top; i--) {
+
+    LMatrix& u = uTree.uMat_level(i);
+    int rank = u.cols();
+    int rows = pow(2, i)*rank;
+
+    // u'*u, the node factors and the workspace
+    //  of multiply_sqrt()
+    VTu_vec[i-1]  = LMatrix(rows, rank, i-1, ctx, runtime);
+    SFac_vec[i-1] = LMatrix(rows, 2*rank+1, i-1, ctx, runtime);
+    VTd_vec[i-1]  = LMatrix(rows, nRhs, i-1, ctx, runtime);
+    VTu_vec[i-1].two_level_partition(ctx, runtime);
+    VTd_vec[i-1].two_level_partition(ctx, runtime);
+    LMatrix& VTu  = VTu_vec[i-1];
+    LMatrix& SFac = SFac_vec[i-1];
+    LMatrix::gemmRed('t', 'n', 1.0, u, u, 0.0, VTu, ctx, runtime );
+    if (i == top+1) {
+      logdet = VTu.node_sqrt( SFac, NULL, logdet, ctx, runtime );
+      continue;
+    }
+
+    // the node task also forms Y*(u'*d) for the ancestors
+    LMatrix d = uTree.uMat();
+    d.set_column_size(uTree.column_begin(i-1)-nRhs);
+    LMatrix VTd(rows, d.cols(), i-1, ctx, runtime);
+    VTd.two_level_partition(ctx, runtime);
+    LMatrix::gemmRed('t', 'n', 1.0, u, d, 0.0, VTd, ctx, runtime );
+    logdet = VTu.node_sqrt( SFac, &VTd, logdet, ctx, runtime );
+    LMatrix::gemmBro('n', 'n', -1.0, u, VTd, 1.0, d, ctx, runtime );
+    VTd.clear(ctx, runtime);
+  }
+  vTree.clear(ctx, runtime);
+  this->factored = true;
+  this->sqrtFactored = true;
+}
+
+// W is the product of the node factors from the top down and
+//  the leaf factors, so for 'n' every node above the launch level
+//  takes y += u*X*(u'*y) before the leaf task applies the rest,
+//  and for 't' the order is reversed with X'
+void HMatrix::multiply_sqrt
+(char trans, const LMatrix& X, LMatrix& Y,
+ Context ctx, HighLevelRuntime* runtime) {
+
+  assert( factored && sqrtFactored );
+  assert( trans == 'n' || trans == 't' );
+  assert( X.rows() == Y.rows() && X.cols() == Y.cols() );
+  LMatrix::add( 1.0, X, 0.0, X, Y, ctx, runtime );
+  if (trans == 't')
+    kTree.multiply_sqrt( trans, uTree.uMat(), Y, ctx, runtime );
+  for (int j=top+1; j<=level; j++) {
+    int i = (trans == 'n' ? j : level+top+1-j);
+    LMatrix& u = uTree.uMat_level(i);
+    // the workspace of factor_sqrt() fits as many columns
+    //  as the right hand side
+    bool temp = Y.cols() != VTd_vec[i-1].cols();
+    LMatrix W = VTd_vec[i-1];
+    if (temp) {
+      W = LMatrix(pow(2, i)*u.cols(), Y.cols(), i-1, ctx, runtime);
+      W.two_level_partition(ctx, runtime);
+    }
+    LMatrix::gemmRed('t', 'n', 1.0, u, Y, 0.0, W, ctx, runtime );
+    SFac_vec[i-1].node_multiply_sqrt( W, trans, ctx, runtime );
+    LMatrix::gemmBro('n', 'n', 1.0, u, W, 1.0, Y, ctx, runtime );
+    if (temp)
+      W.clear(ctx, runtime);
+  }
+  if (trans == 'n')
+    kTree.multiply_sqrt( trans, uTree.uMat(), Y, ctx, runtime );
+}
+
+// The first call keeps copies of the leaf blocks and the u
+//  columns; every call resets them from the copies, and only
+//  the diagonal of the leaf blocks is shifted before factor()
+void HMatrix::shift
+(double sigma, Context ctx, HighLevelRuntime* runtime, bool single) {
+
+  if (!shifted) {
+    assert( !factored );
+    uTree.save_u( ctx, runtime );
+    this->shifted = true;
+  } else
+    uTree.restore_u( ctx, runtime );
+  kTree.shift( sigma, ctx, runtime );
+  this->factored = false;
+  factor( ctx, runtime, single );
+}
+
+// The changed rows flag their leaves, and the first call keeps
+//  the unfactored data like shift()
+void HMatrix::add_diagonal
+(const std::vector<int>& rows, const std::vector<double>& delta,
+ Context ctx, HighLevelRuntime* runtime, bool single) {
+
+  assert( rows.size() == delta.size() );
+  std::vector<int> treeRows(rows);
+  if (permuted)
+    for (size_t k=0; k<rows.size(); k++)
+      treeRows[k] = treeRow[rows[k]];
+  bool first = !shifted;
+  if (first) {
+    assert( !factored );
+    uTree.save_u( ctx, runtime );
+    this->shifted = true;
+  } else {
+    assert( factored );
+    uTree.restore_u( ctx, runtime );
+  }
+  std::vector<bool> update = kTree.add_diagonal( treeRows, delta,
+						 ctx, runtime );
+  this->factored = false;
+  refactor( first ? std::vector<bool>() : update, ctx, runtime, single );
+}
+
+// The solve without stored factors, i.e., factor() and solve()
+//  in one sweep, where every shift has its own copy of the right
+//  hand side and the u columns. The copies are side by side, so
+//  the shifts only add columns to the launches of every level:
+//  V'*u and V'*d are reduced for all shifts at once, the node
+//  systems of all shifts are solved in one launch and so is the
+//  broadcast d -= u*eta.
+void HMatrix::solve_shifts
+(const Matrix& b, const std::vector<double>& sigma,
+ Context ctx, HighLevelRuntime* runtime) {
+
+  assert( !factored );
+  assert( b.rows() > 0 );
+  assert( b.cols() == uTree.rhs_mat().cols() );
+  assert( 0 < sigma.size() && sigma.size() <= size_t(MAX_SHIFTS) );
+
+  // every shift block is the leading columns of U (see
+  //  UTree::column_begin())
+  init_rhs(b, ctx, runtime);
+  int nLevel = uTree.rank_profile().size();
+  int width  = uTree.column_begin(nLevel);
+  if (nShift > 0)
+    shiftMat.clear(ctx, runtime);
+  this->nShift = sigma.size();
+  shiftMat = LMatrix(b.rows(), nShift*width, level, ctx, runtime);
+
+  // leaf solve of all shifts: W = (dense + sigma*I) \ [b, u]
+  kTree.solve_shifts( uTree.leaf(), shiftMat, vTree.leaf(), sigma,
+		      ctx, runtime );
+
+  for (int i=level; i>top; i--) {
+
+    // the columns of the first shift; the others are width
+    //  columns apart
+    LMatrix& V = vTree.level(i);
+    int rank = V.cols();
+    int rows = pow(2, i)*rank;
+    LMatrix d = shiftMat;
+    d.set_column_size(uTree.column_begin(i-1));
+    LMatrix u = shiftMat;
+    u.set_column_begin(uTree.column_begin(i-1));
+    u.set_column_size(rank);
+
+    LMatrix VTu(rows, nShift*rank, i-1, ctx, runtime);
+    LMatrix VTd(rows, nShift*d.cols(), i-1, ctx, runtime);
+    VTu.two_level_partition(ctx, runtime);
+    VTd.two_level_partition(ctx, runtime);
+    LMatrix::gemmRed('t', 'n', 1.0, V, u, 0.0, VTu, nShift, width,
+		     ctx, runtime );
+    LMatrix::gemmRed('t', 'n', 1.0, V, d, 0.0, VTd, nShift, width,
+		     ctx, runtime );
+    VTu.node_solve( VTd, nShift, ctx, runtime );
+    LMatrix::gemmBro('n', 'n', -1.0, u, VTd, 1.0, d, nShift, width,
+		     ctx, runtime );
+    VTu.clear(ctx, runtime);
+    VTd.clear(ctx, runtime);
+  }
+}
+
+Matrix HMatrix::shift_solution
+(int k, Context ctx, HighLevelRuntime* runtime) {
+  assert( 0 <= k && k < nShift );
+  int width = shiftMat.cols() / nShift;
+  int nRhs  = uTree.rhs_mat().cols();
+  if (permuted) {
+    LMatrix x = shiftMat;
+    x.set_column_begin(k*width);
+    x.set_column_size(nRhs);
+    return to_problem_order(x, ctx, runtime);
+  }
+  return shiftMat.to_matrix(k*width, k*width+nRhs, ctx, runtime);
+}
+
+void HMatrix::solve
 (const Matrix& b, Context ctx, HighLevelRuntime* runtime) {
 
   // check input
+  assert( factored );
   assert( b.rows() > 0 );
-  assert( b.cols() == 1 ); // only support a single right hand side now
+  assert( b.cols() == uTree.rhs_mat().cols() );
   
   // initialize the right hand side
-  uTree.init_rhs(b, ctx, runtime);
-  
-  // leaf solve: U = dense \ U
-  kTree.solve( uTree.leaf(), vTree.leaf(), ctx, runtime );
+  init_rhs(b, ctx, runtime);
+  solve_rhs(ctx, runtime);
+}
+
+// The factors give A = diag(A0, A1) * (I + [0, w0*V1'; w1*V0', 0])
+//  at every node with w = A \ u for the children, so the transpose
+//  is eliminated top down: first the nodes above the launch level,
+//  where [w0'*b0; w1'*b1] is reduced, the transposed node system
+//  is solved and every child takes b_c -= V_c * eta_c^1 from its
+//  sibling, and then the subtrees in the partitions (see
+//  hsolve_transpose()). A symmetric matrix is its transpose.
+void HMatrix::solve_transpose
+(const Matrix& b, Context ctx, HighLevelRuntime* runtime) {
+
+  if (spd) {
+    solve(b, ctx, runtime);
+    return;
+  }
+  assert( factored );
+  assert( b.rows() > 0 );
+  assert( b.cols() == uTree.rhs_mat().cols() );
+
+  // gemmSib() is in double only
+  set_factor_type( SCALAR_DOUBLE, ctx, runtime );
+  init_rhs(b, ctx, runtime);
+  LMatrix& d = uTree.rhs_mat();
+  for (int i=top+1; i<=level; i++) {
+
+    LMatrix& u   = uTree.uMat_level(i);
+    LMatrix& VTd = VTd_vec[i-1];
+    LMatrix::gemmRed('t', 'n', 1.0, u, d, 0.0, VTd, ctx, runtime );
+    SFac_vec[i-1].node_solve_factored( VTd, false, true, ctx, runtime );
+    LMatrix::gemmSib('n', 'n', -1.0, vTree.level(i), VTd, 1.0, d,
+		     ctx, runtime );
+  }
+  kTree.solve_factored( d, vTree.leaf(), ctx, runtime, true );
+}
+
+// Every node is A = diag(A0, A1) * (I + [0, w0*V1'; w1*V0', 0]) with
+//  w = A_c \ u for the children c (see hsolve_transpose()), so for
+//  row i of child c
+//    inv(A)(i, i) = inv(A_c)(i, i) - w_c(i, :) * R_c * z_c(i, :)',
+//  where z_c = A_c' \ V_c and R_c couples child c to itself in the
+//  inverse node system (see node_inverse.cc), down to inv(K) at the
+//  leaves. The workspace Z holds z for every depth, which the levels
+//  above the launch level eliminate top down like solve_transpose()
+//  and the leaf tasks finish, and w*R of these levels; the leaf
+//  tasks compute the rest inside their subtree. With spd, z = w.
+LMatrix HMatrix::inverse_diagonal
+(bool blocks, Context ctx, HighLevelRuntime* runtime) {
+
+  assert( factored && !sqrtFactored );
+  set_factor_type( SCALAR_DOUBLE, ctx, runtime );
+  const std::vector<int>& ranks = uTree.rank_profile();
+  const std::vector<int>& vcols = vTree.column_begin();
+  // u columns of all depths and of those above the launch level
+  int nz = 0;
+  int nw = 0;
+  for (int k=0; k<int(ranks.size()); k++) {
+    nz += ranks[k];
+    if (k < level)
+      nw += ranks[k];
+  }
+  int wcol = spd ? 0 : nz;
+  LMatrix Z(uTree.uMat().rows(), std::max(wcol+nw, 1), level, ctx, runtime);
+  if (!spd) {
+    int zcol = 0;
+    for (int k=0; k<int(ranks.size()); k++) {
+      if (ranks[k] == 0) continue;
+      LMatrix v = vTree.leaf();
+      v.set_column_begin(vcols[k]);
+      v.set_column_size(ranks[k]);
+      LMatrix z = Z;
+      z.set_column_begin(zcol);
+      z.set_column_size(ranks[k]);
+      LMatrix::add( 1.0, v, 0.0, v, z, ctx, runtime );
+      zcol += ranks[k];
+    }
+  }
+  if (nw > 0) {
+    LMatrix w = Z;
+    w.set_column_begin(wcol);
+    w.set_column_size(nw);
+    w.clear( 0.0, ctx, runtime );
+  }
+
+  for (int i=top+1; i<=level; i++) {
+
+    LMatrix& u = uTree.uMat_level(i);
+    int rank = u.cols();
+    int rows = pow(2, i)*rank;
+    int zcol = uTree.column_begin(i-1)-uTree.column_begin(0);
+
+    // z of the depths above goes through this level
+    if (!spd && zcol > 0) {
+      LMatrix z = Z;
+      z.set_column_begin(0);
+      z.set_column_size(zcol);
+      LMatrix VTz(rows, zcol, i-1, ctx, runtime);
+      VTz.two_level_partition(ctx, runtime);
+      LMatrix::gemmRed('t', 'n', 1.0, u, z, 0.0, VTz, ctx, runtime );
+      SFac_vec[i-1].node_solve_factored( VTz, false, true, ctx, runtime );
+      LMatrix::gemmSib('n', 'n', -1.0, vTree.level(i), VTz, 1.0, z,
+		       ctx, runtime );
+      VTz.clear(ctx, runtime);
+    }
+
+    // w*R of this level
+    LMatrix R(rows, rank, i-1, ctx, runtime);
+    R.two_level_partition(ctx, runtime);
+    SFac_vec[i-1].node_inverse( R, spd, ctx, runtime );
+    LMatrix w = Z;
+    w.set_column_begin(wcol+zcol);
+    w.set_column_size(rank);
+    LMatrix::gemmSib('n', 'n', 1.0, u, R, 1.0, w, ctx, runtime );
+    R.clear(ctx, runtime);
+  }
+
+  LMatrix X = kTree.inverse_diagonal( blocks, uTree.uMat(), vTree.leaf(),
+				      Z, wcol, ctx, runtime );
+  Z.clear(ctx, runtime);
+  if (!permuted || blocks)
+    return X;
+  LMatrix y = order_region( 1, ctx, runtime );
+  LMatrix::permute( permMat, 0, y, orderPart, X, true, ctx, runtime );
+  LMatrix x(X.rows(), 1, level, ctx, runtime);
+  LMatrix::add( 1.0, y, 0.0, y, x, ctx, runtime );
+  X.clear(ctx, runtime);
+  return x;
+}
+
+// With single precision factors, every solve only has about
+//  single precision accuracy, but the residual is computed in
+//  double, so every step gains the accuracy of the factors
+//  until the double precision residual is reached.
+void HMatrix::solve
+(const Matrix& b, MatvecFunc matvec, int nRefine,
+ Context ctx, HighLevelRuntime* runtime) {
+
+  assert( nRefine >= 0 );
+  solve(b, ctx, runtime);
+  if (nRefine == 0) return;
+
+  // the right hand side, the current solution and the residual
+  LMatrix& d = uTree.rhs_mat();
+  LMatrix B(d.rows(), d.cols(), level, ctx, runtime);
+  LMatrix X(d.rows(), d.cols(), level, ctx, runtime);
+  LMatrix R(d.rows(), d.cols(), level, ctx, runtime);
+  to_tree_order(b, B, ctx, runtime);
+  for (int k=0; k<nRefine; k++) {
+    LMatrix::add( 1.0, d, 0.0, d, X, ctx, runtime );
+    matvec( 'n', X, R, ctx, runtime );
+    // correction: d = A \ (b - A*x)
+    LMatrix::add( 1.0, B, -1.0, R, d, ctx, runtime );
+    if (spd)
+      LMatrix::add( 1.0, B, -1.0, R, uTree.rhs_copy(), ctx, runtime );
+    solve_rhs( ctx, runtime );
+    LMatrix::add( 1.0, X, 1.0, d, R, ctx, runtime );
+    LMatrix::add( 1.0, R, 0.0, R, d, ctx, runtime );
+  }
+  B.clear(ctx, runtime);
+  X.clear(ctx, runtime);
+  R.clear(ctx, runtime);
+}
+
+void HMatrix::init_rhs
+(const Matrix& b, Context ctx, HighLevelRuntime* runtime) {
+  if (!permuted) {
+    uTree.init_rhs(b, ctx, runtime);
+    return;
+  }
+  LMatrix& d = uTree.rhs_mat();
+  to_tree_order( b, d, ctx, runtime );
+  if (spd)
+    LMatrix::add( 1.0, d, 0.0, d, uTree.rhs_copy(), ctx, runtime );
+}
+
+// the data of b is generated in the problem order and gathered
+//  through the permutation
+void HMatrix::to_tree_order
+(const Matrix& b, LMatrix& B, Context ctx, HighLevelRuntime* runtime) {
+  if (!permuted) {
+    B.init_data( b, ctx, runtime );
+    return;
+  }
+  assert( b.rows() == permMat.rows() && b.cols() == B.cols() );
+  LMatrix temp = order_region( b.cols(), ctx, runtime );
+  temp.init_data( b, ctx, runtime );
+  LMatrix::permute( permMat, 0, temp, orderPart, B, false, ctx, runtime );
+}
+
+Matrix HMatrix::to_problem_order
+(const LMatrix& X, Context ctx, HighLevelRuntime* runtime) {
+  assert( permuted && X.rows() == permMat.rows() );
+  LMatrix temp = order_region( X.cols(), ctx, runtime );
+  LMatrix Y = X;
+  LMatrix::permute( permMat, 0, temp, orderPart, Y, true, ctx, runtime );
+  return temp.to_matrix(0, X.cols(), ctx, runtime);
+}
+
+// the columns of view in R, a region with the same columns as
+//  the one of view (see UTree::single_copy())
+static LMatrix column_view(LMatrix& R, const LMatrix& view) {
+  LMatrix v = R;
+  v.set_column_begin(view.column_begin());
+  v.set_column_size(view.cols());
+  return v;
+}
+
+// With single precision factors, the right hand side columns
+//  are converted to the copy of U, the solve runs in float on
+//  the copies of U and V, and the solution is converted back.
+void HMatrix::solve_rhs(Context ctx, HighLevelRuntime* runtime) {
+
+  assert( !sqrtFactored );
+
+  LMatrix d = uTree.rhs_mat();
+  LMatrix b = uTree.rhs_copy();
+  if (singleFactors) {
+    d = column_view( uTree.single_copy(), d );
+    LMatrix::convert( uTree.rhs_mat(), d, ctx, runtime );
+    if (spd) {
+      b = column_view( uTree.single_copy(), b );
+      LMatrix::convert( uTree.rhs_copy(), b, ctx, runtime );
+    }
+  }
+
+  // leaf solve: d = dense \ d
+  if (spd)
+    kTree.solve_factored( d, b.column_begin(), ctx, runtime );
+  else if (singleFactors)
+    kTree.solve_factored( d, vTree.single_copy(), ctx, runtime );
+  else
+    kTree.solve_factored( d, vTree.leaf(), ctx, runtime );
   
   // upward pass:
   // --             --  --    --     --      --
@@ -72,25 +956,264 @@ Vector HMatrix::solve
   // | x1 |   | d1 - u1*eta1 |
   // -    -   --            --
   
-  for (int i=level-1; i>=0; i--) {
+  for (int i=level; i>top; i--) {
 
-    LMatrix& V = vTree.level(i);
-    LMatrix& u = uTree.uMat_level(i);
-    LMatrix& d = uTree.dMat_level(i);
+    LMatrix  u   = uTree.uMat_level(i);
+    LMatrix  V   = vTree.level(i);
+    LMatrix& VTd = VTd_vec[i-1];
+    if (singleFactors) {
+      u = column_view( uTree.single_copy(), u );
+      if (!spd)
+	V = column_view( vTree.single_copy(), V );
+    }
     
-    // reduction operation
-    LMatrix VTu(V.cols(), u.cols(), i, ctx, runtime);
-    LMatrix VTd(V.cols(), d.cols(), i, ctx, runtime);
-    LMatrix::gemmRed('t', 'n', 1.0, V, u, 0.0, VTu, ctx, runtime );
-    LMatrix::gemmRed('t', 'n', 1.0, V, d, 0.0, VTd, ctx, runtime );
+    // reduction operation: V'*d, or u'*b for the symmetric
+    //  factors (see factor())
+    if (spd)
+      LMatrix::gemmRed('t', 'n', 1.0, u, b, 0.0, VTd, ctx, runtime );
+    else
+      LMatrix::gemmRed('t', 'n', 1.0, V, d, 0.0, VTd, ctx, runtime );
     
-    // form and solve the small linear system
-    VTu.node_solve( VTd, ctx, runtime );
+    // solve the small linear system with the stored factors
+    SFac_vec[i-1].node_solve_factored( VTd, spd, false, ctx, runtime );
       
     // broadcast operation
     // d -= u * VTd
     LMatrix::gemmBro('n', 'n', -1.0, u, VTd, 1.0, d, ctx, runtime );
   }
-  
-  return uTree.rhs();
+  if (singleFactors)
+    LMatrix::convert( d, uTree.rhs_mat(), ctx, runtime );
+}
+
+void HMatrix::precondition
+(const LMatrix& r, LMatrix& z, Context ctx, HighLevelRuntime* runtime) {
+
+  LMatrix& d = uTree.rhs_mat();
+  LMatrix::add( 1.0, r, 0.0, r, d, ctx, runtime );
+  if (spd)
+    LMatrix::add( 1.0, r, 0.0, r, uTree.rhs_copy(), ctx, runtime );
+  solve_rhs( ctx, runtime );
+  LMatrix::add( 1.0, d, 0.0, d, z, ctx, runtime );
+}
+
+// The inner products are futures from reductions over the
+//  partitions, and the host only waits for the scalars it
+//  needs to go on; all the vector updates are index launches.
+int HMatrix::cg
+(const Matrix& b, MatvecFunc matvec, double tol, int maxIt,
+ Context ctx, HighLevelRuntime* runtime) {
+
+  assert( factored );
+  assert( b.cols() == 1 && uTree.rhs_mat().cols() == 1 );
+  assert( top == 0 );
+  assert( tol > 0.0 && maxIt > 0 );
+
+  // the solution, the residual, the preconditioned residual,
+  //  the search direction and its product
+  int N = b.rows();
+  LMatrix X(N, 1, level, ctx, runtime);
+  LMatrix R(N, 1, level, ctx, runtime);
+  LMatrix Z(N, 1, level, ctx, runtime);
+  LMatrix P(N, 1, level, ctx, runtime);
+  LMatrix Q(N, 1, level, ctx, runtime);
+  X.clear( 0.0, ctx, runtime );
+  to_tree_order( b, R, ctx, runtime );
+  Future bb = LMatrix::dot( R, R, ctx, runtime );
+  precondition( R, Z, ctx, runtime );
+  LMatrix::add( 1.0, Z, 0.0, Z, P, ctx, runtime );
+  double rz    = LMatrix::dot( R, Z, ctx, runtime ).get_result<double>();
+  double bnorm = sqrt( bb.get_result<double>() );
+
+  int k = 0;
+  while (k < maxIt) {
+    matvec( 'n', P, Q, ctx, runtime );
+    k++;
+    double pq = LMatrix::dot( P, Q, ctx, runtime ).get_result<double>();
+    double alpha = rz / pq;
+    LMatrix::add( 1.0, X,  alpha, P, X, ctx, runtime );
+    LMatrix::add( 1.0, R, -alpha, Q, R, ctx, runtime );
+    Future rr = LMatrix::dot( R, R, ctx, runtime );
+    if (sqrt(rr.get_result<double>()) <= tol*bnorm) break;
+
+    // p = z + beta*p
+    precondition( R, Z, ctx, runtime );
+    double rzNew = LMatrix::dot( R, Z, ctx, runtime ).get_result<double>();
+    LMatrix::add( rzNew/rz, P, 1.0, Z, P, ctx, runtime );
+    rz = rzNew;
+  }
+  LMatrix::add( 1.0, X, 0.0, X, uTree.rhs_mat(), ctx, runtime );
+  X.clear(ctx, runtime);
+  R.clear(ctx, runtime);
+  Z.clear(ctx, runtime);
+  P.clear(ctx, runtime);
+  Q.clear(ctx, runtime);
+  return k;
+}
+
+// Every cycle builds an orthonormal basis v_0, ..., v_m of the
+//  Krylov space of A*M^{-1} from the residual by modified
+//  Gram-Schmidt, and the Hessenberg matrix H of the inner
+//  products stays on the host, where the least squares problem
+//  min |beta*e_1 - H*y| is updated by Givens rotations after
+//  every step; then x += M^{-1} * (V*y).
+int HMatrix::gmres
+(const Matrix& b, MatvecFunc matvec, double tol, int restart,
+ int maxIt, Context ctx, HighLevelRuntime* runtime) {
+
+  assert( factored );
+  assert( b.cols() == 1 && uTree.rhs_mat().cols() == 1 );
+  assert( top == 0 );
+  assert( tol > 0.0 && restart > 0 && maxIt > 0 );
+
+  // the Krylov basis, the right hand side, the solution, the
+  //  residual (also the new basis vector) and the
+  //  preconditioned vectors
+  int N = b.rows();
+  int m = restart;
+  std::vector<LMatrix> V(m+1);
+  for (int j=0; j<=m; j++)
+    V[j] = LMatrix(N, 1, level, ctx, runtime);
+  LMatrix B(N, 1, level, ctx, runtime);
+  LMatrix X(N, 1, level, ctx, runtime);
+  LMatrix R(N, 1, level, ctx, runtime);
+  LMatrix Z(N, 1, level, ctx, runtime);
+  to_tree_order( b, B, ctx, runtime );
+  X.clear( 0.0, ctx, runtime );
+  double bnorm = sqrt( LMatrix::dot(B, B, ctx, runtime).get_result<double>() );
+
+  // H is rotated into an upper triangular matrix, and g is the
+  //  rotated beta*e_1
+  Matrix H(m+1, m);
+  std::vector<double> cs(m), sn(m), g(m+1), y(m);
+  int  k = 0;
+  bool converged = false;
+  while (k < maxIt && !converged) {
+
+    // r = b - A*x
+    matvec( 'n', X, R, ctx, runtime );
+    LMatrix::add( 1.0, B, -1.0, R, R, ctx, runtime );
+    double beta = sqrt( LMatrix::dot(R, R, ctx, runtime).get_result<double>() );
+    if (beta <= tol*bnorm) break;
+    LMatrix::add( 1.0/beta, R, 0.0, R, V[0], ctx, runtime );
+    std::fill(g.begin(), g.end(), 0.0);
+    g[0] = beta;
+
+    int j = 0;
+    while (j < m && k < maxIt && !converged) {
+      // r = A * M^{-1} * v_j orthogonalized against the basis
+      precondition( V[j], Z, ctx, runtime );
+      matvec( 'n', Z, R, ctx, runtime );
+      k++;
+      for (int i=0; i<=j; i++) {
+	H(i, j) = LMatrix::dot( R, V[i], ctx, runtime ).get_result<double>();
+	LMatrix::add( 1.0, R, -H(i, j), V[i], R, ctx, runtime );
+      }
+      H(j+1, j) = sqrt( LMatrix::dot(R, R, ctx, runtime).get_result<double>() );
+      // otherwise the solution is in the span (lucky breakdown)
+      if (H(j+1, j) > 0.0)
+	LMatrix::add( 1.0/H(j+1, j), R, 0.0, R, V[j+1], ctx, runtime );
+
+      // apply the previous rotations and eliminate H(j+1, j)
+      for (int i=0; i<j; i++) {
+	double t  =  cs[i]*H(i, j) + sn[i]*H(i+1, j);
+	H(i+1, j) = -sn[i]*H(i, j) + cs[i]*H(i+1, j);
+	H(i, j)   = t;
+      }
+      double rho = sqrt( H(j, j)*H(j, j) + H(j+1, j)*H(j+1, j) );
+      cs[j]  = H(j, j) / rho;
+      sn[j]  = H(j+1, j) / rho;
+      H(j, j)   = rho;
+      H(j+1, j) = 0.0;
+      g[j+1] = -sn[j]*g[j];
+      g[j]   =  cs[j]*g[j];
+      j++;
+      converged = fabs(g[j]) <= tol*bnorm;
+    }
+
+    // y = H \ g and x += M^{-1} * (V*y)
+    for (int i=j-1; i>=0; i--) {
+      y[i] = g[i];
+      for (int l=i+1; l<j; l++)
+	y[i] -= H(i, l)*y[l];
+      y[i] /= H(i, i);
+    }
+    R.clear( 0.0, ctx, runtime );
+    for (int i=0; i<j; i++)
+      LMatrix::add( 1.0, R, y[i], V[i], R, ctx, runtime );
+    precondition( R, Z, ctx, runtime );
+    LMatrix::add( 1.0, X, 1.0, Z, X, ctx, runtime );
+  }
+  LMatrix::add( 1.0, X, 0.0, X, uTree.rhs_mat(), ctx, runtime );
+  for (int j=0; j<=m; j++)
+    V[j].clear(ctx, runtime);
+  B.clear(ctx, runtime);
+  X.clear(ctx, runtime);
+  R.clear(ctx, runtime);
+  Z.clear(ctx, runtime);
+  return k;
+}
+
+Matrix HMatrix::solution(Context ctx, HighLevelRuntime* runtime) {
+  if (permuted)
+    return to_problem_order(uTree.rhs_mat(), ctx, runtime);
+  return uTree.solution(ctx, runtime);
+}
+
+Matrix HMatrix::solution(int s, Context ctx, HighLevelRuntime* runtime) {
+  int nSys = 1<<top;
+  assert( 0 <= s && s < nSys );
+  LMatrix& b = uTree.rhs_mat();
+  int N = b.rows() / nSys;
+  return b.to_matrix(s*N, (s+1)*N, 0, b.cols(), ctx, runtime);
+}
+
+LMatrix& HMatrix::rhs_mat() {
+  return uTree.rhs_mat();
+}
+
+// A = diag(A0, A1) * (I + [0, w0*V1'; w1*V0', 0]) at every node,
+//  where w = A \ u for the children, and the determinant of the
+//  second factor is that of the node system (Sylvester), so
+//  log|det A| sums over the leaf blocks and all node systems.
+//  Every index launch reduces its part with REDOP_ADD, and the
+//  running sum is passed on as a future.
+Future HMatrix::log_determinant() const {
+  assert( factored );
+  return logdet;
+}
+
+void HMatrix::destroy(Context ctx, HighLevelRuntime* runtime) {
+  // nothing is stored above the systems of a batch
+  for (size_t i=top; i<VTu_vec.size(); i++) {
+    VTu_vec[i].clear(ctx, runtime);
+    SFac_vec[i].clear(ctx, runtime);
+    VTd_vec[i].clear(ctx, runtime);
+  }
+  VTu_vec.clear();
+  SFac_vec.clear();
+  VTd_vec.clear();
+  if (nShift > 0)
+    shiftMat.clear(ctx, runtime);
+  this->nShift = 0;
+  uTree.clear(ctx, runtime);
+  // V of a symmetric matrix is freed by factor(), unless
+  //  it is kept for shift()
+  if (!(spd && factored && !shifted))
+    vTree.clear(ctx, runtime);
+  kTree.clear(ctx, runtime);
+  if (permuted) {
+    permMat.clear(ctx, runtime);
+    runtime->destroy_index_partition(ctx, orderPart.get_index_partition());
+    orderMat.clear(ctx, runtime);
+    orderMat = LMatrix();
+  }
+  this->treeRow.clear();
+  this->permuted = false;
+  this->factored = false;
+  this->spd = false;
+  this->shifted = false;
+  this->sqrtFactored = false;
+  this->singleFactors = false;
+  this->level -= top;
+  this->top = 0;
 }
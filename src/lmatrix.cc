@@ -1,27 +1,31 @@
 #include "lmatrix.hpp"
 #include <math.h> // for pow()
+#include <algorithm> // for std::max() and std::sort()
 
 static Realm::Logger log_solver_tasks("solver_tasks");
 
-LMatrix::LMatrix() : nPart(-1) {}
+LMatrix::LMatrix()
+  : mRows(0), mCols(0), type(SCALAR_DOUBLE), nPart(-1) {}
 
 LMatrix::LMatrix
 (int rows, int cols, int level,
- Context ctx, HighLevelRuntime *runtime) {
-  create(rows, cols, ctx, runtime);
+ Context ctx, HighLevelRuntime *runtime, ScalarType type) {
+  create(rows, cols, ctx, runtime, type);
   partition(level, ctx, runtime);
   this->plevel = 1;
 }
 
 LMatrix::LMatrix
 (int rows, int cols, LogicalRegion r, IndexSpace is, FieldSpace fs)
-  : mRows(rows), mCols(cols), ispace(is), fspace(fs), region(r) {}
+  : mRows(rows), mCols(cols), type(SCALAR_DOUBLE),
+    ispace(is), fspace(fs), region(r) {}
 
 LMatrix::LMatrix(LogicalRegion r, int rows, int cols) {
   this->region = r;
   this->ispace = region.get_index_space();
   this->mRows  = rows;
   this->mCols  = cols;
+  this->type   = SCALAR_DOUBLE;
 }
 
 /*
@@ -69,6 +73,8 @@ void LMatrix::set_column_size(int n) {mCols=n;}
 
 void LMatrix::set_column_begin(int begin) {colIdx=begin;}
 
+void LMatrix::set_small_block_parts(int n) {smallblk=n;}
+
 void LMatrix::set_logical_region(LogicalRegion lr) {region=lr;}
 
 void LMatrix::set_parent_region(LogicalRegion lr) {pregion=lr;}
@@ -76,11 +82,13 @@ void LMatrix::set_parent_region(LogicalRegion lr) {pregion=lr;}
 void LMatrix::set_logical_partition(LogicalPartition lp) {lpart=lp;}
 
 void LMatrix::create
-(int rows, int cols, Context ctx, HighLevelRuntime *runtime) {
+(int rows, int cols, Context ctx, HighLevelRuntime *runtime,
+ ScalarType type) {
   assert(rows>0 && cols>0);
   this->mRows = rows;
   this->mCols = cols;
   this->colIdx = 0;
+  this->type = type;
   Point<2> lo = make_point(0, 0);
   Point<2> hi = make_point(mRows-1, mCols-1);
   Rect<2> rect(lo, hi);
@@ -90,7 +98,7 @@ void LMatrix::create
   {
     FieldAllocator allocator = runtime->
       create_field_allocator(ctx, fspace);
-    allocator.allocate_field(sizeof(double), FIELDID_V);
+    allocator.allocate_field(scalar_size(type), FIELDID_V);
   }
   this->region = runtime->create_logical_region(ctx, ispace, fspace);
   //this->parent = region;
@@ -102,9 +110,13 @@ void LMatrix::clear
   
   // assuming partition is done
   assert(nPart > 0);
-  ClearMatrixTask::TaskArgs args = {rblock, mCols, value};
+  ClearMatrixTask::TaskArgs args = {mCols, colIdx, value};
   ClearMatrixTask launcher(colDom, TaskArgument(&args, sizeof(args)), ArgumentMap());
-  RegionRequirement req(lpart, 0, WRITE_DISCARD, EXCLUSIVE, region);
+  // a column view of a larger region keeps the other columns
+  Domain dom = runtime->get_index_space_domain(ctx, region.get_index_space());
+  bool view = colIdx > 0 || mCols < dom.get_rect<2>().dim_size(1);
+  RegionRequirement req(lpart, 0, view ? READ_WRITE : WRITE_DISCARD,
+			EXCLUSIVE, region);
   req.add_field(FIELDID_V);
   launcher.add_region_requirement(req);
   FutureMap fm = runtime->execute_index_space(ctx, launcher);
@@ -115,14 +127,23 @@ void LMatrix::clear
   }
 }
 
+void LMatrix::scale
+(double alpha, Context ctx, HighLevelRuntime *runtime, bool wait) {
+  SCALAR_DISPATCH(type, scale,
+		  (alpha, ctx, runtime, wait));
+}
+
+template <typename T>
 void LMatrix::scale
 (double alpha, Context ctx, HighLevelRuntime *runtime, bool wait) {
 
   // if alpha = 1.0, do nothing
   if ( fabs(alpha - 1.0) < 1e-10) return;
-  ScaleMatrixTask::TaskArgs args = {this->rblock * plevel, mCols, alpha};
+  typename ScaleMatrixTaskT<T>::TaskArgs args =
+    {this->rblock * plevel, mCols, T(alpha)};
   TaskArgument tArg(&args, sizeof(args));
-  ScaleMatrixTask launcher(colDom, tArg, ArgumentMap(), colDom.get_volume());
+  ScaleMatrixTaskT<T> launcher(colDom, tArg, ArgumentMap(),
+			       colDom.get_volume());
   RegionRequirement req(lpart, 0, READ_WRITE, EXCLUSIVE, region);
   //RegionRequirement req(lpart, 0, WRITE_DISCARD, EXCLUSIVE, region);
   req.add_field(FIELDID_V);
@@ -143,19 +164,28 @@ void LMatrix::init_data
   init_data(0, mat.cols(), mat, ctx, runtime, wait);
 }
 
+void LMatrix::init_data
+(int col0, int col1, const Matrix& mat,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+  SCALAR_DISPATCH(type, init_data,
+		  (col0, col1, mat, ctx, runtime, wait));
+}
+
+template <typename T>
 void LMatrix::init_data
 (int col0, int col1, const Matrix& mat,
  Context ctx, HighLevelRuntime *runtime, bool wait) {
   assert(col0>=0);
   assert(col1<=mCols);
-  assert((col1-col0)>=mat.cols());
-  assert((col1-col0)%mat.cols()==0);
+  // copies of the matrix, or only its leading columns
+  assert((col1-col0)%mat.cols()==0 || (col1-col0)<mat.cols());
   assert(mat.num_partition()%nPart==0);
   this->smallblk = mat.num_partition()/nPart;
   ArgumentMap seeds = MapSeed(mat);
-  InitMatrixTask::TaskArgs args = {rblock, mat.cols(), col0, col1};
+  typename InitMatrixTaskT<T>::TaskArgs args =
+    {rblock, mat.cols(), col0, col1};
   TaskArgument tArg(&args, sizeof(args));
-  InitMatrixTask launcher(colDom, tArg, seeds, nPart);
+  InitMatrixTaskT<T> launcher(colDom, tArg, seeds, nPart);
   //RegionRequirement req(lpart, 0, WRITE_DISCARD, EXCLUSIVE, region);
   RegionRequirement req(lpart, 0, READ_WRITE, EXCLUSIVE, region);
   req.add_field(FIELDID_V);
@@ -176,7 +206,26 @@ void LMatrix::init_data
   */
 }
 
+void LMatrix::init_entries
+(const Matrix& mat, Context ctx, HighLevelRuntime *runtime) {
+  assert(type == SCALAR_DOUBLE);
+  assert(mat.rows()==mRows && mat.cols()==mCols);
+  RegionRequirement req(region, READ_WRITE, EXCLUSIVE, region);
+  req.add_field(FIELDID_V);
+ 
+  InlineLauncher launcher(req);
+  PhysicalRegion region = runtime->map_region(ctx, launcher);
+  region.wait_until_valid();
+ 
+  PtrMatrix pMat = get_raw_pointer(region, 0, mRows, colIdx, colIdx+mCols);
+  for (int j=0; j<mCols; j++)
+    for (int i=0; i<mRows; i++)
+      pMat(i, j) = mat(i, j);
+  runtime->unmap_region(ctx, region);
+}
+
 Matrix LMatrix::to_matrix(Context ctx, HighLevelRuntime *runtime) {
+  assert(type == SCALAR_DOUBLE);
   Matrix temp(mRows, mCols);
   RegionRequirement req(region, READ_ONLY, EXCLUSIVE, region);
   req.add_field(FIELDID_V);
@@ -195,6 +244,7 @@ Matrix LMatrix::to_matrix(Context ctx, HighLevelRuntime *runtime) {
   
 Matrix LMatrix::to_matrix
 (int col0, int col1, Context ctx, HighLevelRuntime *runtime) {
+  assert(type == SCALAR_DOUBLE);
   assert(col0>=0);
   assert(col1<=mCols);
   Matrix temp(mRows, col1-col0);
@@ -216,6 +266,7 @@ Matrix LMatrix::to_matrix
 Matrix LMatrix::to_matrix
 (int rlo, int rhi, int clo, int chi,
  Context ctx, HighLevelRuntime *runtime) {
+  assert(type == SCALAR_DOUBLE);
   assert(rlo>=0&&clo>=0);
   assert(rhi<=mRows&&chi<=mCols);
   Matrix temp(rhi-rlo, chi-clo);
@@ -233,6 +284,35 @@ Matrix LMatrix::to_matrix
   runtime->unmap_region(ctx, region);
   return temp;
 }
+
+template <typename T>
+void LMatrix::to_matrix
+(PtrMatrixT<T>& X, Context ctx, HighLevelRuntime *runtime) {
+  assert(scalar_type_of<T>::value == type);
+  assert(X.rows() == mRows && X.cols() == mCols);
+  RegionRequirement req(region, READ_ONLY, EXCLUSIVE, region);
+  req.add_field(FIELDID_V);
+ 
+  InlineLauncher launcher(req);
+  PhysicalRegion region = runtime->map_region(ctx, launcher);
+  region.wait_until_valid();
+ 
+  PtrMatrixT<T> pMat = get_raw_pointer<T>(region, 0, mRows, colIdx,
+					  colIdx+mCols);
+  for (int j=0; j<mCols; j++)
+    for (int i=0; i<mRows; i++)
+      X(i, j) = pMat(i, j);
+  runtime->unmap_region(ctx, region);
+}
+
+template void LMatrix::to_matrix
+(PtrMatrixT<float>&, Context, HighLevelRuntime*);
+template void LMatrix::to_matrix
+(PtrMatrixT<double>&, Context, HighLevelRuntime*);
+template void LMatrix::to_matrix
+(PtrMatrixT<complex_float>&, Context, HighLevelRuntime*);
+template void LMatrix::to_matrix
+(PtrMatrixT<complex_double>&, Context, HighLevelRuntime*);
   
 // to be removed
 /*
@@ -272,6 +352,14 @@ void LMatrix::init_data
 }
 */
 void LMatrix::init_dense_blocks
+(const Matrix& U, const Matrix& V, const Vector& D,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+  SCALAR_DISPATCH(type, init_dense_blocks,
+		  (U, V, D, ctx, runtime, wait));
+}
+
+template <typename T>
+void LMatrix::init_dense_blocks
 (const Matrix& U, const Matrix& V, const Vector& D,
  Context ctx, HighLevelRuntime *runtime, bool wait) {
   assert(U.num_partition()%nPart==0);
@@ -282,9 +370,41 @@ void LMatrix::init_dense_blocks
   assert(U.rows()==D.rows());
   ArgumentMap seeds = MapSeed(U, V, D);
   int rank = U.cols();
-  DenseBlockTask::TaskArgs args = {rblock, rank, D.offset()};
+  typename DenseBlockTaskT<T>::TaskArgs args =
+    {rblock, rank, D.offset(), false};
+  TaskArgument tArg(&args, sizeof(args));
+  DenseBlockTaskT<T> launcher(colDom, tArg, seeds, this->nPart);
+  RegionRequirement req(lpart, 0, WRITE_DISCARD, EXCLUSIVE, region);
+  req.add_field(FIELDID_V);
+  launcher.add_region_requirement(req);
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+    
+  if(wait) {
+    log_solver_tasks.print("Wait for init dense blocks...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for init dense blocks...");
+  }
+}
+
+void LMatrix::init_dense_blocks
+(const Matrix& K, const Vector& D,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+  SCALAR_DISPATCH(type, init_dense_blocks,
+		  (K, D, ctx, runtime, wait));
+}
+
+template <typename T>
+void LMatrix::init_dense_blocks
+(const Matrix& K, const Vector& D,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+  assert(K.num_partition()%nPart==0);
+  assert(D.num_partition()%nPart==0);
+  assert(K.rows()==D.rows());
+  ArgumentMap seeds = MapSeed(K, D);
+  typename DenseBlockTaskT<T>::TaskArgs args =
+    {rblock, K.cols(), D.offset(), true};
   TaskArgument tArg(&args, sizeof(args));
-  DenseBlockTask launcher(colDom, tArg, seeds, this->nPart);
+  DenseBlockTaskT<T> launcher(colDom, tArg, seeds, this->nPart);
   RegionRequirement req(lpart, 0, WRITE_DISCARD, EXCLUSIVE, region);
   req.add_field(FIELDID_V);
   launcher.add_region_requirement(req);
@@ -296,6 +416,37 @@ void LMatrix::init_dense_blocks
     log_solver_tasks.print("Done for init dense blocks...");
   }
 }
+
+void LMatrix::init_entry_blocks
+(int func, Context ctx, HighLevelRuntime *runtime, bool wait) {
+  init_entry_blocks(func, LMatrix(), ctx, runtime, wait);
+}
+
+// an empty perm is the identity
+void LMatrix::init_entry_blocks
+(int func, const LMatrix& perm,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+  EntryBlockTask::TaskArgs args = {func, smallblk};
+  TaskArgument tArg(&args, sizeof(args));
+  EntryBlockTask launcher(colDom, tArg, ArgumentMap(), this->nPart);
+  RegionRequirement req(lpart, 0, WRITE_DISCARD, EXCLUSIVE, region);
+  req.add_field(FIELDID_V);
+  launcher.add_region_requirement(req);
+  if (perm.rows() > 0) {
+    assert(perm.rows() == mRows && perm.nPart == nPart);
+    RegionRequirement PReq(perm.lpart, 0, READ_ONLY, EXCLUSIVE, perm.region);
+    PReq.add_field(FIELDID_V);
+    launcher.add_region_requirement(PReq);
+  }
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+    
+  if(wait) {
+    log_solver_tasks.print("Wait for init entry blocks...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for init entry blocks...");
+  }
+}
+
 /*
 void LMatrix::init_dense_blocks
 (int nProc_, int nblk, const Matrix& U, const Matrix& V, const Vector& D,
@@ -359,6 +510,23 @@ ArgumentMap LMatrix::MapSeed
   }
   return argMap;
 }
+
+ArgumentMap LMatrix::MapSeed(const Matrix& K, const Vector& D) {
+  assert(K.num_partition()%nPart==0);
+  int blk = K.num_partition() / nPart;
+  ArgumentMap argMap;
+  for (int i = 0; i < nPart; i++) {
+    std::vector<long> vec;
+    vec.push_back(blk);
+    for (int j = 0; j < blk; j++) {
+      vec.push_back(K.rand_seed(i*blk+j));
+      vec.push_back(D.rand_seed(i*blk+j));
+    }
+    argMap.set_point(DomainPoint::from_point<1>(Point<1>(i)),
+		     TaskArgument(&vec[0],sizeof(long)*(2*blk+1)));
+  }
+  return argMap;
+}
 /*
 ArgumentMap LMatrix::MapSeed(int nPart, const Matrix& matrix) {
   assert(nPart == matrix.num_partition());
@@ -387,11 +555,10 @@ IndexPartition LMatrix::UniformRowPartition
   Rect<1> bounds(Point<1>(0),Point<1>(nPart-1));
   Domain  domain = Domain::from_rect<1>(bounds);
 
-  int size = rblock;
   DomainColoring coloring;
   for (int i = 0; i < nPart; i++) {
-    Point<2> lo = make_point(  i   *size,   0);
-    Point<2> hi = make_point( (i+1)*size-1, mCols-1);
+    Point<2> lo = make_point( block_begin(mRows, nPart, i),     0);
+    Point<2> hi = make_point( block_begin(mRows, nPart, i+1)-1, mCols-1);
     Rect<2> subrect(lo, hi);
     coloring[i] = Domain::from_rect<2>(subrect);
   }
@@ -426,6 +593,7 @@ void LMatrix::partition
   // if level=1, the number of partition is 2 for V0 and V1
   this->nPart  = pow(2, level);
   this->rblock = mRows/nPart;
+  assert(nPart <= mRows);
   this->ipart  = UniformRowPartition(ctx, runtime);
   //this->ipart  = UniformRowPartition(nPart, 0, mCols, ctx, runtime);
   this->lpart  = runtime->get_logical_partition(ctx, region, ipart);
@@ -445,10 +613,66 @@ LMatrix LMatrix::partition
 
 int LMatrix::small_block_parts() const {return smallblk;}
 
+ScalarType LMatrix::scalar_type() const {return type;}
+
+// copy the values (ranks or first V columns) of the levels inside
+//  one partition (from the launch level down to the leaves) into
+//  the task arguments
+static void level_slice
+(const std::vector<int>& values, int level, int nPart, int *slice) {
+  int nLevel = log2(nPart);
+  assert( level+nLevel <= int(values.size()) );
+  assert( nLevel <= MAX_TREE_LEVEL );
+  for (int i=0; i<MAX_TREE_LEVEL; i++)
+    slice[i] = i < nLevel ? values[level+i] : 0;
+}
+
+// the ranks of all depths for the leaf solve with a shared
+//  basis (see leaf_columns() in leaf_solve.cc); returns the
+//  number of depths, or zero without a shared basis
+static int shared_ranks
+(bool shared, const std::vector<int>& ranks, int *values) {
+  assert( ranks.size() <= size_t(MAX_TREE_LEVEL) );
+  for (int i=0; i<MAX_TREE_LEVEL; i++)
+    values[i] = shared && i < int(ranks.size()) ? ranks[i] : 0;
+  return shared ? ranks.size() : 0;
+}
+
+// the flags of the nLeaf leaves (or nodes) in every partition
+//  as the local arguments of a launch, see factor(); no flags
+//  are passed if update is empty
+static ArgumentMap update_flags
+(const std::vector<bool>& update, int nPart, int nLeaf) {
+  ArgumentMap argMap;
+  if (update.empty())
+    return argMap;
+  assert( int(update.size()) == nPart*nLeaf );
+  for (int i = 0; i < nPart; i++) {
+    std::vector<char> flags(nLeaf);
+    for (int j = 0; j < nLeaf; j++)
+      flags[j] = update[i*nLeaf+j];
+    argMap.set_point(DomainPoint::from_point<1>(Point<1>(i)),
+		     TaskArgument(&flags[0], sizeof(char)*nLeaf));
+  }
+  return argMap;
+}
+
 // solve A x = b for each partition
 //  b will be overwritten by x
 void LMatrix::solve
-(LMatrix& b, LMatrix& V, Context ctx, HighLevelRuntime* runtime, bool wait) {
+(LMatrix& b, LMatrix& V, const std::vector<int>& ranks,
+ const std::vector<int>& vcols, bool shared,
+ Context ctx, HighLevelRuntime* runtime, bool wait) {
+  assert( b.type == type && V.type == type );
+  SCALAR_DISPATCH(type, solve,
+		  (b, V, ranks, vcols, shared, ctx, runtime, wait));
+}
+
+template <typename T>
+void LMatrix::solve
+(LMatrix& b, LMatrix& V, const std::vector<int>& ranks,
+ const std::vector<int>& vcols, bool shared,
+ Context ctx, HighLevelRuntime* runtime, bool wait) {
 
   // check if the matrix is square
   //assert( this->rblock == this->cols() );
@@ -471,10 +695,19 @@ void LMatrix::solve
   LogicalRegion VRegion = V.logical_region();
   
   Domain domain = this->color_domain();
-  LeafSolveTask::TaskArgs args = {this->rblock, b.cols(), V.cols(), V.small_block_parts()};
+  typename LeafSolveTaskT<T>::TaskArgs args;
+  args.nRhs     = b.cols();
+  args.nPart    = V.small_block_parts();
+  args.factored = false;
+  args.spd      = false;
+  args.trans    = false;
+  level_slice(ranks, log2(nPart), args.nPart, args.ranks);
+  level_slice(vcols, log2(nPart), args.nPart, args.vcols);
+  args.nShared  = shared_ranks(shared, ranks, args.shared);
   TaskArgument tArg(&args, sizeof(args));
-  LeafSolveTask launcher(domain, tArg, ArgumentMap(), nPart);
-  RegionRequirement AReq(APart, 0, READ_ONLY,  EXCLUSIVE, ARegion);
+  LeafSolveTaskT<T> launcher(domain, tArg, ArgumentMap(), nPart);
+  // the dense blocks are overwritten by their LU factors
+  RegionRequirement AReq(APart, 0, READ_WRITE, EXCLUSIVE, ARegion);
   RegionRequirement bReq(bPart, 0, READ_WRITE, EXCLUSIVE, bRegion);
   RegionRequirement VReq(VPart, 0, READ_ONLY,  EXCLUSIVE, VRegion);
   AReq.add_field(FIELDID_V);
@@ -493,181 +726,1022 @@ void LMatrix::solve
   }
 }
 
-void LMatrix::two_level_partition
-(Context ctx, HighLevelRuntime *runtime) {
-  
-  // partition each subregion into two pieces
-  // for V0Tu0 and V1Tu1
-  for (int i=0; i<nPart; i++) {
-    LogicalRegion lr = runtime->get_logical_subregion_by_color(ctx, lpart, i);
-
-    Rect<1> bounds(Point<1>(0),Point<1>(1));
-    Domain  domain = Domain::from_rect<1>(bounds);
-    int size = rblock/2;
-    DomainColoring coloring;
-    for (int j = 0; j < 2; j++) {
-      Point<2> lo = make_point( i*rblock+j*size,   0);
-      Point<2> hi = make_point( i*rblock+(j+1)*size-1, mCols-1);
-      Rect<2> subrect(lo, hi);
-      coloring[j] = Domain::from_rect<2>(subrect);
-    }
-    IndexSpace is = lr.get_index_space();
-    IndexPartition ip = runtime->create_index_partition(ctx, is, domain, coloring, true,0);
-    LogicalPartition lp = runtime->get_logical_partition(ctx, lr, ip);
-    (void)lp;
-  }
-  
-  // update partition parameters
-  this->plevel  = 2;
-  this->rblock /= 2;
-  this->nPart  *= 2;
-}
-
-// solve the following system for every partition
-// --             --  --    --     --      --
-// |  I     V1'*u1 |  | eta0 |     | V1'*d1 |
-// |               |  |      |  =  |        |
-// | V0'*u0   I    |  | eta1 |     | V0'*d0 |
-// --             --  --    --     --      --
-//  VTd will be overwritten by eta
-// Note VTd needs to be reordered,
-//  as shown in the above picture.
-void LMatrix::node_solve
-(LMatrix& b, Context ctx, HighLevelRuntime* runtime, bool wait) {
-
-  //--------------------------------------------------------------
-  // node solve is always launched at the first level of partition
-  //--------------------------------------------------------------
-  
-  //solve<NodeSolveTask>(b, ctx, runtime, wait);
+void LMatrix::solve_shifts
+(const LMatrix& b, LMatrix& W, LMatrix& V, const std::vector<int>& ranks,
+ const std::vector<int>& vcols, bool shared, const std::vector<double>& shifts,
+ Context ctx, HighLevelRuntime* runtime, bool wait) {
 
-  // A and b have the same number of partition
-  // this should refer to the second level
-  assert( this->num_partition() == b.num_partition() );
+  int nShift = shifts.size();
+  assert( 0 < nShift && nShift <= MAX_SHIFTS );
+  assert( W.cols() % nShift == 0 && W.cols()/nShift <= b.cols() );
+  assert( this->rows() == b.rows() &&
+	  this->rows() == W.rows() &&
+	  this->rows() == V.rows() );
+  assert( b.num_partition() == nPart && W.num_partition() == nPart );
 
-  // rowBlk is the size of the Shur complement,
-  // so rowBlk = 2*rowBlk() when plevel=2,
-  // or rowBlk = rowBlk() when plevel=1.
-  int rowBlk = this->rowBlk()*plevel;
-  //std::cout<<"rowBlk:"<<rowBlk<<", mCols:"<<mCols<<std::endl;
-  assert( rowBlk/2 == mCols );
-  
-  // first level stuff
   LogicalPartition APart = this->logical_partition();
   LogicalPartition bPart = b.logical_partition();
+  LogicalPartition VPart = V.logical_partition();
+  LogicalPartition WPart = W.logical_partition();
 
   LogicalRegion ARegion = this->logical_region();
   LogicalRegion bRegion = b.logical_region();
+  LogicalRegion VRegion = V.logical_region();
+  LogicalRegion WRegion = W.logical_region();
 
   Domain domain = this->color_domain();
-  NodeSolveTask::TaskArgs args = {rowBlk, mCols, b.cols()};
-  NodeSolveTask launcher(domain, TaskArgument(&args, sizeof(args)),
-			 ArgumentMap(), domain.get_volume());
-  //RegionRequirement AReq(APart, 0, READ_ONLY,  EXCLUSIVE, ARegion);
-  // bug here: have to use stronger previlige
-  RegionRequirement AReq(APart, 0, READ_WRITE,  EXCLUSIVE, ARegion);
-  RegionRequirement bReq(bPart, 0, READ_WRITE, EXCLUSIVE, bRegion);
+  LeafShiftTask::TaskArgs args;
+  args.ncol   = W.cols() / nShift;
+  args.nPart  = V.small_block_parts();
+  args.nShift = nShift;
+  for (int k=0; k<nShift; k++)
+    args.shifts[k] = shifts[k];
+  level_slice(ranks, log2(nPart), args.nPart, args.ranks);
+  level_slice(vcols, log2(nPart), args.nPart, args.vcols);
+  args.nShared = shared_ranks(shared, ranks, args.shared);
+  TaskArgument tArg(&args, sizeof(args));
+  LeafShiftTask launcher(domain, tArg, ArgumentMap(), nPart);
+  RegionRequirement AReq(APart, 0, READ_ONLY,     EXCLUSIVE, ARegion);
+  RegionRequirement bReq(bPart, 0, READ_ONLY,     EXCLUSIVE, bRegion);
+  RegionRequirement VReq(VPart, 0, READ_ONLY,     EXCLUSIVE, VRegion);
+  RegionRequirement WReq(WPart, 0, WRITE_DISCARD, EXCLUSIVE, WRegion);
   AReq.add_field(FIELDID_V);
   bReq.add_field(FIELDID_V);
+  VReq.add_field(FIELDID_V);
+  WReq.add_field(FIELDID_V);
   launcher.add_region_requirement(AReq);
   launcher.add_region_requirement(bReq);
-  
+  launcher.add_region_requirement(VReq);
+  launcher.add_region_requirement(WReq);
+
   FutureMap fm = runtime->execute_index_space(ctx, launcher);
 
   if(wait) {
-    log_solver_tasks.print("Wait for node solve...");
+    log_solver_tasks.print("Wait for leaf shift solve...");
     fm.wait_all_results();
-    log_solver_tasks.print("Done for node solve...");
+    log_solver_tasks.print("Done for leaf shift solve...");
   }
 }
 
-void LMatrix::node_solve
-(LMatrix& VTu0, LMatrix &VTu1, LMatrix& VTd0, LMatrix &VTd1,
- PhaseBarrier pb_wait, PhaseBarrier pb_ready,
+// solve A x = b for each partition with the factors
+//  computed by factor(); only the columns of b are touched
+void LMatrix::solve
+(LMatrix& b, LMatrix& V, LMatrix& S, const std::vector<int>& ranks,
+ const std::vector<int>& vcols, bool trans,
  Context ctx, HighLevelRuntime* runtime, bool wait) {
-
-  LogicalRegion VTu0_rg = VTu0.logical_region();
-  LogicalRegion VTu1_rg = VTu1.logical_region();
-  LogicalRegion VTd0_rg = VTd0.logical_region();
-  LogicalRegion VTd1_rg = VTd1.logical_region();
-#if 0
-  printf("VTu0 (%x,%x,%x)\n",
-	 VTu0_rg.get_index_space().get_id(), 
-	 VTu0_rg.get_field_space().get_id(),
-	 VTu0_rg.get_tree_id());
-  printf("VTu1 (%x,%x,%x)\n",
-	 VTu1_rg.get_index_space().get_id(), 
-	 VTu1_rg.get_field_space().get_id(),
-	 VTu1_rg.get_tree_id());
-  printf("VTd0 (%x,%x,%x)\n",
-	 VTd0_rg.get_index_space().get_id(), 
-	 VTd0_rg.get_field_space().get_id(),
-	 VTd0_rg.get_tree_id());
-  printf("VTd1 (%x,%x,%x)\n",
-	 VTd1_rg.get_index_space().get_id(), 
-	 VTd1_rg.get_field_space().get_id(),
-	 VTd1_rg.get_tree_id());
-#endif
-  assert(VTu0.rows() == VTu0.cols());
-  assert(VTu1.rows() == VTu1.cols());
-  assert(VTu0.rows() == VTu1.rows());
-  assert(VTd0.rows() == VTd1.rows());
-  assert(VTd0.cols() == VTd1.cols());
-  assert(VTu0.rows() == VTd0.rows());
-  int rank = VTd0.rows();
-  int nRhs = VTd0.cols();
-  NodeSolveRegionTask::TaskArgs args = {rank, nRhs};
-  NodeSolveRegionTask launcher(TaskArgument(&args, sizeof(args)));
-  //RegionRequirement AReq(ARegion, 0, READ_ONLY,  EXCLUSIVE, ARegion);
-  RegionRequirement VTu0_rq(VTu0_rg, READ_ONLY, EXCLUSIVE, VTu0_rg);
-  RegionRequirement VTu1_rq(VTu1_rg, READ_ONLY, EXCLUSIVE, VTu1_rg);
-  RegionRequirement VTd0_rq(VTd0_rg, READ_WRITE, EXCLUSIVE, VTd0_rg);
-  RegionRequirement VTd1_rq(VTd1_rg, READ_WRITE, EXCLUSIVE, VTd1_rg);
-  VTu0_rq.add_field(FIELDID_V);
-  VTu1_rq.add_field(FIELDID_V);
-  VTd0_rq.add_field(FIELDID_V);
-  VTd1_rq.add_field(FIELDID_V);
-  launcher.add_region_requirement(VTu0_rq);
-  launcher.add_region_requirement(VTu1_rq);
-  launcher.add_region_requirement(VTd0_rq);
-  launcher.add_region_requirement(VTd1_rq);
-  launcher.add_wait_barrier(pb_wait);
-  launcher.add_arrival_barrier(pb_ready);
-  runtime->execute_task(ctx, launcher);
+  assert( b.type == type && V.type == type && S.type == type );
+  SCALAR_DISPATCH(type, solve,
+		  (b, V, S, ranks, vcols, trans, ctx, runtime, wait));
 }
 
-/*
-template <typename SolveTask>
+template <typename T>
 void LMatrix::solve
-(LMatrix& b, Context ctx, HighLevelRuntime *runtime, bool wait) {
+(LMatrix& b, LMatrix& V, LMatrix& S, const std::vector<int>& ranks,
+ const std::vector<int>& vcols, bool trans,
+ Context ctx, HighLevelRuntime* runtime, bool wait) {
 
-  // A and b have the same number of partition
-  assert( this->num_partition() == b.num_partition() );
+  assert( this->rows() == b.rows() &&
+	  this->rows() == V.rows() );
+  assert( b.cols() > 0 && b.column_begin() == 0 );
+  assert( b.num_partition() == nPart );
+  assert( S.num_partition() == nPart );
 
   LogicalPartition APart = this->logical_partition();
   LogicalPartition bPart = b.logical_partition();
-
+  LogicalPartition VPart = V.logical_partition();
+  LogicalPartition SPart = S.logical_partition();
+  
   LogicalRegion ARegion = this->logical_region();
   LogicalRegion bRegion = b.logical_region();
+  LogicalRegion VRegion = V.logical_region();
+  LogicalRegion SRegion = S.logical_region();
 
+  // u columns of the partition roots
+  int level  = log2(nPart);
+  int colIdx = b.cols();
+  for (int i=0; i<level; i++)
+    colIdx += ranks[i];
   Domain domain = this->color_domain();
-  SolveTask launcher(domain, TaskArgument(), ArgumentMap());
+  typename LeafSolveTaskT<T>::TaskArgs args;
+  args.nRhs     = b.cols();
+  args.nPart    = V.small_block_parts();
+  args.factored = true;
+  args.colIdx   = colIdx;
+  args.Srblk    = S.rowBlk();
+  args.spd      = false;
+  args.trans    = trans;
+  level_slice(ranks, level, args.nPart, args.ranks);
+  level_slice(vcols, level, args.nPart, args.vcols);
+  TaskArgument tArg(&args, sizeof(args));
+  LeafSolveTaskT<T> launcher(domain, tArg, ArgumentMap(), nPart);
   RegionRequirement AReq(APart, 0, READ_ONLY,  EXCLUSIVE, ARegion);
   RegionRequirement bReq(bPart, 0, READ_WRITE, EXCLUSIVE, bRegion);
+  RegionRequirement VReq(VPart, 0, READ_ONLY,  EXCLUSIVE, VRegion);
+  RegionRequirement SReq(SPart, 0, READ_ONLY,  EXCLUSIVE, SRegion);
   AReq.add_field(FIELDID_V);
   bReq.add_field(FIELDID_V);
+  VReq.add_field(FIELDID_V);
+  SReq.add_field(FIELDID_V);
   launcher.add_region_requirement(AReq);
   launcher.add_region_requirement(bReq);
-  
+  launcher.add_region_requirement(VReq);
+  launcher.add_region_requirement(SReq);
+    
   FutureMap fm = runtime->execute_index_space(ctx, launcher);
 
   if(wait) {
-    std::cout << "Wait for solve..." << std::endl;
+    log_solver_tasks.print("Wait for leaf solve...");
     fm.wait_all_results();
+    log_solver_tasks.print("Done for leaf solve...");
   }
 }
-*/
-void LMatrix::add
+
+void LMatrix::solve_spd
+(LMatrix& b, LMatrix& S, const std::vector<int>& ranks, int bcol,
+ Context ctx, HighLevelRuntime* runtime, bool wait) {
+  assert( b.type == type && S.type == type );
+  SCALAR_DISPATCH(type, solve_spd,
+		  (b, S, ranks, bcol, ctx, runtime, wait));
+}
+
+template <typename T>
+void LMatrix::solve_spd
+(LMatrix& b, LMatrix& S, const std::vector<int>& ranks, int bcol,
+ Context ctx, HighLevelRuntime* runtime, bool wait) {
+
+  assert( this->rows() == b.rows() );
+  assert( b.cols() > 0 && b.column_begin() == 0 );
+  assert( b.num_partition() == nPart );
+  assert( S.num_partition() == nPart );
+
+  LogicalPartition APart = this->logical_partition();
+  LogicalPartition bPart = b.logical_partition();
+  LogicalPartition SPart = S.logical_partition();
+  
+  LogicalRegion ARegion = this->logical_region();
+  LogicalRegion bRegion = b.logical_region();
+  LogicalRegion SRegion = S.logical_region();
+
+  // u columns of the partition roots
+  int level  = log2(nPart);
+  int colIdx = b.cols();
+  for (int i=0; i<level; i++)
+    colIdx += ranks[i];
+  Domain domain = this->color_domain();
+  typename LeafSolveTaskT<T>::TaskArgs args;
+  args.nRhs     = b.cols();
+  args.nPart    = (1<<ranks.size()) / nPart;
+  args.factored = true;
+  args.colIdx   = colIdx;
+  args.Srblk    = S.rowBlk();
+  args.spd      = true;
+  args.bcol     = bcol;
+  args.trans    = false;
+  level_slice(ranks, level, args.nPart, args.ranks);
+  TaskArgument tArg(&args, sizeof(args));
+  LeafSolveTaskT<T> launcher(domain, tArg, ArgumentMap(), nPart);
+  RegionRequirement AReq(APart, 0, READ_ONLY,  EXCLUSIVE, ARegion);
+  RegionRequirement bReq(bPart, 0, READ_WRITE, EXCLUSIVE, bRegion);
+  RegionRequirement SReq(SPart, 0, READ_ONLY,  EXCLUSIVE, SRegion);
+  AReq.add_field(FIELDID_V);
+  bReq.add_field(FIELDID_V);
+  SReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(AReq);
+  launcher.add_region_requirement(bReq);
+  launcher.add_region_requirement(SReq);
+    
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for leaf solve...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for leaf solve...");
+  }
+}
+
+// LU factorize the dense blocks (pivots go to the last column)
+//  and the node systems below the launch level (stored in S);
+//  the u columns U are overwritten by the factored solve;
+//  returns the sum of log|det| over all partitions
+Future LMatrix::factor
+(LMatrix& U, LMatrix& V, LMatrix& S, const std::vector<int>& ranks,
+ const std::vector<int>& vcols, bool shared, bool spd, bool single,
+ const std::vector<bool>& update,
+ Context ctx, HighLevelRuntime* runtime, bool wait) {
+
+  assert( this->rows() == U.rows() &&
+	  this->rows() == V.rows() );
+  assert( U.num_partition() == nPart );
+  assert( S.num_partition() == nPart );
+
+  LogicalPartition APart = this->logical_partition();
+  LogicalPartition UPart = U.logical_partition();
+  LogicalPartition VPart = V.logical_partition();
+  LogicalPartition SPart = S.logical_partition();
+  
+  LogicalRegion ARegion = this->logical_region();
+  LogicalRegion URegion = U.logical_region();
+  LogicalRegion VRegion = V.logical_region();
+  LogicalRegion SRegion = S.logical_region();
+
+  // u columns above the launch level
+  int level = log2(nPart);
+  int ncol  = 0;
+  for (int i=0; i<level; i++)
+    ncol += ranks[i];
+  Domain domain = this->color_domain();
+  LeafFactorTask::TaskArgs args;
+  args.colIdx = U.column_begin();
+  args.ncol   = ncol;
+  args.nPart  = V.small_block_parts();
+  args.Srblk  = S.rowBlk();
+  args.spd    = spd;
+  args.single = single;
+  level_slice(ranks, level, args.nPart, args.ranks);
+  level_slice(vcols, level, args.nPart, args.vcols);
+  args.nShared = shared_ranks(shared, ranks, args.shared);
+  TaskArgument tArg(&args, sizeof(args));
+  LeafFactorTask launcher(domain, tArg,
+			  update_flags(update, nPart, args.nPart), nPart);
+  // the kept factors are read
+  PrivilegeMode SPriv = update.empty() ? WRITE_DISCARD : READ_WRITE;
+  RegionRequirement AReq(APart, 0, READ_WRITE,    EXCLUSIVE, ARegion);
+  RegionRequirement UReq(UPart, 0, READ_WRITE,    EXCLUSIVE, URegion);
+  RegionRequirement VReq(VPart, 0, READ_ONLY,     EXCLUSIVE, VRegion);
+  RegionRequirement SReq(SPart, 0, SPriv,         EXCLUSIVE, SRegion);
+  AReq.add_field(FIELDID_V);
+  UReq.add_field(FIELDID_V);
+  VReq.add_field(FIELDID_V);
+  SReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(AReq);
+  launcher.add_region_requirement(UReq);
+  launcher.add_region_requirement(VReq);
+  launcher.add_region_requirement(SReq);
+    
+  Future logdet = runtime->execute_index_space(ctx, launcher, REDOP_ADD);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for leaf factor...");
+    logdet.get_void_result();
+    log_solver_tasks.print("Done for leaf factor...");
+  }
+  return logdet;
+}
+
+// the diagonal of the inverse for each partition; the u columns
+//  of the partition roots follow those of the levels above
+void LMatrix::inverse_diagonal
+(const LMatrix& U, const LMatrix& V, LMatrix& S, LMatrix& Z, LMatrix& X,
+ const std::vector<int>& ranks, const std::vector<int>& vcols,
+ int wcol, bool spd, Context ctx, HighLevelRuntime* runtime, bool wait) {
+
+  assert( this->rows() == U.rows() &&
+	  this->rows() == Z.rows() &&
+	  this->rows() == X.rows() );
+  assert( U.num_partition() == nPart );
+  assert( Z.num_partition() == nPart );
+  assert( X.num_partition() == nPart );
+  assert( S.num_partition() == nPart );
+
+  LogicalPartition APart = this->logical_partition();
+  LogicalPartition UPart = U.logical_partition();
+  LogicalPartition SPart = S.logical_partition();
+  LogicalPartition ZPart = Z.logical_partition();
+  LogicalPartition XPart = X.logical_partition();
+
+  LogicalRegion ARegion = this->logical_region();
+  LogicalRegion URegion = U.logical_region();
+  LogicalRegion SRegion = S.logical_region();
+  LogicalRegion ZRegion = Z.logical_region();
+  LogicalRegion XRegion = X.logical_region();
+
+  // u columns above the launch level
+  int level = log2(nPart);
+  int ncol  = 0;
+  for (int i=0; i<level; i++)
+    ncol += ranks[i];
+  Domain domain = this->color_domain();
+  LeafInverseTask::TaskArgs args;
+  args.ncol   = ncol;
+  args.nPart  = (1<<ranks.size()) / nPart;
+  args.colIdx = U.column_begin();
+  args.Srblk  = S.rowBlk();
+  args.wcol   = wcol;
+  args.spd    = spd;
+  args.blocks = X.cols() > 1;
+  level_slice(ranks, level, args.nPart, args.ranks);
+  level_slice(vcols, level, args.nPart, args.vcols);
+  TaskArgument tArg(&args, sizeof(args));
+  LeafInverseTask launcher(domain, tArg, ArgumentMap(), nPart);
+  RegionRequirement AReq(APart, 0, READ_ONLY,     EXCLUSIVE, ARegion);
+  RegionRequirement UReq(UPart, 0, READ_ONLY,     EXCLUSIVE, URegion);
+  RegionRequirement SReq(SPart, 0, READ_ONLY,     EXCLUSIVE, SRegion);
+  RegionRequirement ZReq(ZPart, 0, READ_WRITE,    EXCLUSIVE, ZRegion);
+  RegionRequirement XReq(XPart, 0, WRITE_DISCARD, EXCLUSIVE, XRegion);
+  AReq.add_field(FIELDID_V);
+  UReq.add_field(FIELDID_V);
+  SReq.add_field(FIELDID_V);
+  ZReq.add_field(FIELDID_V);
+  XReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(AReq);
+  launcher.add_region_requirement(UReq);
+  launcher.add_region_requirement(SReq);
+  launcher.add_region_requirement(ZReq);
+  launcher.add_region_requirement(XReq);
+  if (!spd) {
+    assert( V.num_partition() == nPart );
+    RegionRequirement VReq(V.logical_partition(), 0, READ_ONLY, EXCLUSIVE,
+			   V.logical_region());
+    VReq.add_field(FIELDID_V);
+    launcher.add_region_requirement(VReq);
+  }
+
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for leaf inverse...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for leaf inverse...");
+  }
+}
+
+// the symmetric factor W of every partition, see LeafSqrtTask;
+//  returns the sum of log|det| over all partitions
+Future LMatrix::factor_sqrt
+(LMatrix& U, LMatrix& S, const std::vector<int>& ranks, bool shared,
+ Context ctx, HighLevelRuntime* runtime, bool wait) {
+
+  assert( this->rows() == U.rows() );
+  assert( U.num_partition() == nPart );
+  assert( S.num_partition() == nPart );
+
+  LogicalPartition APart = this->logical_partition();
+  LogicalPartition UPart = U.logical_partition();
+  LogicalPartition SPart = S.logical_partition();
+
+  LogicalRegion ARegion = this->logical_region();
+  LogicalRegion URegion = U.logical_region();
+  LogicalRegion SRegion = S.logical_region();
+
+  // u columns above the launch level
+  int level = log2(nPart);
+  int ncol  = 0;
+  for (int i=0; i<level; i++)
+    ncol += ranks[i];
+  Domain domain = this->color_domain();
+  LeafSqrtTask::TaskArgs args;
+  args.op     = 'f';
+  args.ncol   = ncol;
+  args.nPart  = (1<<ranks.size()) / nPart;
+  args.colIdx = U.column_begin();
+  args.Srblk  = S.rowBlk();
+  args.bcol   = 0;
+  args.nRhs   = 0;
+  level_slice(ranks, level, args.nPart, args.ranks);
+  args.nShared = shared_ranks(shared, ranks, args.shared);
+  TaskArgument tArg(&args, sizeof(args));
+  LeafSqrtTask launcher(domain, tArg, ArgumentMap(), nPart);
+  RegionRequirement AReq(APart, 0, READ_WRITE,    EXCLUSIVE, ARegion);
+  RegionRequirement UReq(UPart, 0, READ_WRITE,    EXCLUSIVE, URegion);
+  RegionRequirement SReq(SPart, 0, WRITE_DISCARD, EXCLUSIVE, SRegion);
+  AReq.add_field(FIELDID_V);
+  UReq.add_field(FIELDID_V);
+  SReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(AReq);
+  launcher.add_region_requirement(UReq);
+  launcher.add_region_requirement(SReq);
+
+  Future logdet = runtime->execute_index_space(ctx, launcher, REDOP_ADD);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for leaf sqrt...");
+    logdet.get_void_result();
+    log_solver_tasks.print("Done for leaf sqrt...");
+  }
+  return logdet;
+}
+
+void LMatrix::multiply_sqrt
+(char trans, const LMatrix& U, LMatrix& S, const std::vector<int>& ranks,
+ LMatrix& B, Context ctx, HighLevelRuntime* runtime, bool wait) {
+
+  assert( trans == 'n' || trans == 't' );
+  assert( this->rows() == U.rows() &&
+	  this->rows() == B.rows() );
+  assert( U.num_partition() == nPart );
+  assert( S.num_partition() == nPart );
+  assert( B.num_partition() == nPart );
+
+  LogicalPartition APart = this->logical_partition();
+  LogicalPartition UPart = U.logical_partition();
+  LogicalPartition SPart = S.logical_partition();
+  LogicalPartition BPart = B.logical_partition();
+
+  LogicalRegion ARegion = this->logical_region();
+  LogicalRegion URegion = U.logical_region();
+  LogicalRegion SRegion = S.logical_region();
+  LogicalRegion BRegion = B.logical_region();
+
+  int level = log2(nPart);
+  int ncol  = 0;
+  for (int i=0; i<level; i++)
+    ncol += ranks[i];
+  Domain domain = this->color_domain();
+  LeafSqrtTask::TaskArgs args;
+  args.op     = trans;
+  args.ncol   = ncol;
+  args.nPart  = (1<<ranks.size()) / nPart;
+  args.colIdx = U.column_begin();
+  args.Srblk  = S.rowBlk();
+  args.bcol   = B.column_begin();
+  args.nRhs   = B.cols();
+  level_slice(ranks, level, args.nPart, args.ranks);
+  args.nShared = shared_ranks(false, ranks, args.shared);
+  TaskArgument tArg(&args, sizeof(args));
+  LeafSqrtTask launcher(domain, tArg, ArgumentMap(), nPart);
+  RegionRequirement AReq(APart, 0, READ_ONLY,  EXCLUSIVE, ARegion);
+  RegionRequirement UReq(UPart, 0, READ_ONLY,  EXCLUSIVE, URegion);
+  RegionRequirement SReq(SPart, 0, READ_ONLY,  EXCLUSIVE, SRegion);
+  RegionRequirement BReq(BPart, 0, READ_WRITE, EXCLUSIVE, BRegion);
+  AReq.add_field(FIELDID_V);
+  UReq.add_field(FIELDID_V);
+  SReq.add_field(FIELDID_V);
+  BReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(AReq);
+  launcher.add_region_requirement(UReq);
+  launcher.add_region_requirement(SReq);
+  launcher.add_region_requirement(BReq);
+
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for leaf sqrt multiply...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for leaf sqrt multiply...");
+  }
+}
+
+// one task for every child at depth level, like aca()
+void LMatrix::sketch
+(int level, int rank, Context ctx, HighLevelRuntime* runtime, bool wait) {
+
+  assert( colIdx == 0 );
+  assert( rank == 0 || 2*rank <= mCols );
+  LMatrix XPart = *this;
+  XPart.partition(level, ctx, runtime);
+
+  SketchTask::TaskArgs args = {XPart.nPart, rank, mCols};
+  TaskArgument tArgs(&args, sizeof(args));
+  Domain domain = XPart.color_domain();
+  SketchTask launcher(domain, tArgs, ArgumentMap(), XPart.nPart);
+  RegionRequirement req(XPart.lpart, 0, WRITE_DISCARD, EXCLUSIVE, region);
+  req.add_field(FIELDID_V);
+  launcher.add_region_requirement(req);
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for sketch...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for sketch...");
+  }
+}
+
+void LMatrix::multiply
+(char trans, double alpha, int nlevel, bool dense, double sigma,
+ const LMatrix& U, const LMatrix& V, const std::vector<int>& ranks,
+ const std::vector<int>& ucols, const std::vector<int>& vcols,
+ const LMatrix& X, LMatrix& Y,
+ Context ctx, HighLevelRuntime* runtime, bool wait) {
+
+  assert( trans == 'n' || trans == 't' );
+  assert( this->rows() == X.rows() && this->rows() == Y.rows() );
+  assert( X.cols() == Y.cols() );
+  assert( U.num_partition() == nPart && V.num_partition() == nPart );
+  assert( X.num_partition() == nPart && Y.num_partition() == nPart );
+
+  int level = log2(nPart);
+  LeafMultiplyTask::TaskArgs args;
+  args.trans  = trans;
+  args.alpha  = alpha;
+  args.nPart  = V.small_block_parts();
+  args.nlevel = nlevel;
+  args.dense  = dense;
+  args.sigma  = sigma;
+  args.ncol   = X.cols();
+  args.xcol   = X.column_begin();
+  args.ycol   = Y.column_begin();
+  level_slice(ranks, level, args.nPart, args.ranks);
+  level_slice(ucols, level, args.nPart, args.ucols);
+  level_slice(vcols, level, args.nPart, args.vcols);
+  TaskArgument tArg(&args, sizeof(args));
+  LeafMultiplyTask launcher(colDom, tArg, ArgumentMap(), nPart);
+  RegionRequirement KReq(lpart,   0, READ_ONLY,  EXCLUSIVE, region);
+  RegionRequirement UReq(U.lpart, 0, READ_ONLY,  EXCLUSIVE, U.region);
+  RegionRequirement VReq(V.lpart, 0, READ_ONLY,  EXCLUSIVE, V.region);
+  RegionRequirement XReq(X.lpart, 0, READ_ONLY,  EXCLUSIVE, X.region);
+  RegionRequirement YReq(Y.lpart, 0, READ_WRITE, EXCLUSIVE, Y.region);
+  KReq.add_field(FIELDID_V);
+  UReq.add_field(FIELDID_V);
+  VReq.add_field(FIELDID_V);
+  XReq.add_field(FIELDID_V);
+  YReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(KReq);
+  launcher.add_region_requirement(UReq);
+  launcher.add_region_requirement(VReq);
+  launcher.add_region_requirement(XReq);
+  launcher.add_region_requirement(YReq);
+    
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for leaf multiply...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for leaf multiply...");
+  }
+}
+
+// the copy K0 has the columns of the leaf blocks only
+void LMatrix::shift_diagonal
+(double sigma, int nLeaf, const LMatrix& K0,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+
+  assert( this->rows() == K0.rows() && this->cols() > K0.cols() );
+  assert( K0.num_partition() == nPart );
+
+  ShiftDiagonalTask::TaskArgs args = {sigma, nLeaf, K0.cols(), false};
+  TaskArgument tArgs(&args, sizeof(args));
+  Domain domain = this->color_domain();
+  ShiftDiagonalTask launcher(domain, tArgs, ArgumentMap());
+  RegionRequirement K0Req(K0.logical_partition(), 0, READ_ONLY,
+			  EXCLUSIVE, K0.logical_region());
+  RegionRequirement KReq(this->logical_partition(), 0, READ_WRITE,
+			 EXCLUSIVE, this->logical_region());
+  K0Req.add_field(FIELDID_V);
+  KReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(K0Req);
+  launcher.add_region_requirement(KReq);
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for shifting diagonal...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for shifting diagonal...");
+  }
+}
+
+// the entries go to the partitions holding their rows, and the
+//  partitions without any do nothing
+void LMatrix::add_diagonal
+(const std::vector<int>& rows, const std::vector<double>& delta,
+ double sigma, int nLeaf, LMatrix& K0,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+
+  assert( this->rows() == K0.rows() && this->cols() > K0.cols() );
+  assert( K0.num_partition() == nPart );
+  assert( rows.size() == delta.size() );
+
+  std::vector< std::vector<ShiftDiagonalTask::Entry> > entries(nPart);
+  for (size_t k=0; k<rows.size(); k++) {
+    assert( 0 <= rows[k] && rows[k] < mRows );
+    ShiftDiagonalTask::Entry e = {rows[k], delta[k]};
+    entries[block_index(mRows, nPart, rows[k])].push_back(e);
+  }
+  ArgumentMap argMap;
+  for (int i=0; i<nPart; i++)
+    if (!entries[i].empty())
+      argMap.set_point(DomainPoint::from_point<1>(Point<1>(i)),
+		       TaskArgument(&entries[i][0], entries[i].size()*
+				    sizeof(ShiftDiagonalTask::Entry)));
+
+  ShiftDiagonalTask::TaskArgs args = {sigma, nLeaf, K0.cols(), true};
+  TaskArgument tArgs(&args, sizeof(args));
+  Domain domain = this->color_domain();
+  ShiftDiagonalTask launcher(domain, tArgs, argMap);
+  RegionRequirement K0Req(K0.logical_partition(), 0, READ_WRITE,
+			  EXCLUSIVE, K0.logical_region());
+  RegionRequirement KReq(this->logical_partition(), 0, READ_WRITE,
+			 EXCLUSIVE, this->logical_region());
+  K0Req.add_field(FIELDID_V);
+  KReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(K0Req);
+  launcher.add_region_requirement(KReq);
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for adding to diagonal...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for adding to diagonal...");
+  }
+}
+
+void LMatrix::two_level_partition
+(Context ctx, HighLevelRuntime *runtime) {
+  
+  // partition each subregion into two pieces
+  // for V0Tu0 and V1Tu1
+  for (int i=0; i<nPart; i++) {
+    LogicalRegion lr = runtime->get_logical_subregion_by_color(ctx, lpart, i);
+
+    Rect<1> bounds(Point<1>(0),Point<1>(1));
+    Domain  domain = Domain::from_rect<1>(bounds);
+    int size = rblock/2;
+    DomainColoring coloring;
+    for (int j = 0; j < 2; j++) {
+      Point<2> lo = make_point( i*rblock+j*size,   0);
+      Point<2> hi = make_point( i*rblock+(j+1)*size-1, mCols-1);
+      Rect<2> subrect(lo, hi);
+      coloring[j] = Domain::from_rect<2>(subrect);
+    }
+    IndexSpace is = lr.get_index_space();
+    IndexPartition ip = runtime->create_index_partition(ctx, is, domain, coloring, true,0);
+    LogicalPartition lp = runtime->get_logical_partition(ctx, lr, ip);
+    (void)lp;
+  }
+  
+  // update partition parameters
+  this->plevel  = 2;
+  this->rblock /= 2;
+  this->nPart  *= 2;
+}
+
+// solve the following system for every partition
+// --             --  --    --     --      --
+// |  I     V1'*u1 |  | eta0 |     | V1'*d1 |
+// |               |  |      |  =  |        |
+// | V0'*u0   I    |  | eta1 |     | V0'*d0 |
+// --             --  --    --     --      --
+//  VTd will be overwritten by eta
+// Note VTd needs to be reordered,
+//  as shown in the above picture.
+void LMatrix::node_solve
+(LMatrix& b, Context ctx, HighLevelRuntime* runtime, bool wait) {
+  node_solve(b, 1, ctx, runtime, wait);
+}
+
+// the systems of batch shifts, whose blocks are side by side
+//  in this matrix and in b
+void LMatrix::node_solve
+(LMatrix& b, int batch, Context ctx, HighLevelRuntime* runtime,
+ bool wait) {
+  assert( b.type == type );
+  SCALAR_DISPATCH(type, node_solve,
+		  (b, batch, ctx, runtime, wait));
+}
+
+template <typename T>
+void LMatrix::node_solve
+(LMatrix& b, int batch, Context ctx, HighLevelRuntime* runtime,
+ bool wait) {
+
+  //--------------------------------------------------------------
+  // node solve is always launched at the first level of partition
+  //--------------------------------------------------------------
+  
+  //solve<NodeSolveTask>(b, ctx, runtime, wait);
+
+  // A and b have the same number of partition
+  // this should refer to the second level
+  assert( this->num_partition() == b.num_partition() );
+
+  // rowBlk is the size of the Shur complement,
+  // so rowBlk = 2*rowBlk() when plevel=2,
+  // or rowBlk = rowBlk() when plevel=1.
+  int rowBlk = this->rowBlk()*plevel;
+  //std::cout<<"rowBlk:"<<rowBlk<<", mCols:"<<mCols<<std::endl;
+  assert( batch > 0 && mCols % batch == 0 && b.cols() % batch == 0 );
+  assert( rowBlk/2 == mCols/batch );
+  
+  // first level stuff
+  LogicalPartition APart = this->logical_partition();
+  LogicalPartition bPart = b.logical_partition();
+
+  LogicalRegion ARegion = this->logical_region();
+  LogicalRegion bRegion = b.logical_region();
+
+  Domain domain = this->color_domain();
+  typename NodeSolveTaskT<T>::TaskArgs args =
+    {rowBlk, mCols/batch, b.cols()/batch, false, false, false, batch};
+  NodeSolveTaskT<T> launcher(domain, TaskArgument(&args, sizeof(args)),
+			     ArgumentMap(), domain.get_volume());
+  //RegionRequirement AReq(APart, 0, READ_ONLY,  EXCLUSIVE, ARegion);
+  // bug here: have to use stronger previlige
+  RegionRequirement AReq(APart, 0, READ_WRITE,  EXCLUSIVE, ARegion);
+  RegionRequirement bReq(bPart, 0, READ_WRITE, EXCLUSIVE, bRegion);
+  AReq.add_field(FIELDID_V);
+  bReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(AReq);
+  launcher.add_region_requirement(bReq);
+  
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for node solve...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for node solve...");
+  }
+}
+
+// form and factorize the node systems (see node_solve()) for
+//  every partition; S has 2*rank rows per node and
+//  2*rank+1 columns, the last one for the pivots; returns
+//  logdet plus the sum of log|det| over the node systems
+Future LMatrix::node_factor
+(LMatrix& S, bool spd, bool single, const std::vector<bool>& update,
+ const Future& logdet, Context ctx, HighLevelRuntime* runtime,
+ bool wait) {
+
+  int rowBlk = this->rowBlk()*plevel;
+  assert( rowBlk/2 == mCols );
+  assert( S.rowBlk() == rowBlk && S.cols() == rowBlk+1 );
+  assert( S.color_domain().get_volume() == colDom.get_volume() );
+  
+  LogicalPartition APart = this->logical_partition();
+  LogicalPartition SPart = S.logical_partition();
+
+  LogicalRegion ARegion = this->logical_region();
+  LogicalRegion SRegion = S.logical_region();
+
+  Domain domain = this->color_domain();
+  NodeFactorTask::TaskArgs args = {rowBlk, mCols, spd, single};
+  NodeFactorTask launcher(domain, TaskArgument(&args, sizeof(args)),
+			  update_flags(update, domain.get_volume(), 1),
+			  domain.get_volume());
+  PrivilegeMode SPriv = update.empty() ? WRITE_DISCARD : READ_WRITE;
+  RegionRequirement AReq(APart, 0, READ_ONLY,     EXCLUSIVE, ARegion);
+  RegionRequirement SReq(SPart, 0, SPriv,         EXCLUSIVE, SRegion);
+  AReq.add_field(FIELDID_V);
+  SReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(AReq);
+  launcher.add_region_requirement(SReq);
+  launcher.add_future(logdet);
+  
+  Future sum = runtime->execute_index_space(ctx, launcher, REDOP_ADD);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for node factor...");
+    sum.get_void_result();
+    log_solver_tasks.print("Done for node factor...");
+  }
+  return sum;
+}
+
+// same as node_solve(), but this matrix holds the factors
+//  computed by node_factor()
+void LMatrix::node_solve_factored
+(LMatrix& b, bool spd, bool trans, Context ctx, HighLevelRuntime* runtime,
+ bool wait) {
+  assert( b.type == type );
+  SCALAR_DISPATCH(type, node_solve_factored,
+		  (b, spd, trans, ctx, runtime, wait));
+}
+
+template <typename T>
+void LMatrix::node_solve_factored
+(LMatrix& b, bool spd, bool trans, Context ctx, HighLevelRuntime* runtime,
+ bool wait) {
+
+  int rowBlk = this->rowBlk()*plevel;
+  assert( rowBlk+1 == mCols );
+  assert( b.color_domain().get_volume() == colDom.get_volume() );
+  
+  LogicalPartition APart = this->logical_partition();
+  LogicalPartition bPart = b.logical_partition();
+
+  LogicalRegion ARegion = this->logical_region();
+  LogicalRegion bRegion = b.logical_region();
+
+  Domain domain = this->color_domain();
+  assert( !(spd && trans) );
+  typename NodeSolveTaskT<T>::TaskArgs args =
+    {rowBlk, mCols, b.cols(), true, spd, trans, 1};
+  NodeSolveTaskT<T> launcher(domain, TaskArgument(&args, sizeof(args)),
+			     ArgumentMap(), domain.get_volume());
+  RegionRequirement AReq(APart, 0, READ_ONLY,  EXCLUSIVE, ARegion);
+  RegionRequirement bReq(bPart, 0, READ_WRITE, EXCLUSIVE, bRegion);
+  AReq.add_field(FIELDID_V);
+  bReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(AReq);
+  launcher.add_region_requirement(bReq);
+  
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for node solve...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for node solve...");
+  }
+}
+
+void LMatrix::node_inverse
+(LMatrix& R, bool spd, Context ctx, HighLevelRuntime* runtime, bool wait) {
+
+  int rowBlk = this->rowBlk()*plevel;
+  assert( rowBlk+1 == mCols );
+  assert( R.cols() == rowBlk/2 );
+  assert( R.color_domain().get_volume() == colDom.get_volume() );
+
+  LogicalPartition APart = this->logical_partition();
+  LogicalPartition RPart = R.logical_partition();
+
+  LogicalRegion ARegion = this->logical_region();
+  LogicalRegion RRegion = R.logical_region();
+
+  Domain domain = this->color_domain();
+  NodeInverseTask::TaskArgs args = {rowBlk, spd};
+  NodeInverseTask launcher(domain, TaskArgument(&args, sizeof(args)),
+			   ArgumentMap(), domain.get_volume());
+  RegionRequirement AReq(APart, 0, READ_ONLY,     EXCLUSIVE, ARegion);
+  RegionRequirement RReq(RPart, 0, WRITE_DISCARD, EXCLUSIVE, RRegion);
+  AReq.add_field(FIELDID_V);
+  RReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(AReq);
+  launcher.add_region_requirement(RReq);
+
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for node inverse...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for node inverse...");
+  }
+}
+
+// this matrix holds u'*u with rank columns; S has 2*rank rows
+//  per node and 2*rank+1 columns like node_factor()
+Future LMatrix::node_sqrt
+(LMatrix& S, LMatrix* b, const Future& logdet, Context ctx,
+ HighLevelRuntime* runtime, bool wait) {
+
+  int rowBlk = this->rowBlk()*plevel;
+  assert( rowBlk/2 == mCols );
+  assert( S.rowBlk() == rowBlk && S.cols() == rowBlk+1 );
+  assert( S.color_domain().get_volume() == colDom.get_volume() );
+
+  LogicalPartition APart = this->logical_partition();
+  LogicalPartition SPart = S.logical_partition();
+
+  LogicalRegion ARegion = this->logical_region();
+  LogicalRegion SRegion = S.logical_region();
+
+  Domain domain = this->color_domain();
+  NodeSqrtTask::TaskArgs args = {rowBlk, b ? b->cols() : 0, 'f'};
+  NodeSqrtTask launcher(domain, TaskArgument(&args, sizeof(args)),
+			ArgumentMap(), domain.get_volume());
+  RegionRequirement AReq(APart, 0, READ_ONLY,     EXCLUSIVE, ARegion);
+  RegionRequirement SReq(SPart, 0, WRITE_DISCARD, EXCLUSIVE, SRegion);
+  AReq.add_field(FIELDID_V);
+  SReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(AReq);
+  launcher.add_region_requirement(SReq);
+  if (b != NULL) {
+    assert( b->color_domain().get_volume() == colDom.get_volume() );
+    RegionRequirement bReq(b->logical_partition(), 0, READ_WRITE, EXCLUSIVE,
+			   b->logical_region());
+    bReq.add_field(FIELDID_V);
+    launcher.add_region_requirement(bReq);
+  }
+  launcher.add_future(logdet);
+
+  Future sum = runtime->execute_index_space(ctx, launcher, REDOP_ADD);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for node sqrt...");
+    sum.get_void_result();
+    log_solver_tasks.print("Done for node sqrt...");
+  }
+  return sum;
+}
+
+void LMatrix::node_multiply_sqrt
+(LMatrix& b, char trans, Context ctx, HighLevelRuntime* runtime,
+ bool wait) {
+
+  int rowBlk = this->rowBlk()*plevel;
+  assert( rowBlk+1 == mCols );
+  assert( b.color_domain().get_volume() == colDom.get_volume() );
+
+  LogicalPartition APart = this->logical_partition();
+  LogicalPartition bPart = b.logical_partition();
+
+  LogicalRegion ARegion = this->logical_region();
+  LogicalRegion bRegion = b.logical_region();
+
+  Domain domain = this->color_domain();
+  NodeSqrtTask::TaskArgs args = {rowBlk, b.cols(), trans};
+  NodeSqrtTask launcher(domain, TaskArgument(&args, sizeof(args)),
+			ArgumentMap(), domain.get_volume());
+  RegionRequirement AReq(APart, 0, READ_ONLY,  EXCLUSIVE, ARegion);
+  RegionRequirement bReq(bPart, 0, READ_WRITE, EXCLUSIVE, bRegion);
+  AReq.add_field(FIELDID_V);
+  bReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(AReq);
+  launcher.add_region_requirement(bReq);
+
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for node sqrt multiply...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for node sqrt multiply...");
+  }
+}
+
+void LMatrix::node_solve
+(LMatrix& VTu0, LMatrix &VTu1, LMatrix& VTd0, LMatrix &VTd1,
+ PhaseBarrier pb_wait, PhaseBarrier pb_ready,
+ Context ctx, HighLevelRuntime* runtime, bool wait) {
+  node_solve(VTu0, VTu1, VTd0, VTd1, 1, pb_wait, pb_ready, ctx, runtime,
+	     wait);
+}
+
+void LMatrix::node_solve
+(LMatrix& VTu0, LMatrix &VTu1, LMatrix& VTd0, LMatrix &VTd1, int batch,
+ PhaseBarrier pb_wait, PhaseBarrier pb_ready,
+ Context ctx, HighLevelRuntime* runtime, bool wait) {
+
+  LogicalRegion VTu0_rg = VTu0.logical_region();
+  LogicalRegion VTu1_rg = VTu1.logical_region();
+  LogicalRegion VTd0_rg = VTd0.logical_region();
+  LogicalRegion VTd1_rg = VTd1.logical_region();
+#if 0
+  printf("VTu0 (%x,%x,%x)\n",
+	 VTu0_rg.get_index_space().get_id(), 
+	 VTu0_rg.get_field_space().get_id(),
+	 VTu0_rg.get_tree_id());
+  printf("VTu1 (%x,%x,%x)\n",
+	 VTu1_rg.get_index_space().get_id(), 
+	 VTu1_rg.get_field_space().get_id(),
+	 VTu1_rg.get_tree_id());
+  printf("VTd0 (%x,%x,%x)\n",
+	 VTd0_rg.get_index_space().get_id(), 
+	 VTd0_rg.get_field_space().get_id(),
+	 VTd0_rg.get_tree_id());
+  printf("VTd1 (%x,%x,%x)\n",
+	 VTd1_rg.get_index_space().get_id(), 
+	 VTd1_rg.get_field_space().get_id(),
+	 VTd1_rg.get_tree_id());
+#endif
+  assert(batch > 0 && VTd0.cols() % batch == 0);
+  assert(VTu0.rows()*batch == VTu0.cols());
+  assert(VTu1.rows()*batch == VTu1.cols());
+  assert(VTu0.rows() == VTu1.rows());
+  assert(VTd0.rows() == VTd1.rows());
+  assert(VTd0.cols() == VTd1.cols());
+  assert(VTu0.rows() == VTd0.rows());
+  int rank = VTd0.rows();
+  int nRhs = VTd0.cols()/batch;
+  NodeSolveRegionTask::TaskArgs args = {rank, nRhs, batch};
+  NodeSolveRegionTask launcher(TaskArgument(&args, sizeof(args)));
+  //RegionRequirement AReq(ARegion, 0, READ_ONLY,  EXCLUSIVE, ARegion);
+  RegionRequirement VTu0_rq(VTu0_rg, READ_ONLY, EXCLUSIVE, VTu0_rg);
+  RegionRequirement VTu1_rq(VTu1_rg, READ_ONLY, EXCLUSIVE, VTu1_rg);
+  RegionRequirement VTd0_rq(VTd0_rg, READ_WRITE, EXCLUSIVE, VTd0_rg);
+  RegionRequirement VTd1_rq(VTd1_rg, READ_WRITE, EXCLUSIVE, VTd1_rg);
+  VTu0_rq.add_field(FIELDID_V);
+  VTu1_rq.add_field(FIELDID_V);
+  VTd0_rq.add_field(FIELDID_V);
+  VTd1_rq.add_field(FIELDID_V);
+  launcher.add_region_requirement(VTu0_rq);
+  launcher.add_region_requirement(VTu1_rq);
+  launcher.add_region_requirement(VTd0_rq);
+  launcher.add_region_requirement(VTd1_rq);
+  launcher.add_wait_barrier(pb_wait);
+  launcher.add_arrival_barrier(pb_ready);
+  runtime->execute_task(ctx, launcher);
+}
+
+/*
+template <typename SolveTask>
+void LMatrix::solve
+(LMatrix& b, Context ctx, HighLevelRuntime *runtime, bool wait) {
+
+  // A and b have the same number of partition
+  assert( this->num_partition() == b.num_partition() );
+
+  LogicalPartition APart = this->logical_partition();
+  LogicalPartition bPart = b.logical_partition();
+
+  LogicalRegion ARegion = this->logical_region();
+  LogicalRegion bRegion = b.logical_region();
+
+  Domain domain = this->color_domain();
+  SolveTask launcher(domain, TaskArgument(), ArgumentMap());
+  RegionRequirement AReq(APart, 0, READ_ONLY,  EXCLUSIVE, ARegion);
+  RegionRequirement bReq(bPart, 0, READ_WRITE, EXCLUSIVE, bRegion);
+  AReq.add_field(FIELDID_V);
+  bReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(AReq);
+  launcher.add_region_requirement(bReq);
+  
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  if(wait) {
+    std::cout << "Wait for solve..." << std::endl;
+    fm.wait_all_results();
+  }
+}
+*/
+void LMatrix::add
 (double alpha, const LMatrix& A,
  double beta, const LMatrix& B, LMatrix& C,
  Context ctx, HighLevelRuntime *runtime, bool wait) {
@@ -678,6 +1752,17 @@ void LMatrix::add
   assert( A.num_partition() == B.num_partition() &&
 	  A.num_partition() == C.num_partition() );
 
+  // C = alpha*C + beta*B in place, which only needs two regions
+  if (B.logical_region() == C.logical_region() &&
+      B.column_begin() == C.column_begin() &&
+      A.logical_region() != C.logical_region()) {
+    add(beta, B, alpha, A, C, ctx, runtime, wait);
+    return;
+  }
+  bool inplace = (A.logical_region() == C.logical_region());
+  assert( !inplace || A.column_begin() == C.column_begin() );
+  assert( B.logical_region() != C.logical_region() );
+
   LogicalPartition APart = A.logical_partition();
   LogicalPartition BPart = B.logical_partition();
   LogicalPartition CPart = C.logical_partition();
@@ -686,19 +1771,21 @@ void LMatrix::add
   LogicalRegion BReg = B.logical_region();
   LogicalRegion CReg = C.logical_region();
 
-  int rblock = A.rowBlk();
   int cols   = A.cols();
-  AddMatrixTask::TaskArgs args = {alpha, beta, rblock, cols};
+  AddMatrixTask::TaskArgs args = {alpha, beta, cols, A.column_begin(),
+				  B.column_begin(), C.column_begin()};
   TaskArgument tArgs(&args, sizeof(args));
   Domain domain = A.color_domain();
   AddMatrixTask launcher(domain, tArgs, ArgumentMap());  
   RegionRequirement AReq(APart, 0, READ_ONLY, EXCLUSIVE, AReg);
   RegionRequirement BReq(BPart, 0, READ_ONLY, EXCLUSIVE, BReg);
-  RegionRequirement CReq(CPart, 0, WRITE_DISCARD, EXCLUSIVE, CReg);
+  // C may be a column view of a larger region
+  RegionRequirement CReq(CPart, 0, READ_WRITE, EXCLUSIVE, CReg);
   AReq.add_field(FIELDID_V);
   BReq.add_field(FIELDID_V);
   CReq.add_field(FIELDID_V);
-  launcher.add_region_requirement(AReq);
+  if (!inplace)
+    launcher.add_region_requirement(AReq);
   launcher.add_region_requirement(BReq);
   launcher.add_region_requirement(CReq);
   
@@ -711,13 +1798,103 @@ void LMatrix::add
   }  
 }
 
+void LMatrix::convert
+(const LMatrix& A, LMatrix& B,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+
+  assert( A.rows() == B.rows() && A.cols() == B.cols() );
+  assert( A.num_partition() == B.num_partition() );
+  assert( A.type != B.type );
+
+  ConvertMatrixTask::TaskArgs args = {A.cols(), A.column_begin(),
+				      B.column_begin(), A.type, B.type};
+  TaskArgument tArgs(&args, sizeof(args));
+  Domain domain = A.color_domain();
+  ConvertMatrixTask launcher(domain, tArgs, ArgumentMap());
+  RegionRequirement AReq(A.logical_partition(), 0, READ_ONLY, EXCLUSIVE,
+			 A.logical_region());
+  // B may be a column view of a larger region
+  RegionRequirement BReq(B.logical_partition(), 0, READ_WRITE, EXCLUSIVE,
+			 B.logical_region());
+  AReq.add_field(FIELDID_V);
+  BReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(AReq);
+  launcher.add_region_requirement(BReq);
+
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for converting matrix...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for converting matrix...");
+  }
+}
+
+// every partition returns its part and the launch reduces
+//  them with REDOP_ADD, so nobody waits until the value is used
+Future LMatrix::dot
+(const LMatrix& A, const LMatrix& B,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+
+  assert( A.rows() == B.rows() && A.cols() == B.cols() );
+  assert( A.num_partition() == B.num_partition() );
+
+  LogicalPartition APart = A.logical_partition();
+  LogicalPartition BPart = B.logical_partition();
+
+  LogicalRegion AReg = A.logical_region();
+  LogicalRegion BReg = B.logical_region();
+
+  DotProductTask::TaskArgs args = {A.cols(), A.column_begin(),
+				   B.column_begin()};
+  TaskArgument tArgs(&args, sizeof(args));
+  Domain domain = A.color_domain();
+  DotProductTask launcher(domain, tArgs, ArgumentMap());  
+  RegionRequirement AReq(APart, 0, READ_ONLY, EXCLUSIVE, AReg);
+  RegionRequirement BReq(BPart, 0, READ_ONLY, EXCLUSIVE, BReg);
+  AReq.add_field(FIELDID_V);
+  BReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(AReq);
+  launcher.add_region_requirement(BReq);
+  
+  Future sum = runtime->execute_index_space(ctx, launcher, REDOP_ADD);
+
+  if(wait) {
+    std::cout << "Wait for dot product..." << std::endl;
+    sum.get_void_result();
+    std::cout << "Done for dot product..." << std::endl;
+  }
+  return sum;
+}
+
 void LMatrix::gemmRed // static method
 (char transa, char transb, double alpha,
  const LMatrix& A, const LMatrix& B,
  double beta, LMatrix& C,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+  gemmRed(transa, transb, alpha, A, B, beta, C, 1, 0, ctx, runtime, wait);
+}
+
+void LMatrix::gemmRed // static method
+(char transa, char transb, double alpha,
+ const LMatrix& A, const LMatrix& B,
+ double beta, LMatrix& C, int batch, int stride,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+  assert( A.type == C.type && B.type == C.type );
+  SCALAR_DISPATCH(C.type, gemmRed,
+		  (transa, transb, alpha, A, B, beta, C, batch, stride,
+		   ctx, runtime, wait));
+}
+
+template <typename T>
+void LMatrix::gemmRed // static method
+(char transa, char transb, double alpha,
+ const LMatrix& A, const LMatrix& B,
+ double beta, LMatrix& C, int batch, int stride,
  Context ctx, HighLevelRuntime *runtime, bool wait) {
 
   assert( fabs(beta - 0.0) < 1e-10);
+  assert( batch > 0 && C.cols() % batch == 0 );
   C.scale(beta, ctx, runtime);
   
   // A and B have the same number of partition
@@ -733,18 +1910,21 @@ void LMatrix::gemmRed // static method
   LogicalRegion CReg = C.logical_region();
 
   int colorSize = A.num_partition() / C.num_partition();
-  GemmRedTask::TaskArgs args={colorSize, C.partition_level(),
-			      alpha, transa, transb,
-			      A.rowBlk(), B.rowBlk(), C.rowBlk(),
-			      A.cols(), B.cols(), C.cols(),
-			      A.column_begin(), B.column_begin(), C.column_begin()};
+  typename GemmRedTaskT<T>::TaskArgs args =
+    {colorSize, C.partition_level(),
+     T(alpha), transa, transb,
+     A.rowBlk(), B.rowBlk(), C.rowBlk(),
+     A.cols(), B.cols(), C.cols()/batch,
+     A.column_begin(), B.column_begin(), C.column_begin(),
+     batch, stride};
   TaskArgument tArgs(&args, sizeof(args));
   Domain domain = A.color_domain();
-  GemmRedTask launcher(domain, tArgs, ArgumentMap(), A.nPart);
+  GemmRedTaskT<T> launcher(domain, tArgs, ArgumentMap(), A.nPart);
   
   RegionRequirement AReq(APart, 0,           READ_ONLY, EXCLUSIVE, AReg);
   RegionRequirement BReq(BPart, 0,           READ_ONLY, EXCLUSIVE, BReg);
-  RegionRequirement CReq(CPart, CONTRACTION, REDOP_ADD, EXCLUSIVE, CReg);
+  RegionRequirement CReq(CPart, CONTRACTION, AddT<T>::redop_id(), EXCLUSIVE,
+			  CReg);
   AReq.add_field(FIELDID_V);
   BReq.add_field(FIELDID_V);
   CReq.add_field(FIELDID_V);
@@ -765,13 +1945,23 @@ void LMatrix::gemm // static method
 (char transa, char transb,
  double alpha, const LMatrix& A, const LMatrix& B,
  double beta, LMatrix& C,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+  gemm(transa, transb, alpha, A, B, beta, C, 1, 0, ctx, runtime, wait);
+}
+
+void LMatrix::gemm // static method
+(char transa, char transb,
+ double alpha, const LMatrix& A, const LMatrix& B,
+ double beta, LMatrix& C, int batch, int stride,
  Context ctx, HighLevelRuntime *runtime, bool wait) {
   // skip scaling C matrix
   assert( fabs(beta - 0.0) < 1e-10);
+  assert( batch > 0 && C.cols() % batch == 0 );
   GemmTask::TaskArgs args = {transa, transb, alpha, beta,
 			     A.rows(), B.rows(), C.rows(),
 			     A.column_begin(), B.column_begin(),
-			     A.cols(), B.cols(), C.cols()};
+			     A.cols(), B.cols(), C.cols()/batch,
+			     batch, stride};
   GemmTask launcher(TaskArgument(&args, sizeof(args)));
   launcher.add_region_requirement
     (RegionRequirement(A.logical_region(),READ_ONLY,EXCLUSIVE,A.logical_region())
@@ -789,13 +1979,23 @@ void LMatrix::gemm_inplace // static method
 (char transa, char transb, double alpha,
  const LMatrix& A, const LMatrix& B,
  double beta, LMatrix& C,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+  gemm_inplace(transa, transb, alpha, A, B, beta, C, 1, 0, ctx, runtime,
+	       wait);
+}
+
+void LMatrix::gemm_inplace // static method
+(char transa, char transb, double alpha,
+ const LMatrix& A, const LMatrix& B,
+ double beta, LMatrix& C, int batch, int stride,
  Context ctx, HighLevelRuntime *runtime, bool wait) {
   // skip scaling C matrix
   assert( fabs(beta - 1.0) < 1e-10);
+  assert( batch > 0 && B.cols() % batch == 0 );
   GemmInplaceTask::TaskArgs args = {transa, transb, alpha, beta,
 				    A.rows(), B.rows(), C.rows(),
-				    A.cols(), B.cols(), C.cols(),
-				    A.column_begin()};
+				    A.cols(), B.cols()/batch, C.cols(),
+				    A.column_begin(), batch, stride};
   GemmInplaceTask launcher(TaskArgument(&args, sizeof(args)));
   launcher.add_region_requirement
     (RegionRequirement(A.logical_region(),READ_WRITE,EXCLUSIVE,A.logical_region())
@@ -809,6 +2009,210 @@ void LMatrix::gemm_inplace // static method
   runtime->execute_task(ctx, launcher);
 }
 
+// one task for every child at depth level+1, which
+//  writes its rows of U and the rows of its sibling in V
+void LMatrix::aca // static method
+(int func, double tol, int level, int ucol, int vcol, int rank,
+ const LMatrix& U, const LMatrix& V,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+  aca(func, tol, level, ucol, vcol, rank, U, V, LMatrix(),
+      ctx, runtime, wait);
+}
+
+// with perm, the tasks also read the indices of the rows of the
+//  child and of its sibling; an empty perm is the identity
+void LMatrix::aca // static method
+(int func, double tol, int level, int ucol, int vcol, int rank,
+ const LMatrix& U, const LMatrix& V, const LMatrix& perm,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+
+  assert( U.rows() == V.rows() );
+  assert( ucol+rank <= U.cols() && vcol+rank <= V.cols() );
+  LMatrix UPart = U;
+  LMatrix VPart = V;
+  UPart.partition(level+1, ctx, runtime);
+  VPart.partition(level+1, ctx, runtime);
+
+  AcaBlockTask::TaskArgs args = {func, ucol, vcol, rank, tol};
+  TaskArgument tArgs(&args, sizeof(args));
+  Domain domain = UPart.color_domain();
+  AcaBlockTask launcher(domain, tArgs, ArgumentMap(), UPart.nPart);
+  
+  RegionRequirement UReq(UPart.lpart, 0,       READ_WRITE, EXCLUSIVE, U.region);
+  RegionRequirement VReq(VPart.lpart, SIBLING, READ_WRITE, EXCLUSIVE, V.region);
+  UReq.add_field(FIELDID_V);
+  VReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(UReq);
+  launcher.add_region_requirement(VReq);
+  if (perm.rows() > 0) {
+    assert( perm.rows() == U.rows() );
+    LMatrix PPart = perm;
+    PPart.partition(level+1, ctx, runtime);
+    RegionRequirement PReq(PPart.lpart, 0,       READ_ONLY, EXCLUSIVE, perm.region);
+    RegionRequirement QReq(PPart.lpart, SIBLING, READ_ONLY, EXCLUSIVE, perm.region);
+    PReq.add_field(FIELDID_V);
+    QReq.add_field(FIELDID_V);
+    launcher.add_region_requirement(PReq);
+    launcher.add_region_requirement(QReq);
+  }
+  
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for ACA...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for ACA...");
+  }  
+}
+
+// part p holds the rows of src that the rows of block p of P
+//  gather, as runs of consecutive indices in all columns, so
+//  the partition is disjoint for a permutation
+LogicalPartition LMatrix::permute_partition // static method
+(const std::vector<int>& rows, const LMatrix& P, const LMatrix& src,
+ Context ctx, HighLevelRuntime *runtime) {
+
+  assert( int(rows.size()) == P.rows() );
+  Rect<2> bounds = runtime->get_index_space_domain
+    (ctx, src.region.get_index_space()).get_rect<2>();
+  MultiDomainColoring coloring;
+  for (int p=0; p<P.nPart; p++) {
+    std::vector<int> idx(rows.begin()+block_begin(P.rows(), P.nPart, p),
+			 rows.begin()+block_begin(P.rows(), P.nPart, p+1));
+    std::sort(idx.begin(), idx.end());
+    for (size_t k=0; k<idx.size(); ) {
+      size_t l = k+1;
+      while (l < idx.size() && idx[l] == idx[l-1]+1)
+	l++;
+      Point<2> lo = make_point( idx[k],   bounds.lo[1]);
+      Point<2> hi = make_point( idx[l-1], bounds.hi[1]);
+      coloring[p].insert( Domain::from_rect<2>(Rect<2>(lo, hi)) );
+      k = l;
+    }
+  }
+  IndexPartition ip = runtime->create_index_partition
+    (ctx, src.region.get_index_space(), P.colDom, coloring, true);
+  return runtime->get_logical_partition(ctx, src.region, ip);
+}
+
+void LMatrix::permute // static method
+(const LMatrix& P, int pcol, const LMatrix& src, LogicalPartition spart,
+ LMatrix& dst, bool scatter, Context ctx, HighLevelRuntime *runtime,
+ bool wait) {
+
+  assert( P.rows() == dst.rows() && P.nPart == dst.nPart );
+  assert( 0 <= pcol && pcol < P.cols() );
+  assert( src.cols() == dst.cols() );
+  assert( src.region != dst.region );
+
+  PermuteTask::TaskArgs args = {P.colIdx+pcol, src.colIdx, dst.colIdx,
+				dst.cols(), scatter};
+  TaskArgument tArgs(&args, sizeof(args));
+  PermuteTask launcher(dst.colDom, tArgs, ArgumentMap(), dst.nPart);
+
+  RegionRequirement PReq(P.lpart,   0, READ_ONLY, EXCLUSIVE, P.region);
+  RegionRequirement SReq(spart,     0, scatter ? READ_WRITE : READ_ONLY,
+			 EXCLUSIVE, src.region);
+  RegionRequirement DReq(dst.lpart, 0, scatter ? READ_ONLY : READ_WRITE,
+			 EXCLUSIVE, dst.region);
+  PReq.add_field(FIELDID_V);
+  SReq.add_field(FIELDID_V);
+  DReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(PReq);
+  launcher.add_region_requirement(SReq);
+  launcher.add_region_requirement(DReq);
+
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for permute...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for permute...");
+  }
+}
+
+// one task for every child at depth level, which recompresses
+//  its rows of U against the rows of its sibling in V
+int LMatrix::recompress // static method
+(double tol, int level, int ucol, int vcol, int rank,
+ const LMatrix& U, const LMatrix& V,
+ Context ctx, HighLevelRuntime *runtime) {
+
+  assert( U.rows() == V.rows() );
+  assert( ucol+rank <= U.cols() && vcol+rank <= V.cols() );
+  assert( rank > 0 && tol > 0.0 );
+  LMatrix UPart = U;
+  LMatrix VPart = V;
+  UPart.partition(level+1, ctx, runtime);
+  VPart.partition(level+1, ctx, runtime);
+
+  RecompressTask::TaskArgs args = {ucol, vcol, rank, tol};
+  TaskArgument tArgs(&args, sizeof(args));
+  Domain domain = UPart.color_domain();
+  RecompressTask launcher(domain, tArgs, ArgumentMap(), UPart.nPart);
+  
+  RegionRequirement UReq(UPart.lpart, 0,       READ_WRITE, EXCLUSIVE, U.region);
+  RegionRequirement VReq(VPart.lpart, SIBLING, READ_WRITE, EXCLUSIVE, V.region);
+  UReq.add_field(FIELDID_V);
+  VReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(UReq);
+  launcher.add_region_requirement(VReq);
+  
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  // the new rank decides the layout of the regions
+  int newRank = 1;
+  for (int i=0; i<UPart.nPart; i++) {
+    DomainPoint p = DomainPoint::from_point<1>(Point<1>(i));
+    newRank = std::max(newRank, fm.get_result<int>(p));
+  }
+  return newRank;
+}
+
+// one task for every child at depth level, which reads its rows
+//  of Y and writes its rows of B (and X)
+void LMatrix::peel // static method
+(int level, int rank, bool orth, const LMatrix& Y, const LMatrix& B,
+ int col, const LMatrix& X, Context ctx, HighLevelRuntime *runtime,
+ bool wait) {
+
+  assert( Y.rows() == B.rows() && Y.rows() == X.rows() );
+  assert( Y.column_begin() == 0 );
+  assert( !orth || rank > 0 );
+  LMatrix YPart = Y;
+  LMatrix BPart = B;
+  YPart.partition(level, ctx, runtime);
+  BPart.partition(level, ctx, runtime);
+
+  PeelBlockTask::TaskArgs args = {rank, col, orth};
+  TaskArgument tArgs(&args, sizeof(args));
+  Domain domain = YPart.color_domain();
+  PeelBlockTask launcher(domain, tArgs, ArgumentMap(), YPart.nPart);
+  
+  RegionRequirement YReq(YPart.lpart, 0, READ_ONLY,  EXCLUSIVE, Y.region);
+  RegionRequirement BReq(BPart.lpart, 0, READ_WRITE, EXCLUSIVE, B.region);
+  YReq.add_field(FIELDID_V);
+  BReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(YReq);
+  launcher.add_region_requirement(BReq);
+  if (orth) {
+    assert( X.column_begin() == 0 );
+    LMatrix XPart = X;
+    XPart.partition(level, ctx, runtime);
+    RegionRequirement XReq(XPart.lpart, 0, WRITE_DISCARD, EXCLUSIVE, X.region);
+    XReq.add_field(FIELDID_V);
+    launcher.add_region_requirement(XReq);
+  }
+  
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for peeling...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for peeling...");
+  }  
+}
+
 // compute A * B = C; broadcast B
 // this is hard coded in that A and C are the same region
 // so is GemmBroTask.
@@ -816,9 +2220,30 @@ void LMatrix::gemmBro // static method
 (char transa, char transb, double alpha,
  const LMatrix& A, const LMatrix& B,
  double beta, LMatrix& C,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+  gemmBro(transa, transb, alpha, A, B, beta, C, 1, 0, ctx, runtime, wait);
+}
+
+void LMatrix::gemmBro // static method
+(char transa, char transb, double alpha,
+ const LMatrix& A, const LMatrix& B,
+ double beta, LMatrix& C, int batch, int stride,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+  assert( A.type == C.type && B.type == C.type );
+  SCALAR_DISPATCH(C.type, gemmBro,
+		  (transa, transb, alpha, A, B, beta, C, batch, stride,
+		   ctx, runtime, wait));
+}
+
+template <typename T>
+void LMatrix::gemmBro // static method
+(char transa, char transb, double alpha,
+ const LMatrix& A, const LMatrix& B,
+ double beta, LMatrix& C, int batch, int stride,
  Context ctx, HighLevelRuntime *runtime, bool wait) {
 
   assert( fabs(beta - 1.0) < 1e-10);
+  assert( batch > 0 && B.cols() % batch == 0 );
   //C.scale(beta, ctx, runtime);
   
   // A and C have the same number of partition
@@ -835,14 +2260,16 @@ void LMatrix::gemmBro // static method
   assert(AReg==CReg);
   
   int colorSize = A.nPart / B.nPart;
-  GemmBroTask::TaskArgs args = {colorSize, B.partition_level(),
-				alpha, transa, transb,
-				A.rowBlk(), B.rowBlk(), C.rowBlk(),
-				A.cols(), B.cols(), C.cols(),
-				A.column_begin()};
+  typename GemmBroTaskT<T>::TaskArgs args =
+    {colorSize, B.partition_level(),
+     T(alpha), transa, transb,
+     A.rowBlk(), B.rowBlk(), C.rowBlk(),
+     A.cols(), B.cols()/batch, C.cols(),
+     A.column_begin(), C.column_begin(),
+     false /*sibling*/, batch, stride};
   TaskArgument tArgs(&args, sizeof(args));
   Domain domain = A.color_domain();
-  GemmBroTask launcher(domain, tArgs, ArgumentMap(), A.nPart);
+  GemmBroTaskT<T> launcher(domain, tArgs, ArgumentMap(), A.nPart);
   
   //RegionRequirement AReq(AP, 0,           READ_ONLY,  EXCLUSIVE, AReg);
   RegionRequirement AReq(AP, 0,           READ_WRITE,  EXCLUSIVE, AReg);
@@ -864,7 +2291,55 @@ void LMatrix::gemmBro // static method
     log_solver_tasks.print("Done for gemm broadcast...");
   }  
 }
+
+void LMatrix::gemmSib // static method
+(char transa, char transb, double alpha,
+ const LMatrix& A, const LMatrix& B,
+ double beta, LMatrix& C,
+ Context ctx, HighLevelRuntime *runtime, bool wait) {
+
+  assert( fabs(beta - 1.0) < 1e-10);
+  assert( A.num_partition() == C.num_partition() );
+  assert( A.num_partition() %  B.num_partition() == 0 );
+  
+  LogicalPartition AP = A.logical_partition();
+  LogicalPartition BP = B.logical_partition();
+  LogicalPartition CP = C.logical_partition();
+
+  LogicalRegion AReg = A.logical_region();
+  LogicalRegion BReg = B.logical_region();
+  LogicalRegion CReg = C.logical_region();
+  
+  int colorSize = A.nPart / B.nPart;
+  GemmBroTask::TaskArgs args = {colorSize, B.partition_level(),
+				alpha, transa, transb,
+				A.rowBlk(), B.rowBlk(), C.rowBlk(),
+				A.cols(), B.cols(), C.cols(),
+				A.column_begin(), C.column_begin(),
+				true /*sibling*/, 1, 0};
+  TaskArgument tArgs(&args, sizeof(args));
+  Domain domain = A.color_domain();
+  GemmBroTask launcher(domain, tArgs, ArgumentMap(), A.nPart);
   
+  RegionRequirement AReq(AP, 0,                   READ_ONLY,  EXCLUSIVE, AReg);
+  RegionRequirement BReq(BP, CONTRACTION_SIBLING, READ_ONLY,  EXCLUSIVE, BReg);
+  RegionRequirement CReq(CP, 0,                   READ_WRITE, EXCLUSIVE, CReg);
+  AReq.add_field(FIELDID_V);
+  BReq.add_field(FIELDID_V);
+  CReq.add_field(FIELDID_V);
+  launcher.add_region_requirement(AReq);
+  launcher.add_region_requirement(BReq);
+  launcher.add_region_requirement(CReq);
+  
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+
+  if(wait) {
+    log_solver_tasks.print("Wait for gemm sibling...");
+    fm.wait_all_results();
+    log_solver_tasks.print("Done for gemm sibling...");
+  }  
+}
+
 void LMatrix::display
 (const std::string& name,
  Context ctx, HighLevelRuntime *runtime, bool wait) {
@@ -889,3 +2364,16 @@ void LMatrix::clear(Context ctx, HighLevelRuntime* runtime) {
   runtime->destroy_field_space(ctx, fspace);
   runtime->destroy_index_space(ctx, ispace);
 }
+
+void LMatrix::set_scalar_type
+(ScalarType type_, Context ctx, HighLevelRuntime *runtime) {
+  if (type_ == type)
+    return;
+  assert( colIdx == 0 );
+  LMatrix B(mRows, mCols, log2(nPart), ctx, runtime, type_);
+  B.smallblk = smallblk;
+  B.plevel   = plevel;
+  convert( *this, B, ctx, runtime );
+  clear(ctx, runtime);
+  *this = B;
+}
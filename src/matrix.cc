@@ -7,6 +7,125 @@
 #include <math.h>   // for sqrt()
 #include <stdlib.h> // for srand48_r(), lrand48_r() and drand48_r()
 #include <time.h>
+#include <algorithm> // for std::copy() and std::nth_element()
+
+int block_begin(int nrow, int nblk, int i) {
+  assert( nblk>0 && !(nblk & (nblk-1)) );
+  assert( 0<=i && i<=nblk );
+  int begin = 0;
+  while (nblk > 1) {
+    nblk /= 2;
+    if (i < nblk) {
+      nrow = nrow/2;
+    } else {
+      begin += nrow/2;
+      nrow  -= nrow/2;
+      i     -= nblk;
+    }
+  }
+  return begin + i*nrow;
+}
+
+int block_index(int nrow, int nblk, int row) {
+  assert( nblk>0 && !(nblk & (nblk-1)) );
+  assert( 0<=row && row<nrow );
+  int i = 0;
+  while (nblk > 1) {
+    nblk /= 2;
+    if (row < nrow/2) {
+      nrow = nrow/2;
+    } else {
+      row  -= nrow/2;
+      nrow -= nrow/2;
+      i    += nblk;
+    }
+  }
+  return i;
+}
+
+// the direction to split the points idx[0, n) across
+static std::vector<double> split_direction
+(const Matrix& X, const int *idx, int n, bool pca) {
+  int dim = X.cols();
+  std::vector<double> lo(dim), hi(dim), mean(dim, 0.0);
+  for (int k=0; k<dim; k++)
+    lo[k] = hi[k] = X(idx[0], k);
+  for (int i=0; i<n; i++)
+    for (int k=0; k<dim; k++) {
+      double x = X(idx[i], k);
+      lo[k] = std::min(lo[k], x);
+      hi[k] = std::max(hi[k], x);
+      mean[k] += x / n;
+    }
+  int widest = 0;
+  for (int k=1; k<dim; k++)
+    if (hi[k]-lo[k] > hi[widest]-lo[widest])
+      widest = k;
+  std::vector<double> dir(dim, 0.0);
+  dir[widest] = 1.0;
+  if (!pca || dim == 1) return dir;
+
+  // power iteration with the covariance, starting from the
+  //  widest coordinate
+  Matrix C(dim, dim);
+  for (int l=0; l<dim; l++)
+    for (int k=0; k<dim; k++) {
+      C(k, l) = 0.0;
+      for (int i=0; i<n; i++)
+	C(k, l) += (X(idx[i], k)-mean[k]) * (X(idx[i], l)-mean[l]);
+    }
+  std::vector<double> w(dim);
+  for (int it=0; it<50; it++) {
+    double norm = 0.0;
+    for (int k=0; k<dim; k++) {
+      w[k] = 0.0;
+      for (int l=0; l<dim; l++)
+	w[k] += C(k, l) * dir[l];
+      norm += w[k] * w[k];
+    }
+    // all points are the same
+    if (norm == 0.0) break;
+    for (int k=0; k<dim; k++)
+      dir[k] = w[k] / sqrt(norm);
+  }
+  return dir;
+}
+
+// compare points by their projections
+struct ProjectionLess {
+  const std::vector<double>& p;
+  ProjectionLess(const std::vector<double>& p_) : p(p_) {}
+  bool operator() (int a, int b) const { return p[a] < p[b]; }
+};
+
+// split the points idx[0, n) for a subtree with nLevel levels
+static void bisect
+(const Matrix& X, int *idx, int n, int nLevel, bool pca,
+ std::vector<double>& proj) {
+  if (nLevel == 0 || n < 2) return;
+  std::vector<double> dir = split_direction(X, idx, n, pca);
+  for (int i=0; i<n; i++) {
+    proj[idx[i]] = 0.0;
+    for (int k=0; k<X.cols(); k++)
+      proj[idx[i]] += X(idx[i], k) * dir[k];
+  }
+  int n0 = n/2;
+  std::nth_element(idx, idx+n0, idx+n, ProjectionLess(proj));
+  bisect(X, idx,    n0,   nLevel-1, pca, proj);
+  bisect(X, idx+n0, n-n0, nLevel-1, pca, proj);
+}
+
+std::vector<int> cluster_order
+(const Matrix& points, int nLevel, bool pca) {
+  int N = points.rows();
+  assert( N > 0 && points.cols() > 0 && nLevel >= 0 );
+  std::vector<int> perm(N);
+  for (int i=0; i<N; i++)
+    perm[i] = i;
+  std::vector<double> proj(N);
+  bisect(points, &perm[0], N, nLevel, pca, proj);
+  return perm;
+}
 
 Vector::Vector() : nPart(-1), mRows(-1), has_entry(true) {}
 
@@ -50,8 +169,8 @@ double Vector::norm() const {
 
 void Vector::rand(int nPart_, int offset_) {
   this->mOffset = offset_;
-  assert( mRows%nPart == 0 );
   this->nPart = nPart_;
+  assert( nPart>0 && nPart<=mRows );
   struct drand48_data buffer;
   assert( srand48_r( time(NULL)+2, &buffer ) == 0 );
   for (int i=0; i<nPart; i++) {
@@ -62,14 +181,13 @@ void Vector::rand(int nPart_, int offset_) {
 
   // generating random numbers
   if (has_entry) {
-    int count = 0;
-    int colorSize = mRows / nPart;
     for (int i=0; i<nPart; i++) {
       assert( srand48_r( seeds[i], &buffer ) == 0 );
-      for (int j=0; j<colorSize; j++) {
-	assert( drand48_r(&buffer, &data[count]) == 0 );
-	data[count] += offset_;
-	count++;
+      int rlo = block_begin(mRows, nPart, i);
+      int rhi = block_begin(mRows, nPart, i+1);
+      for (int j=rlo; j<rhi; j++) {
+	assert( drand48_r(&buffer, &data[j]) == 0 );
+	data[j] += offset_;
       }
     }
   }
@@ -77,7 +195,6 @@ void Vector::rand(int nPart_, int offset_) {
 
 void Vector::rand(int offset_) {
   assert(mRows>0 && nPart>0);
-  assert(mRows%nPart == 0);
   this->mOffset = offset_;
   struct drand48_data buffer;
   assert( srand48_r( time(NULL)+2, &buffer ) == 0 );
@@ -88,14 +205,13 @@ void Vector::rand(int offset_) {
   }
   // generating random numbers
   if (has_entry) {
-    int count = 0;
-    int blkSize = mRows / nPart;
     for (int i=0; i<nPart; i++) {
       assert( srand48_r( seeds[i], &buffer ) == 0 );
-      for (int j=0; j<blkSize; j++) {
-	assert( drand48_r(&buffer, &data[count]) == 0 );
-	data[count] += mOffset;
-	count++;
+      int rlo = block_begin(mRows, nPart, i);
+      int rhi = block_begin(mRows, nPart, i+1);
+      for (int j=rlo; j<rhi; j++) {
+	assert( drand48_r(&buffer, &data[j]) == 0 );
+	data[j] += mOffset;
       }
     }
   }
@@ -203,6 +319,30 @@ Vector operator * (const double alpha,  const Vector& vec) {
   return temp;
 }
 
+// the partitions of the blocks follow each other, which is
+//  the split of block_begin() since the number of blocks is
+//  a power of two
+Vector Vector::stack(const std::vector<Vector>& blocks) {
+  int n = blocks.size();
+  assert( n>0 && !(n & (n-1)) );
+  const Vector& first = blocks[0];
+  assert( first.nPart>0 );
+  Vector temp(n*first.mRows, first.has_entry);
+  temp.nPart   = n*first.nPart;
+  temp.mOffset = first.mOffset;
+  for (int k=0; k<n; k++) {
+    const Vector& blk = blocks[k];
+    assert( blk.mRows == first.mRows && blk.nPart == first.nPart );
+    assert( blk.mOffset == first.mOffset );
+    assert( blk.has_entry == first.has_entry );
+    temp.seeds.insert(temp.seeds.end(), blk.seeds.begin(), blk.seeds.end());
+    if (temp.has_entry)
+      std::copy(blk.data.begin(), blk.data.end(),
+		temp.data.begin()+k*first.mRows);
+  }
+  return temp;
+}
+
 Matrix::Matrix() : nPart(-1), mRows(-1), mCols(-1), has_entry(true) {}
 
 Matrix::Matrix(int row, int col, bool has)
@@ -222,7 +362,6 @@ Matrix::Matrix(int base, int level, int col, bool has)
     has_entry(has) {
   
   assert( nPart>0 && mRows>0 && mCols>0 );
-  assert( base>col );
   if (has_entry) {
     // allocate memory
     data.resize(mRows*mCols);
@@ -248,8 +387,10 @@ double* Matrix::pointer() {return &data[0];}
 int Matrix::num_partition() const {return nPart;}
 
 void Matrix::rand(int nPart_) {
-  this->nPart = nPart_;
-  assert( mRows%nPart == 0 );
+  this->nPart  = nPart_;
+  this->mLevel = log2(nPart);
+  assert( nPart>0 && nPart<=mRows );
+  assert( nPart == (1<<mLevel) );
   struct drand48_data buffer;
   assert( srand48_r( time(NULL) + lrand48(), &buffer ) == 0 );
   for (int i=0; i<nPart; i++) {
@@ -260,9 +401,10 @@ void Matrix::rand(int nPart_) {
     
   // generating random numbers
   if (has_entry) {
-    int nrow = mRows / nPart;
     for (int k=0; k<nPart; k++) {
-      PtrMatrix pMat(nrow, mCols, mRows, &data[k*nrow]);
+      int rlo = block_begin(mRows, nPart, k);
+      int rhi = block_begin(mRows, nPart, k+1);
+      PtrMatrix pMat(rhi-rlo, mCols, mRows, &data[rlo]);
       pMat.rand( seeds[k] );
     }
   }
@@ -270,7 +412,6 @@ void Matrix::rand(int nPart_) {
 
 void Matrix::rand() {
   assert( nPart>0 && mRows>0 );
-  assert( mRows%nPart == 0 );
   struct drand48_data buffer;
   assert( srand48_r( time(NULL) + lrand48(), &buffer ) == 0 );
   for (int i=0; i<nPart; i++) {
@@ -288,9 +429,10 @@ void Matrix::rand() {
   
   // generating random numbers
   if (has_entry) {
-    int nrow = mRows / nPart;
     for (int k=0; k<nPart; k++) {
-      PtrMatrix pMat(nrow, mCols, mRows, &data[k*nrow]);
+      int rlo = block_begin(mRows, nPart, k);
+      int rhi = block_begin(mRows, nPart, k+1);
+      PtrMatrix pMat(rhi-rlo, mCols, mRows, &data[rlo]);
       pMat.rand( seeds[k] );
     }
   }
@@ -445,3 +587,26 @@ Matrix Matrix::identity(int N) {
     temp(i, i) = 1.0;
   return temp;
 }
+
+Matrix Matrix::stack(const std::vector<Matrix>& blocks) {
+  int n = blocks.size();
+  assert( n>0 && !(n & (n-1)) );
+  const Matrix& first = blocks[0];
+  assert( first.nPart>0 );
+  int nrow = first.mRows;
+  Matrix temp(n*nrow, first.mCols, first.has_entry);
+  temp.nPart  = n*first.nPart;
+  temp.mLevel = log2(temp.nPart);
+  for (int k=0; k<n; k++) {
+    const Matrix& blk = blocks[k];
+    assert( blk.mRows == nrow && blk.mCols == first.mCols );
+    assert( blk.nPart == first.nPart );
+    assert( blk.has_entry == first.has_entry );
+    temp.seeds.insert(temp.seeds.end(), blk.seeds.begin(), blk.seeds.end());
+    if (temp.has_entry)
+      for (int j=0; j<temp.mCols; j++)
+	for (int i=0; i<nrow; i++)
+	  temp(k*nrow+i, j) = blk(i, j);
+  }
+  return temp;
+}
@@ -0,0 +1,150 @@
+#include "node_system.hpp"
+#include "ptr_matrix.hpp"
+#include "small_kernels.hpp"
+#include "lapack_blas.hpp"
+
+#include <assert.h>
+#include <stdlib.h> // for malloc() and free()
+
+// C -= op(A)*B, where A is r x r and B is r x nrhs
+template <typename T>
+static void gemm_sub
+(const SmallKernelsT<T> *small, char transa, int r, int nrhs,
+ const T *A, int LDA, const T *B, int LDB, T *C, int LDC) {
+  if (small && transa == 'n') {
+    small->gemm_nn_sub(r, nrhs, A, LDA, B, LDB, C, LDC);
+    return;
+  }
+  char transb = 'n';
+  T    alpha  = -1.0;
+  T    beta   =  1.0;
+  blas::gemm(&transa, &transb, &r, &nrhs, &r, &alpha,
+	     const_cast<T*>(A), &LDA, const_cast<T*>(B), &LDB,
+	     &beta, C, &LDC);
+}
+
+// eliminate with the factors of M
+template <typename T>
+static void eliminate
+(const SmallKernelsT<T> *small, int r, const T *M, int LDM,
+ const T *ipiv, const T *P, int LDP, const T *Q, int LDQ,
+ char trans, int nrhs, T *B0, int LDB0, T *B1, int LDB1) {
+  if (trans == 't') {
+    // S' = [I, P'; Q', I]: M'*eta0 = B0 - P'*B1, eta1 = B1 - Q'*eta0
+    gemm_sub(small, 't', r, nrhs, P, LDP, B1, LDB1, B0, LDB0);
+    if (small)
+      small->getrs('t', M, LDM, ipiv, nrhs, B0, LDB0);
+    else {
+      PtrMatrixT<T> B(r, nrhs, LDB0, B0);
+      PtrMatrixT<T>(r, r, LDM, const_cast<T*>(M)).solve(B, ipiv, 't');
+    }
+    gemm_sub(small, 't', r, nrhs, Q, LDQ, B0, LDB0, B1, LDB1);
+    return;
+  }
+  // eta0 goes to B1 and eta1 to B0 before the swap
+  gemm_sub(small, 'n', r, nrhs, Q, LDQ, B0, LDB0, B1, LDB1);
+  if (small)
+    small->getrs('n', M, LDM, ipiv, nrhs, B1, LDB1);
+  else {
+    PtrMatrixT<T> B(r, nrhs, LDB1, B1);
+    PtrMatrixT<T>(r, r, LDM, const_cast<T*>(M)).solve(B, ipiv);
+  }
+  gemm_sub(small, 'n', r, nrhs, P, LDP, B1, LDB1, B0, LDB0);
+  for (int j=0; j<nrhs; j++)
+    for (int i=0; i<r; i++) {
+      T temp       = B0[i+j*LDB0];
+      B0[i+j*LDB0] = B1[i+j*LDB1];
+      B1[i+j*LDB1] = temp;
+    }
+}
+
+// M = I - Q*P
+template <typename T>
+static void form_schur
+(const SmallKernelsT<T> *small, int r, const T *P, int LDP,
+ const T *Q, int LDQ, T *M, int LDM) {
+  for (int j=0; j<r; j++) {
+    for (int i=0; i<r; i++)
+      M[i+j*LDM] = 0.0;
+    M[j+j*LDM] = 1.0;
+  }
+  gemm_sub(small, 'n', r, r, Q, LDQ, P, LDP, M, LDM);
+}
+
+template <typename T>
+typename scalar_traits<T>::real node_system_factor
+(int r, T *S, int LDS, T *ipiv, bool single) {
+  const SmallKernelsT<T> *small = small_kernels<T>(r);
+  form_schur(small, r, S+r, LDS, S+r*LDS, LDS, S, LDS);
+  if (small && !single)
+    return small->getrf(S, LDS, ipiv);
+  return PtrMatrixT<T>(r, r, LDS, S).factor(ipiv, single);
+}
+
+template <typename T>
+typename scalar_traits<T>::real node_system_log_det
+(int r, const T *S, int LDS) {
+  return PtrMatrixT<T>(r, r, LDS, const_cast<T*>(S)).log_det_lu();
+}
+
+template <typename T>
+void node_system_solve
+(int r, const T *S, int LDS, const T *ipiv, char trans,
+ int nrhs, T *B0, int LDB0, T *B1, int LDB1) {
+  eliminate(small_kernels<T>(r), r, S, LDS, ipiv, S+r, LDS, S+r*LDS, LDS,
+	    trans, nrhs, B0, LDB0, B1, LDB1);
+}
+
+template <typename T>
+void node_system_solve
+(int r, const T *P, int LDP, const T *Q, int LDQ,
+ int nrhs, T *B0, int LDB0, T *B1, int LDB1) {
+  const SmallKernelsT<T> *small = small_kernels<T>(r);
+  T *M    = (T *) malloc(r * r * sizeof(T));
+  T *ipiv = (T *) malloc(r * sizeof(T));
+  form_schur(small, r, P, LDP, Q, LDQ, M, r);
+  if (small)
+    small->getrf(M, r, ipiv);
+  else
+    PtrMatrixT<T>(r, r, r, M).factor(ipiv);
+  eliminate(small, r, M, r, ipiv, P, LDP, Q, LDQ, 'n',
+	    nrhs, B0, LDB0, B1, LDB1);
+  free(M);
+  free(ipiv);
+}
+
+template double node_system_factor<double>
+(int, double *, int, double *, bool);
+template float node_system_factor<float>
+(int, float *, int, float *, bool);
+template float node_system_factor<complex_float>
+(int, complex_float *, int, complex_float *, bool);
+template double node_system_factor<complex_double>
+(int, complex_double *, int, complex_double *, bool);
+
+template double node_system_log_det<double>
+(int, const double *, int);
+template float node_system_log_det<float>
+(int, const float *, int);
+template float node_system_log_det<complex_float>
+(int, const complex_float *, int);
+template double node_system_log_det<complex_double>
+(int, const complex_double *, int);
+
+template void node_system_solve<double>
+(int, const double *, int, const double *, char, int, double *, int, double *, int);
+template void node_system_solve<float>
+(int, const float *, int, const float *, char, int, float *, int, float *, int);
+template void node_system_solve<complex_float>
+(int, const complex_float *, int, const complex_float *, char, int, complex_float *, int, complex_float *, int);
+template void node_system_solve<complex_double>
+(int, const complex_double *, int, const complex_double *, char, int, complex_double *, int, complex_double *, int);
+
+template void node_system_solve<double>
+(int, const double *, int, const double *, int, int, double *, int, double *, int);
+template void node_system_solve<float>
+(int, const float *, int, const float *, int, int, float *, int, float *, int);
+template void node_system_solve<complex_float>
+(int, const complex_float *, int, const complex_float *, int, int, complex_float *, int, complex_float *, int);
+template void node_system_solve<complex_double>
+(int, const complex_double *, int, const complex_double *, int, int, complex_double *, int, complex_double *, int);
@@ -2,25 +2,30 @@
 #include "utility.hpp"
 
 #include <assert.h>
+#include <math.h>   // for log() and fabs()
 #include <stdlib.h> // for srand48_r(), lrand48_r() and drand48_r()
 
-PtrMatrix::PtrMatrix()
+template <typename T>
+PtrMatrixT<T>::PtrMatrixT()
   : mRows(-1), mCols(-1), leadD(-1), ptr(NULL),
     has_memory(false), trans('n') {}
 
-PtrMatrix::PtrMatrix(int r, int c)
+template <typename T>
+PtrMatrixT<T>::PtrMatrixT(int r, int c)
   : mRows(r), mCols(c), leadD(r),
     has_memory(true), trans('n') {
-  ptr = new double[mRows*mCols];
+  ptr = new T[mRows*mCols];
 }
 
-PtrMatrix::PtrMatrix(int r, int c, int l, double *p, char trans_)
+template <typename T>
+PtrMatrixT<T>::PtrMatrixT(int r, int c, int l, T *p, char trans_)
   : mRows(r), mCols(c), leadD(l), ptr(p),
     has_memory(false), trans(trans_) {
   assert(trans_ == 't' || trans_ == 'n');
 }
 
-PtrMatrix::~PtrMatrix() {
+template <typename T>
+PtrMatrixT<T>::~PtrMatrixT() {
   if (has_memory)
     delete[] ptr;
   ptr = NULL;
@@ -28,49 +33,79 @@ PtrMatrix::~PtrMatrix() {
 
 // legion uses column major storage,
 //  which is consistant with blas and lapack layout
-double PtrMatrix::operator()(int r, int c) const {
+template <typename T>
+T PtrMatrixT<T>::operator()(int r, int c) const {
   return ptr[r+c*leadD];
 }
 
-double& PtrMatrix::operator()(int r, int c) {
+template <typename T>
+T& PtrMatrixT<T>::operator()(int r, int c) {
   return ptr[r+c*leadD];
 }
 
-double* PtrMatrix::pointer() const {return ptr;}
+template <typename T>
+T* PtrMatrixT<T>::pointer() const {return ptr;}
 
-double* PtrMatrix::pointer(int r, int c) {
+template <typename T>
+T* PtrMatrixT<T>::pointer(int r, int c) {
   return &ptr[r+c*leadD];
 }
 
-void PtrMatrix::set_trans(char trans_) {
+template <typename T>
+void PtrMatrixT<T>::set_trans(char trans_) {
   assert(trans_ == 't' || trans_ == 'n');
   this->trans=trans_;
 }
 
-void PtrMatrix::clear(double value) {
+template <typename T>
+void PtrMatrixT<T>::clear(T value) {
   for (int j=0; j<mCols; j++)
     for (int i=0; i<mRows; i++)
       (*this)(i, j) = value;
 }
 
-void PtrMatrix::scale(double alpha) {
+template <typename T>
+void PtrMatrixT<T>::scale(T alpha) {
   for (int j=0; j<mCols; j++)
     for (int i=0; i<mRows; i++)
       (*this)(i, j) *= alpha;
 }
 
-void PtrMatrix::rand(long seed, int offset) {
+// a random entry in [offset, offset+1), and the imaginary
+//  part in [0, 1) for complex types
+static void rand_entry(struct drand48_data *buffer, int offset, double& x) {
+  assert( drand48_r(buffer, &x) == 0 );
+  x += offset;
+}
+
+static void rand_entry(struct drand48_data *buffer, int offset, float& x) {
+  double y;
+  rand_entry(buffer, offset, y);
+  x = y;
+}
+
+template <typename U>
+static void rand_entry
+(struct drand48_data *buffer, int offset, std::complex<U>& x) {
+  double re, im;
+  rand_entry(buffer, offset, re);
+  rand_entry(buffer, 0, im);
+  x = std::complex<U>(re, im);
+}
+
+template <typename T>
+void PtrMatrixT<T>::rand(long seed, int offset) {
   struct drand48_data buffer;
   assert( srand48_r( seed, &buffer ) == 0 );
   for (int i=0; i<mRows; i++) {
     for (int j=0; j<mCols; j++) {
-      assert( drand48_r(&buffer, this->pointer(i,j) ) == 0 );
-      (*this)(i,j) += offset;
+      rand_entry(&buffer, offset, (*this)(i,j));
     }
   }
 }
 
-void PtrMatrix::display(const std::string& name) {
+template <typename T>
+void PtrMatrixT<T>::display(const std::string& name) {
   std::cout << name << ":" << std::endl;
   for(int ri = 0; ri < mRows; ri++) {
     for(int ci = 0; ci < mCols; ci++) {
@@ -80,9 +115,11 @@ void PtrMatrix::display(const std::string& name) {
   }
 }
 
-int PtrMatrix::LD() const {return leadD;}
+template <typename T>
+int PtrMatrixT<T>::LD() const {return leadD;}
 
-int PtrMatrix::rows() const {
+template <typename T>
+int PtrMatrixT<T>::rows() const {
   switch (trans) {
   case 'n': return mRows; break;
   case 't': return mCols; break;
@@ -90,7 +127,8 @@ int PtrMatrix::rows() const {
   }
 }
 
-int PtrMatrix::cols() const {
+template <typename T>
+int PtrMatrixT<T>::cols() const {
   switch (trans) {
   case 't': return mRows; break;
   case 'n': return mCols; break;
@@ -98,15 +136,16 @@ int PtrMatrix::cols() const {
   }
 }
 
-void PtrMatrix::solve(PtrMatrix& B) {
+template <typename T>
+void PtrMatrixT<T>::solve(PtrMatrixT<T>& B) {
   int N = this->mRows;
   int NRHS = B.cols();
   int LDA = leadD;
   int LDB = B.LD();
   int IPIV[N];
   int INFO;
-  lapack::dgesv_(&N, &NRHS, ptr, &LDA, IPIV,
-		 B.pointer(), &LDB, &INFO);
+  lapack::gesv(&N, &NRHS, ptr, &LDA, IPIV,
+	       B.pointer(), &LDB, &INFO);
   assert(INFO==0);
   /*
   std::cout << "Permutation:" << std::endl;
@@ -116,17 +155,258 @@ void PtrMatrix::solve(PtrMatrix& B) {
   */
 }
 
-void PtrMatrix::identity() {
+template <typename T>
+void PtrMatrixT<T>::to_single(low *A) const {
+  for (int j=0; j<mCols; j++)
+    for (int i=0; i<mRows; i++)
+      A[i+j*mRows] = low(ptr[i+j*leadD]);
+}
+
+template <typename T>
+void PtrMatrixT<T>::from_single(const low *A) {
+  for (int j=0; j<mCols; j++)
+    for (int i=0; i<mRows; i++)
+      ptr[i+j*leadD] = T(A[i+j*mRows]);
+}
+
+// pivots are stored in the real part of a scalar
+template <typename T>
+static int pivot(T p) {
+  return int(scalar_traits<T>::real_part(p));
+}
+
+template <typename T>
+typename PtrMatrixT<T>::real PtrMatrixT<T>::factor(T *ipiv, bool single) {
+  int N = this->mRows;
+  int LDA = leadD;
+  int IPIV[N];
+  int INFO;
+  assert(mRows==mCols);
+  if (single) {
+    low *A = new low[N*N];
+    to_single(A);
+    lapack::getrf(&N, &N, A, &N, IPIV, &INFO);
+    from_single(A);
+    delete[] A;
+  } else
+    lapack::getrf(&N, &N, ptr, &LDA, IPIV, &INFO);
+  assert(INFO==0);
+  for (int i=0; i<N; i++)
+    ipiv[i] = T(IPIV[i]);
+  return log_det_lu();
+}
+
+template <typename T>
+typename PtrMatrixT<T>::real PtrMatrixT<T>::log_det_lu() const {
+  real logdet = 0.0;
+  for (int i=0; i<mRows; i++)
+    logdet += log(scalar_traits<T>::abs(ptr[i+i*leadD]));
+  return logdet;
+}
+
+template <typename T>
+void PtrMatrixT<T>::solve(PtrMatrixT<T>& B, const T *ipiv, char trans) {
+  char TRANS = trans;
+  int N = this->mRows;
+  int NRHS = B.cols();
+  int LDA = leadD;
+  int LDB = B.LD();
+  int IPIV[N];
+  int INFO;
+  for (int i=0; i<N; i++)
+    IPIV[i] = pivot(ipiv[i]);
+  lapack::getrs(&TRANS, &N, &NRHS, ptr, &LDA, IPIV,
+		B.pointer(), &LDB, &INFO);
+  assert(INFO==0);
+}
+
+template <typename T>
+typename PtrMatrixT<T>::real PtrMatrixT<T>::factor_cholesky(bool single) {
+  char UPLO = 'L';
+  int N = this->mRows;
+  int LDA = leadD;
+  int INFO;
+  assert(mRows==mCols);
+  if (single) {
+    low *A = new low[N*N];
+    to_single(A);
+    lapack::potrf(&UPLO, &N, A, &N, &INFO);
+    from_single(A);
+    delete[] A;
+  } else
+    lapack::potrf(&UPLO, &N, ptr, &LDA, &INFO);
+  assert(INFO==0);
+  return log_det_cholesky();
+}
+
+template <typename T>
+typename PtrMatrixT<T>::real PtrMatrixT<T>::log_det_cholesky() const {
+  real logdet = 0.0;
+  for (int i=0; i<mRows; i++)
+    logdet += 2.0*log(scalar_traits<T>::real_part(ptr[i+i*leadD]));
+  return logdet;
+}
+
+template <typename T>
+void PtrMatrixT<T>::solve_cholesky(PtrMatrixT<T>& B) {
+  char UPLO = 'L';
+  int N = this->mRows;
+  int NRHS = B.cols();
+  int LDA = leadD;
+  int LDB = B.LD();
+  int INFO;
+  lapack::potrs(&UPLO, &N, &NRHS, ptr, &LDA,
+		B.pointer(), &LDB, &INFO);
+  assert(INFO==0);
+}
+
+// op(L) is L' for trans='t', which is the conjugate transpose
+//  for a Hermitian matrix
+template <typename T>
+static void triangular
+(bool solve, const T *L, int N, int LDA, char trans, PtrMatrixT<T>& B) {
+  char SIDE = 'L';
+  char UPLO = 'L';
+  char TRANSA = trans == 'n' ? 'N' : 'C';
+  char DIAG = 'N';
+  int NRHS = B.cols();
+  int LDB = B.LD();
+  T alpha = 1.0;
+  assert(B.rows() == N);
+  if (solve)
+    blas::trsm(&SIDE, &UPLO, &TRANSA, &DIAG, &N, &NRHS, &alpha,
+	       const_cast<T*>(L), &LDA, B.pointer(), &LDB);
+  else
+    blas::trmm(&SIDE, &UPLO, &TRANSA, &DIAG, &N, &NRHS, &alpha,
+	       const_cast<T*>(L), &LDA, B.pointer(), &LDB);
+}
+
+template <typename T>
+void PtrMatrixT<T>::multiply_triangular(PtrMatrixT<T>& B, char trans) {
+  triangular(false, ptr, mRows, leadD, trans, B);
+}
+
+template <typename T>
+void PtrMatrixT<T>::solve_triangular(PtrMatrixT<T>& B, char trans) {
+  triangular(true, ptr, mRows, leadD, trans, B);
+}
+
+// the block diagonal D has 1x1 blocks and 2x2 blocks, marked by
+//  negative pivots, in the diagonal and the subdiagonal
+template <typename T>
+static typename scalar_traits<T>::real log_det_ldl
+(const T *A, int N, int LDA, const int *IPIV) {
+  typename scalar_traits<T>::real logdet = 0.0;
+  for (int i=0; i<N; i++) {
+    if (IPIV[i] > 0)
+      logdet += log(scalar_traits<T>::abs(A[i+i*LDA]));
+    else {
+      T a = A[i+i*LDA], b = A[i+1+i*LDA], c = A[i+1+(i+1)*LDA];
+      logdet += log(scalar_traits<T>::abs(a*c-b*b));
+      i++;
+    }
+  }
+  return logdet;
+}
+
+// LDL' of A (or of a copy) with the workspace query
+template <typename T>
+static void ldl(char *UPLO, int *N, T *A, int *LDA, int *IPIV) {
+  int INFO;
+  T lwork;
+  int LWORK = -1;
+  lapack::sytrf(UPLO, N, A, LDA, IPIV, &lwork, &LWORK, &INFO);
+  assert(INFO==0);
+  LWORK = scalar_traits<T>::real_part(lwork);
+  T *WORK = new T[LWORK];
+  lapack::sytrf(UPLO, N, A, LDA, IPIV, WORK, &LWORK, &INFO);
+  assert(INFO==0);
+  delete[] WORK;
+}
+
+template <typename T>
+typename PtrMatrixT<T>::real PtrMatrixT<T>::factor_symmetric
+(T *ipiv, bool single) {
+  char UPLO = 'L';
+  int N = this->mRows;
+  int LDA = leadD;
+  int IPIV[N];
+  assert(mRows==mCols);
+  if (single) {
+    low *A = new low[N*N];
+    to_single(A);
+    ldl(&UPLO, &N, A, &N, IPIV);
+    from_single(A);
+    delete[] A;
+  } else
+    ldl(&UPLO, &N, ptr, &LDA, IPIV);
+  for (int i=0; i<N; i++)
+    ipiv[i] = T(IPIV[i]);
+  return log_det_ldl(ptr, N, LDA, IPIV);
+}
+
+template <typename T>
+typename PtrMatrixT<T>::real PtrMatrixT<T>::log_det_symmetric
+(const T *ipiv) const {
+  int N = this->mRows;
+  int IPIV[N];
+  for (int i=0; i<N; i++)
+    IPIV[i] = pivot(ipiv[i]);
+  return log_det_ldl(ptr, N, leadD, IPIV);
+}
+
+template <typename T>
+void PtrMatrixT<T>::solve_symmetric(PtrMatrixT<T>& B, const T *ipiv) {
+  char UPLO = 'L';
+  int N = this->mRows;
+  int NRHS = B.cols();
+  int LDA = leadD;
+  int LDB = B.LD();
+  int IPIV[N];
+  int INFO;
+  for (int i=0; i<N; i++)
+    IPIV[i] = pivot(ipiv[i]);
+  lapack::sytrs(&UPLO, &N, &NRHS, ptr, &LDA, IPIV,
+		B.pointer(), &LDB, &INFO);
+  assert(INFO==0);
+}
+
+template <typename T>
+void PtrMatrixT<T>::orthonormalize() {
+  int M = this->mRows;
+  int N = this->mCols;
+  int LDA = leadD;
+  int INFO;
+  assert(M>=N);
+  // workspace query
+  T lwork;
+  int LWORK = -1;
+  T TAU[N];
+  lapack::geqrf(&M, &N, ptr, &LDA, TAU, &lwork, &LWORK, &INFO);
+  assert(INFO==0);
+  LWORK = scalar_traits<T>::real_part(lwork);
+  T *WORK = new T[LWORK];
+  lapack::geqrf(&M, &N, ptr, &LDA, TAU, WORK, &LWORK, &INFO);
+  assert(INFO==0);
+  lapack::orgqr(&M, &N, &N, ptr, &LDA, TAU, WORK, &LWORK, &INFO);
+  assert(INFO==0);
+  delete[] WORK;
+}
+
+template <typename T>
+void PtrMatrixT<T>::identity() {
   assert(mRows==mCols);
   assert(mRows==leadD);
-  memset(ptr, 0, mRows*mCols*sizeof(double)); // initialize to 0's
+  for (int i=0; i<mRows*mCols; i++)
+    ptr[i] = T(0.0); // initialize to 0's
   for (int i=0; i<mRows; i++)
-    (*this)(i, i) = 1.0;
+    (*this)(i, i) = T(1.0);
 }
 
-void PtrMatrix::add
-  (double alpha, const PtrMatrix& A,
-   double beta,  const PtrMatrix& B, PtrMatrix& C) {
+template <typename T>
+void PtrMatrixT<T>::add
+  (T alpha, const PtrMatrixT<T>& A,
+   T beta,  const PtrMatrixT<T>& B, PtrMatrixT<T>& C) {
 
   assert(A.rows() == B.rows() && A.rows() == C.rows());
   assert(A.rows() == B.rows() && A.rows() == C.rows());
@@ -138,9 +418,21 @@ void PtrMatrix::add
     }
 }
 
-void PtrMatrix::gemm
-(const PtrMatrix& U, const PtrMatrix& V, const PtrMatrix& D,
- PtrMatrix& res) {
+template <typename T>
+T PtrMatrixT<T>::dot(const PtrMatrixT<T>& A, const PtrMatrixT<T>& B) {
+
+  assert(A.rows() == B.rows() && A.cols() == B.cols());
+  T sum = 0.0;
+  for (int j=0; j<A.cols(); j++)
+    for (int i=0; i<A.rows(); i++)
+      sum += scalar_traits<T>::conj(A(i,j))*B(i,j);
+  return sum;
+}
+
+template <typename T>
+void PtrMatrixT<T>::gemm
+(const PtrMatrixT<T>& U, const PtrMatrixT<T>& V, const PtrMatrixT<T>& D,
+ PtrMatrixT<T>& res) {
   assert(U.cols() == V.rows());
   char transa = U.trans;
   char transb = V.trans;
@@ -150,12 +442,12 @@ void PtrMatrix::gemm
   int  LDA = U.LD();
   int  LDB = V.LD();
   int  LDC = res.LD();
-  double alpha = 1.0, beta = 0.0;
-  //double alpha = 0.0, beta = 0.0;
-  blas::dgemm_(&transa, &transb, &M, &N, &K,
-	       &alpha, U.pointer(), &LDA,
-	       V.pointer(), &LDB,
-	       &beta, res.pointer(), &LDC);
+  T alpha = 1.0, beta = 0.0;
+  //T alpha = 0.0, beta = 0.0;
+  blas::gemm(&transa, &transb, &M, &N, &K,
+	     &alpha, U.pointer(), &LDA,
+	     V.pointer(), &LDB,
+	     &beta, res.pointer(), &LDC);
 
   // add the diagonal
   assert(res.rows() == res.cols());
@@ -163,9 +455,10 @@ void PtrMatrix::gemm
     res(i, i) += D(i, 0);
 }
   
-void PtrMatrix::gemm
-(double alpha, const PtrMatrix& U, const PtrMatrix& V,
- PtrMatrix& W) {
+template <typename T>
+void PtrMatrixT<T>::gemm
+(T alpha, const PtrMatrixT<T>& U, const PtrMatrixT<T>& V,
+ PtrMatrixT<T>& W) {
   assert(U.cols() == V.rows());
   assert(U.rows() == W.rows());
   assert(V.cols() == W.cols());
@@ -177,16 +470,17 @@ void PtrMatrix::gemm
   int  LDA = U.LD();
   int  LDB = V.LD();
   int  LDC = W.LD();
-  double beta = 1.0;
-  blas::dgemm_(&transa, &transb, &M, &N, &K,
-	       &alpha, U.pointer(), &LDA,
-	       V.pointer(), &LDB,
-	       &beta, W.pointer(), &LDC);
+  T beta = 1.0;
+  blas::gemm(&transa, &transb, &M, &N, &K,
+	     &alpha, U.pointer(), &LDA,
+	     V.pointer(), &LDB,
+	     &beta, W.pointer(), &LDC);
 }
 
-void PtrMatrix::gemm
-(double alpha, const PtrMatrix& U, const PtrMatrix& V,
- double beta, PtrMatrix& W) {
+template <typename T>
+void PtrMatrixT<T>::gemm
+(T alpha, const PtrMatrixT<T>& U, const PtrMatrixT<T>& V,
+ T beta, PtrMatrixT<T>& W) {
   assert(U.cols() == V.rows());
   assert(U.rows() == W.rows());
   assert(V.cols() == W.cols());
@@ -198,8 +492,14 @@ void PtrMatrix::gemm
   int  LDA = U.LD();
   int  LDB = V.LD();
   int  LDC = W.LD();
-  blas::dgemm_(&transa, &transb, &M, &N, &K,
-	       &alpha, U.pointer(), &LDA,
-	       V.pointer(), &LDB,
-	       &beta, W.pointer(), &LDC);
+  blas::gemm(&transa, &transb, &M, &N, &K,
+	     &alpha, U.pointer(), &LDA,
+	     V.pointer(), &LDB,
+	     &beta, W.pointer(), &LDC);
 }
+
+// the scalar types with blas and lapack routines
+template class PtrMatrixT<float>;
+template class PtrMatrixT<double>;
+template class PtrMatrixT<complex_float>;
+template class PtrMatrixT<complex_double>;
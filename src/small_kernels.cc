@@ -0,0 +1,142 @@
+#include "small_kernels.hpp"
+
+#include <assert.h>
+#include <math.h> // for log() and fabs()
+
+// N is the size of the Schur complement for rank R
+//  (see node_system.hpp)
+template <int R>
+struct RankKernels {
+  static const int N = R;
+
+  static double getrf(double *A, int LDA, double *ipiv) {
+    double logdet = 0.0;
+    for (int k=0; k<N; k++) {
+      int p = k;
+      for (int i=k+1; i<N; i++)
+	if (fabs(A[i+k*LDA]) > fabs(A[p+k*LDA])) p = i;
+      ipiv[k] = p+1;
+      if (p != k)
+	for (int j=0; j<N; j++) {
+	  double temp  = A[k+j*LDA];
+	  A[k+j*LDA] = A[p+j*LDA];
+	  A[p+j*LDA] = temp;
+	}
+      double pivot = A[k+k*LDA];
+      assert(pivot != 0.0);
+      logdet += log(fabs(pivot));
+      for (int i=k+1; i<N; i++)
+	A[i+k*LDA] /= pivot;
+      for (int j=k+1; j<N; j++) {
+	double a = A[k+j*LDA];
+	for (int i=k+1; i<N; i++)
+	  A[i+j*LDA] -= A[i+k*LDA] * a;
+      }
+    }
+    return logdet;
+  }
+
+  static void getrs
+  (char trans, const double *A, int LDA, const double *ipiv,
+   int nrhs, double *B, int LDB) {
+    for (int j=0; j<nrhs; j++) {
+      double x[N];
+      for (int i=0; i<N; i++)
+	x[i] = B[i+j*LDB];
+      if (trans == 'n' || trans == 'N') {
+	// P*L*U*x = b
+	for (int k=0; k<N; k++) {
+	  int p = ipiv[k]-1;
+	  double temp = x[k]; x[k] = x[p]; x[p] = temp;
+	}
+	for (int k=0; k<N; k++)
+	  for (int i=k+1; i<N; i++)
+	    x[i] -= A[i+k*LDA] * x[k];
+	for (int k=N-1; k>=0; k--) {
+	  x[k] /= A[k+k*LDA];
+	  for (int i=0; i<k; i++)
+	    x[i] -= A[i+k*LDA] * x[k];
+	}
+      } else {
+	// U'*L'*P'*x = b
+	for (int k=0; k<N; k++) {
+	  for (int i=0; i<k; i++)
+	    x[k] -= A[i+k*LDA] * x[i];
+	  x[k] /= A[k+k*LDA];
+	}
+	for (int k=N-1; k>=0; k--)
+	  for (int i=k+1; i<N; i++)
+	    x[k] -= A[i+k*LDA] * x[i];
+	for (int k=N-1; k>=0; k--) {
+	  int p = ipiv[k]-1;
+	  double temp = x[k]; x[k] = x[p]; x[p] = temp;
+	}
+      }
+      for (int i=0; i<N; i++)
+	B[i+j*LDB] = x[i];
+    }
+  }
+
+  static void gemm_tn
+  (int n, int nrhs, const double *A, int LDA, const double *B, int LDB,
+   double *C, int LDC) {
+    for (int j=0; j<nrhs; j++) {
+      double c[R] = {0.0};
+      for (int i=0; i<n; i++) {
+	double b = B[i+j*LDB];
+	for (int l=0; l<R; l++)
+	  c[l] += A[i+l*LDA] * b;
+      }
+      for (int l=0; l<R; l++)
+	C[l+j*LDC] = c[l];
+    }
+  }
+
+  static void gemm_nn_sub
+  (int n, int nrhs, const double *A, int LDA, const double *B, int LDB,
+   double *C, int LDC) {
+    for (int j=0; j<nrhs; j++) {
+      double b[R];
+      for (int l=0; l<R; l++)
+	b[l] = B[l+j*LDB];
+      for (int i=0; i<n; i++) {
+	double c = 0.0;
+	for (int l=0; l<R; l++)
+	  c += A[i+l*LDA] * b[l];
+	C[i+j*LDC] -= c;
+      }
+    }
+  }
+};
+
+// fill the table from rank R down to 1
+template <int R>
+struct FillTable {
+  static void fill(SmallKernels *table) {
+    SmallKernels k = {RankKernels<R>::getrf, RankKernels<R>::getrs,
+		      RankKernels<R>::gemm_tn, RankKernels<R>::gemm_nn_sub};
+    table[R] = k;
+    FillTable<R-1>::fill(table);
+  }
+};
+
+template <>
+struct FillTable<0> {
+  static void fill(SmallKernels *) {}
+};
+
+struct KernelTable {
+  SmallKernels table[MAX_SMALL_RANK+1];
+  KernelTable() {
+    FillTable<MAX_SMALL_RANK>::fill(table);
+  }
+};
+
+static const KernelTable kernel_table;
+
+const SmallKernels* small_kernels(int r) {
+  assert(r > 0);
+  if (r > MAX_SMALL_RANK)
+    return NULL;
+  return &kernel_table.table[r];
+}
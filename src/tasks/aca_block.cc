@@ -0,0 +1,161 @@
+#include "aca_block.hpp"
+#include "ptr_matrix.hpp"
+
+#include "utility.hpp" // for FIELDID_V and entry_func()
+#include <assert.h>
+#include <math.h>
+#include <vector>
+
+static Realm::Logger log_solver_tasks("solver_tasks");
+
+int aca(EntryFunc entry, const int *rows, const int *cols, double tol,
+	PtrMatrix& U, PtrMatrix& V, bool *converged);
+
+int AcaBlockTask::TASKID;
+
+AcaBlockTask::AcaBlockTask(Domain domain,
+			   TaskArgument global_arg,
+			   ArgumentMap arg_map,
+			   MappingTagID tag,
+			   Predicate pred,
+			   bool must,
+			   MapperID id)
+  
+  : IndexLauncher(TASKID, domain, global_arg,
+		  arg_map, pred, must, id, tag) {}
+
+void AcaBlockTask::register_tasks(void)
+{
+  TASKID = HighLevelRuntime::register_legion_task
+    <AcaBlockTask::cpu_task>(AUTO_GENERATE_ID,
+			     Processor::LOC_PROC, 
+			     false,
+			     true,
+			     AUTO_GENERATE_ID,
+			     TaskConfigOptions(true/*leaf*/),
+			     "ACA_Block");
+
+#ifdef SHOW_REGISTER_TASKS
+  printf("Register task %d : ACA_Block\n", TASKID);
+#endif
+}
+
+// regions: rows of the child in U and rows of its sibling in V,
+//  and optionally the indices of both rows in the permutation
+void AcaBlockTask::cpu_task(const Task *task,
+			    const std::vector<PhysicalRegion> &regions,
+			    Context ctx, HighLevelRuntime *runtime) {
+
+  assert(regions.size() == 2 || regions.size() == 4);
+  assert(task->regions.size() == regions.size());
+  assert(task->arglen == sizeof(TaskArgs));
+  log_solver_tasks.print("Inside ACA block tasks.");
+
+  const TaskArgs args = *((const TaskArgs*)task->args);
+  Rect<2> Urect = region_bounds(regions[0], ctx, runtime);
+  Rect<2> Vrect = region_bounds(regions[1], ctx, runtime);
+  int rlo = Urect.lo[0];
+  int rhi = Urect.hi[0] + 1;
+  int clo = Vrect.lo[0];
+  int chi = Vrect.hi[0] + 1;
+  PtrMatrix U = get_raw_pointer(regions[0], rlo, rhi,
+				args.ucol, args.ucol+args.rank);
+  PtrMatrix V = get_raw_pointer(regions[1], clo, chi,
+				args.vcol, args.vcol+args.rank);
+  // the entry indices of the rows and the columns
+  std::vector<int> rows(rhi-rlo), cols(chi-clo);
+  for (int i=0; i<rhi-rlo; i++)
+    rows[i] = rlo+i;
+  for (int j=0; j<chi-clo; j++)
+    cols[j] = clo+j;
+  if (regions.size() == 4) {
+    PtrMatrix P = get_raw_pointer(regions[2], rlo, rhi, 0, 1);
+    PtrMatrix Q = get_raw_pointer(regions[3], clo, chi, 0, 1);
+    for (int i=0; i<rhi-rlo; i++)
+      rows[i] = int(P(i, 0));
+    for (int j=0; j<chi-clo; j++)
+      cols[j] = int(Q(j, 0));
+  }
+  U.clear(0.0);
+  V.clear(0.0);
+  bool converged;
+  int rank = aca(entry_func(args.func), &rows[0], &cols[0], args.tol, U, V,
+		 &converged);
+  if (!converged)
+    log_solver_tasks.print("ACA block (%d, %d) may not reach the tolerance "
+			   "with rank %d.", rlo, clo, rank);
+}
+
+// Adaptive cross approximation with partial pivoting of the block
+//  A(i, j) = entry(rows[i], cols[j]) ~ U * V', using at most U.cols()
+//  crosses; returns the number of crosses. It stops when the last
+//  cross is below tol times the (estimated) norm of U * V', and
+//  converged is false if it stops on U.cols() crosses instead.
+int aca(EntryFunc entry, const int *rows, const int *cols, double tol,
+	PtrMatrix& U, PtrMatrix& V, bool *converged) {
+  int m = U.rows();
+  int n = V.rows();
+  int r = U.cols();
+  assert(V.cols() == r);
+  std::vector<bool> used(m, false);
+  double norm2 = 0.0;
+  int i0 = 0;
+  int k  = 0;
+  *converged = true;
+  while (k < r) {
+    // residual row i0
+    used[i0] = true;
+    int j0 = 0;
+    for (int j=0; j<n; j++) {
+      double a = entry(rows[i0], cols[j]);
+      for (int l=0; l<k; l++)
+	a -= U(i0, l) * V(j, l);
+      V(j, k) = a;
+      if (fabs(a) > fabs(V(j0, k)))
+	j0 = j;
+    }
+    double pivot = V(j0, k);
+    if (pivot == 0.0) {
+      // the row is already approximated; try another one
+      for (i0=0; i0<m && used[i0]; i0++);
+      if (i0 == m) {
+	*converged = true;
+	break;
+      }
+      continue;
+    }
+    // residual column j0
+    for (int j=0; j<n; j++)
+      V(j, k) /= pivot;
+    for (int i=0; i<m; i++) {
+      double a = entry(rows[i], cols[j0]);
+      for (int l=0; l<k; l++)
+	a -= U(i, l) * V(j0, l);
+      U(i, k) = a;
+    }
+    // update the norm of U * V'
+    double u2 = 0.0, v2 = 0.0;
+    for (int i=0; i<m; i++) u2 += U(i, k) * U(i, k);
+    for (int j=0; j<n; j++) v2 += V(j, k) * V(j, k);
+    for (int l=0; l<k; l++) {
+      double uu = 0.0, vv = 0.0;
+      for (int i=0; i<m; i++) uu += U(i, l) * U(i, k);
+      for (int j=0; j<n; j++) vv += V(j, l) * V(j, k);
+      norm2 += 2.0 * uu * vv;
+    }
+    norm2 += u2 * v2;
+    k++;
+    *converged = sqrt(u2 * v2) <= tol * sqrt(norm2);
+    if (*converged) break;
+    // next row: the largest entry of the new column
+    i0 = -1;
+    for (int i=0; i<m; i++)
+      if (!used[i] && (i0 < 0 || fabs(U(i, k-1)) > fabs(U(i0, k-1))))
+	i0 = i;
+    if (i0 < 0) {
+      *converged = true;
+      break;
+    }
+  }
+  return k;
+}
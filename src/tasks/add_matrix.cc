@@ -35,24 +35,29 @@ void AddMatrixTask::cpu_task(const Task *task,
 			     const std::vector<PhysicalRegion> &regions,
 			     Context ctx, HighLevelRuntime *runtime) {
 
-  assert(regions.size() == 3);
-  assert(task->regions.size() == 3);
+  // two regions for C = alpha*C + beta*B (see LMatrix::add())
+  assert(regions.size() == 3 || regions.size() == 2);
+  assert(task->regions.size() == regions.size());
   assert(task->arglen == sizeof(TaskArgs));
 
-  Point<1> p = task->index_point.get_point<1>();
-  //printf("point = %d\n", p[0]);
-
   const TaskArgs args = *((const TaskArgs*)task->args);
-  int rblk = args.nrow;
   int cols = args.cols;
   double alpha = args.alpha;
   double beta  = args.beta;
 
-  int rlo = p[0]*rblk;
-  int rhi = (p[0] + 1) * rblk;
+  // the rows of this partition (see block_begin())
+  Rect<2> rect = region_bounds(regions[0], ctx, runtime);
+  int rlo = rect.lo[0];
+  int rhi = rect.hi[0] + 1;
   
-  PtrMatrix AMat = get_raw_pointer(regions[0], rlo, rhi, 0, cols);
-  PtrMatrix BMat = get_raw_pointer(regions[1], rlo, rhi, 0, cols);
-  PtrMatrix CMat = get_raw_pointer(regions[2], rlo, rhi, 0, cols);
+  const PhysicalRegion& CReg = regions.back();
+  const PhysicalRegion& AReg = regions.size() == 3 ? regions[0] : CReg;
+  const PhysicalRegion& BReg = regions[regions.size()-2];
+  PtrMatrix AMat = get_raw_pointer(AReg, rlo, rhi, args.AcolIdx,
+				   args.AcolIdx+cols);
+  PtrMatrix BMat = get_raw_pointer(BReg, rlo, rhi, args.BcolIdx,
+				   args.BcolIdx+cols);
+  PtrMatrix CMat = get_raw_pointer(CReg, rlo, rhi, args.CcolIdx,
+				   args.CcolIdx+cols);
   PtrMatrix::add(alpha, AMat, beta, BMat, CMat);
 }
@@ -38,17 +38,15 @@ void ClearMatrixTask::cpu_task(const Task *task,
   assert(task->regions.size() == 1);
   assert(task->arglen == sizeof(TaskArgs));
 
-  Point<1> p = task->index_point.get_point<1>();
-  //printf("point = %d\n", p[0]);
-
   const TaskArgs args = *((const TaskArgs*)task->args);
-  int rblk  = args.rblock;
   int cols  = args.cols;
   double value = args.value;
 
-  int rlo = p[0]*rblk;
-  int rhi = (p[0] + 1) * rblk;
-  //double *base = region_pointer(regions[0], rlo, rhi, 0, cols);
-  PtrMatrix A = get_raw_pointer(regions[0], rlo, rhi, 0, cols);
+  // the rows of this partition (see block_begin())
+  Rect<2> rect = region_bounds(regions[0], ctx, runtime);
+  int rlo = rect.lo[0];
+  int rhi = rect.hi[0] + 1;
+  PtrMatrix A = get_raw_pointer(regions[0], rlo, rhi, args.colIdx,
+				args.colIdx+cols);
   A.clear(value);
 }
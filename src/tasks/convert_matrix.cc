@@ -0,0 +1,77 @@
+#include "convert_matrix.hpp"
+#include "ptr_matrix.hpp"
+#include "utility.hpp"
+
+int ConvertMatrixTask::TASKID;
+
+ConvertMatrixTask::ConvertMatrixTask(Domain domain,
+				     TaskArgument global_arg,
+				     ArgumentMap arg_map,
+				     Predicate pred,
+				     bool must,
+				     MapperID id,
+				     MappingTagID tag)
+  
+  : IndexLauncher(TASKID, domain, global_arg,
+		  arg_map, pred, must, id, tag) {}
+
+void ConvertMatrixTask::register_tasks(void)
+{
+  TASKID = HighLevelRuntime::register_legion_task
+    <ConvertMatrixTask::cpu_task>(AUTO_GENERATE_ID,
+				Processor::LOC_PROC, 
+				false,
+				true,
+				AUTO_GENERATE_ID,
+				TaskConfigOptions(true/*leaf*/),
+				"convert_matrix");
+
+#ifdef SHOW_REGISTER_TASKS
+  printf("Register task %d : convert_matrix\n", TASKID);
+#endif
+}
+
+template <typename S, typename T>
+static void convert
+(const PhysicalRegion& AReg, const PhysicalRegion& BReg, int rlo, int rhi,
+ const ConvertMatrixTask::TaskArgs& args) {
+  PtrMatrixT<S> AMat = get_raw_pointer<S>(AReg, rlo, rhi, args.AcolIdx,
+					  args.AcolIdx+args.cols);
+  PtrMatrixT<T> BMat = get_raw_pointer<T>(BReg, rlo, rhi, args.BcolIdx,
+					  args.BcolIdx+args.cols);
+  for (int j=0; j<args.cols; j++)
+    for (int i=0; i<rhi-rlo; i++)
+      BMat(i, j) = T(AMat(i, j));
+}
+
+void ConvertMatrixTask::cpu_task(const Task *task,
+				 const std::vector<PhysicalRegion> &regions,
+				 Context ctx, HighLevelRuntime *runtime) {
+
+  assert(regions.size() == 2);
+  assert(task->regions.size() == 2);
+  assert(task->arglen == sizeof(TaskArgs));
+
+  const TaskArgs args = *((const TaskArgs*)task->args);
+
+  // the rows of this partition (see block_begin())
+  Rect<2> rect = region_bounds(regions[0], ctx, runtime);
+  int rlo = rect.lo[0];
+  int rhi = rect.hi[0] + 1;
+
+  // a real and a complex type do not convert
+  if (args.Atype == SCALAR_DOUBLE && args.Btype == SCALAR_FLOAT)
+    convert<double, float>(regions[0], regions[1], rlo, rhi, args);
+  else if (args.Atype == SCALAR_FLOAT && args.Btype == SCALAR_DOUBLE)
+    convert<float, double>(regions[0], regions[1], rlo, rhi, args);
+  else if (args.Atype == SCALAR_COMPLEX_DOUBLE &&
+	   args.Btype == SCALAR_COMPLEX_FLOAT)
+    convert<complex_double, complex_float>(regions[0], regions[1],
+					   rlo, rhi, args);
+  else if (args.Atype == SCALAR_COMPLEX_FLOAT &&
+	   args.Btype == SCALAR_COMPLEX_DOUBLE)
+    convert<complex_float, complex_double>(regions[0], regions[1],
+					   rlo, rhi, args);
+  else
+    assert(false);
+}
@@ -2,42 +2,48 @@
 #include "ptr_matrix.hpp"
 
 #include "utility.hpp" // for FIELDID_V
+#include "matrix.hpp"  // for block_begin()
 #include <assert.h>
 
 static Realm::Logger log_solver_tasks("solver_tasks");
 
-int DenseBlockTask::TASKID;
+template <typename T>
+int DenseBlockTaskT<T>::TASKID;
 
-DenseBlockTask::DenseBlockTask(Domain domain,
-			       TaskArgument global_arg,
-			       ArgumentMap arg_map,
-			       MappingTagID tag,
-			       Predicate pred,
-			       bool must,
-			       MapperID id)
+template <typename T>
+DenseBlockTaskT<T>::DenseBlockTaskT(Domain domain,
+				    TaskArgument global_arg,
+				    ArgumentMap arg_map,
+				    MappingTagID tag,
+				    Predicate pred,
+				    bool must,
+				    MapperID id)
   
   : IndexLauncher(TASKID, domain, global_arg,
 		  arg_map, pred, must, id, tag) {}
 
-void DenseBlockTask::register_tasks(void)
+template <typename T>
+void DenseBlockTaskT<T>::register_tasks(void)
 {
+  const char* name = task_name("Dense_Block", scalar_type_of<T>::value);
   TASKID = HighLevelRuntime::register_legion_task
-    <DenseBlockTask::cpu_task>(AUTO_GENERATE_ID,
-			       Processor::LOC_PROC, 
-			       false,
-			       true,
-			       AUTO_GENERATE_ID,
-			       TaskConfigOptions(true/*leaf*/),
-			       "Dense_Block");
+    <DenseBlockTaskT<T>::cpu_task>(AUTO_GENERATE_ID,
+				   Processor::LOC_PROC,
+				   false,
+				   true,
+				   AUTO_GENERATE_ID,
+				   TaskConfigOptions(true/*leaf*/),
+				   name);
 
 #ifdef SHOW_REGISTER_TASKS
-  printf("Register task %d : Dense_Block\n", TASKID);
+  printf("Register task %d : %s\n", TASKID, name);
 #endif
 }
 
-void DenseBlockTask::cpu_task(const Task *task,
-			      const std::vector<PhysicalRegion> &regions,
-			      Context ctx, HighLevelRuntime *runtime) {
+template <typename T>
+void DenseBlockTaskT<T>::cpu_task(const Task *task,
+				  const std::vector<PhysicalRegion> &regions,
+				  Context ctx, HighLevelRuntime *runtime) {
 
   assert(regions.size() == 1);
   assert(task->regions.size() == 1);
@@ -45,8 +51,6 @@ void DenseBlockTask::cpu_task(const Task *task,
   //  assert(task->local_arglen == sizeof(ThreeSeeds));
   log_solver_tasks.print("Inside init dense block tasks.");
   
-  Point<1> p = task->index_point.get_point<1>();
-  //printf("point = %d\n", p[0]);
 
   //const ThreeSeeds seeds = *((const ThreeSeeds*)task->local_args);
   //long uSeed = seeds.uSeed;
@@ -55,18 +59,32 @@ void DenseBlockTask::cpu_task(const Task *task,
   //printf("random seeds = (%lu, %lu, %lu) \n", uSeed, vSeed, dSeed);
   
   const TaskArgs matrix = *((const TaskArgs*)task->args);
-  int nrow = matrix.size;
   int rank = matrix.rank;
   int ofst = matrix.offset;
-  int rlo = p[0]*nrow;
-  //  int rhi = (p[0]+1)*nrow;
+  Rect<2> rect = region_bounds(regions[0], ctx, runtime);
+  int rlo  = rect.lo[0];
+  int nrow = rect.hi[0] - rect.lo[0] + 1;
   
   const long nPart = *((const long*)task->local_args);
-  int rblk = nrow / nPart;
   for (int i=0; i<nPart; i++) {
-    PtrMatrix K = get_raw_pointer(regions[0], rlo+i*rblk, rlo+(i+1)*rblk, 0, rblk);
+    // leaves may differ in size by one row
+    int blo  = rlo + block_begin(nrow, nPart, i);
+    int rblk = block_begin(nrow, nPart, i+1) - block_begin(nrow, nPart, i);
+    PtrMatrixT<T> K = get_raw_pointer<T>(regions[0], blo, blo+rblk, 0, rblk);
+    if (matrix.dense) {
+      // leading columns of the generator of K, plus D
+      PtrMatrixT<T> G(rblk, rank), D(rblk, 1);
+      const long kSeed = *((const long*)task->local_args + 1 + 2*i + 0);
+      const long dSeed = *((const long*)task->local_args + 1 + 2*i + 1);
+      G.rand(kSeed);
+      D.rand(dSeed, ofst);
+      for (int c=0; c<rblk; c++)
+	for (int r=0; r<rblk; r++)
+	  K(r, c) = G(r, c) + (r==c ? D(r, 0) : T(0));
+      continue;
+    }
     // recover U, V and D
-    PtrMatrix U(rblk, rank), V(rblk, rank), D(rblk, 1);
+    PtrMatrixT<T> U(rblk, rank), V(rblk, rank), D(rblk, 1);
     const long uSeed = *((const long*)task->local_args + 1 + 3*i + 0);
     const long vSeed = *((const long*)task->local_args + 1 + 3*i + 1);
     const long dSeed = *((const long*)task->local_args + 1 + 3*i + 2);
@@ -74,6 +92,11 @@ void DenseBlockTask::cpu_task(const Task *task,
     V.rand(vSeed);
     D.rand(dSeed, ofst);
     V.set_trans('t');
-    PtrMatrix::gemm(U, V, D, K);
+    PtrMatrixT<T>::gemm(U, V, D, K);
   }
 }
+
+template class DenseBlockTaskT<float>;
+template class DenseBlockTaskT<double>;
+template class DenseBlockTaskT<complex_float>;
+template class DenseBlockTaskT<complex_double>;
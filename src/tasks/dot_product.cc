@@ -0,0 +1,55 @@
+#include "dot_product.hpp"
+#include "ptr_matrix.hpp"
+#include "utility.hpp"
+
+int DotProductTask::TASKID;
+
+DotProductTask::DotProductTask(Domain domain,
+			       TaskArgument global_arg,
+			       ArgumentMap arg_map,
+			       Predicate pred,
+			       bool must,
+			       MapperID id,
+			       MappingTagID tag)
+  
+  : IndexLauncher(TASKID, domain, global_arg,
+		  arg_map, pred, must, id, tag) {}
+
+void DotProductTask::register_tasks(void)
+{
+  TASKID = HighLevelRuntime::register_legion_task
+    <double, DotProductTask::cpu_task>(AUTO_GENERATE_ID,
+				      Processor::LOC_PROC, 
+				      false,
+				      true,
+				      AUTO_GENERATE_ID,
+				      TaskConfigOptions(true/*leaf*/),
+				      "dot_product");
+
+#ifdef SHOW_REGISTER_TASKS
+  printf("Register task %d : dot_product\n", TASKID);
+#endif
+}
+
+double DotProductTask::cpu_task(const Task *task,
+				const std::vector<PhysicalRegion> &regions,
+				Context ctx, HighLevelRuntime *runtime) {
+
+  assert(regions.size() == 2);
+  assert(task->regions.size() == 2);
+  assert(task->arglen == sizeof(TaskArgs));
+
+  const TaskArgs args = *((const TaskArgs*)task->args);
+  int cols = args.cols;
+
+  // the rows of this partition (see block_begin())
+  Rect<2> rect = region_bounds(regions[0], ctx, runtime);
+  int rlo = rect.lo[0];
+  int rhi = rect.hi[0] + 1;
+  
+  PtrMatrix AMat = get_raw_pointer(regions[0], rlo, rhi, args.AcolIdx,
+				   args.AcolIdx+cols);
+  PtrMatrix BMat = get_raw_pointer(regions[1], rlo, rhi, args.BcolIdx,
+				   args.BcolIdx+cols);
+  return PtrMatrix::dot(AMat, BMat);
+}
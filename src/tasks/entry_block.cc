@@ -0,0 +1,71 @@
+#include "entry_block.hpp"
+#include "ptr_matrix.hpp"
+
+#include "utility.hpp" // for FIELDID_V and entry_func()
+#include "matrix.hpp"  // for block_begin()
+#include <assert.h>
+#include <vector>
+
+static Realm::Logger log_solver_tasks("solver_tasks");
+
+int EntryBlockTask::TASKID;
+
+EntryBlockTask::EntryBlockTask(Domain domain,
+			       TaskArgument global_arg,
+			       ArgumentMap arg_map,
+			       MappingTagID tag,
+			       Predicate pred,
+			       bool must,
+			       MapperID id)
+  
+  : IndexLauncher(TASKID, domain, global_arg,
+		  arg_map, pred, must, id, tag) {}
+
+void EntryBlockTask::register_tasks(void)
+{
+  TASKID = HighLevelRuntime::register_legion_task
+    <EntryBlockTask::cpu_task>(AUTO_GENERATE_ID,
+			       Processor::LOC_PROC, 
+			       false,
+			       true,
+			       AUTO_GENERATE_ID,
+			       TaskConfigOptions(true/*leaf*/),
+			       "Entry_Block");
+
+#ifdef SHOW_REGISTER_TASKS
+  printf("Register task %d : Entry_Block\n", TASKID);
+#endif
+}
+
+void EntryBlockTask::cpu_task(const Task *task,
+			      const std::vector<PhysicalRegion> &regions,
+			      Context ctx, HighLevelRuntime *runtime) {
+
+  assert(regions.size() == 1 || regions.size() == 2);
+  assert(task->regions.size() == regions.size());
+  assert(task->arglen == sizeof(TaskArgs));
+  log_solver_tasks.print("Inside entry block tasks.");
+
+  const TaskArgs args = *((const TaskArgs*)task->args);
+  EntryFunc entry = entry_func(args.func);
+  Rect<2> rect = region_bounds(regions[0], ctx, runtime);
+  int rlo  = rect.lo[0];
+  int nrow = rect.hi[0] - rect.lo[0] + 1;
+  // the entry index of every row
+  std::vector<int> idx(nrow);
+  for (int r=0; r<nrow; r++)
+    idx[r] = rlo+r;
+  if (regions.size() == 2) {
+    PtrMatrix P = get_raw_pointer(regions[1], rlo, rlo+nrow, 0, 1);
+    for (int r=0; r<nrow; r++)
+      idx[r] = int(P(r, 0));
+  }
+  for (int i=0; i<args.nblk; i++) {
+    int blo  = block_begin(nrow, args.nblk, i);
+    int rblk = block_begin(nrow, args.nblk, i+1) - blo;
+    PtrMatrix K = get_raw_pointer(regions[0], rlo+blo, rlo+blo+rblk, 0, rblk);
+    for (int c=0; c<rblk; c++)
+      for (int r=0; r<rblk; r++)
+	K(r, c) = entry(idx[blo+r], idx[blo+c]);
+  }
+}
@@ -59,12 +59,15 @@ void GemmTask::cpu_task(const Task *task,
 	 Crows, Ccols);
 #endif
   PtrMatrix AMat = get_raw_pointer(regions[0], 0, Arows, AcolIdx, AcolIdx+Acols);
-  PtrMatrix BMat = get_raw_pointer(regions[1], 0, Brows, BcolIdx, BcolIdx+Bcols);
-  PtrMatrix CMat = get_raw_pointer(regions[2], 0, Crows, 0,       Ccols);
   AMat.set_trans(transA);
-  BMat.set_trans(transB);
+  for (int k=0; k<args.batch; k++) {
+    int Bcol = BcolIdx + k*args.stride;
+    PtrMatrix BMat = get_raw_pointer(regions[1], 0, Brows, Bcol, Bcol+Bcols);
+    PtrMatrix CMat = get_raw_pointer(regions[2], 0, Crows, k*Ccols, (k+1)*Ccols);
+    BMat.set_trans(transB);
 
-  //printf("leading D: %d\n", CMat.LD());  
-  PtrMatrix::gemm(alpha, AMat, BMat, beta, CMat);
+    //printf("leading D: %d\n", CMat.LD());  
+    PtrMatrix::gemm(alpha, AMat, BMat, beta, CMat);
+  }
 }
 
@@ -4,43 +4,48 @@
 
 static Realm::Logger log_solver_tasks("solver_tasks");
 
-int GemmBroTask::TASKID;
+template <typename T>
+int GemmBroTaskT<T>::TASKID;
 
-GemmBroTask::GemmBroTask(Domain domain,
-			 TaskArgument global_arg,
-			 ArgumentMap arg_map,
-			 MappingTagID tag,
-			 Predicate pred,
-			 bool must,
-			 MapperID id)
+template <typename T>
+GemmBroTaskT<T>::GemmBroTaskT(Domain domain,
+			      TaskArgument global_arg,
+			      ArgumentMap arg_map,
+			      MappingTagID tag,
+			      Predicate pred,
+			      bool must,
+			      MapperID id)
   
   : IndexLauncher(TASKID, domain, global_arg,
 		  arg_map, pred, must, id, tag) {}
 
-void GemmBroTask::register_tasks(void)
+template <typename T>
+void GemmBroTaskT<T>::register_tasks(void)
 {
+  const char* name = task_name("GemmBroadcast", scalar_type_of<T>::value);
   TASKID = HighLevelRuntime::register_legion_task
-    <GemmBroTask::cpu_task>(AUTO_GENERATE_ID,
-			    Processor::LOC_PROC, 
-			    false,
-			    true,
-			    AUTO_GENERATE_ID,
-			    TaskConfigOptions(true/*leaf*/),
-			    "GemmBroadcast");
+    <GemmBroTaskT<T>::cpu_task>(AUTO_GENERATE_ID,
+				Processor::LOC_PROC,
+				false,
+				true,
+				AUTO_GENERATE_ID,
+				TaskConfigOptions(true/*leaf*/),
+				name);
 
 #ifdef SHOW_REGISTER_TASKS
-  printf("Register task %d : GemmBroadcast\n", TASKID);
+  printf("Register task %d : %s\n", TASKID, name);
 #endif
 }
 
-void GemmBroTask::cpu_task(const Task *task,
-			   const std::vector<PhysicalRegion> &regions,
-			   Context ctx, HighLevelRuntime *runtime) {
+template <typename T>
+void GemmBroTaskT<T>::cpu_task(const Task *task,
+			       const std::vector<PhysicalRegion> &regions,
+			       Context ctx, HighLevelRuntime *runtime) {
 
   //assert(regions.size() == 3);
   //assert(task->regions.size() == 3);
-  assert(regions.size() == 2);
-  assert(task->regions.size() == 2);
+  assert(regions.size() == 2 || regions.size() == 3);
+  assert(task->regions.size() == regions.size());
   assert(task->arglen == sizeof(TaskArgs));
   Point<1> p = task->index_point.get_point<1>();
   //printf("point = %d\n", p[0]);
@@ -48,40 +53,53 @@ void GemmBroTask::cpu_task(const Task *task,
   log_solver_tasks.print("Inside gemm broadcast tasks.");
 
   const TaskArgs args = *((const TaskArgs*)task->args);
-  int Arblk = args.Arblk;
   int Brblk = args.Brblk;
-  int Crblk = args.Crblk;
   int Acols = args.Acols;
   int Bcols = args.Bcols;
   int Ccols = args.Ccols;
   int AcolIdx = args.AcolIdx;
+  int CcolIdx = args.CcolIdx;
   //printf("A(%d, %d), B(%d, %d), C(%d, %d)\n",
   //	 Arblk, Acols, Brblk, Bcols, Crblk, Ccols);
   
-  int Arlo = p[0]*Arblk;
-  int Arhi = (p[0] + 1) * Arblk;
-  int Crlo = p[0]*Crblk;
-  int Crhi = (p[0] + 1) * Crblk;
+  // A and C are the same region unless C is given, partitioned
+  //  along the tree
+  const PhysicalRegion& Creg = regions.size() == 3 ? regions[2] : regions[0];
+  Rect<2> Arect = region_bounds(regions[0], ctx, runtime);
+  int Arlo = Arect.lo[0];
+  int Arhi = Arect.hi[0] + 1;
+  int Crlo = Arlo;
+  int Crhi = Arhi;
   
   int clrSize = args.colorSize;
   int color = p[0] / clrSize;
+  if (args.sibling)
+    color ^= 1;
   int Brlo = color*Brblk;
   int Brhi = (color + 1) * Brblk;
   
-  PtrMatrix AMat = get_raw_pointer(regions[0], Arlo, Arhi, AcolIdx, AcolIdx+Acols);
-  PtrMatrix BMat = get_raw_pointer(regions[1], Brlo, Brhi, 0, Bcols);
-  //PtrMatrix CMat = get_raw_pointer(regions[2], Crlo, Crhi, 0, Ccols);
-  PtrMatrix CMat = get_raw_pointer(regions[0], Crlo, Crhi, 0, Ccols);
-  AMat.set_trans(args.transa);
-  BMat.set_trans(args.transb);
-  double alpha = args.alpha;
+  T alpha = args.alpha;
+  for (int k=0; k<args.batch; k++) {
+    int Acol = AcolIdx + k*args.stride;
+    int Ccol = CcolIdx + k*args.stride;
+    PtrMatrixT<T> AMat = get_raw_pointer<T>(regions[0], Arlo, Arhi, Acol, Acol+Acols);
+    PtrMatrixT<T> BMat = get_raw_pointer<T>(regions[1], Brlo, Brhi, k*Bcols, (k+1)*Bcols);
+    //PtrMatrixT<T> CMat = get_raw_pointer<T>(regions[2], Crlo, Crhi, 0, Ccols);
+    PtrMatrixT<T> CMat = get_raw_pointer<T>(Creg, Crlo, Crhi, Ccol, Ccol+Ccols);
+    AMat.set_trans(args.transa);
+    BMat.set_trans(args.transb);
 
-  /*
-  std::cout << "gemm:" << std::endl;
-  AMat.display("A");
-  BMat.display("B");
-  CMat.display("C");
-*/
-  PtrMatrix::gemm(alpha, AMat, BMat, CMat);
+    /*
+    std::cout << "gemm:" << std::endl;
+    AMat.display("A");
+    BMat.display("B");
+    CMat.display("C");
+    */
+    PtrMatrixT<T>::gemm(alpha, AMat, BMat, CMat);
+  }
 }
 
+template class GemmBroTaskT<float>;
+template class GemmBroTaskT<double>;
+template class GemmBroTaskT<complex_float>;
+template class GemmBroTaskT<complex_double>;
@@ -56,18 +56,22 @@ void GemmInplaceTask::cpu_task(const Task *task,
 	 Brows, Bcols,
 	 Crows, Ccols);
 #endif
-  PtrMatrix AMat = get_raw_pointer(regions[0], 0, Arows, AcolIdx, AcolIdx+Acols);
-  PtrMatrix BMat = get_raw_pointer(regions[1], 0, Brows, 0, Bcols);
-  PtrMatrix CMat = get_raw_pointer(regions[0], 0, Crows, 0, Ccols);
-  AMat.set_trans(transA);
-  BMat.set_trans(transB);
+  for (int k=0; k<args.batch; k++) {
+    int Acol = AcolIdx + k*args.stride;
+    int Ccol = k*args.stride;
+    PtrMatrix AMat = get_raw_pointer(regions[0], 0, Arows, Acol, Acol+Acols);
+    PtrMatrix BMat = get_raw_pointer(regions[1], 0, Brows, k*Bcols, (k+1)*Bcols);
+    PtrMatrix CMat = get_raw_pointer(regions[0], 0, Crows, Ccol, Ccol+Ccols);
+    AMat.set_trans(transA);
+    BMat.set_trans(transB);
 
-  /*
-  std::cout << "gemm:" << std::endl;
-  AMat.display("A");
-  BMat.display("B");
-  CMat.display("C");
-*/
-  PtrMatrix::gemm(alpha, AMat, BMat, beta, CMat);
+    /*
+    std::cout << "gemm:" << std::endl;
+    AMat.display("A");
+    BMat.display("B");
+    CMat.display("C");
+    */
+    PtrMatrix::gemm(alpha, AMat, BMat, beta, CMat);
+  }
 }
 
@@ -4,38 +4,43 @@
 
 static Realm::Logger log_solver_tasks("solver_tasks");
 
-int GemmRedTask::TASKID;
+template <typename T>
+int GemmRedTaskT<T>::TASKID;
 
-GemmRedTask::GemmRedTask(Domain domain,
-			 TaskArgument global_arg,
-			 ArgumentMap arg_map,
-			 MappingTagID tag,
-			 Predicate pred,
-			 bool must,
-			 MapperID id)
+template <typename T>
+GemmRedTaskT<T>::GemmRedTaskT(Domain domain,
+			      TaskArgument global_arg,
+			      ArgumentMap arg_map,
+			      MappingTagID tag,
+			      Predicate pred,
+			      bool must,
+			      MapperID id)
   
   : IndexLauncher(TASKID, domain, global_arg,
 		  arg_map, pred, must, id, tag) {}
 
-void GemmRedTask::register_tasks(void)
+template <typename T>
+void GemmRedTaskT<T>::register_tasks(void)
 {
+  const char* name = task_name("GemmRed", scalar_type_of<T>::value);
   TASKID = HighLevelRuntime::register_legion_task
-    <GemmRedTask::cpu_task>(AUTO_GENERATE_ID,
-			    Processor::LOC_PROC, 
-			    false,
-			    true,
-			    AUTO_GENERATE_ID,
-			    TaskConfigOptions(true/*leaf*/),
-			    "GemmRed");
+    <GemmRedTaskT<T>::cpu_task>(AUTO_GENERATE_ID,
+				Processor::LOC_PROC,
+				false,
+				true,
+				AUTO_GENERATE_ID,
+				TaskConfigOptions(true/*leaf*/),
+				name);
 
 #ifdef SHOW_REGISTER_TASKS
-  printf("Register task %d : GemmRed\n", TASKID);
+  printf("Register task %d : %s\n", TASKID, name);
 #endif
 }
 
-void GemmRedTask::cpu_task(const Task *task,
-			   const std::vector<PhysicalRegion> &regions,
-			   Context ctx, HighLevelRuntime *runtime) {
+template <typename T>
+void GemmRedTaskT<T>::cpu_task(const Task *task,
+			       const std::vector<PhysicalRegion> &regions,
+			       Context ctx, HighLevelRuntime *runtime) {
 
   assert(regions.size() == 3);
   assert(task->regions.size() == 3);
@@ -46,8 +51,6 @@ void GemmRedTask::cpu_task(const Task *task,
   log_solver_tasks.print("Inside gemm reduction tasks.");
 
   const TaskArgs args = *((const TaskArgs*)task->args);
-  int Arblk = args.Arblk;
-  int Brblk = args.Brblk;
   int Crblk = args.Crblk;
   int Acols = args.Acols;
   int Bcols = args.Bcols;
@@ -58,25 +61,35 @@ void GemmRedTask::cpu_task(const Task *task,
   //printf("A(%d, %d), B(%d, %d), C(%d, %d)\n",
   //	 Arblk, Acols, Brblk, Bcols, Crblk, Ccols);
   
-  int Arlo = p[0]*Arblk;
-  int Arhi = (p[0] + 1) * Arblk;
-  int Brlo = p[0]*Brblk;
-  int Brhi = (p[0] + 1) * Brblk;
+  // A and B are partitioned along the tree, so the
+  //  row blocks may differ in size
+  Rect<2> Arect = region_bounds(regions[0], ctx, runtime);
+  Rect<2> Brect = region_bounds(regions[1], ctx, runtime);
+  int Arlo = Arect.lo[0];
+  int Arhi = Arect.hi[0] + 1;
+  int Brlo = Brect.lo[0];
+  int Brhi = Brect.hi[0] + 1;
   
   int clrSize = args.colorSize;
   int color = p[0] / clrSize;
   int Crlo = color*Crblk;
   int Crhi = (color + 1) * Crblk;
   
-  PtrMatrix AMat = get_raw_pointer(regions[0], Arlo, Arhi, AcolIdx, AcolIdx+Acols);
-  PtrMatrix BMat = get_raw_pointer(regions[1], Brlo, Brhi, BcolIdx, BcolIdx+Bcols);
-  PtrMatrix CMat = reduction_pointer(regions[2], Crlo, Crhi, CcolIdx, CcolIdx+Ccols);
+  PtrMatrixT<T> AMat = get_raw_pointer<T>(regions[0], Arlo, Arhi, AcolIdx, AcolIdx+Acols);
   AMat.set_trans(args.transa);
-  BMat.set_trans(args.transb);
-  double alpha = args.alpha;
+  T alpha = args.alpha;
 
-  //printf("leading D: %d\n", CMat.LD());  
-  PtrMatrix::gemm(alpha, AMat, BMat, CMat);
+  // A is read once for all the blocks
+  for (int k=0; k<args.batch; k++) {
+    int Bcol = BcolIdx + k*args.Bstride;
+    int Ccol = CcolIdx + k*Ccols;
+    PtrMatrixT<T> BMat = get_raw_pointer<T>(regions[1], Brlo, Brhi, Bcol, Bcol+Bcols);
+    PtrMatrixT<T> CMat = reduction_pointer<T>(regions[2], Crlo, Crhi, Ccol, Ccol+Ccols);
+    BMat.set_trans(args.transb);
+
+    //printf("leading D: %d\n", CMat.LD());  
+    PtrMatrixT<T>::gemm(alpha, AMat, BMat, CMat);
+  }
   /*
   std::cout << "gemm:" << std::endl;
   AMat.display("A");
@@ -85,3 +98,7 @@ void GemmRedTask::cpu_task(const Task *task,
 */
 }
 
+template class GemmRedTaskT<float>;
+template class GemmRedTaskT<double>;
+template class GemmRedTaskT<complex_float>;
+template class GemmRedTaskT<complex_double>;
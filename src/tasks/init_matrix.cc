@@ -2,75 +2,104 @@
 #include "ptr_matrix.hpp"
 
 #include "utility.hpp" // for FIELDID_V
+#include "matrix.hpp"  // for block_begin()
 #include <assert.h>
 
 static Realm::Logger log_solver_tasks("solver_tasks");
 
-int InitMatrixTask::TASKID;
+template <typename T>
+int InitMatrixTaskT<T>::TASKID;
 
-InitMatrixTask::InitMatrixTask(Domain domain,
-			       TaskArgument global_arg,
-			       ArgumentMap arg_map,
-			       MappingTagID tag,
-			       Predicate pred,
-			       bool must,
-			       MapperID id)
+template <typename T>
+InitMatrixTaskT<T>::InitMatrixTaskT(Domain domain,
+				    TaskArgument global_arg,
+				    ArgumentMap arg_map,
+				    MappingTagID tag,
+				    Predicate pred,
+				    bool must,
+				    MapperID id)
   
   : IndexLauncher(TASKID, domain, global_arg,
 		  arg_map, pred, must, id, tag) {}
 
-void InitMatrixTask::register_tasks(void)
+template <typename T>
+void InitMatrixTaskT<T>::register_tasks(void)
 {
+  const char* name = task_name("Init_Matrix", scalar_type_of<T>::value);
   TASKID = HighLevelRuntime::register_legion_task
-    <InitMatrixTask::cpu_task>(AUTO_GENERATE_ID,
-			       Processor::LOC_PROC, 
-			       false,
-			       true,
-			       AUTO_GENERATE_ID,
-			       TaskConfigOptions(true/*leaf*/),
-			       "Init_Matrix");
+    <InitMatrixTaskT<T>::cpu_task>(AUTO_GENERATE_ID,
+				   Processor::LOC_PROC,
+				   false,
+				   true,
+				   AUTO_GENERATE_ID,
+				   TaskConfigOptions(true/*leaf*/),
+				   name);
 
 #ifdef SHOW_REGISTER_TASKS
-  printf("Register task %d : Init_Matrix\n", TASKID);
+  printf("Register task %d : %s\n", TASKID, name);
 #endif
 }
 
-void InitMatrixTask::cpu_task(const Task *task,
-			      const std::vector<PhysicalRegion> &regions,
-			      Context ctx, HighLevelRuntime *runtime) {
+template <typename T>
+void InitMatrixTaskT<T>::cpu_task(const Task *task,
+				  const std::vector<PhysicalRegion> &regions,
+				  Context ctx, HighLevelRuntime *runtime) {
   assert(regions.size() == 1);
   assert(task->regions.size() == 1);
   assert(task->arglen == sizeof(TaskArgs));
   //assert(task->local_arglen == sizeof(long));
   log_solver_tasks.print("Inside init tasks.");
 
-  Point<1> p = task->index_point.get_point<1>();
-  //printf("point = %d\n", p[0]);
-
   const long nPart = *((const long*)task->local_args);
   //printf("nPart = %lu \n", nPart);
 
   const TaskArgs blockSize = *((const TaskArgs*)task->args);
-  int rblk  = blockSize.rblk;
   int cblk  = blockSize.cblk;
   int chi   = blockSize.chi;
-  //printf("block row size = %i\n", rows);
   //printf("block col size = %i\n", cols);
 
-  int rlo = p[0]*rblk;
-  //int rhi = (p[0] + 1) * rblk;
+  // partitions (and the blocks inside) may have different sizes
+  Rect<2> rect = region_bounds(regions[0], ctx, runtime);
+  int rlo  = rect.lo[0];
+  int nrow = rect.hi[0] - rect.lo[0] + 1;
 
-  int blksmall = rblk / nPart;
   for (int i=0; i<nPart; i++) {
     const long seed = *((const long*)task->local_args + i + 1);
     //printf(" seed = %lu \n", seed);
+    int blo   = rlo + block_begin(nrow, nPart, i);
+    int bhi   = rlo + block_begin(nrow, nPart, i+1);
     int clo   = blockSize.clo;
+    // the copies (e.g., the u columns of every level) are the
+    //  same, so only the first one is generated
     while (clo+cblk <= chi) {
-      PtrMatrix A = get_raw_pointer(regions[0], rlo+i*blksmall, rlo+(i+1)*blksmall, clo, clo+cblk);
-      A.rand(seed);
+      PtrMatrixT<T> A = get_raw_pointer<T>(regions[0], blo, bhi, clo, clo+cblk);
+      if (clo == blockSize.clo) {
+	A.rand(seed);
+      } else {
+	PtrMatrixT<T> B = get_raw_pointer<T>(regions[0], blo, bhi, blockSize.clo,
+					     blockSize.clo+cblk);
+	for (int c=0; c<cblk; c++)
+	  for (int r=0; r<bhi-blo; r++)
+	    A(r, c) = B(r, c);
+      }
       //A.display("sub-mat");
       //std::cout<<"LD:"<<A.LD()<<std::endl;
       clo += cblk;
     }
+    // leading columns only, e.g., a lower rank at some level
+    if (clo < chi) {
+      assert(clo == blockSize.clo);
+      PtrMatrixT<T> A = get_raw_pointer<T>(regions[0], blo, bhi, clo, chi);
+      PtrMatrixT<T> B(bhi-blo, cblk);
+      B.rand(seed);
+      for (int c=0; c<chi-clo; c++)
+	for (int r=0; r<bhi-blo; r++)
+	  A(r, c) = B(r, c);
+    }
   }
 }
+
+template class InitMatrixTaskT<float>;
+template class InitMatrixTaskT<double>;
+template class InitMatrixTaskT<complex_float>;
+template class InitMatrixTaskT<complex_double>;
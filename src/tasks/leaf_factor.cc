@@ -0,0 +1,241 @@
+#include "leaf_factor.hpp"
+#include "ptr_matrix.hpp"
+#include "node_system.hpp"
+#include "utility.hpp"
+#include <math.h>
+#include <algorithm> // for std::max()
+
+static Realm::Logger log_solver_tasks("solver_tasks");
+
+double hfactor
+(int nrow, int ncol, const int *rank, const int *vcol, int nPart,
+ int LD, double *K, double *P, double *U, double *V,
+ int LDS, int Sblk, double *S, bool spd, bool single,
+ int nShared, const int *shared, const char *update);
+
+int leaf_columns
+(int ncol, int nShared, const int *shared, int *lo, int *hi);
+
+template <typename T>
+void leaf_copy
+(int nrow, int ncol, int LD, T *B, int nShared, const int *shared);
+
+int LeafFactorTask::TASKID;
+
+LeafFactorTask::LeafFactorTask(Domain domain,
+			       TaskArgument global_arg,
+			       ArgumentMap arg_map,
+			       MappingTagID tag,
+			       Predicate pred,
+			       bool must,
+			       MapperID id)
+
+  : IndexLauncher(TASKID, domain, global_arg,
+		  arg_map, pred, must, id, tag) {}
+
+void LeafFactorTask::register_tasks(void)
+{
+  TASKID = HighLevelRuntime::register_legion_task
+    <double, LeafFactorTask::cpu_task>(AUTO_GENERATE_ID,
+			       Processor::LOC_PROC,
+			       false,
+			       true,
+			       AUTO_GENERATE_ID,
+			       TaskConfigOptions(true/*leaf*/),
+			       "Leaf_Factor");
+
+#ifdef SHOW_REGISTER_TASKS
+  printf("Register task %d : Leaf_Factor\n", TASKID);
+#endif
+}
+
+// regions: dense blocks (the last column stores pivots), u columns,
+//  V and the node factors below the launch level; the local
+//  argument, if any, flags the leaves to factorize again (see
+//  LMatrix::factor())
+double LeafFactorTask::cpu_task(const Task *task,
+			      const std::vector<PhysicalRegion> &regions,
+			      Context ctx, HighLevelRuntime *runtime) {
+
+  assert(regions.size() == 4);
+  assert(task->regions.size() == 4);
+  assert(task->arglen == sizeof(TaskArgs));
+  Point<1> p = task->index_point.get_point<1>();
+  log_solver_tasks.print("Inside leaf factor tasks.");
+
+  const TaskArgs args = *((const TaskArgs*)task->args);
+  int nPart = args.nPart;
+  int Srblk = args.Srblk;
+  int level = log2(nPart);
+  // all u columns and the widest node system
+  int ncol  = args.ncol;
+  int rmax  = 0;
+  for (int i=0; i<level; i++) {
+    ncol += args.ranks[i];
+    rmax  = std::max(rmax, args.ranks[i]);
+  }
+  // rows of this partition; pivots go to the column past
+  //  the largest leaf
+  Rect<2> Krect = region_bounds(regions[0], ctx, runtime);
+  int rlo  = Krect.lo[0];
+  int rhi  = Krect.hi[0] + 1;
+  int rblk = rhi - rlo;
+  int leaf = Krect.hi[1];
+  int vcol = region_bounds(regions[2], ctx, runtime).hi[1] + 1;
+  PtrMatrix KMat = get_raw_pointer(regions[0], rlo, rhi, 0, leaf+1);
+  PtrMatrix UMat = get_raw_pointer(regions[1], rlo, rhi,
+				   args.colIdx, args.colIdx+ncol);
+  PtrMatrix VMat = get_raw_pointer(regions[2], rlo, rhi, 0, vcol);
+  PtrMatrix SMat = get_raw_pointer(regions[3], p[0]*Srblk, (p[0]+1)*Srblk,
+				   0, 2*rmax+1);
+  assert(KMat.LD() == UMat.LD());
+  assert(KMat.LD() == VMat.LD());
+  assert(nPart==(int)pow(2,level));
+  const char *update = NULL;
+  if (task->local_arglen > 0) {
+    assert(task->local_arglen == nPart*sizeof(char));
+    update = (const char*)task->local_args;
+  }
+  return hfactor(rblk, args.ncol, args.ranks, args.vcols, nPart, KMat.LD(),
+	  KMat.pointer(), KMat.pointer(0, leaf), UMat.pointer(),
+	  VMat.pointer(), SMat.LD(), 2*rmax, SMat.pointer(), args.spd,
+	  args.single, args.nShared, args.shared, update);
+}
+
+// The same recursion as hsolve() in leaf_solve.cc, but the
+//  factors are kept:
+//  - leaf blocks are overwritten by LU factors with pivots in P
+//    (Cholesky factors with spd)
+//  - node systems are stored in S in preorder, Sblk rows
+//    per node, with pivots in column Sblk (the general system
+//    keeps the factors of its Schur complement, see
+//    node_system.hpp)
+// U holds the u columns of the ancestors (ncol of them) followed
+//  by the u columns of this subtree; rank[k] is the rank k levels
+//  below this node and vcol[k] the first column of its basis in V.
+// With spd, the leaf blocks are Cholesky factorized (P is not used)
+//  and the node systems are symmetric (see NodeFactorTask). With
+//  single, all factorizations are done in single precision, while
+//  the eliminations stay in double. With a shared basis, the leaf
+//  solve is done once for the u columns of all depths (see
+//  leaf_columns() in leaf_solve.cc).
+// Unless update is NULL, only the leaves with update[i] set and
+//  the nodes above them are factorized, while the other blocks
+//  already hold their factors, which are used as they are (see
+//  HMatrix::add_diagonal()); the u columns are solved in any case.
+// Returns log|det| of the subtree, i.e., the sum over the leaf
+//  blocks and the node systems (see HMatrix::log_determinant()).
+double hfactor
+(int nrow, int ncol, const int *rank, const int *vcol, int nPart,
+ int LD, double *K, double *P, double *U, double *V,
+ int LDS, int Sblk, double *S, bool spd, bool single,
+ int nShared, const int *shared, const char *update) {
+  bool refactor = update == NULL;
+  for (int i=0; i<nPart && !refactor; i++)
+    refactor = update[i];
+  if (nPart==1) {
+    PtrMatrix KMat(nrow, nrow, LD, K);
+    double logdet;
+    if (refactor)
+      logdet = spd ? KMat.factor_cholesky(single) : KMat.factor(P, single);
+    else
+      logdet = spd ? KMat.log_det_cholesky() : KMat.log_det_lu();
+    int lo[2], hi[2];
+    int nRange = leaf_columns(ncol, nShared, shared, lo, hi);
+    for (int k=0; k<nRange; k++) {
+      if (hi[k] == lo[k]) continue;
+      PtrMatrix UMat(nrow, hi[k]-lo[k], LD, U+lo[k]*LD);
+      if (spd)
+	KMat.solve_cholesky(UMat);
+      else
+	KMat.solve(UMat, P);
+    }
+    leaf_copy(nrow, ncol, LD, U, nShared, shared);
+    return logdet;
+  }
+
+  // recursively factor two children
+  assert(nPart%2==0);
+  int     half = nPart/2;
+  int     n0   = nrow/2;
+  int     n1   = nrow-n0;
+  double *d0 = U;
+  double *d1 = U  + n0;
+  double *V0 = V  + vcol[0]*LD;
+  double *V1 = V0 + n0;
+  double *u0 = d0 + ncol*LD;
+  double *u1 = d1 + ncol*LD;
+  int     r    = rank[0];
+  double logdet =
+    hfactor(n0, ncol+r, rank+1, vcol+1, half, LD, K,    P,
+	    d0, V,    LDS, Sblk, S+Sblk, spd, single, nShared, shared,
+	    update) +
+    hfactor(n1, ncol+r, rank+1, vcol+1, half, LD, K+n0, P+n0,
+	    d1, V+n0, LDS, Sblk, S+Sblk*half, spd, single, nShared, shared,
+	    update ? update+half : NULL);
+
+  char   transa = 't';
+  char   transb = 'n';
+  double alpha  = 1.0;
+  double beta   = 0.0;
+
+  int     S_size = 2*r;
+  double *IPIV_S = S + Sblk*LDS;
+  PtrMatrix SMat(S_size, S_size, LDS, S);
+  if (!refactor) {
+    // the factors of the node system are kept
+    logdet += spd ? SMat.log_det_symmetric(IPIV_S)
+                  : node_system_log_det(r, S, LDS);
+  } else {
+    // form the node system in place
+    for (int j=0; j<S_size; j++) {
+      for (int i=0; i<S_size; i++)
+	S[i+j*LDS] = 0.0;
+      S[j+j*LDS] = 1.0;
+    }
+    double *V0Tu0 = S + S_size/2;
+    double *V1Tu1 = S + S_size/2*LDS;
+    if (spd) {
+      // the symmetric system has the identity off the diagonal
+      V0Tu0 = S;
+      V1Tu1 = S + r + r*LDS;
+      for (int i=0; i<r; i++) {
+	S[i+i*LDS] = 0.0;
+	S[r+i+(r+i)*LDS] = 0.0;
+	S[r+i+i*LDS] = S[i+(r+i)*LDS] = 1.0;
+      }
+    }
+    blas::dgemm_(&transa, &transb, &r, &r, &n0, &alpha, V0, &LD, u0, &LD, &beta, V0Tu0, &LDS);
+    blas::dgemm_(&transa, &transb, &r, &r, &n1, &alpha, V1, &LD, u1, &LD, &beta, V1Tu1, &LDS);
+    if (spd)
+      logdet += SMat.factor_symmetric(IPIV_S, single);
+    else
+      logdet += node_system_factor(r, S, LDS, IPIV_S, single);
+  }
+
+  // eliminate the u columns of the ancestors
+  if (ncol == 0) return logdet;
+  double *RHS  = (double *) malloc(S_size * ncol * sizeof(double));
+  double *V0Td0 = RHS;
+  double *V1Td1 = RHS + S_size/2;
+  blas::dgemm_(&transa, &transb, &r, &ncol, &n0, &alpha, V0, &LD, d0, &LD, &beta, V0Td0, &S_size);
+  blas::dgemm_(&transa, &transb, &r, &ncol, &n1, &alpha, V1, &LD, d1, &LD, &beta, V1Td1, &S_size);
+
+  PtrMatrix B(S_size, ncol, S_size, RHS);
+  if (spd)
+    SMat.solve_symmetric(B, IPIV_S);
+  else
+    node_system_solve(r, S, LDS, IPIV_S, 'n', ncol,
+		      V0Td0, S_size, V1Td1, S_size);
+
+  transa =  'n';
+  alpha  = -1.0;
+  beta   =  1.0;
+  // the solution is in the natural order for both systems
+  double *eta0 = RHS;
+  double *eta1 = RHS + S_size/2;
+  blas::dgemm_(&transa, &transb, &n0, &ncol, &r, &alpha, u0, &LD, eta0, &S_size, &beta, d0, &LD);
+  blas::dgemm_(&transa, &transb, &n1, &ncol, &r, &alpha, u1, &LD, eta1, &S_size, &beta, d1, &LD);
+  free(RHS);
+  return logdet;
+}
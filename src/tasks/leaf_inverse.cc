@@ -0,0 +1,257 @@
+#include "leaf_inverse.hpp"
+#include "ptr_matrix.hpp"
+#include "node_system.hpp"
+#include "utility.hpp"
+#include "matrix.hpp"  // for block_begin()
+#include <math.h>
+#include <algorithm> // for std::max()
+
+static Realm::Logger log_solver_tasks("solver_tasks");
+
+void node_coupling
+(int r, const double *S, int LDS, bool spd,
+ double *R0, int LDR0, double *R1, int LDR1);
+
+static void zsweep
+(int nrow, int ncol, const int *rank, const int *vcol, int nPart,
+ int LD, double *K, double *P, double *W, double *V, double *Z,
+ int LDS, int Sblk, double *S);
+
+static void hcouple
+(int nrow, int ncol, const int *rank, int nPart, int LD, double *W,
+ int LDS, int Sblk, double *S, bool spd, double *T, int LDT);
+
+int LeafInverseTask::TASKID;
+
+LeafInverseTask::LeafInverseTask(Domain domain,
+				 TaskArgument global_arg,
+				 ArgumentMap arg_map,
+				 MappingTagID tag,
+				 Predicate pred,
+				 bool must,
+				 MapperID id)
+
+  : IndexLauncher(TASKID, domain, global_arg,
+		  arg_map, pred, must, id, tag) {}
+
+void LeafInverseTask::register_tasks(void)
+{
+  TASKID = HighLevelRuntime::register_legion_task
+    <LeafInverseTask::cpu_task>(AUTO_GENERATE_ID,
+				Processor::LOC_PROC,
+				false,
+				true,
+				AUTO_GENERATE_ID,
+				TaskConfigOptions(true/*leaf*/),
+				"Leaf_Inverse");
+
+#ifdef SHOW_REGISTER_TASKS
+  printf("Register task %d : Leaf_Inverse\n", TASKID);
+#endif
+}
+
+// regions: the factors of the dense blocks (the last column stores
+//  pivots), the factored u columns, the node factors below the
+//  launch level, the workspace, the output and V (not for spd).
+//  The workspace holds z = A_c' \ V for every depth (see
+//  zsweep()), with the levels above the launch level eliminated
+//  already, and at column wcol the corrections w*R of these levels
+//  (see hcouple()). Row i of the inverse then has the diagonal
+//  entry inv(K)(i, i) - sum_k T(i, k)*z(i, k) over the columns of
+//  all depths, and the same sums give the leaf blocks.
+void LeafInverseTask::cpu_task(const Task *task,
+			       const std::vector<PhysicalRegion> &regions,
+			       Context ctx, HighLevelRuntime *runtime) {
+
+  assert(task->arglen == sizeof(TaskArgs));
+  const TaskArgs args = *((const TaskArgs*)task->args);
+  assert(regions.size() == (args.spd ? 5 : 6));
+  assert(task->regions.size() == regions.size());
+  Point<1> p = task->index_point.get_point<1>();
+  log_solver_tasks.print("Inside leaf inverse tasks.");
+
+  int ncol  = args.ncol;
+  int nPart = args.nPart;
+  int level = log2(nPart);
+  // u columns of this subtree and the widest node system
+  int ucol  = 0;
+  int rmax  = 0;
+  for (int i=0; i<level; i++) {
+    ucol += args.ranks[i];
+    rmax  = std::max(rmax, args.ranks[i]);
+  }
+  int nz = ncol + ucol;
+  assert(nPart==(int)pow(2,level));
+
+  // rows of this partition; pivots go to the column past
+  //  the largest leaf
+  Rect<2> Krect = region_bounds(regions[0], ctx, runtime);
+  int rlo  = Krect.lo[0];
+  int rhi  = Krect.hi[0] + 1;
+  int rblk = rhi - rlo;
+  int leaf = Krect.hi[1];
+  int Srblk = args.Srblk;
+  PtrMatrix KMat = get_raw_pointer(regions[0], rlo, rhi, 0, leaf+1);
+  PtrMatrix SMat = get_raw_pointer(regions[2], p[0]*Srblk, (p[0]+1)*Srblk,
+				   0, 2*rmax+1);
+  PtrMatrix XMat = get_raw_pointer(regions[4], rlo, rhi, 0,
+				   args.blocks ? leaf : 1);
+  // no u columns if the tree is one leaf
+  PtrMatrix UMat, ZMat, WMat;
+  if (nz > 0) {
+    UMat = get_raw_pointer(regions[1], rlo, rhi, args.colIdx,
+			   args.colIdx+nz);
+    assert(KMat.LD() == UMat.LD());
+    // with spd, z = A_c \ u are the factored u columns
+    ZMat = args.spd ? UMat : get_raw_pointer(regions[3], rlo, rhi, 0, nz);
+  }
+  if (ncol > 0)
+    WMat = get_raw_pointer(regions[3], rlo, rhi, args.wcol, args.wcol+ncol);
+  if (!args.spd && nz > 0) {
+    int vcol = region_bounds(regions[5], ctx, runtime).hi[1] + 1;
+    PtrMatrix VMat = get_raw_pointer(regions[5], rlo, rhi, 0, vcol);
+    assert(KMat.LD() == VMat.LD() && KMat.LD() == ZMat.LD());
+    zsweep(rblk, ncol, args.ranks, args.vcols, nPart, KMat.LD(),
+	   KMat.pointer(), KMat.pointer(0, leaf), UMat.pointer(),
+	   VMat.pointer(), ZMat.pointer(), SMat.LD(), 2*rmax,
+	   SMat.pointer());
+  }
+
+  // T = w*R for all depths
+  double *T = NULL;
+  if (nz > 0) {
+    T = (double *) malloc(rblk * nz * sizeof(double));
+    for (int j=0; j<ncol; j++)
+      for (int i=0; i<rblk; i++)
+	T[i+j*rblk] = WMat(i, j);
+    hcouple(rblk, ncol, args.ranks, nPart, KMat.LD(), UMat.pointer(),
+	    SMat.LD(), 2*rmax, SMat.pointer(), args.spd, T, rblk);
+  }
+
+  for (int l=0; l<nPart; l++) {
+    int lo = block_begin(rblk, nPart, l);
+    int n  = block_begin(rblk, nPart, l+1) - lo;
+    PtrMatrix Kinv(n, n);
+    Kinv.identity();
+    PtrMatrix Kl(n, n, KMat.LD(), KMat.pointer(lo, 0));
+    if (args.spd)
+      Kl.solve_cholesky(Kinv);
+    else
+      Kl.solve(Kinv, KMat.pointer(lo, leaf));
+    if (args.blocks) {
+      // the columns past a smaller leaf are zero
+      for (int j=0; j<leaf; j++)
+	for (int i=0; i<n; i++)
+	  XMat(lo+i, j) = j < n ? Kinv(i, j) : 0.0;
+      if (nz == 0) continue;
+      PtrMatrix Tl(n, nz, rblk, T+lo);
+      PtrMatrix Zl(n, nz, ZMat.LD(), ZMat.pointer(lo, 0));
+      PtrMatrix Xl(n, n, XMat.LD(), XMat.pointer(lo, 0));
+      Zl.set_trans('t');
+      PtrMatrix::gemm(-1.0, Tl, Zl, 1.0, Xl);
+    } else {
+      for (int i=0; i<n; i++) {
+	double x = Kinv(i, i);
+	for (int k=0; k<nz; k++)
+	  x -= T[lo+i+k*rblk] * ZMat(lo+i, k);
+	XMat(lo+i, 0) = x;
+      }
+    }
+  }
+  free(T);
+}
+
+// z = A_c' \ V for the bases of all depths, where A_c is the
+//  diagonal block of the child c of the node that uses the basis:
+//  like hsolve_transpose() in leaf_solve.cc, every node eliminates
+//  the ncol columns of the depths above it top down, and the leaf
+//  solve with K' ends it. W holds the factored u columns of all
+//  depths and Z the columns of V, both in the same order.
+static void zsweep
+(int nrow, int ncol, const int *rank, const int *vcol, int nPart,
+ int LD, double *K, double *P, double *W, double *V, double *Z,
+ int LDS, int Sblk, double *S) {
+  if (nPart==1) {
+    if (ncol == 0) return;
+    PtrMatrix ZMat(nrow, ncol, LD, Z);
+    PtrMatrix(nrow, nrow, LD, K).solve(ZMat, P, 't');
+    return;
+  }
+
+  int     half = nPart/2;
+  int     n0 = nrow/2;
+  int     n1 = nrow-n0;
+  double *z0 = Z;
+  double *z1 = Z  + n0;
+  double *w0 = W  + ncol*LD;
+  double *w1 = w0 + n0;
+  double *V0 = V  + vcol[0]*LD;
+  double *V1 = V0 + n0;
+  int     r  = rank[0];
+
+  if (ncol > 0) {
+    char   transa = 't';
+    char   transb = 'n';
+    double alpha  = 1.0;
+    double beta   = 0.0;
+
+    int     S_size = 2*r;
+    double *RHS  = (double *) malloc(S_size * ncol * sizeof(double));
+    double *eta0 = RHS;
+    double *eta1 = RHS + S_size/2;
+    blas::dgemm_(&transa, &transb, &r, &ncol, &n0, &alpha, w0, &LD, z0, &LD, &beta, eta0, &S_size);
+    blas::dgemm_(&transa, &transb, &r, &ncol, &n1, &alpha, w1, &LD, z1, &LD, &beta, eta1, &S_size);
+    node_system_solve(r, S, LDS, S+Sblk*LDS, 't', ncol,
+		      eta0, S_size, eta1, S_size);
+
+    transa =  'n';
+    alpha  = -1.0;
+    beta   =  1.0;
+    blas::dgemm_(&transa, &transb, &n0, &ncol, &r, &alpha, V0, &LD, eta1, &S_size, &beta, z0, &LD);
+    blas::dgemm_(&transa, &transb, &n1, &ncol, &r, &alpha, V1, &LD, eta0, &S_size, &beta, z1, &LD);
+    free(RHS);
+  }
+
+  zsweep(n0, ncol+r, rank+1, vcol+1, half, LD, K,    P,
+	 W,    V,    z0, LDS, Sblk, S+Sblk);
+  zsweep(n1, ncol+r, rank+1, vcol+1, half, LD, K+n0, P+n0,
+	 W+n0, V+n0, z1, LDS, Sblk, S+Sblk*half);
+}
+
+// T = w*R for the depths below the launch level, where R is the
+//  coupling block of the node system for the child that holds the
+//  rows (see node_coupling()); W and T start with the ncol columns
+//  of the depths above this node.
+static void hcouple
+(int nrow, int ncol, const int *rank, int nPart, int LD, double *W,
+ int LDS, int Sblk, double *S, bool spd, double *T, int LDT) {
+  if (nPart==1) return;
+
+  int     half = nPart/2;
+  int     n0 = nrow/2;
+  int     n1 = nrow-n0;
+  double *w0 = W  + ncol*LD;
+  double *w1 = w0 + n0;
+  double *T0 = T  + ncol*LDT;
+  double *T1 = T0 + n0;
+  int     r  = rank[0];
+
+  char   transa = 'n';
+  char   transb = 'n';
+  double alpha  = 1.0;
+  double beta   = 0.0;
+
+  int     S_size = 2*r;
+  double *R  = (double *) malloc(S_size * r * sizeof(double));
+  double *R0 = R;
+  double *R1 = R + S_size/2;
+  node_coupling(r, S, LDS, spd, R0, S_size, R1, S_size);
+  blas::dgemm_(&transa, &transb, &n0, &r, &r, &alpha, w0, &LD, R0, &S_size, &beta, T0, &LDT);
+  blas::dgemm_(&transa, &transb, &n1, &r, &r, &alpha, w1, &LD, R1, &S_size, &beta, T1, &LDT);
+  free(R);
+
+  hcouple(n0, ncol+r, rank+1, half, LD, W,    LDS, Sblk, S+Sblk,
+	  spd, T,    LDT);
+  hcouple(n1, ncol+r, rank+1, half, LD, W+n0, LDS, Sblk, S+Sblk*half,
+	  spd, T+n0, LDT);
+}
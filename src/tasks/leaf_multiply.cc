@@ -0,0 +1,147 @@
+#include "leaf_multiply.hpp"
+#include "ptr_matrix.hpp"
+#include "lapack_blas.hpp"
+#include "utility.hpp"
+#include <math.h>
+#include <stdlib.h> // for malloc()
+#include <algorithm> // for std::max() and std::swap()
+
+static Realm::Logger log_solver_tasks("solver_tasks");
+
+void hmultiply
+(char trans, double alpha, int nrow, int ncol, int nlevel, bool dense,
+ int nPart, const int *rank, const int *ucol, const int *vcol,
+ int LDK, double *K, int LDU, double *U, int LDV,
+ double *V, int LDX, double *x, int LDY, double *y);
+
+int LeafMultiplyTask::TASKID;
+
+LeafMultiplyTask::LeafMultiplyTask(Domain domain,
+				   TaskArgument global_arg,
+				   ArgumentMap arg_map,
+				   MappingTagID tag,
+				   Predicate pred,
+				   bool must,
+				   MapperID id)
+  
+  : IndexLauncher(TASKID, domain, global_arg,
+		  arg_map, pred, must, id, tag) {}
+
+void LeafMultiplyTask::register_tasks(void)
+{
+  TASKID = HighLevelRuntime::register_legion_task
+    <LeafMultiplyTask::cpu_task>(AUTO_GENERATE_ID,
+				 Processor::LOC_PROC, 
+				 false,
+				 true,
+				 AUTO_GENERATE_ID,
+				 TaskConfigOptions(true/*leaf*/),
+				 "Leaf_Multiply");
+
+#ifdef SHOW_REGISTER_TASKS
+  printf("Register task %d : Leaf_Multiply\n", TASKID);
+#endif
+}
+
+// regions: dense blocks, u columns, V, x and y
+void LeafMultiplyTask::cpu_task(const Task *task,
+				const std::vector<PhysicalRegion> &regions,
+				Context ctx, HighLevelRuntime *runtime) {
+
+  assert(regions.size() == 5);
+  assert(task->regions.size() == 5);
+  assert(task->arglen == sizeof(TaskArgs));
+  log_solver_tasks.print("Inside leaf multiply tasks.");
+
+  const TaskArgs args = *((const TaskArgs*)task->args);
+  assert(args.nlevel <= log2(args.nPart));
+  Rect<2> Krect = region_bounds(regions[0], ctx, runtime);
+  int rlo  = Krect.lo[0];
+  int rhi  = Krect.hi[0] + 1;
+  // all columns of K, which may include the pivot column
+  int kcol = Krect.hi[1] + 1;
+  int ucol = region_bounds(regions[1], ctx, runtime).hi[1] + 1;
+  int vcol = region_bounds(regions[2], ctx, runtime).hi[1] + 1;
+  PtrMatrix KMat = get_raw_pointer(regions[0], rlo, rhi, 0, kcol);
+  PtrMatrix UMat = get_raw_pointer(regions[1], rlo, rhi, 0, ucol);
+  PtrMatrix VMat = get_raw_pointer(regions[2], rlo, rhi, 0, vcol);
+  PtrMatrix XMat = get_raw_pointer(regions[3], rlo, rhi, args.xcol,
+				   args.xcol+args.ncol);
+  PtrMatrix YMat = get_raw_pointer(regions[4], rlo, rhi, args.ycol,
+				   args.ycol+args.ncol);
+  hmultiply(args.trans, args.alpha, rhi-rlo, args.ncol, args.nlevel,
+	    args.dense, args.nPart, args.ranks, args.ucols, args.vcols,
+	    KMat.LD(), KMat.pointer(), UMat.LD(), UMat.pointer(),
+	    VMat.LD(), VMat.pointer(), XMat.LD(), XMat.pointer(),
+	    YMat.LD(), YMat.pointer());
+  if (args.dense && args.sigma != 0.0)
+    PtrMatrix::add(args.alpha*args.sigma, XMat, 1.0, YMat, YMat);
+}
+
+// y += alpha*op(A)*x for a subtree with nPart leaves, where rank[k]
+//  is the rank k levels below this node with u columns starting
+//  at ucol[k] and V columns at vcol[k]; the off-diagonal blocks of
+//  op(A) are
+// --               --        --               --
+// |   0      u0*V1' |        |   0      V0*u1' |
+// |                 |   or   |                 |
+// | u1*V0'     0    |        | V1*u0'     0    |
+// --               --        --               --
+//  for 'n' and 't', respectively
+void hmultiply
+(char trans, double alpha, int nrow, int ncol, int nlevel, bool dense,
+ int nPart, const int *rank, const int *ucol, const int *vcol,
+ int LDK, double *K, int LDU, double *U, int LDV,
+ double *V, int LDX, double *x, int LDY, double *y) {
+
+  if (nPart==1) {
+    if (!dense) return;
+    char   transb = 'n';
+    double beta   = 1.0;
+    blas::dgemm_(&trans, &transb, &nrow, &ncol, &nrow, &alpha,
+		 K, &LDK, x,
+		 &LDX, &beta, y, &LDY);
+    return;
+  }
+
+  // recursively multiply two children; the left child
+  //  has nrow/2 rows (see block_begin())
+  assert(nPart%2==0);
+  int half = nPart/2;
+  int n0   = nrow/2;
+  int n1   = nrow-n0;
+  if (nlevel > 0) {
+    // the left and right factors of the blocks
+    int r = rank[0];
+    int LDL = LDU, LDR = LDV;
+    double *L = U + ucol[0]*LDU;
+    double *R = V + vcol[0]*LDV;
+    if (trans == 't') {
+      std::swap(LDL, LDR);
+      std::swap(L, R);
+    }
+    double *L0 = L, *L1 = L+n0;
+    double *R0 = R, *R1 = R+n0;
+    double *W = (double *) malloc(2*r * ncol * sizeof(double));
+    double *W0 = W, *W1 = W + r*ncol;
+    char   transa = 't', transb = 'n';
+    double one    = 1.0, zero = 0.0;
+    blas::dgemm_(&transa, &transb, &r, &ncol, &n0, &one,
+		 R0, &LDR, x,    &LDX, &zero, W0, &r);
+    blas::dgemm_(&transa, &transb, &r, &ncol, &n1, &one,
+		 R1, &LDR, x+n0, &LDX, &zero, W1, &r);
+    transa = 'n';
+    blas::dgemm_(&transa, &transb, &n0, &ncol, &r, &alpha,
+		 L0, &LDL, W1, &r, &one, y, &LDY);
+    blas::dgemm_(&transa, &transb, &n1, &ncol, &r, &alpha,
+		 L1, &LDL, W0, &r, &one, y+n0, &LDY);
+    free(W);
+  } else if (!dense) {
+    return;
+  }
+  int nsub = std::max(nlevel-1, 0);
+  hmultiply(trans, alpha, n0, ncol, nsub, dense, half, rank+1, ucol+1,
+	    vcol+1, LDK, K,    LDU, U,    LDV, V,    LDX, x,    LDY, y);
+  hmultiply(trans, alpha, n1, ncol, nsub, dense, half, rank+1, ucol+1,
+	    vcol+1, LDK, K+n0, LDU, U+n0, LDV, V+n0, LDX, x+n0, LDY, y+n0);
+}
@@ -0,0 +1,87 @@
+#include "leaf_shift.hpp"
+#include "ptr_matrix.hpp"
+#include "utility.hpp"
+#include <math.h>
+
+static Realm::Logger log_solver_tasks("solver_tasks");
+
+template <typename T>
+void hsolve
+(int nrow, int nrhs, const int *rank, const int *vcol, int nPart,
+ int LD, T *K, T *U, T *V, bool copy, T sigma,
+ int nShared, const int *shared);
+
+int LeafShiftTask::TASKID;
+
+LeafShiftTask::LeafShiftTask(Domain domain,
+			     TaskArgument global_arg,
+			     ArgumentMap arg_map,
+			     MappingTagID tag,
+			     Predicate pred,
+			     bool must,
+			     MapperID id)
+
+  : IndexLauncher(TASKID, domain, global_arg,
+		  arg_map, pred, must, id, tag) {}
+
+void LeafShiftTask::register_tasks(void)
+{
+  TASKID = HighLevelRuntime::register_legion_task
+    <LeafShiftTask::cpu_task>(AUTO_GENERATE_ID,
+			      Processor::LOC_PROC,
+			      false,
+			      true,
+			      AUTO_GENERATE_ID,
+			      TaskConfigOptions(true/*leaf*/),
+			      "Leaf_Shift");
+
+#ifdef SHOW_REGISTER_TASKS
+  printf("Register task %d : Leaf_Shift\n", TASKID);
+#endif
+}
+
+// regions: dense blocks, the right hand side with the u columns
+//  (the first ncol columns), V and the shift blocks, where block
+//  k takes columns [k*ncol, (k+1)*ncol)
+void LeafShiftTask::cpu_task(const Task *task,
+			     const std::vector<PhysicalRegion> &regions,
+			     Context ctx, HighLevelRuntime *runtime) {
+
+  assert(regions.size() == 4);
+  assert(task->regions.size() == 4);
+  assert(task->arglen == sizeof(TaskArgs));
+  log_solver_tasks.print("Inside leaf shift tasks.");
+
+  const TaskArgs args = *((const TaskArgs*)task->args);
+  int ncol   = args.ncol;
+  int nPart  = args.nPart;
+  int nShift = args.nShift;
+  int level  = log2(nPart);
+  // u columns of this subtree
+  int ucol   = 0;
+  for (int i=0; i<level; i++)
+    ucol += args.ranks[i];
+  assert(0 < nShift && nShift <= MAX_SHIFTS);
+  assert(nPart==(int)pow(2,level));
+
+  Rect<2> Krect = region_bounds(regions[0], ctx, runtime);
+  int rlo  = Krect.lo[0];
+  int rhi  = Krect.hi[0] + 1;
+  int rblk = rhi - rlo;
+  int leaf = Krect.hi[1];
+  int vcol = region_bounds(regions[2], ctx, runtime).hi[1] + 1;
+  PtrMatrix KMat = get_raw_pointer(regions[0], rlo, rhi, 0, leaf);
+  PtrMatrix UMat = get_raw_pointer(regions[1], rlo, rhi, 0, ncol);
+  PtrMatrix VMat = get_raw_pointer(regions[2], rlo, rhi, 0, vcol);
+  PtrMatrix WMat = get_raw_pointer(regions[3], rlo, rhi, 0, nShift*ncol);
+  assert(KMat.LD() == WMat.LD());
+  assert(KMat.LD() == VMat.LD());
+  for (int k=0; k<nShift; k++) {
+    for (int j=0; j<ncol; j++)
+      for (int i=0; i<rblk; i++)
+	WMat(i, k*ncol+j) = UMat(i, j);
+    hsolve(rblk, ncol-ucol, args.ranks, args.vcols, nPart, KMat.LD(),
+	   KMat.pointer(), WMat.pointer(0, k*ncol), VMat.pointer(),
+	   true, args.shifts[k], args.nShared, args.shared);
+  }
+}
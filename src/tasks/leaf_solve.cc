@@ -1,147 +1,315 @@
 #include "leaf_solve.hpp"
 #include "ptr_matrix.hpp"
+#include "small_kernels.hpp"
+#include "node_system.hpp"
 #include "utility.hpp"
 #include <math.h>
+#include <algorithm> // for std::max()
 
 static Realm::Logger log_solver_tasks("solver_tasks");
 
+template <typename T>
 void hsolve
-(int nrow, int nrhs, int rank, int nPart, int LD,
- double *K, double *U, double *V);
+(int nrow, int nrhs, const int *rank, const int *vcol, int nPart,
+ int LD, T *K, T *U, T *V, bool copy, T sigma,
+ int nShared, const int *shared);
+
+int leaf_columns
+(int ncol, int nShared, const int *shared, int *lo, int *hi);
+
+template <typename T>
+void leaf_copy
+(int nrow, int ncol, int LD, T *B, int nShared, const int *shared);
+
+template <typename T>
+void hsolve
+(int nrow, int nrhs, const int *rank, const int *vcol, int nPart,
+ int LD, T *K, T *P, T *d, T *u, T *V,
+ int LDS, int Sblk, T *S, T *b);
+
+template <typename T>
+void hsolve_transpose
+(int nrow, int nrhs, const int *rank, const int *vcol, int nPart,
+ int LD, T *K, T *P, T *d, T *u, T *V,
+ int LDS, int Sblk, T *S);
   
-int LeafSolveTask::TASKID;
-
-LeafSolveTask::LeafSolveTask(Domain domain,
-			     TaskArgument global_arg,
-			     ArgumentMap arg_map,
-			     MappingTagID tag,
-			     Predicate pred,
-			     bool must,
-			     MapperID id)
+template <typename T>
+int LeafSolveTaskT<T>::TASKID;
+
+template <typename T>
+LeafSolveTaskT<T>::LeafSolveTaskT(Domain domain,
+				  TaskArgument global_arg,
+				  ArgumentMap arg_map,
+				  MappingTagID tag,
+				  Predicate pred,
+				  bool must,
+				  MapperID id)
   
   : IndexLauncher(TASKID, domain, global_arg,
 		  arg_map, pred, must, id, tag) {}
 
-void LeafSolveTask::register_tasks(void)
+template <typename T>
+void LeafSolveTaskT<T>::register_tasks(void)
 {
+  const char* name = task_name("Leaf_Solve", scalar_type_of<T>::value);
   TASKID = HighLevelRuntime::register_legion_task
-    <LeafSolveTask::cpu_task>(AUTO_GENERATE_ID,
-			    Processor::LOC_PROC, 
-			    false,
-			    true,
-			    AUTO_GENERATE_ID,
-			    TaskConfigOptions(true/*leaf*/),
-			    "Leaf_Solve");
+    <LeafSolveTaskT<T>::cpu_task>(AUTO_GENERATE_ID,
+				  Processor::LOC_PROC,
+				  false,
+				  true,
+				  AUTO_GENERATE_ID,
+				  TaskConfigOptions(true/*leaf*/),
+				  name);
 
 #ifdef SHOW_REGISTER_TASKS
-  printf("Register task %d : Leaf_Solve\n", TASKID);
+  printf("Register task %d : %s\n", TASKID, name);
 #endif
 }
 
-void LeafSolveTask::cpu_task(const Task *task,
-			     const std::vector<PhysicalRegion> &regions,
-			     Context ctx, HighLevelRuntime *runtime) {
+template <typename T>
+void LeafSolveTaskT<T>::cpu_task(const Task *task,
+				 const std::vector<PhysicalRegion> &regions,
+				 Context ctx, HighLevelRuntime *runtime) {
 
-  assert(regions.size() == 3);
-  assert(task->regions.size() == 3);
   assert(task->arglen == sizeof(TaskArgs));
+  const TaskArgs args = *((const TaskArgs*)task->args);
+  assert(regions.size() == (args.factored && !args.spd ? 4 : 3));
+  assert(task->regions.size() == regions.size());
   Point<1> p = task->index_point.get_point<1>();  
   log_solver_tasks.print("Inside leaf solve tasks.");
 
-  const TaskArgs args = *((const TaskArgs*)task->args);
-  int rblk  = args.nrow;
   int nRhs  = args.nRhs;
-  int rank  = args.rank;
   int nPart = args.nPart;
   int level = log2(nPart);
-  //assert(rank*nPart==rblk);
-  int rlo = p[0]*rblk;
-  int rhi = (p[0] + 1) * rblk;
-  PtrMatrix KMat = get_raw_pointer(regions[0], rlo, rhi, 0, rblk/nPart);
-  PtrMatrix UMat = get_raw_pointer(regions[1], rlo, rhi, 0, nRhs);
-  PtrMatrix VMat = get_raw_pointer(regions[2], rlo, rhi, 0, rank);
+  // u columns of this subtree and the widest node system
+  int ucol  = 0;
+  int rmax  = 0;
+  for (int i=0; i<level; i++) {
+    ucol += args.ranks[i];
+    rmax  = std::max(rmax, args.ranks[i]);
+  }
+  // rows of this partition; the last column of the dense
+  //  blocks is past the largest leaf
+  Rect<2> Krect = region_bounds(regions[0], ctx, runtime);
+  int rlo  = Krect.lo[0];
+  int rhi  = Krect.hi[0] + 1;
+  int rblk = rhi - rlo;
+  int leaf = Krect.hi[1];
+  if (args.spd) {
+    // regions: symmetric factors, right hand side (with the u
+    //  columns and the copy of b) and the node factors
+    assert(args.factored);
+    int Srblk = args.Srblk;
+    PtrMatrixT<T> KMat = get_raw_pointer<T>(regions[0], rlo, rhi, 0, leaf+1);
+    PtrMatrixT<T> dMat = get_raw_pointer<T>(regions[1], rlo, rhi, 0, nRhs);
+    PtrMatrixT<T> bMat = get_raw_pointer<T>(regions[1], rlo, rhi, args.bcol,
+					    args.bcol+nRhs);
+    PtrMatrixT<T> uMat;
+    if (level > 0)
+      uMat = get_raw_pointer<T>(regions[1], rlo, rhi, args.colIdx,
+				args.colIdx+ucol);
+    PtrMatrixT<T> SMat = get_raw_pointer<T>(regions[2], p[0]*Srblk,
+					    (p[0]+1)*Srblk, 0, 2*rmax+1);
+    assert(KMat.LD() == bMat.LD());
+    hsolve<T>(rblk, nRhs, args.ranks, args.vcols, nPart, KMat.LD(),
+	      KMat.pointer(), KMat.pointer(0, leaf), dMat.pointer(),
+	      uMat.pointer(), NULL, SMat.LD(), 2*rmax,
+	      SMat.pointer(), bMat.pointer());
+    return;
+  }
+  // all bases in V
+  int vcol = region_bounds(regions[2], ctx, runtime).hi[1] + 1;
+  if (args.factored) {
+    int Srblk = args.Srblk;
+    PtrMatrixT<T> KMat = get_raw_pointer<T>(regions[0], rlo, rhi, 0, leaf+1);
+    PtrMatrixT<T> dMat = get_raw_pointer<T>(regions[1], rlo, rhi, 0, nRhs);
+    // no u columns if every partition is a leaf
+    PtrMatrixT<T> uMat;
+    if (level > 0)
+      uMat = get_raw_pointer<T>(regions[1], rlo, rhi, args.colIdx,
+				args.colIdx+ucol);
+    PtrMatrixT<T> VMat = get_raw_pointer<T>(regions[2], rlo, rhi, 0, vcol);
+    PtrMatrixT<T> SMat = get_raw_pointer<T>(regions[3], p[0]*Srblk,
+					    (p[0]+1)*Srblk, 0, 2*rmax+1);
+    if (args.trans) {
+      hsolve_transpose(rblk, nRhs, args.ranks, args.vcols, nPart,
+		       KMat.LD(), KMat.pointer(), KMat.pointer(0, leaf),
+		       dMat.pointer(), uMat.pointer(), VMat.pointer(),
+		       SMat.LD(), 2*rmax, SMat.pointer());
+      return;
+    }
+    hsolve<T>(rblk, nRhs, args.ranks, args.vcols, nPart, KMat.LD(),
+	      KMat.pointer(), KMat.pointer(0, leaf), dMat.pointer(),
+	      uMat.pointer(), VMat.pointer(), SMat.LD(), 2*rmax,
+	      SMat.pointer(), NULL);
+    return;
+  }
+  PtrMatrixT<T> KMat = get_raw_pointer<T>(regions[0], rlo, rhi, 0, leaf);
+  PtrMatrixT<T> UMat = get_raw_pointer<T>(regions[1], rlo, rhi, 0, nRhs);
+  PtrMatrixT<T> VMat = get_raw_pointer<T>(regions[2], rlo, rhi, 0, vcol);
   assert(KMat.LD() == UMat.LD());
   assert(KMat.LD() == VMat.LD());
   //std::cout<<"nPart:"<<nPart<<", level:"<<level<<std::endl;
   assert(nPart==(int)pow(2,level));
 #ifdef DEBUG_SOLVER
   std::cout<<"point:"<<p[0]<<std::endl;
-  std::cout<<"nrow:"<<rblk<<", nRhs:"<<nRhs<<", rank:"<<rank
+  std::cout<<"nrow:"<<rblk<<", nRhs:"<<nRhs<<", u columns:"<<ucol
 	   <<", nPart:"<<nPart<<", LD:"<<KMat.LD()<<std::endl;
 #endif
-  hsolve(rblk, nRhs-level*rank, rank, nPart, KMat.LD(),
-  	 KMat.pointer(), UMat.pointer(), VMat.pointer());
+  hsolve(rblk, nRhs-ucol, args.ranks, args.vcols, nPart, KMat.LD(),
+	 KMat.pointer(), UMat.pointer(), VMat.pointer(), false, T(0),
+	 args.nShared, args.shared);
+}
+
+// The u columns of the nShared depths above a leaf are the last
+//  columns at the leaf, root first, after the right hand sides.
+//  With a shared basis, depth k takes the leading shared[k]
+//  columns of one basis, so its leaf solve K \ u is the leading
+//  columns of that of the widest depth: only the other columns
+//  and the widest depth are solved, and leaf_copy() fills in the
+//  rest. Returns the number of column ranges [lo, hi) to solve.
+int leaf_columns
+(int ncol, int nShared, const int *shared, int *lo, int *hi) {
+  if (nShared == 0) {
+    lo[0] = 0;
+    hi[0] = ncol;
+    return 1;
+  }
+  int widest = 0;
+  int usize  = 0;
+  for (int k=0; k<nShared; k++) {
+    usize += shared[k];
+    if (shared[k] > shared[widest])
+      widest = k;
+  }
+  assert(usize <= ncol);
+  lo[0] = 0;
+  hi[0] = ncol-usize;
+  lo[1] = hi[0];
+  for (int k=0; k<widest; k++)
+    lo[1] += shared[k];
+  hi[1] = lo[1] + shared[widest];
+  return 2;
 }
 
+// copy the solution of the widest depth to the others, see
+//  leaf_columns()
+template <typename T>
+void leaf_copy
+(int nrow, int ncol, int LD, T *B, int nShared, const int *shared) {
+  if (nShared == 0) return;
+  int lo[2], hi[2];
+  leaf_columns(ncol, nShared, shared, lo, hi);
+  const T *src = B + lo[1]*LD;
+  T *dst = B + hi[0]*LD;
+  for (int k=0; k<nShared; k++) {
+    if (dst != src)
+      for (int j=0; j<shared[k]; j++)
+	for (int i=0; i<nrow; i++)
+	  dst[i+j*LD] = src[i+j*LD];
+    dst += shared[k]*LD;
+  }
+}
+
+// rank[k] is the rank k levels below this node and its basis
+//  starts at column vcol[k] of V. With copy, the leaf blocks are
+//  solved as K + sigma*I from a copy, so K is left intact for
+//  other shifts (see LeafShiftTask); otherwise K is overwritten
+//  by its LU factors and sigma must be zero. With a shared basis
+//  the leaves are solved only once for the u columns of all
+//  depths (see leaf_columns())
+template <typename T>
 void hsolve
-(int nrow, int nrhs, int rank, int nPart, int LD,
- double *K, double *U, double *V) {
+(int nrow, int nrhs, const int *rank, const int *vcol, int nPart,
+ int LD, T *K, T *U, T *V, bool copy, T sigma,
+ int nShared, const int *shared) {
 #ifdef DEBUG_SOLVER
-  std::cout<<"nrow:"<<nrow<<", nRhs:"<<nrhs<<", rank:"<<rank
+  std::cout<<"nrow:"<<nrow<<", nRhs:"<<nrhs<<", rank:"<<rank[0]
 	   <<", nPart:"<<nPart<<", LD:"<<LD<<std::endl;
 #endif
   if (nPart==1) {
+    char    trans = 'n';
     int     N    = nrow;
-    int     NRHS = nrhs;
     int     LDA  = LD;
     int     LDB  = LD;
-    double *A    = K;
-    double *B    = U;
+    T      *A    = K;
     int     INFO;
     int     IPIV[N];
-    lapack::dgesv_(&N, &NRHS, A, &LDA, IPIV, B, &LDB, &INFO);
+    if (copy) {
+      LDA = N;
+      A   = (T *) malloc(N * N * sizeof(T));
+      for (int j=0; j<N; j++) {
+	for (int i=0; i<N; i++)
+	  A[i+j*N] = K[i+j*LD];
+	A[j+j*N] += sigma;
+      }
+    } else
+      assert(sigma == T(0));
+    lapack::getrf(&N, &N, A, &LDA, IPIV, &INFO);
     assert(INFO == 0);
+    int lo[2], hi[2];
+    int nRange = leaf_columns(nrhs, nShared, shared, lo, hi);
+    for (int k=0; k<nRange; k++) {
+      int NRHS = hi[k]-lo[k];
+      if (NRHS == 0) continue;
+      lapack::getrs(&trans, &N, &NRHS, A, &LDA, IPIV, U+lo[k]*LD, &LDB,
+		    &INFO);
+      assert(INFO == 0);
+    }
+    leaf_copy(N, nrhs, LD, U, nShared, shared);
+    if (copy)
+      free(A);
     return;
   }
 
-  // recursively solve two children
-  assert(nrow%2==0);
+  // recursively solve two children; the left child
+  //  has nrow/2 rows (see block_begin())
   assert(nPart%2==0);
-  double *d0 = U;
-  double *d1 = U  + nrow/2;
-  double *V0 = V;
-  double *V1 = V  + nrow/2;
-  double *u0 = d0 + nrhs*LD;
-  double *u1 = d1 + nrhs*LD;
-  hsolve(nrow/2, nrhs+rank, rank, nPart/2, LD, K,        d0, V0);
-  hsolve(nrow/2, nrhs+rank, rank, nPart/2, LD, K+nrow/2, d1, V1);
+  int     n0 = nrow/2;
+  int     n1 = nrow-n0;
+  T      *d0 = U;
+  T      *d1 = U  + n0;
+  T      *V0 = V  + vcol[0]*LD;
+  T      *V1 = V0 + n0;
+  T      *u0 = d0 + nrhs*LD;
+  T      *u1 = d1 + nrhs*LD;
+  hsolve(n0, nrhs+rank[0], rank+1, vcol+1, nPart/2, LD, K,    d0, V,
+	 copy, sigma, nShared, shared);
+  hsolve(n1, nrhs+rank[0], rank+1, vcol+1, nPart/2, LD, K+n0, d1, V+n0,
+	 copy, sigma, nShared, shared);
 
   char   transa = 't';
   char   transb = 'n';
-  double alpha  = 1.0;
-  double beta   = 0.0;
+  T      alpha  = 1.0;
+  T      beta   = 0.0;
 
-  int V0_rows = nrow/2, V1_rows = nrow/2;
-  int V0_cols = rank,   V1_cols = rank;
-  int u0_rows = nrow/2, u1_rows = nrow/2;
-  int u0_cols = rank,   u1_cols = rank;
+  int V0_rows = n0,     V1_rows = n1;
+  int V0_cols = rank[0], V1_cols = rank[0];
+  int u0_rows = n0,     u1_rows = n1;
+  int u0_cols = rank[0], u1_cols = rank[0];
   //int d0_rows = nrow, d1_rows = nrow;
   int d0_cols = nrhs,   d1_cols = nrhs;
 
-  // form the Schur complement, refer to the algorithm in HMatrix.cc
-  int     S_size = 2*rank;
-  double *S   = (double *) calloc(S_size * S_size, sizeof(double));
-  double *RHS = (double *) malloc(S_size * nrhs * sizeof(double));
-  for (int i=0; i<S_size; i++) {
-    S[S_size*i+i] = 1.0;
-  }
+  // form the node system, refer to the algorithm in HMatrix.cc,
+  //  and eliminate through its Schur complement
+  int     r   = rank[0];
+  T      *VTu = (T *) malloc(2 * r * r * sizeof(T));
+  T      *RHS = (T *) malloc(2 * r * nrhs * sizeof(T));
+  T      *V0Tu0 = VTu;
+  T      *V1Tu1 = VTu + r*r;
+  T      *V0Td0 = RHS;
+  T      *V1Td1 = RHS + r;
+  int     S_size = 2*r;
   
-  // set the pointers
-  double *V0Tu0 = S + S_size/2;
-  double *V1Tu1 = S + S_size/2*S_size;
-  double *V0Td0 = RHS + S_size/2;
-  double *V1Td1 = RHS;
-  
-  blas::dgemm_(&transa, &transb, &V0_cols, &u0_cols, &V0_rows, &alpha, V0, &LD, u0, &LD, &beta, V0Tu0, &S_size);
-  blas::dgemm_(&transa, &transb, &V1_cols, &u1_cols, &V1_rows, &alpha, V1, &LD, u1, &LD, &beta, V1Tu1, &S_size);
-  blas::dgemm_(&transa, &transb, &V0_cols, &d0_cols, &V0_rows, &alpha, V0, &LD, d0, &LD, &beta, V0Td0, &S_size);
-  blas::dgemm_(&transa, &transb, &V1_cols, &d1_cols, &V1_rows, &alpha, V1, &LD, d1, &LD, &beta, V1Td1, &S_size);
+  blas::gemm(&transa, &transb, &V0_cols, &u0_cols, &V0_rows, &alpha, V0, &LD, u0, &LD, &beta, V0Tu0, &r);
+  blas::gemm(&transa, &transb, &V1_cols, &u1_cols, &V1_rows, &alpha, V1, &LD, u1, &LD, &beta, V1Tu1, &r);
+  blas::gemm(&transa, &transb, &V0_cols, &d0_cols, &V0_rows, &alpha, V0, &LD, d0, &LD, &beta, V0Td0, &S_size);
+  blas::gemm(&transa, &transb, &V1_cols, &d1_cols, &V1_rows, &alpha, V1, &LD, d1, &LD, &beta, V1Td1, &S_size);
 
-  int INFO;
-  int IPIV[S_size];
   assert(d0_cols == d1_cols);
-  lapack::dgesv_(&S_size, &d0_cols, S, &S_size, IPIV, RHS, &S_size, &INFO);
-  assert(INFO == 0);
+  node_system_solve(r, V0Tu0, r, V1Tu1, r, d0_cols,
+		    V0Td0, S_size, V1Td1, S_size);
+  free(VTu);
 
   transa =  'n';
   alpha  = -1.0;
@@ -149,10 +317,178 @@ void hsolve
 
   //int eta0_rows = S_size/2, eta1_rows = S_size/2;
   int eta0_cols = d0_cols,  eta1_cols = d0_cols;
-  double *eta0 = V1Td1;
-  double *eta1 = V0Td0;
+  T      *eta0 = V0Td0;
+  T      *eta1 = V1Td1;
   
-  blas::dgemm_(&transa, &transb, &u0_rows, &eta0_cols, &u0_cols, &alpha, u0, &LD, eta0, &S_size, &beta, d0, &LD);
-  blas::dgemm_(&transa, &transb, &u1_rows, &eta1_cols, &u1_cols, &alpha, u1, &LD, eta1, &S_size, &beta, d1, &LD);
+  blas::gemm(&transa, &transb, &u0_rows, &eta0_cols, &u0_cols, &alpha, u0, &LD, eta0, &S_size, &beta, d0, &LD);
+  blas::gemm(&transa, &transb, &u1_rows, &eta1_cols, &u1_cols, &alpha, u1, &LD, eta1, &S_size, &beta, d1, &LD);
+  free(RHS);
+}
+
+
+// solve with the factors computed in hfactor() (see leaf_factor.cc):
+//  only the nrhs columns in d are touched, and u points to the
+//  (factored) u columns of this subtree.
+// With the symmetric factors, b points to the original right hand
+//  side and V is not used: V'*d = u'*b (see HMatrix::solve()).
+template <typename T>
+void hsolve
+(int nrow, int nrhs, const int *rank, const int *vcol, int nPart,
+ int LD, T *K, T *P, T *d, T *u, T *V,
+ int LDS, int Sblk, T *S, T *b) {
+  bool spd = (b != NULL);
+  if (nPart==1 && spd) {
+    PtrMatrixT<T> dMat(nrow, nrhs, LD, d);
+    PtrMatrixT<T>(nrow, nrow, LD, K).solve_cholesky(dMat);
+    return;
+  }
+  if (nPart==1) {
+    PtrMatrixT<T> dMat(nrow, nrhs, LD, d);
+    PtrMatrixT<T>(nrow, nrow, LD, K).solve(dMat, P);
+    return;
+  }
+
+  int     half = nPart/2;
+  int     n0 = nrow/2;
+  int     n1 = nrow-n0;
+  T      *d0 = d;
+  T      *d1 = d  + n0;
+  T      *u0 = u;
+  T      *u1 = u  + n0;
+  T      *b0 = b;
+  T      *b1 = spd ? b + n0 : NULL;
+  T      *V0 = spd ? NULL : V + vcol[0]*LD;
+  T      *V1 = spd ? NULL : V0 + n0;
+  T      *Vc = spd ? NULL : V + n0;
+  int     r  = rank[0];
+  hsolve(n0, nrhs, rank+1, vcol+1, half, LD, K,    P,
+	 d0, u0+r*LD, V,  LDS, Sblk, S+Sblk,      b0);
+  hsolve(n1, nrhs, rank+1, vcol+1, half, LD, K+n0, P+n0,
+	 d1, u1+r*LD, Vc, LDS, Sblk, S+Sblk*half, b1);
+
+  char   transa = 't';
+  char   transb = 'n';
+  T      alpha  = 1.0;
+  T      beta   = 0.0;
+
+  int     S_size = 2*r;
+  T      *RHS = (T *) malloc(S_size * nrhs * sizeof(T));
+  // unrolled kernels for small ranks
+  const SmallKernelsT<T> *small = small_kernels<T>(r);
+  if (spd) {
+    T *V0Td0 = RHS;
+    T *V1Td1 = RHS + S_size/2;
+    blas::gemm(&transa, &transb, &r, &nrhs, &n0, &alpha, u0, &LD, b0, &LD, &beta, V0Td0, &S_size);
+    blas::gemm(&transa, &transb, &r, &nrhs, &n1, &alpha, u1, &LD, b1, &LD, &beta, V1Td1, &S_size);
+    PtrMatrixT<T> B(S_size, nrhs, S_size, RHS);
+    PtrMatrixT<T>(S_size, S_size, LDS, S).solve_symmetric(B, S+Sblk*LDS);
+  } else {
+    T *V0Td0 = RHS;
+    T *V1Td1 = RHS + S_size/2;
+    if (small) {
+      small->gemm_tn(n0, nrhs, V0, LD, d0, LD, V0Td0, S_size);
+      small->gemm_tn(n1, nrhs, V1, LD, d1, LD, V1Td1, S_size);
+    } else {
+      blas::gemm(&transa, &transb, &r, &nrhs, &n0, &alpha, V0, &LD, d0, &LD, &beta, V0Td0, &S_size);
+      blas::gemm(&transa, &transb, &r, &nrhs, &n1, &alpha, V1, &LD, d1, &LD, &beta, V1Td1, &S_size);
+    }
+    node_system_solve(r, S, LDS, S+Sblk*LDS, 'n', nrhs,
+		      V0Td0, S_size, V1Td1, S_size);
+  }
+
+  transa =  'n';
+  alpha  = -1.0;
+  beta   =  1.0;
+  // the solution is in the natural order for both systems
+  T      *eta0 = RHS;
+  T      *eta1 = RHS + S_size/2;
+  if (small) {
+    small->gemm_nn_sub(n0, nrhs, u0, LD, eta0, S_size, d0, LD);
+    small->gemm_nn_sub(n1, nrhs, u1, LD, eta1, S_size, d1, LD);
+  } else {
+    blas::gemm(&transa, &transb, &n0, &nrhs, &r, &alpha, u0, &LD, eta0, &S_size, &beta, d0, &LD);
+    blas::gemm(&transa, &transb, &n1, &nrhs, &r, &alpha, u1, &LD, eta1, &S_size, &beta, d1, &LD);
+  }
+  free(RHS);
 }
 
+// solve A'*x = d with the factors from hfactor(): every node is
+//  A = diag(A0, A1) * (I + [0, w0*V1'; w1*V0', 0]) with w = A \ u
+//  for the children, so A' = (I + [0, V0*w1'; V1*w0', 0]) *
+//  diag(A0', A1') and the nodes are eliminated top down. The
+//  inverse of the first factor only needs the transposed node
+//  system, i.e., S'*eta = [w0'*d0; w1'*d1] and then
+//  d0 -= V0*eta1, d1 -= V1*eta0.
+template <typename T>
+void hsolve_transpose
+(int nrow, int nrhs, const int *rank, const int *vcol, int nPart,
+ int LD, T *K, T *P, T *d, T *u, T *V,
+ int LDS, int Sblk, T *S) {
+  if (nPart==1) {
+    PtrMatrixT<T> dMat(nrow, nrhs, LD, d);
+    PtrMatrixT<T>(nrow, nrow, LD, K).solve(dMat, P, 't');
+    return;
+  }
+
+  int     half = nPart/2;
+  int     n0 = nrow/2;
+  int     n1 = nrow-n0;
+  T      *d0 = d;
+  T      *d1 = d  + n0;
+  T      *u0 = u;
+  T      *u1 = u  + n0;
+  T      *V0 = V  + vcol[0]*LD;
+  T      *V1 = V0 + n0;
+  int     r  = rank[0];
+
+  char   transa = 't';
+  char   transb = 'n';
+  T      alpha  = 1.0;
+  T      beta   = 0.0;
+
+  int     S_size = 2*r;
+  T      *RHS  = (T *) malloc(S_size * nrhs * sizeof(T));
+  T      *eta0 = RHS;
+  T      *eta1 = RHS + S_size/2;
+  // unrolled kernels for small ranks
+  const SmallKernelsT<T> *small = small_kernels<T>(r);
+  if (small) {
+    small->gemm_tn(n0, nrhs, u0, LD, d0, LD, eta0, S_size);
+    small->gemm_tn(n1, nrhs, u1, LD, d1, LD, eta1, S_size);
+    node_system_solve(r, S, LDS, S+Sblk*LDS, 't', nrhs,
+		      eta0, S_size, eta1, S_size);
+    small->gemm_nn_sub(n0, nrhs, V0, LD, eta1, S_size, d0, LD);
+    small->gemm_nn_sub(n1, nrhs, V1, LD, eta0, S_size, d1, LD);
+    free(RHS);
+  } else {
+    blas::gemm(&transa, &transb, &r, &nrhs, &n0, &alpha, u0, &LD, d0, &LD, &beta, eta0, &S_size);
+    blas::gemm(&transa, &transb, &r, &nrhs, &n1, &alpha, u1, &LD, d1, &LD, &beta, eta1, &S_size);
+    node_system_solve(r, S, LDS, S+Sblk*LDS, 't', nrhs,
+		      eta0, S_size, eta1, S_size);
+
+    transa =  'n';
+    alpha  = -1.0;
+    beta   =  1.0;
+    blas::gemm(&transa, &transb, &n0, &nrhs, &r, &alpha, V0, &LD, eta1, &S_size, &beta, d0, &LD);
+    blas::gemm(&transa, &transb, &n1, &nrhs, &r, &alpha, V1, &LD, eta0, &S_size, &beta, d1, &LD);
+    free(RHS);
+  }
+
+  hsolve_transpose(n0, nrhs, rank+1, vcol+1, half, LD, K,    P,
+		   d0, u0+r*LD, V,    LDS, Sblk, S+Sblk);
+  hsolve_transpose(n1, nrhs, rank+1, vcol+1, half, LD, K+n0, P+n0,
+		   d1, u1+r*LD, V+n0, LDS, Sblk, S+Sblk*half);
+}
+
+// the shifted, factored and square root leaves are in double
+template void hsolve
+(int nrow, int nrhs, const int *rank, const int *vcol, int nPart,
+ int LD, double *K, double *U, double *V, bool copy, double sigma,
+ int nShared, const int *shared);
+template void leaf_copy
+(int nrow, int ncol, int LD, double *B, int nShared, const int *shared);
+
+template class LeafSolveTaskT<float>;
+template class LeafSolveTaskT<double>;
+template class LeafSolveTaskT<complex_float>;
+template class LeafSolveTaskT<complex_double>;
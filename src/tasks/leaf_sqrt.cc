@@ -0,0 +1,246 @@
+#include "leaf_sqrt.hpp"
+#include "ptr_matrix.hpp"
+#include "utility.hpp"
+#include <math.h>
+#include <algorithm> // for std::max()
+
+static Realm::Logger log_solver_tasks("solver_tasks");
+
+double node_sqrt
+(int r, const double *P, int LDP, const double *Q, int LDQ,
+ double *X, int LDX, double *Y, int LDY);
+
+int leaf_columns
+(int ncol, int nShared, const int *shared, int *lo, int *hi);
+
+template <typename T>
+void leaf_copy
+(int nrow, int ncol, int LD, T *B, int nShared, const int *shared);
+
+static double hsqrt
+(int nrow, int ncol, const int *rank, int nPart, int LD, double *K,
+ double *U, int LDS, int Sblk, double *S, int nShared, const int *shared);
+
+static void hsqrt_multiply
+(char trans, int nrow, int nrhs, const int *rank, int nPart,
+ int LDK, double *K, int LDU, double *u, int LDB, double *B,
+ int LDS, int Sblk, double *S);
+
+int LeafSqrtTask::TASKID;
+
+LeafSqrtTask::LeafSqrtTask(Domain domain,
+			   TaskArgument global_arg,
+			   ArgumentMap arg_map,
+			   MappingTagID tag,
+			   Predicate pred,
+			   bool must,
+			   MapperID id)
+
+  : IndexLauncher(TASKID, domain, global_arg,
+		  arg_map, pred, must, id, tag) {}
+
+void LeafSqrtTask::register_tasks(void)
+{
+  TASKID = HighLevelRuntime::register_legion_task
+    <double, LeafSqrtTask::cpu_task>(AUTO_GENERATE_ID,
+				     Processor::LOC_PROC,
+				     false,
+				     true,
+				     AUTO_GENERATE_ID,
+				     TaskConfigOptions(true/*leaf*/),
+				     "Leaf_Sqrt");
+
+#ifdef SHOW_REGISTER_TASKS
+  printf("Register task %d : Leaf_Sqrt\n", TASKID);
+#endif
+}
+
+// regions: dense blocks (the last column is not used), u columns,
+//  the node factors below the launch level and, for 'n' and 't',
+//  B
+double LeafSqrtTask::cpu_task(const Task *task,
+			      const std::vector<PhysicalRegion> &regions,
+			      Context ctx, HighLevelRuntime *runtime) {
+
+  assert(task->arglen == sizeof(TaskArgs));
+  const TaskArgs args = *((const TaskArgs*)task->args);
+  assert(regions.size() == (args.op == 'f' ? 3 : 4));
+  assert(task->regions.size() == regions.size());
+  Point<1> p = task->index_point.get_point<1>();
+  log_solver_tasks.print("Inside leaf sqrt tasks.");
+
+  int ncol  = args.ncol;
+  int nPart = args.nPart;
+  int level = log2(nPart);
+  // u columns of this subtree and the widest node system
+  int ucol  = 0;
+  int rmax  = 0;
+  for (int i=0; i<level; i++) {
+    ucol += args.ranks[i];
+    rmax  = std::max(rmax, args.ranks[i]);
+  }
+  assert(nPart==(int)pow(2,level));
+  Rect<2> Krect = region_bounds(regions[0], ctx, runtime);
+  int rlo  = Krect.lo[0];
+  int rhi  = Krect.hi[0] + 1;
+  int rblk = rhi - rlo;
+  int leaf = Krect.hi[1];
+  int Srblk = args.Srblk;
+  PtrMatrix KMat = get_raw_pointer(regions[0], rlo, rhi, 0, leaf);
+  PtrMatrix SMat = get_raw_pointer(regions[2], p[0]*Srblk, (p[0]+1)*Srblk,
+				   0, 2*rmax+1);
+  if (args.op == 'f') {
+    PtrMatrix UMat = get_raw_pointer(regions[1], rlo, rhi, args.colIdx,
+				     args.colIdx+ncol+ucol);
+    assert(KMat.LD() == UMat.LD());
+    return hsqrt(rblk, ncol, args.ranks, nPart, KMat.LD(), KMat.pointer(),
+		 UMat.pointer(), SMat.LD(), 2*rmax, SMat.pointer(),
+		 args.nShared, args.shared);
+  }
+
+  assert(args.op == 'n' || args.op == 't');
+  // no u columns if every partition is a leaf
+  PtrMatrix uMat;
+  if (level > 0)
+    uMat = get_raw_pointer(regions[1], rlo, rhi, args.colIdx+ncol,
+			   args.colIdx+ncol+ucol);
+  PtrMatrix BMat = get_raw_pointer(regions[3], rlo, rhi, args.bcol,
+				   args.bcol+args.nRhs);
+  hsqrt_multiply(args.op, rblk, args.nRhs, args.ranks, nPart,
+		 KMat.LD(), KMat.pointer(), uMat.LD(), uMat.pointer(),
+		 BMat.LD(), BMat.pointer(), SMat.LD(), 2*rmax, SMat.pointer());
+  return 0.0;
+}
+
+// The factor W of A = W*W' follows the tree like hfactor() in
+//  leaf_factor.cc: a leaf is the Cholesky factor L of its block,
+//  and a node is W = diag(W0, W1) * (I + u*X*u'), where u is
+//  overwritten by diag(W0 \ u0, W1 \ u1) and X comes from u'*u
+//  (see node_sqrt()). The u columns of the ncol ancestors are
+//  eliminated by the inverses, L \ d at the leaves and
+//  d -= u*Y*(u'*d) at the nodes, which leaves them in the same
+//  state for the nodes above. X is stored in S in preorder, Sblk
+//  rows per node, like the node systems of hfactor(), and the
+//  leaf blocks keep their Cholesky factors. With a shared basis,
+//  the leaf solve is done once for the u columns of all depths
+//  (see leaf_columns() in leaf_solve.cc). Returns log|det| of the
+//  subtree.
+static double hsqrt
+(int nrow, int ncol, const int *rank, int nPart, int LD, double *K,
+ double *U, int LDS, int Sblk, double *S, int nShared, const int *shared) {
+  if (nPart==1) {
+    PtrMatrix KMat(nrow, nrow, LD, K);
+    double logdet = KMat.factor_cholesky();
+    int lo[2], hi[2];
+    int nRange = leaf_columns(ncol, nShared, shared, lo, hi);
+    for (int k=0; k<nRange; k++) {
+      if (hi[k] == lo[k]) continue;
+      PtrMatrix UMat(nrow, hi[k]-lo[k], LD, U+lo[k]*LD);
+      KMat.solve_triangular(UMat);
+    }
+    leaf_copy(nrow, ncol, LD, U, nShared, shared);
+    return logdet;
+  }
+
+  int     half = nPart/2;
+  int     n0   = nrow/2;
+  int     n1   = nrow-n0;
+  double *d0 = U;
+  double *d1 = U  + n0;
+  double *u0 = d0 + ncol*LD;
+  double *u1 = d1 + ncol*LD;
+  int     r    = rank[0];
+  double logdet =
+    hsqrt(n0, ncol+r, rank+1, half, LD, K,    d0, LDS, Sblk, S+Sblk,
+	  nShared, shared) +
+    hsqrt(n1, ncol+r, rank+1, half, LD, K+n0, d1, LDS, Sblk, S+Sblk*half,
+	  nShared, shared);
+
+  char   transa = 't';
+  char   transb = 'n';
+  double alpha  = 1.0;
+  double beta   = 0.0;
+
+  int     S_size = 2*r;
+  double *UTU = (double *) malloc(S_size * r * sizeof(double));
+  double *Y   = NULL;
+  if (ncol > 0)
+    Y = (double *) malloc(S_size * S_size * sizeof(double));
+  blas::dgemm_(&transa, &transb, &r, &r, &n0, &alpha, u0, &LD, u0, &LD, &beta, UTU,   &S_size);
+  blas::dgemm_(&transa, &transb, &r, &r, &n1, &alpha, u1, &LD, u1, &LD, &beta, UTU+r, &S_size);
+  logdet += node_sqrt(r, UTU, S_size, UTU+r, S_size, S, LDS, Y, S_size);
+  free(UTU);
+  if (ncol == 0) return logdet;
+
+  // eliminate the u columns of the ancestors
+  double *RHS = (double *) malloc(S_size * ncol * sizeof(double));
+  double *ETA = (double *) malloc(S_size * ncol * sizeof(double));
+  blas::dgemm_(&transa, &transb, &r, &ncol, &n0, &alpha, u0, &LD, d0, &LD, &beta, RHS,   &S_size);
+  blas::dgemm_(&transa, &transb, &r, &ncol, &n1, &alpha, u1, &LD, d1, &LD, &beta, RHS+r, &S_size);
+  transa = 'n';
+  blas::dgemm_(&transa, &transb, &S_size, &ncol, &S_size, &alpha, Y, &S_size, RHS, &S_size, &beta, ETA, &S_size);
+  alpha = -1.0;
+  beta  =  1.0;
+  blas::dgemm_(&transa, &transb, &n0, &ncol, &r, &alpha, u0, &LD, ETA,   &S_size, &beta, d0, &LD);
+  blas::dgemm_(&transa, &transb, &n1, &ncol, &r, &alpha, u1, &LD, ETA+r, &S_size, &beta, d1, &LD);
+  free(RHS);
+  free(ETA);
+  free(Y);
+  return logdet;
+}
+
+// B = W*B or W'*B with the factors from hsqrt(), where u points to
+//  the u columns of this subtree: W applies the nodes top down
+//  before the leaves, B += u*X*(u'*B), and W' = (I + u*X'*u') *
+//  diag(W0', W1') the leaves first and the nodes bottom up.
+static void hsqrt_multiply
+(char trans, int nrow, int nrhs, const int *rank, int nPart,
+ int LDK, double *K, int LDU, double *u, int LDB, double *B,
+ int LDS, int Sblk, double *S) {
+  if (nPart==1) {
+    PtrMatrix BMat(nrow, nrhs, LDB, B);
+    PtrMatrix(nrow, nrow, LDK, K).multiply_triangular(BMat, trans);
+    return;
+  }
+
+  int     half = nPart/2;
+  int     n0 = nrow/2;
+  int     n1 = nrow-n0;
+  double *u0 = u;
+  double *u1 = u  + n0;
+  double *B0 = B;
+  double *B1 = B  + n0;
+  int     r  = rank[0];
+  if (trans == 't') {
+    hsqrt_multiply(trans, n0, nrhs, rank+1, half, LDK, K,    LDU, u0+r*LDU,
+		   LDB, B0, LDS, Sblk, S+Sblk);
+    hsqrt_multiply(trans, n1, nrhs, rank+1, half, LDK, K+n0, LDU, u1+r*LDU,
+		   LDB, B1, LDS, Sblk, S+Sblk*half);
+  }
+
+  char   transa = 't';
+  char   transb = 'n';
+  double alpha  = 1.0;
+  double beta   = 0.0;
+
+  int     S_size = 2*r;
+  double *RHS = (double *) malloc(S_size * nrhs * sizeof(double));
+  double *ETA = (double *) malloc(S_size * nrhs * sizeof(double));
+  blas::dgemm_(&transa, &transb, &r, &nrhs, &n0, &alpha, u0, &LDU, B0, &LDB, &beta, RHS,   &S_size);
+  blas::dgemm_(&transa, &transb, &r, &nrhs, &n1, &alpha, u1, &LDU, B1, &LDB, &beta, RHS+r, &S_size);
+  transa = trans;
+  blas::dgemm_(&transa, &transb, &S_size, &nrhs, &S_size, &alpha, S, &LDS, RHS, &S_size, &beta, ETA, &S_size);
+  transa = 'n';
+  beta   = 1.0;
+  blas::dgemm_(&transa, &transb, &n0, &nrhs, &r, &alpha, u0, &LDU, ETA,   &S_size, &beta, B0, &LDB);
+  blas::dgemm_(&transa, &transb, &n1, &nrhs, &r, &alpha, u1, &LDU, ETA+r, &S_size, &beta, B1, &LDB);
+  free(RHS);
+  free(ETA);
+
+  if (trans == 'n') {
+    hsqrt_multiply(trans, n0, nrhs, rank+1, half, LDK, K,    LDU, u0+r*LDU,
+		   LDB, B0, LDS, Sblk, S+Sblk);
+    hsqrt_multiply(trans, n1, nrhs, rank+1, half, LDK, K+n0, LDU, u1+r*LDU,
+		   LDB, B1, LDS, Sblk, S+Sblk*half);
+  }
+}
@@ -0,0 +1,113 @@
+#include "node_factor.hpp"
+#include "ptr_matrix.hpp"
+#include "node_system.hpp"
+#include "utility.hpp"
+
+static Realm::Logger log_solver_tasks("solver_tasks");
+
+int NodeFactorTask::TASKID;
+
+NodeFactorTask::NodeFactorTask(Domain domain,
+			       TaskArgument global_arg,
+			       ArgumentMap arg_map,
+			       MappingTagID tag)
+  
+  : IndexLauncher(TASKID, domain, global_arg, arg_map,
+		  Predicate::TRUE_PRED, false, 0, tag) {}
+
+void NodeFactorTask::register_tasks(void)
+{
+  TASKID = HighLevelRuntime::register_legion_task
+    <double, NodeFactorTask::cpu_task>(AUTO_GENERATE_ID,
+			       Processor::LOC_PROC, 
+			       false,
+			       true,
+			       AUTO_GENERATE_ID,
+			       TaskConfigOptions(true/*leaf*/),
+			       "Node_Factor");
+
+#ifdef SHOW_REGISTER_TASKS
+  printf("Register task %d : Node_Factor\n", TASKID);
+#endif
+}
+
+// form the following matrix for every partition
+// --             --
+// |  I     V1'*u1 |
+// |               |
+// | V0'*u0   I    |
+// --             --
+// and store its LU factors, with the pivots in the last column;
+//  for a symmetric matrix (V=u before the solve), the rows are
+//  swapped into the symmetric system
+// --             --
+// | V0'*u0   I    |
+// |               |
+// |  I     V1'*u1 |
+// --             --
+//  with LDL' factors instead. A zero flag in the local argument
+//  keeps the factors in place, and only their log|det| is
+//  returned (see LMatrix::node_factor())
+double NodeFactorTask::cpu_task(const Task *task,
+			      const std::vector<PhysicalRegion> &regions,
+			      Context ctx, HighLevelRuntime *runtime) {
+
+  assert(regions.size() == 2);
+  assert(task->regions.size() == 2);
+  assert(task->arglen == sizeof(TaskArgs));
+  Point<1> p = task->index_point.get_point<1>();
+
+  log_solver_tasks.print("Inside node factor tasks.");
+
+  const TaskArgs args = *((const TaskArgs*)task->args);
+  int rblk  = args.rblock;
+  int Acols = args.Acols;
+  int rlo = p[0] * rblk;
+  int rhi = (p[0] + 1) * rblk;
+  
+  PtrMatrix AMat = get_raw_pointer(regions[0], rlo, rhi, 0, Acols);
+  PtrMatrix SMat = get_raw_pointer(regions[1], rlo, rhi, 0, rblk+1);
+
+  PtrMatrix S(rblk, rblk, SMat.LD(), SMat.pointer());
+
+  // the log-determinant of the blocks factorized before is
+  //  passed to the first node (see LMatrix::node_factor())
+  double logdet = 0.0;
+  if (p[0] == 0 && !task->futures.empty())
+    logdet = task->futures[0].get_result<double>();
+
+  assert(rblk%2==0);
+  int r = rblk / 2;
+  if (task->local_arglen > 0) {
+    assert(task->local_arglen == sizeof(char));
+    if (!*(const char*)task->local_args)
+      return logdet + (args.spd ? S.log_det_symmetric(SMat.pointer(0, rblk))
+		       : node_system_log_det(r, S.pointer(), S.LD()));
+  }
+
+  S.clear(0.0);
+  for (int i=0; i<rblk; i++)
+    S(i, i) = 1.0;
+  if (args.spd) {
+    S.clear(0.0);
+    for (int i=0; i<r; i++) {
+      S(r+i, i) = S(i, r+i) = 1.0;
+      for (int j=0; j<r; j++) {
+	S(i, j)     = AMat(i, j);
+	S(r+i, r+j) = AMat(r+i, j);
+      }
+    }
+    logdet += S.factor_symmetric( SMat.pointer(0, rblk), args.single );
+    return logdet;
+  }
+  for (int i=0; i<r; i++) {
+    for (int j=0; j<r; j++) {
+      S(r+i, j) = AMat(i, j);
+      S(i, r+j) = AMat(r+i, j);
+    }
+  }
+  // only the Schur complement is factorized (see node_system.hpp)
+  logdet += node_system_factor( r, S.pointer(), S.LD(),
+				SMat.pointer(0, rblk), args.single );
+  return logdet;
+}
@@ -0,0 +1,94 @@
+#include "node_inverse.hpp"
+#include "ptr_matrix.hpp"
+#include "node_system.hpp"
+#include "utility.hpp"
+
+static Realm::Logger log_solver_tasks("solver_tasks");
+
+void node_coupling
+(int r, const double *S, int LDS, bool spd,
+ double *R0, int LDR0, double *R1, int LDR1);
+
+int NodeInverseTask::TASKID;
+
+NodeInverseTask::NodeInverseTask(Domain domain,
+				 TaskArgument global_arg,
+				 ArgumentMap arg_map,
+				 MappingTagID tag)
+
+  : IndexLauncher(TASKID, domain, global_arg, arg_map,
+		  Predicate::TRUE_PRED, false, 0, tag) {}
+
+void NodeInverseTask::register_tasks(void)
+{
+  TASKID = HighLevelRuntime::register_legion_task
+    <NodeInverseTask::cpu_task>(AUTO_GENERATE_ID,
+				Processor::LOC_PROC,
+				false,
+				true,
+				AUTO_GENERATE_ID,
+				TaskConfigOptions(true/*leaf*/),
+				"Node_Inverse");
+
+#ifdef SHOW_REGISTER_TASKS
+  printf("Register task %d : Node_Inverse\n", TASKID);
+#endif
+}
+
+// regions: the node factors and the coupling blocks, r rows per
+//  child; the rows of child k hold the block of its sibling, so
+//  that LMatrix::gemmSib() multiplies every child with its own
+//  (see HMatrix::inverse_diagonal())
+void NodeInverseTask::cpu_task(const Task *task,
+			       const std::vector<PhysicalRegion> &regions,
+			       Context ctx, HighLevelRuntime *runtime) {
+
+  assert(regions.size() == 2);
+  assert(task->regions.size() == 2);
+  assert(task->arglen == sizeof(TaskArgs));
+  Point<1> p = task->index_point.get_point<1>();
+
+  log_solver_tasks.print("Inside node inverse tasks.");
+
+  const TaskArgs args = *((const TaskArgs*)task->args);
+  int rblk = args.rblock;
+  int rlo = p[0] * rblk;
+  int rhi = (p[0] + 1) * rblk;
+  assert(rblk%2==0);
+  int r = rblk / 2;
+
+  PtrMatrix SMat = get_raw_pointer(regions[0], rlo, rhi, 0, rblk+1);
+  PtrMatrix RMat = get_raw_pointer(regions[1], rlo, rhi, 0, r);
+  node_coupling(r, SMat.pointer(), SMat.LD(), args.spd,
+		RMat.pointer(r, 0), RMat.LD(), RMat.pointer(), RMat.LD());
+}
+
+// With eta = S \ [V1'*d1; V0'*d0] for the node system S (see
+//  node_system.hpp), eta0 depends on d0 through R0 = d eta0 /
+//  d(V0'*d0) and eta1 on d1 through R1 = d eta1 / d(V1'*d1), the
+//  off-diagonal blocks of inv(S). The symmetric system (see
+//  NodeFactorTask) has its rows swapped, which makes them the
+//  diagonal blocks of its inverse. Both are solved from the
+//  stored factors with the identity.
+void node_coupling
+(int r, const double *S, int LDS, bool spd,
+ double *R0, int LDR0, double *R1, int LDR1) {
+  int     S_size = 2*r;
+  double *B = (double *) malloc(S_size * S_size * sizeof(double));
+  PtrMatrix BMat(S_size, S_size, S_size, B);
+  BMat.identity();
+  const double *ipiv = S + S_size*LDS;
+  if (spd)
+    PtrMatrix(S_size, S_size, LDS, const_cast<double*>(S))
+      .solve_symmetric(BMat, ipiv);
+  else
+    // B0 = [I, 0] and B1 = [0, I]
+    node_system_solve(r, S, LDS, ipiv, 'n', S_size,
+		      B, S_size, B+r, S_size);
+  for (int j=0; j<r; j++)
+    for (int i=0; i<r; i++) {
+      R0[i+j*LDR0] = BMat(i, j);
+      R1[i+j*LDR1] = BMat(r+i, r+j);
+    }
+  free(B);
+}
@@ -1,32 +1,37 @@
 #include "node_solve.hpp"
 #include "ptr_matrix.hpp"
+#include "node_system.hpp"
 #include "utility.hpp"
 
 static Realm::Logger log_solver_tasks("solver_tasks");
 
-int NodeSolveTask::TASKID;
+template <typename T>
+int NodeSolveTaskT<T>::TASKID;
 
-NodeSolveTask::NodeSolveTask(Domain domain,
-			     TaskArgument global_arg,
-			     ArgumentMap arg_map,
-			     MappingTagID tag)
+template <typename T>
+NodeSolveTaskT<T>::NodeSolveTaskT(Domain domain,
+				  TaskArgument global_arg,
+				  ArgumentMap arg_map,
+				  MappingTagID tag)
   
   : IndexLauncher(TASKID, domain, global_arg, arg_map,
 		  Predicate::TRUE_PRED, false, 0, tag) {}
 
-void NodeSolveTask::register_tasks(void)
+template <typename T>
+void NodeSolveTaskT<T>::register_tasks(void)
 {
+  const char* name = task_name("Node_Solve", scalar_type_of<T>::value);
   TASKID = HighLevelRuntime::register_legion_task
-    <NodeSolveTask::cpu_task>(AUTO_GENERATE_ID,
-			      Processor::LOC_PROC, 
-			      false,
-			      true,
-			      AUTO_GENERATE_ID,
-			      TaskConfigOptions(true/*leaf*/),
-			      "Node_Solve");
+    <NodeSolveTaskT<T>::cpu_task>(AUTO_GENERATE_ID,
+				  Processor::LOC_PROC,
+				  false,
+				  true,
+				  AUTO_GENERATE_ID,
+				  TaskConfigOptions(true/*leaf*/),
+				  name);
 
 #ifdef SHOW_REGISTER_TASKS
-  printf("Register task %d : Node_Solve\n", TASKID);
+  printf("Register task %d : %s\n", TASKID, name);
 #endif
 }
 
@@ -36,10 +41,13 @@ void NodeSolveTask::register_tasks(void)
 // |               |  |      |  =  |        |
 // | V0'*u0   I    |  | eta1 |     | V0'*d0 |
 // --             --  --    --     --      --
-// note the reversed order in VTd
-void NodeSolveTask::cpu_task(const Task *task,
-			     const std::vector<PhysicalRegion> &regions,
-			     Context ctx, HighLevelRuntime *runtime) {
+// note the reversed order in VTd, except for the symmetric
+//  system (see NodeFactorTask); the general system is eliminated
+//  through its r x r Schur complement (see node_system.hpp)
+template <typename T>
+void NodeSolveTaskT<T>::cpu_task(const Task *task,
+				 const std::vector<PhysicalRegion> &regions,
+				 Context ctx, HighLevelRuntime *runtime) {
 
   assert(regions.size() == 2);
   assert(task->regions.size() == 2);
@@ -57,29 +65,39 @@ void NodeSolveTask::cpu_task(const Task *task,
   int rhi = (p[0] + 1) * rblk;
   //printf("(rblock=%d, Acols=%d, Bcols=%d)\n", rblk, Acols, Bcols);
   
-  PtrMatrix AMat = get_raw_pointer(regions[0], rlo, rhi, 0, Acols);
-  PtrMatrix BMat = get_raw_pointer(regions[1], rlo, rhi, 0, Bcols);
+  int batch = args.batch;
+  PtrMatrixT<T> AMat = get_raw_pointer<T>(regions[0], rlo, rhi, 0, batch*Acols);
+  PtrMatrixT<T> BMat = get_raw_pointer<T>(regions[1], rlo, rhi, 0, batch*Bcols);
 
-  PtrMatrix S(rblk, rblk);
-  S.identity(); // initialize to identity matrix
-  
-  // assume V0'*u0 and V1'*u1 have the same number of rows
   assert(rblk%2==0);
   int r = rblk / 2;
-  for (int i=0; i<r; i++) {
-    for (int j=0; j<r; j++) {
-      S(r+i, j) = AMat(i, j);
-      S(i, r+j) = AMat(r+i, j);
-    }
+  if (args.factored && args.spd) {
+    assert(Acols == rblk+1 && batch == 1);
+    PtrMatrixT<T> S(rblk, rblk, AMat.LD(), AMat.pointer());
+    S.solve_symmetric( BMat, AMat.pointer(0, rblk) );
+    return;
+  }
+  if (args.factored) {
+    // the transposed system needs no permutation: the
+    //  right hand side is [u0'*d0; u1'*d1] (see
+    //  HMatrix::solve_transpose())
+    assert(Acols == rblk+1 && batch == 1);
+    node_system_solve(r, AMat.pointer(), AMat.LD(), AMat.pointer(0, rblk),
+		      args.trans ? 't' : 'n', Bcols,
+		      BMat.pointer(), BMat.LD(), BMat.pointer(r, 0), BMat.LD());
+    return;
+  }
+  // V0'*u0 and V1'*u1 have the same number of rows; every
+  //  shift has its own system
+  for (int k=0; k<batch; k++) {
+    T *A = AMat.pointer(0, k*Acols);
+    T *B = BMat.pointer(0, k*Bcols);
+    node_system_solve(r, A, AMat.LD(), A+r, AMat.LD(), Bcols,
+		      B, BMat.LD(), B+r, BMat.LD());
   }
-  // set the right hand side
-  for (int j=0; j<Bcols; j++) {
-    for (int i=0; i<r; i++) {
-      // switch BMat(i, j) with BMat(r+i, j)
-      double temp = BMat(i, j);
-      BMat(i, j) = BMat(r+i, j);
-      BMat(r+i, j) = temp;
-    }
-  }  
-  S.solve( BMat );
 }
+
+template class NodeSolveTaskT<float>;
+template class NodeSolveTaskT<double>;
+template class NodeSolveTaskT<complex_float>;
+template class NodeSolveTaskT<complex_double>;
@@ -1,5 +1,6 @@
 #include "node_solve_region.hpp"
 #include "ptr_matrix.hpp"
+#include "node_system.hpp"
 #include "utility.hpp"
 
 static Realm::Logger log_solver_tasks("solver_tasks");
@@ -69,31 +70,19 @@ void NodeSolveRegionTask::cpu_task(const Task *task,
   const TaskArgs args = *((const TaskArgs*)task->args);
   int rank = args.rank;
   int nRhs = args.nRhs;
+  int batch = args.batch;
   //printf("rank=%d, nRhs=%d\n", rank, nRhs);
 
-  PtrMatrix VTu0 = get_raw_pointer(regions[0], 0, rank, 0, rank);
-  PtrMatrix VTu1 = get_raw_pointer(regions[1], 0, rank, 0, rank);
-  PtrMatrix VTd0 = get_raw_pointer(regions[2], 0, rank, 0, nRhs);
-  PtrMatrix VTd1 = get_raw_pointer(regions[3], 0, rank, 0, nRhs);
+  PtrMatrix VTu0 = get_raw_pointer(regions[0], 0, rank, 0, batch*rank);
+  PtrMatrix VTu1 = get_raw_pointer(regions[1], 0, rank, 0, batch*rank);
+  PtrMatrix VTd0 = get_raw_pointer(regions[2], 0, rank, 0, batch*nRhs);
+  PtrMatrix VTd1 = get_raw_pointer(regions[3], 0, rank, 0, batch*nRhs);
  
-  PtrMatrix S(2*rank, 2*rank);
-  PtrMatrix B(2*rank, nRhs);
-  
-  // assume V0'*u0 and V1'*u1 have the same number of rows
-  S.identity(); // initialize to identity matrix
-  int r = rank;
-  for (int i=0; i<r; i++) {
-    for (int j=0; j<r; j++) {
-      S(r+i, j) = VTu0(i, j);
-      S(i, r+j) = VTu1(i, j);
-    }
-  }
-  // set the right hand side
-  for (int j=0; j<nRhs; j++) {
-    for (int i=0; i<r; i++) {
-      B(i,   j) = VTd1(i, j);
-      B(i+r, j) = VTd0(i, j);
-    }
-  }  
-  S.solve( B );
+  // eliminate through the Schur complement (see node_system.hpp);
+  //  the solution is written back: eta0 goes with d0 and eta1 with d1
+  for (int k=0; k<batch; k++)
+    node_system_solve(rank, VTu0.pointer(0, k*rank), VTu0.LD(),
+		      VTu1.pointer(0, k*rank), VTu1.LD(), nRhs,
+		      VTd0.pointer(0, k*nRhs), VTd0.LD(),
+		      VTd1.pointer(0, k*nRhs), VTd1.LD());
 }
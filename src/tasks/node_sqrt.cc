@@ -0,0 +1,161 @@
+#include "node_sqrt.hpp"
+#include "ptr_matrix.hpp"
+#include "utility.hpp"
+#include <algorithm> // for std::swap()
+
+static Realm::Logger log_solver_tasks("solver_tasks");
+
+double node_sqrt
+(int r, const double *P, int LDP, const double *Q, int LDQ,
+ double *X, int LDX, double *Y, int LDY);
+
+int NodeSqrtTask::TASKID;
+
+NodeSqrtTask::NodeSqrtTask(Domain domain,
+			   TaskArgument global_arg,
+			   ArgumentMap arg_map,
+			   MappingTagID tag)
+
+  : IndexLauncher(TASKID, domain, global_arg, arg_map,
+		  Predicate::TRUE_PRED, false, 0, tag) {}
+
+void NodeSqrtTask::register_tasks(void)
+{
+  TASKID = HighLevelRuntime::register_legion_task
+    <double, NodeSqrtTask::cpu_task>(AUTO_GENERATE_ID,
+				     Processor::LOC_PROC,
+				     false,
+				     true,
+				     AUTO_GENERATE_ID,
+				     TaskConfigOptions(true/*leaf*/),
+				     "Node_Sqrt");
+
+#ifdef SHOW_REGISTER_TASKS
+  printf("Register task %d : Node_Sqrt\n", TASKID);
+#endif
+}
+
+// regions for 'f': u'*u with r rows for every child, the node
+//  factors and, if there are ancestors, their V'*d = u'*d, which
+//  is overwritten by eta = Y*(u'*d) for d -= u*eta (see
+//  node_sqrt()); for 'n' and 't': the node factors and B
+double NodeSqrtTask::cpu_task(const Task *task,
+			      const std::vector<PhysicalRegion> &regions,
+			      Context ctx, HighLevelRuntime *runtime) {
+
+  assert(task->regions.size() == regions.size());
+  assert(task->arglen == sizeof(TaskArgs));
+  Point<1> p = task->index_point.get_point<1>();
+
+  log_solver_tasks.print("Inside node sqrt tasks.");
+
+  const TaskArgs args = *((const TaskArgs*)task->args);
+  int rblk  = args.rblock;
+  int Bcols = args.Bcols;
+  int rlo = p[0] * rblk;
+  int rhi = (p[0] + 1) * rblk;
+  assert(rblk%2==0);
+  int r = rblk / 2;
+
+  if (args.op != 'f') {
+    assert(regions.size() == 2);
+    assert(args.op == 'n' || args.op == 't');
+    PtrMatrix SMat = get_raw_pointer(regions[0], rlo, rhi, 0, rblk+1);
+    PtrMatrix BMat = get_raw_pointer(regions[1], rlo, rhi, 0, Bcols);
+    PtrMatrix X(rblk, rblk, SMat.LD(), SMat.pointer(), args.op);
+    PtrMatrix B(rblk, Bcols);
+    PtrMatrix::add(1.0, BMat, 0.0, BMat, B);
+    PtrMatrix::gemm(1.0, X, B, 0.0, BMat);
+    return 0.0;
+  }
+
+  assert(regions.size() == 2 || regions.size() == 3);
+  PtrMatrix AMat = get_raw_pointer(regions[0], rlo, rhi, 0, r);
+  PtrMatrix SMat = get_raw_pointer(regions[1], rlo, rhi, 0, rblk+1);
+
+  // the log-determinant of the blocks factorized before is
+  //  passed to the first node (see LMatrix::node_factor())
+  double logdet = 0.0;
+  if (p[0] == 0 && !task->futures.empty())
+    logdet = task->futures[0].get_result<double>();
+
+  if (regions.size() == 2)
+    return logdet + node_sqrt(r, AMat.pointer(), AMat.LD(),
+			      AMat.pointer(r, 0), AMat.LD(),
+			      SMat.pointer(), SMat.LD(), NULL, 0);
+  PtrMatrix Y(rblk, rblk);
+  logdet += node_sqrt(r, AMat.pointer(), AMat.LD(),
+		      AMat.pointer(r, 0), AMat.LD(),
+		      SMat.pointer(), SMat.LD(), Y.pointer(), Y.LD());
+  PtrMatrix BMat = get_raw_pointer(regions[2], rlo, rhi, 0, Bcols);
+  PtrMatrix B(rblk, Bcols);
+  PtrMatrix::add(1.0, BMat, 0.0, BMat, B);
+  PtrMatrix::gemm(1.0, Y, B, 0.0, BMat);
+  return logdet;
+}
+
+// B = L' \ B / L for the lower triangular L
+static void congruence(PtrMatrix& L, PtrMatrix& B) {
+  int n = B.rows();
+  for (int k=0; k<2; k++) {
+    L.solve_triangular(B, 't');
+    for (int j=0; j<n; j++)
+      for (int i=0; i<j; i++)
+	std::swap(B(i, j), B(j, i));
+  }
+}
+
+// A node of W is diag(W0, W1) * (I + u*X*u'), where the u columns
+//  are diag(W0 \ u0, W1 \ u1) (see hsqrt() in leaf_sqrt.cc), and
+//  X is chosen such that
+//    (I + u*X*u') * (I + u*X*u')' = I + u*[0, I; I, 0]*u',
+//  which is inv(diag(W0, W1)) * A * inv(diag(W0, W1))' at the
+//  node. With the Cholesky factors L = diag(L0, L1) of
+//  u'*u = diag(P, Q), the Cholesky factor C of
+//  I + L'*[0, I; I, 0]*L gives X = L' \ (C - I) / L, and the
+//  inverse of the node is I - u*Y*u' with Y = L' \ (I - inv(C)) / L.
+//  X goes to the leading 2r columns of the node factors, and Y
+//  too unless it is NULL; returns log|det| of the node, i.e.,
+//  of C*C'.
+double node_sqrt
+(int r, const double *P, int LDP, const double *Q, int LDQ,
+ double *X, int LDX, double *Y, int LDY) {
+  int S_size = 2*r;
+  PtrMatrix L(S_size, S_size);
+  L.clear(0.0);
+  for (int j=0; j<r; j++)
+    for (int i=j; i<r; i++) {
+      L(i, j)     = P[i+j*LDP];
+      L(r+i, r+j) = Q[i+j*LDQ];
+    }
+  PtrMatrix(r, r, S_size, L.pointer()).factor_cholesky();
+  PtrMatrix(r, r, S_size, L.pointer(r, r)).factor_cholesky();
+
+  // C = I + L'*[L1; L0] with the block rows of L swapped
+  PtrMatrix C(S_size, S_size);
+  for (int j=0; j<S_size; j++)
+    for (int i=0; i<S_size; i++)
+      C(i, j) = L((i+r)%S_size, j);
+  L.multiply_triangular(C, 't');
+  for (int i=0; i<S_size; i++)
+    C(i, i) += 1.0;
+  double logdet = C.factor_cholesky();
+
+  PtrMatrix XMat(S_size, S_size, LDX, X);
+  for (int j=0; j<S_size; j++)
+    for (int i=0; i<S_size; i++)
+      XMat(i, j) = i < j ? 0.0 : C(i, j) - (i == j ? 1.0 : 0.0);
+  congruence(L, XMat);
+  if (Y == NULL)
+    return logdet;
+  PtrMatrix YMat(S_size, S_size, LDY, Y);
+  for (int j=0; j<S_size; j++)
+    for (int i=0; i<S_size; i++)
+      YMat(i, j) = i == j ? 1.0 : 0.0;
+  C.solve_triangular(YMat);
+  for (int j=0; j<S_size; j++)
+    for (int i=0; i<S_size; i++)
+      YMat(i, j) = (i == j ? 1.0 : 0.0) - YMat(i, j);
+  congruence(L, YMat);
+  return logdet;
+}
@@ -0,0 +1,77 @@
+#include "peel_block.hpp"
+#include "ptr_matrix.hpp"
+
+#include "utility.hpp" // for FIELDID_V
+#include <assert.h>
+
+static Realm::Logger log_solver_tasks("solver_tasks");
+
+int PeelBlockTask::TASKID;
+
+PeelBlockTask::PeelBlockTask(Domain domain,
+			     TaskArgument global_arg,
+			     ArgumentMap arg_map,
+			     MappingTagID tag,
+			     Predicate pred,
+			     bool must,
+			     MapperID id)
+  
+  : IndexLauncher(TASKID, domain, global_arg,
+		  arg_map, pred, must, id, tag) {}
+
+void PeelBlockTask::register_tasks(void)
+{
+  TASKID = HighLevelRuntime::register_legion_task
+    <PeelBlockTask::cpu_task>(AUTO_GENERATE_ID,
+			      Processor::LOC_PROC, 
+			      false,
+			      true,
+			      AUTO_GENERATE_ID,
+			      TaskConfigOptions(true/*leaf*/),
+			      "Peel_Block");
+
+#ifdef SHOW_REGISTER_TASKS
+  printf("Register task %d : Peel_Block\n", TASKID);
+#endif
+}
+
+// one task for every child; regions: the product with the
+//  sketch, the destination and, with orth, the next sketch
+// The sketch of child c is nonzero in the columns of its parity
+//  (see SketchTask), so the sample of the off-diagonal block
+//  (c, c^1) is in the columns of the other parity.
+void PeelBlockTask::cpu_task(const Task *task,
+			     const std::vector<PhysicalRegion> &regions,
+			     Context ctx, HighLevelRuntime *runtime) {
+
+  assert(task->arglen == sizeof(TaskArgs));
+  const TaskArgs args = *((const TaskArgs*)task->args);
+  assert(regions.size() == (args.orth ? 3 : 2));
+  assert(task->regions.size() == regions.size());
+  Point<1> p = task->index_point.get_point<1>();
+  log_solver_tasks.print("Inside peel block tasks.");
+
+  int rank = args.rank;
+  Rect<2> rect = region_bounds(regions[0], ctx, runtime);
+  int rlo  = rect.lo[0];
+  int rhi  = rect.hi[0] + 1;
+  // a leaf is its own block
+  int scol = (rank > 0 ? (1-p[0]%2)*rank : 0);
+  int ncol = (rank > 0 ? rank : rhi-rlo);
+  PtrMatrix Y = get_raw_pointer(regions[0], rlo, rhi, scol, scol+ncol);
+  PtrMatrix B = get_raw_pointer(regions[1], rlo, rhi,
+				args.col, args.col+ncol);
+  for (int j=0; j<ncol; j++)
+    for (int i=0; i<rhi-rlo; i++)
+      B(i, j) = Y(i, j);
+  if (!args.orth) return;
+  
+  assert(rank > 0);
+  B.orthonormalize();
+  PtrMatrix X = get_raw_pointer(regions[2], rlo, rhi, 0, 2*rank);
+  X.clear(0.0);
+  int xcol = (p[0]%2)*rank;
+  for (int j=0; j<rank; j++)
+    for (int i=0; i<rhi-rlo; i++)
+      X(i, xcol+j) = B(i, j);
+}
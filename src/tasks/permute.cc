@@ -0,0 +1,77 @@
+#include "permute.hpp"
+#include "ptr_matrix.hpp"
+
+#include "utility.hpp" // for FIELDID_V
+#include <assert.h>
+#include <algorithm> // for std::min()
+
+static Realm::Logger log_solver_tasks("solver_tasks");
+
+int PermuteTask::TASKID;
+
+PermuteTask::PermuteTask(Domain domain,
+			 TaskArgument global_arg,
+			 ArgumentMap arg_map,
+			 MappingTagID tag,
+			 Predicate pred,
+			 bool must,
+			 MapperID id)
+  
+  : IndexLauncher(TASKID, domain, global_arg,
+		  arg_map, pred, must, id, tag) {}
+
+void PermuteTask::register_tasks(void)
+{
+  TASKID = HighLevelRuntime::register_legion_task
+    <PermuteTask::cpu_task>(AUTO_GENERATE_ID,
+			    Processor::LOC_PROC, 
+			    false,
+			    true,
+			    AUTO_GENERATE_ID,
+			    TaskConfigOptions(true/*leaf*/),
+			    "Permute");
+
+#ifdef SHOW_REGISTER_TASKS
+  printf("Register task %d : Permute\n", TASKID);
+#endif
+}
+
+// regions: the indices of this partition, the rows of the source
+//  they hold and the rows of this partition in the destination;
+//  the source rows are runs of a structured region, so its
+//  instance spans the rows between the smallest and largest index
+void PermuteTask::cpu_task(const Task *task,
+			   const std::vector<PhysicalRegion> &regions,
+			   Context ctx, HighLevelRuntime *runtime) {
+
+  assert(regions.size() == 3);
+  assert(task->regions.size() == 3);
+  assert(task->arglen == sizeof(TaskArgs));
+  log_solver_tasks.print("Inside permute tasks.");
+
+  const TaskArgs args = *((const TaskArgs*)task->args);
+  Rect<2> Prect = region_bounds(regions[0], ctx, runtime);
+  int rlo  = Prect.lo[0];
+  int rhi  = Prect.hi[0] + 1;
+  PtrMatrix P = get_raw_pointer(regions[0], rlo, rhi,
+				args.pcol, args.pcol+1);
+  // indices are stored exactly as doubles
+  int slo = int(P(0, 0));
+  int shi = slo;
+  for (int i=1; i<rhi-rlo; i++) {
+    slo = std::min(slo, int(P(i, 0)));
+    shi = std::max(shi, int(P(i, 0)));
+  }
+  PtrMatrix S = get_raw_pointer(regions[1], slo, shi+1,
+				args.scol, args.scol+args.ncol);
+  PtrMatrix D = get_raw_pointer(regions[2], rlo, rhi,
+				args.dcol, args.dcol+args.ncol);
+  for (int i=0; i<rhi-rlo; i++) {
+    int r = int(P(i, 0)) - slo;
+    for (int j=0; j<args.ncol; j++)
+      if (args.scatter)
+	S(r, j) = D(i, j);
+      else
+	D(i, j) = S(r, j);
+  }
+}
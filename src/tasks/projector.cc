@@ -1,9 +1,11 @@
 #include "projector.hpp"
 
 const ProjectionID CONTRACTION = 1988;
+const ProjectionID SIBLING     = 1989;
+const ProjectionID CONTRACTION_SIBLING = 1990;
 
-Contraction::Contraction(HighLevelRuntime *runtime)
-  : ProjectionFunctor(runtime) {
+Contraction::Contraction(HighLevelRuntime *runtime, bool sibling_)
+  : ProjectionFunctor(runtime), sibling(sibling_) {
   //std::cout<<"Register projection functor with ID: "<<CONTRACTION<<std::endl;
 }
 
@@ -26,6 +28,8 @@ LogicalRegion Contraction::project(Context ctx, Task *task,
   //printf("colorSize: %d, partition level: %d\n", clrSize, plevel);
   
   int color = point.point_data[0] / clrSize;
+  if (sibling)
+    color ^= 1;
   if (plevel == 1) {
     return runtime->get_logical_subregion_by_color(ctx, partition, color);
   }
@@ -41,3 +45,25 @@ LogicalRegion Contraction::project(Context ctx, Task *task,
 unsigned Contraction::get_depth() const {
   return 1;
 }
+
+Sibling::Sibling(HighLevelRuntime *runtime)
+  : ProjectionFunctor(runtime) {}
+
+LogicalRegion Sibling::project(Context ctx, Task *task,
+			       unsigned index,
+			       LogicalRegion upper_bound,
+			       const DomainPoint &point) {
+  assert(false && "unimplemented");
+}
+
+LogicalRegion Sibling::project(Context ctx, Task *task,
+			       unsigned index,
+			       LogicalPartition partition,
+			       const DomainPoint &point) {
+  int color = point.point_data[0] ^ 1;
+  return runtime->get_logical_subregion_by_color(ctx, partition, color);
+}
+
+unsigned Sibling::get_depth() const {
+  return 0;
+}
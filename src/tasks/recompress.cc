@@ -0,0 +1,147 @@
+#include "recompress.hpp"
+#include "ptr_matrix.hpp"
+#include "lapack_blas.hpp"
+
+#include "utility.hpp" // for FIELDID_V
+#include <assert.h>
+#include <vector>
+
+static Realm::Logger log_solver_tasks("solver_tasks");
+
+int recompress(double tol, PtrMatrix& U, PtrMatrix& V);
+
+int RecompressTask::TASKID;
+
+RecompressTask::RecompressTask(Domain domain,
+			       TaskArgument global_arg,
+			       ArgumentMap arg_map,
+			       MappingTagID tag,
+			       Predicate pred,
+			       bool must,
+			       MapperID id)
+  
+  : IndexLauncher(TASKID, domain, global_arg,
+		  arg_map, pred, must, id, tag) {}
+
+void RecompressTask::register_tasks(void)
+{
+  TASKID = HighLevelRuntime::register_legion_task
+    <int, RecompressTask::cpu_task>(AUTO_GENERATE_ID,
+				    Processor::LOC_PROC, 
+				    false,
+				    true,
+				    AUTO_GENERATE_ID,
+				    TaskConfigOptions(true/*leaf*/),
+				    "Recompress");
+
+#ifdef SHOW_REGISTER_TASKS
+  printf("Register task %d : Recompress\n", TASKID);
+#endif
+}
+
+// regions: rows of the child in U and rows of its sibling in V
+int RecompressTask::cpu_task(const Task *task,
+			     const std::vector<PhysicalRegion> &regions,
+			     Context ctx, HighLevelRuntime *runtime) {
+
+  assert(regions.size() == 2);
+  assert(task->regions.size() == 2);
+  assert(task->arglen == sizeof(TaskArgs));
+  log_solver_tasks.print("Inside recompress tasks.");
+
+  const TaskArgs args = *((const TaskArgs*)task->args);
+  Rect<2> Urect = region_bounds(regions[0], ctx, runtime);
+  Rect<2> Vrect = region_bounds(regions[1], ctx, runtime);
+  PtrMatrix U = get_raw_pointer(regions[0], Urect.lo[0], Urect.hi[0]+1,
+				args.ucol, args.ucol+args.rank);
+  PtrMatrix V = get_raw_pointer(regions[1], Vrect.lo[0], Vrect.hi[0]+1,
+				args.vcol, args.vcol+args.rank);
+  return recompress(args.tol, U, V);
+}
+
+// QR factorize A in place into the orthonormal factor and
+//  return the triangular factor in R (A.cols() rows)
+static void qr(PtrMatrix& A, std::vector<double>& R) {
+  int M = A.rows();
+  int N = A.cols();
+  int LDA = A.LD();
+  int INFO;
+  assert(M >= N);
+  double lwork;
+  int LWORK = -1;
+  std::vector<double> TAU(N);
+  lapack::geqrf(&M, &N, A.pointer(), &LDA, &TAU[0], &lwork, &LWORK, &INFO);
+  assert(INFO == 0);
+  LWORK = lwork;
+  std::vector<double> WORK(LWORK);
+  lapack::geqrf(&M, &N, A.pointer(), &LDA, &TAU[0], &WORK[0], &LWORK,
+		&INFO);
+  assert(INFO == 0);
+  R.assign(N*N, 0.0);
+  for (int j=0; j<N; j++)
+    for (int i=0; i<=j; i++)
+      R[i+j*N] = A(i, j);
+  lapack::orgqr(&M, &N, &N, A.pointer(), &LDA, &TAU[0], &WORK[0], &LWORK,
+		&INFO);
+  assert(INFO == 0);
+}
+
+// With u = Qu*Ru, v = Qv*Rv and Ru*Rv' = W*S*Z', the block is
+//  u*v' = (Qu*W*S) * (Qv*Z)', where the singular values S are in
+//  decreasing order; u and v are overwritten by the two factors.
+//  Returns the number of singular values above tol*S(0), at
+//  least one.
+int recompress(double tol, PtrMatrix& U, PtrMatrix& V) {
+  int r = U.cols();
+  assert(V.cols() == r);
+  std::vector<double> Ru, Rv;
+  qr(U, Ru);
+  qr(V, Rv);
+
+  // M = Ru * Rv'
+  char   transa = 'n';
+  char   transb = 't';
+  double alpha  = 1.0;
+  double beta   = 0.0;
+  std::vector<double> M(r*r);
+  blas::dgemm_(&transa, &transb, &r, &r, &r, &alpha, &Ru[0], &r,
+	       &Rv[0], &r, &beta, &M[0], &r);
+
+  // M = W * S * Z'
+  char jobz = 'S';
+  int  INFO;
+  std::vector<double> S(r), W(r*r), ZT(r*r);
+  std::vector<int> IWORK(8*r);
+  double lwork;
+  int LWORK = -1;
+  lapack::gesdd(&jobz, &r, &r, &M[0], &r, &S[0], &W[0], &r, &ZT[0], &r,
+		&lwork, &LWORK, &IWORK[0], &INFO);
+  assert(INFO == 0);
+  LWORK = lwork;
+  std::vector<double> WORK(LWORK);
+  lapack::gesdd(&jobz, &r, &r, &M[0], &r, &S[0], &W[0], &r, &ZT[0], &r,
+		&WORK[0], &LWORK, &IWORK[0], &INFO);
+  assert(INFO == 0);
+
+  // u = Qu * W * S and v = Qv * Z
+  for (int j=0; j<r; j++)
+    for (int i=0; i<r; i++)
+      W[i+j*r] *= S[j];
+  PtrMatrix Qu(U.rows(), r);
+  PtrMatrix Qv(V.rows(), r);
+  for (int j=0; j<r; j++) {
+    for (int i=0; i<U.rows(); i++)
+      Qu(i, j) = U(i, j);
+    for (int i=0; i<V.rows(); i++)
+      Qv(i, j) = V(i, j);
+  }
+  PtrMatrix WMat(r, r, r, &W[0]);
+  PtrMatrix ZMat(r, r, r, &ZT[0], 't');
+  PtrMatrix::gemm(1.0, Qu, WMat, 0.0, U);
+  PtrMatrix::gemm(1.0, Qv, ZMat, 0.0, V);
+
+  int k = 1;
+  while (k < r && S[k] > tol*S[0])
+    k++;
+  return k;
+}
@@ -1,49 +1,101 @@
 #include "reduce_add.hpp"
 
 const ReductionOpID REDOP_ADD = 4321;
+const ReductionOpID REDOP_ADD_FLOAT = 4322;
+const ReductionOpID REDOP_ADD_COMPLEX_FLOAT = 4323;
+const ReductionOpID REDOP_ADD_COMPLEX_DOUBLE = 4324;
 
-const double Add::identity = 0.0;
+template <typename T>
+const T AddT<T>::identity = T(0.0);
 
-template<>
-void Add::apply<true>(LHS &lhs, RHS rhs)
-{
-  lhs += rhs;
-}
-
-template<>
-void Add::apply<false>(LHS &lhs, RHS rhs){
+// x += y with compare and swap on the bits
+static void atomic_add(double *x, double y) {
   
-  int64_t *target = (int64_t *)&lhs;
+  int64_t *target = (int64_t *)x;
   union { int64_t as_int; double as_T; } oldval, newval;
   do {
     oldval.as_int = *target;
-    newval.as_T = oldval.as_T + rhs;
+    newval.as_T = oldval.as_T + y;
   } while (!__sync_bool_compare_and_swap(target,
 					 oldval.as_int,
 					 newval.as_int)
 	   );
 }
 
-template<>
-void Add::fold<true>(RHS &rhs1, RHS rhs2)
-{
-  rhs1 += rhs2;
-}
-
-template<>
-void Add::fold<false>(RHS &rhs1, RHS rhs2)
-{
-  int64_t *target = (int64_t *)&rhs1;
-  union { int64_t as_int; double as_T; } oldval, newval;
+static void atomic_add(float *x, float y) {
+  
+  int32_t *target = (int32_t *)x;
+  union { int32_t as_int; float as_T; } oldval, newval;
   do {
     oldval.as_int = *target;
-    newval.as_T = oldval.as_T + rhs2;
+    newval.as_T = oldval.as_T + y;
   } while (!__sync_bool_compare_and_swap(target,
 					 oldval.as_int,
 					 newval.as_int)
 	   );
 }
 
-void Add::register_operator() {
-  HighLevelRuntime::register_reduction_op<Add>(REDOP_ADD);
+// the real and the imaginary parts are added separately
+template <typename T>
+static void atomic_add(std::complex<T> *x, std::complex<T> y) {
+  T *parts = reinterpret_cast<T *>(x);
+  atomic_add(parts,   y.real());
+  atomic_add(parts+1, y.imag());
+}
+
+template <typename T> template <bool EXCLUSIVE>
+void AddT<T>::apply(LHS &lhs, RHS rhs)
+{
+  if (EXCLUSIVE)
+    lhs += rhs;
+  else
+    atomic_add(&lhs, rhs);
+}
+
+template <typename T> template <bool EXCLUSIVE>
+void AddT<T>::fold(RHS &rhs1, RHS rhs2)
+{
+  if (EXCLUSIVE)
+    rhs1 += rhs2;
+  else
+    atomic_add(&rhs1, rhs2);
+}
+
+template <>
+void AddT<double>::register_operator() {
+  HighLevelRuntime::register_reduction_op<AddT<double> >(REDOP_ADD);
+}
+
+template <>
+int AddT<double>::redop_id() {return REDOP_ADD;}
+
+template <>
+void AddT<float>::register_operator() {
+  HighLevelRuntime::register_reduction_op<AddT<float> >(REDOP_ADD_FLOAT);
+}
+
+template <>
+int AddT<float>::redop_id() {return REDOP_ADD_FLOAT;}
+
+template <>
+void AddT< std::complex<float> >::register_operator() {
+  HighLevelRuntime::register_reduction_op< AddT< std::complex<float> > >
+    (REDOP_ADD_COMPLEX_FLOAT);
 }
+
+template <>
+int AddT< std::complex<float> >::redop_id() {return REDOP_ADD_COMPLEX_FLOAT;}
+
+template <>
+void AddT< std::complex<double> >::register_operator() {
+  HighLevelRuntime::register_reduction_op< AddT< std::complex<double> > >
+    (REDOP_ADD_COMPLEX_DOUBLE);
+}
+
+template <>
+int AddT< std::complex<double> >::redop_id() {return REDOP_ADD_COMPLEX_DOUBLE;}
+
+template class AddT<float>;
+template class AddT<double>;
+template class AddT< std::complex<float> >;
+template class AddT< std::complex<double> >;
@@ -4,38 +4,43 @@
 
 static Realm::Logger log_solver_tasks("solver_tasks");
 
-int ScaleMatrixTask::TASKID;
-
-ScaleMatrixTask::ScaleMatrixTask(Domain domain,
-				 TaskArgument global_arg,
-				 ArgumentMap arg_map,
-				 MappingTagID tag,
-				 Predicate pred,
-				 bool must,
-				 MapperID id)
+template <typename T>
+int ScaleMatrixTaskT<T>::TASKID;
+
+template <typename T>
+ScaleMatrixTaskT<T>::ScaleMatrixTaskT(Domain domain,
+				      TaskArgument global_arg,
+				      ArgumentMap arg_map,
+				      MappingTagID tag,
+				      Predicate pred,
+				      bool must,
+				      MapperID id)
   
   : IndexLauncher(TASKID, domain, global_arg,
 		  arg_map, pred, must, id, tag) {}
 
-void ScaleMatrixTask::register_tasks(void)
+template <typename T>
+void ScaleMatrixTaskT<T>::register_tasks(void)
 {
+  const char* name = task_name("Scale_Matrix", scalar_type_of<T>::value);
   TASKID = HighLevelRuntime::register_legion_task
-    <ScaleMatrixTask::cpu_task>(AUTO_GENERATE_ID,
-			       Processor::LOC_PROC, 
-			       false,
-			       true,
-			       AUTO_GENERATE_ID,
-			       TaskConfigOptions(true/*leaf*/),
-			       "Scale_Matrix");
+    <ScaleMatrixTaskT<T>::cpu_task>(AUTO_GENERATE_ID,
+				    Processor::LOC_PROC,
+				    false,
+				    true,
+				    AUTO_GENERATE_ID,
+				    TaskConfigOptions(true/*leaf*/),
+				    name);
 
 #ifdef SHOW_REGISTER_TASKS
-  printf("Register task %d : Scale_Matrix\n", TASKID);
+  printf("Register task %d : %s\n", TASKID, name);
 #endif
 }
 
-void ScaleMatrixTask::cpu_task(const Task *task,
-			      const std::vector<PhysicalRegion> &regions,
-			      Context ctx, HighLevelRuntime *runtime) {
+template <typename T>
+void ScaleMatrixTaskT<T>::cpu_task(const Task *task,
+				   const std::vector<PhysicalRegion> &regions,
+				   Context ctx, HighLevelRuntime *runtime) {
 
   assert(regions.size() == 1);
   assert(task->regions.size() == 1);
@@ -49,11 +54,16 @@ void ScaleMatrixTask::cpu_task(const Task *task,
   const TaskArgs args = *((const TaskArgs*)task->args);
   int rblk  = args.rblock;
   int cols  = args.cols;
-  double alpha = args.alpha;
+  T alpha = args.alpha;
 
   int rlo = (p[0]) * rblk;
   int rhi = (p[0] + 1) * rblk;
-  PtrMatrix A = get_raw_pointer(regions[0], rlo, rhi, 0, cols);
+  PtrMatrixT<T> A = get_raw_pointer<T>(regions[0], rlo, rhi, 0, cols);
   A.scale(alpha);
   //A.display("After scaling");
 }
+
+template class ScaleMatrixTaskT<float>;
+template class ScaleMatrixTaskT<double>;
+template class ScaleMatrixTaskT<complex_float>;
+template class ScaleMatrixTaskT<complex_double>;
@@ -0,0 +1,78 @@
+#include "shift_diagonal.hpp"
+#include "ptr_matrix.hpp"
+#include "utility.hpp"
+#include "matrix.hpp"  // for block_begin()
+
+int ShiftDiagonalTask::TASKID;
+
+ShiftDiagonalTask::ShiftDiagonalTask(Domain domain,
+				     TaskArgument global_arg,
+				     ArgumentMap arg_map,
+				     Predicate pred,
+				     bool must,
+				     MapperID id,
+				     MappingTagID tag)
+  
+  : IndexLauncher(TASKID, domain, global_arg,
+		  arg_map, pred, must, id, tag) {}
+
+void ShiftDiagonalTask::register_tasks(void)
+{
+  TASKID = HighLevelRuntime::register_legion_task
+    <ShiftDiagonalTask::cpu_task>(AUTO_GENERATE_ID,
+				  Processor::LOC_PROC, 
+				  false,
+				  true,
+				  AUTO_GENERATE_ID,
+				  TaskConfigOptions(true/*leaf*/),
+				  "shift_diagonal");
+
+#ifdef SHOW_REGISTER_TASKS
+  printf("Register task %d : shift_diagonal\n", TASKID);
+#endif
+}
+
+// regions: the copy of the dense blocks and the dense blocks,
+//  where the leaves split like the tree (see block_begin()) and
+//  every leaf block starts at column 0 of its rows
+void ShiftDiagonalTask::cpu_task(const Task *task,
+				 const std::vector<PhysicalRegion> &regions,
+				 Context ctx, HighLevelRuntime *runtime) {
+
+  assert(regions.size() == 2);
+  assert(task->regions.size() == 2);
+  assert(task->arglen == sizeof(TaskArgs));
+  assert(task->local_arglen % sizeof(Entry) == 0);
+
+  const TaskArgs args = *((const TaskArgs*)task->args);
+  const Entry *entry = (const Entry*)task->local_args;
+  int nEntry = task->local_arglen / sizeof(Entry);
+  int cols   = args.cols;
+
+  // the rows of this partition (see block_begin())
+  Rect<2> rect = region_bounds(regions[1], ctx, runtime);
+  int rlo  = rect.lo[0];
+  int rhi  = rect.hi[0] + 1;
+  int nrow = rhi - rlo;
+  
+  PtrMatrix K0 = get_raw_pointer(regions[0], rlo, rhi, 0, cols);
+  PtrMatrix K  = get_raw_pointer(regions[1], rlo, rhi, 0, cols);
+  for (int i=0; i<args.nPart; i++) {
+    int  blo   = block_begin(nrow, args.nPart, i);
+    int  bhi   = block_begin(nrow, args.nPart, i+1);
+    bool reset = !args.update;
+    for (int k=0; k<nEntry; k++) {
+      int row = entry[k].row - rlo;
+      if (blo <= row && row < bhi) {
+	K0(row, row-blo) += entry[k].delta;
+	reset = true;
+      }
+    }
+    if (!reset) continue;
+    for (int j=0; j<bhi-blo; j++)
+      for (int r=blo; r<bhi; r++)
+	K(r, j) = K0(r, j);
+    for (int r=blo; r<bhi; r++)
+      K(r, r-blo) += args.sigma;
+  }
+}
@@ -0,0 +1,74 @@
+#include "sketch.hpp"
+#include "ptr_matrix.hpp"
+
+#include "utility.hpp" // for FIELDID_V
+#include <assert.h>
+
+static Realm::Logger log_solver_tasks("solver_tasks");
+
+int SketchTask::TASKID;
+
+SketchTask::SketchTask(Domain domain,
+		       TaskArgument global_arg,
+		       ArgumentMap arg_map,
+		       MappingTagID tag,
+		       Predicate pred,
+		       bool must,
+		       MapperID id)
+  
+  : IndexLauncher(TASKID, domain, global_arg,
+		  arg_map, pred, must, id, tag) {}
+
+void SketchTask::register_tasks(void)
+{
+  TASKID = HighLevelRuntime::register_legion_task
+    <SketchTask::cpu_task>(AUTO_GENERATE_ID,
+			   Processor::LOC_PROC, 
+			   false,
+			   true,
+			   AUTO_GENERATE_ID,
+			   TaskConfigOptions(true/*leaf*/),
+			   "Sketch");
+
+#ifdef SHOW_REGISTER_TASKS
+  printf("Register task %d : Sketch\n", TASKID);
+#endif
+}
+
+// one task for every child: child c gets random columns [0, rank)
+//  if c is even and [rank, 2*rank) if c is odd; all other entries
+//  are zero
+void SketchTask::cpu_task(const Task *task,
+			  const std::vector<PhysicalRegion> &regions,
+			  Context ctx, HighLevelRuntime *runtime) {
+
+  assert(regions.size() == 1);
+  assert(task->regions.size() == 1);
+  assert(task->arglen == sizeof(TaskArgs));
+  Point<1> p = task->index_point.get_point<1>();
+  log_solver_tasks.print("Inside sketch tasks.");
+
+  const TaskArgs args = *((const TaskArgs*)task->args);
+  int rank = args.rank;
+  Rect<2> rect = region_bounds(regions[0], ctx, runtime);
+  int rlo  = rect.lo[0];
+  int rhi  = rect.hi[0] + 1;
+  int nrow = rhi - rlo;
+  PtrMatrix X = get_raw_pointer(regions[0], rlo, rhi, 0, args.cols);
+  X.clear(0.0);
+  if (rank == 0) {
+    assert(nrow <= args.cols);
+    for (int j=0; j<nrow; j++)
+      X(j, j) = 1.0;
+    return;
+  }
+  // centered uniform entries; the seed is unique for every
+  //  child of every level
+  assert(2*rank <= args.cols);
+  PtrMatrix R(nrow, rank);
+  R.rand(args.nchild + p[0]);
+  int col = (p[0]%2)*rank;
+  for (int j=0; j<rank; j++)
+    for (int i=0; i<nrow; i++)
+      X(i, col+j) = R(i, j) - 0.5;
+}
@@ -56,24 +56,64 @@ void create_projector(Machine machine, HighLevelRuntime *rt,
 			   const std::set<Processor> &local_procs) {    
   rt->register_projection_functor
     (CONTRACTION, new Contraction(rt));
+  rt->register_projection_functor
+    (SIBLING, new Sibling(rt));
+  rt->register_projection_functor
+    (CONTRACTION_SIBLING, new Contraction(rt, true /*sibling*/));
+}
+
+// the variants of the typed tasks for the other scalar types,
+//  the double ones are registered with the rest (see ScalarType)
+template <typename T>
+static void register_typed_tasks() {
+  InitMatrixTaskT<T>::register_tasks();
+  DenseBlockTaskT<T>::register_tasks();
+  ScaleMatrixTaskT<T>::register_tasks();
+  LeafSolveTaskT<T>::register_tasks();
+  NodeSolveTaskT<T>::register_tasks();
+  GemmRedTaskT<T>::register_tasks();
+  GemmBroTaskT<T>::register_tasks();
 }
 
 void register_solver_tasks() {
   InitMatrixTask::register_tasks();
   DenseBlockTask::register_tasks();
+  EntryBlockTask::register_tasks();
   AddMatrixTask::register_tasks();
+  ConvertMatrixTask::register_tasks();
+  DotProductTask::register_tasks();
+  ShiftDiagonalTask::register_tasks();
   ClearMatrixTask::register_tasks();
   ScaleMatrixTask::register_tasks();
   DisplayMatrixTask::register_tasks();
+  PermuteTask::register_tasks();
   
   LeafSolveTask::register_tasks();
+  LeafFactorTask::register_tasks();
+  LeafShiftTask::register_tasks();
+  LeafInverseTask::register_tasks();
+  LeafSqrtTask::register_tasks();
+  AcaBlockTask::register_tasks();
+  RecompressTask::register_tasks();
+  SketchTask::register_tasks();
+  PeelBlockTask::register_tasks();
+  LeafMultiplyTask::register_tasks();
   NodeSolveTask::register_tasks();
+  NodeFactorTask::register_tasks();
+  NodeInverseTask::register_tasks();
+  NodeSqrtTask::register_tasks();
   NodeSolveRegionTask::register_tasks();
   GemmTask::register_tasks();
   GemmInplaceTask::register_tasks();
   GemmRedTask::register_tasks();
   GemmBroTask::register_tasks();
+  register_typed_tasks<float>();
+  register_typed_tasks<complex_float>();
+  register_typed_tasks<complex_double>();
   Add::register_operator();
+  AddT<float>::register_operator();
+  AddT< std::complex<float> >::register_operator();
+  AddT< std::complex<double> >::register_operator();
 #if 0
   HighLevelRuntime::set_registration_callback(create_projector);
 #else
@@ -1,23 +1,89 @@
 #include "tree.hpp"
 
 #include <math.h> // for pow()
+#include <algorithm> // for std::max()
+
+// the rank of every level, root first; an empty profile means
+//  the column size of the matrix at all levels. A zero rank
+//  leaves the two children uncoupled, which is how independent
+//  systems are stacked (see HMatrix::init_batch())
+static std::vector<int> level_ranks
+(const Matrix& mat, int level, const std::vector<int>& ranks) {
+  if (ranks.empty())
+    return std::vector<int>(level, mat.cols());
+  assert(ranks.size() == size_t(level));
+  assert(level <= MAX_TREE_LEVEL);
+  for (size_t i=0; i<ranks.size(); i++)
+    assert(0 <= ranks[i] && ranks[i] <= mat.cols());
+  return ranks;
+}
+
+// first column of every level in the V region: the levels
+//  either share the leading columns of one basis or have
+//  their own columns side by side
+static std::vector<int> basis_columns
+(const std::vector<int>& ranks, bool shared) {
+  std::vector<int> cols(ranks.size(), 0);
+  for (size_t i=1; i<ranks.size() && !shared; i++)
+    cols[i] = cols[i-1] + ranks[i-1];
+  return cols;
+}
 
-void UTree::init(const Matrix& UMat_) {
+void UTree::init(const Matrix& UMat_, int nRhs_,
+		 const std::vector<int>& ranks_) {
   assert(UMat_.rows()>0 && UMat_.cols()>0);
+  assert(nRhs_>0);
   this->UMat  = UMat_;
-  this->rank  = UMat.cols();
-  this->nRhs  = 1; // hard code the number of rhs
+  this->nRhs  = nRhs_;
+  this->ranks = level_ranks(UMat, UMat.levels(), ranks_);
+  this->bases.clear();
+  this->generated = true;
+  this->copy = false;
+  this->saved = false;
+}
+
+void UTree::init(const std::vector<Matrix>& bases_, int nRhs_) {
+  assert(!bases_.empty() && bases_.size() <= MAX_TREE_LEVEL);
+  assert(nRhs_>0);
+  this->UMat  = bases_[0];
+  this->nRhs  = nRhs_;
+  this->bases = bases_;
+  this->generated = true;
+  this->copy = false;
+  this->saved = false;
+  this->ranks.clear();
+  for (size_t i=0; i<bases.size(); i++) {
+    assert(bases[i].rows() == UMat.rows() && bases[i].cols() > 0);
+    ranks.push_back(bases[i].cols());
+  }
+}
+
+void UTree::init(int nrow, const std::vector<int>& ranks_, int nRhs_) {
+  assert(nrow>0 && nRhs_>0);
+  assert(!ranks_.empty() && ranks_.size() <= MAX_TREE_LEVEL);
+  this->UMat  = Matrix(nrow, 1, false);
+  this->nRhs  = nRhs_;
+  this->ranks = ranks_;
+  this->bases.clear();
+  this->generated = false;
+  this->copy = false;
+  this->saved = false;
 }
 
 void UTree::init(int level, const Matrix& UMat_,
-		 Context ctx, HighLevelRuntime *runtime) {
+		 Context ctx, HighLevelRuntime *runtime, int nRhs_) {
   assert(UMat_.rows()>0 && UMat_.cols()>0);
+  assert(nRhs_>0);
   this->mLevel = level;
   this->UMat   = UMat_;
-  this->nRhs   = 1; // hard code the number of rhs
-  this->rank   = UMat.cols();
+  this->nRhs   = nRhs_;
+  this->ranks  = level_ranks(UMat, mLevel, std::vector<int>());
+  this->bases.clear();
+  this->generated = true;
+  this->copy = false;
+  this->saved = false;
   // create the region 
-  int cols = nRhs + UMat.cols()*mLevel;
+  int cols = column_begin(mLevel);
   U.create(UMat.rows(), cols, ctx, runtime);
 }
 
@@ -29,7 +95,11 @@ void UTree::init_rhs
 void UTree::init_rhs
 (const Matrix& b, Context ctx, HighLevelRuntime *runtime,
  bool wait) {
-  assert(b.cols()==1);
+  assert(b.cols()==nRhs);
+  if (copy) {
+    int bcol = column_begin(ranks.size());
+    U.init_data(bcol, bcol+nRhs, b, ctx, runtime);
+  }
   U.init_data(b, ctx, runtime, wait);
 }
 
@@ -39,14 +109,102 @@ Vector UTree::rhs() {
   return Vector();
 }
 
+int UTree::column_begin(int level) const {
+  assert(0 <= level && level <= int(ranks.size()));
+  int col = nRhs;
+  for (int i=0; i<level; i++)
+    col += ranks[i];
+  return col;
+}
+
+void UTree::resize
+(const std::vector<int>& ranks_, Context ctx, HighLevelRuntime *runtime) {
+  assert(ranks_.size() == ranks.size());
+  assert(!saved);
+  if (ranks_ == ranks) return;
+  std::vector<int> ucols;
+  for (size_t i=0; i<ranks.size(); i++) {
+    assert(ranks_[i] <= ranks[i]);
+    ucols.push_back(column_begin(i));
+  }
+  LMatrix Uold = U;
+  this->ranks = ranks_;
+  int cols = column_begin(ranks.size());
+  if (copy)
+    cols += nRhs;
+  U = LMatrix(Uold.rows(), cols, mLevel, ctx, runtime);
+  for (size_t i=0; i<ranks.size(); i++) {
+    if (ranks[i] == 0) continue;
+    LMatrix src = Uold;
+    src.set_column_begin(ucols[i]);
+    src.set_column_size(ranks[i]);
+    LMatrix dst = U;
+    dst.set_column_begin(column_begin(i));
+    dst.set_column_size(ranks[i]);
+    LMatrix::add(1.0, src, 0.0, src, dst, ctx, runtime);
+  }
+  Uold.clear(ctx, runtime);
+  // the region holds the data now
+  this->generated = false;
+  init_columns(ctx, runtime);
+}
+
+void UTree::save_u(Context ctx, HighLevelRuntime *runtime) {
+  assert(!saved);
+  uSaved = LMatrix(uMat_all.rows(), uMat_all.cols(), mLevel, ctx, runtime);
+  LMatrix::add(1.0, uMat_all, 0.0, uMat_all, uSaved, ctx, runtime);
+  this->saved = true;
+}
+
+void UTree::restore_u(Context ctx, HighLevelRuntime *runtime) {
+  assert(saved);
+  LMatrix::add(1.0, uSaved, 0.0, uSaved, uMat_all, ctx, runtime);
+}
+
+LMatrix UTree::saved_level(int i) {
+  assert(saved && 0<i && i<=mLevel);
+  LMatrix uMat = uSaved;
+  uMat.set_column_size(ranks[i-1]);
+  uMat.set_column_begin(column_begin(i-1)-column_begin(0));
+  return uMat;
+}
+
+LMatrix& UTree::saved_u() {
+  assert(saved);
+  return uSaved;
+}
+
+void UTree::keep_single(Context ctx, HighLevelRuntime *runtime) {
+  if (uSingle.num_partition() < 0)
+    uSingle = LMatrix(U.rows(), U.cols(), mLevel, ctx, runtime,
+		      SCALAR_FLOAT);
+  LMatrix::convert(U, uSingle, ctx, runtime);
+}
+
+LMatrix& UTree::single_copy() {
+  assert(uSingle.num_partition() > 0);
+  return uSingle;
+}
+
+void UTree::keep_rhs_copy() {
+  this->copy = true;
+}
+
+const std::vector<int>& UTree::rank_profile() const {
+  return ranks;
+}
+
 void UTree::partition
-(int level, Context ctx, HighLevelRuntime *runtime) {
+(int level, Context ctx, HighLevelRuntime *runtime,
+ ScalarType type) {
   // make sure UMat is valid
   assert( UMat.rows() > 0 );
   assert( UMat.cols() > 0 );
   // create region
-  int cols = nRhs + UMat.cols()*UMat.levels();
-  U.create(UMat.rows(), cols, ctx, runtime);
+  int cols = column_begin(ranks.size());
+  if (copy)
+    cols += nRhs;
+  U.create(UMat.rows(), cols, ctx, runtime, type);
   // partition the big region
   // this is the only partition we will use
   // i.e. the same partition for all u and d
@@ -56,23 +214,7 @@ void UTree::partition
   this->mLevel = level;
   U.partition(mLevel, ctx, runtime);
   // initialize region
-  U.init_data(1, U.cols(), UMat, ctx, runtime);
-
-  // Set column range for all u and d matrics.
-  // In particular, we need to set the column begin
-  // for u matrices.
-  for (int i=0; i<mLevel; i++) {
-    int ncol = nRhs + rank*i;
-    LMatrix dMat = U;
-    dMat.set_column_size(ncol);
-    dMat_vec.push_back(dMat);
-    LMatrix uMat = U;
-    uMat.set_column_size(rank);
-    uMat.set_column_begin(ncol);
-    uMat_vec.push_back(uMat);
-  }
-  assert(uMat_vec.size() == size_t(mLevel));
-  assert(dMat_vec.size() == size_t(mLevel));
+  init_columns(ctx, runtime);
 }
 
 void UTree::horizontal_partition
@@ -81,23 +223,57 @@ void UTree::horizontal_partition
   // partition data
   U.partition(task_level, ctx, runtime);
   // initialize region
-  U.init_data(nRhs, U.cols(), UMat, ctx, runtime);
+  init_columns(ctx, runtime);
+}
+
+void UTree::init_columns(Context ctx, HighLevelRuntime *runtime) {
+
+  // fill the u columns level by level unless every level
+  //  uses all columns of UMat
+  bool uniform = bases.empty();
+  for (size_t i=0; i<ranks.size(); i++)
+    uniform = uniform && ranks[i] == UMat.cols();
+  if (!generated) {
+    // written by a builder
+  } else if (!bases.empty()) {
+    for (size_t i=0; i<ranks.size(); i++)
+      U.init_data(column_begin(i), column_begin(i+1), bases[i], ctx, runtime);
+  } else if (uniform) {
+    U.init_data(nRhs, column_begin(ranks.size()), UMat, ctx, runtime);
+  } else {
+    for (size_t i=0; i<ranks.size(); i++)
+      if (ranks[i] > 0)
+	U.init_data(column_begin(i), column_begin(i+1), UMat, ctx, runtime);
+  }
 
   // Set column range for all u and d matrics.
   // In particular, we need to set the column begin
   // for u matrices.
+  uMat_vec.clear();
+  dMat_vec.clear();
   for (int i=0; i<mLevel; i++) {
-    int ncol = nRhs + rank*i;
+    int ncol = column_begin(i);
     LMatrix dMat = U;
     dMat.set_column_size(ncol);
     dMat_vec.push_back(dMat);
     LMatrix uMat = U;
-    uMat.set_column_size(rank);
+    uMat.set_column_size(ranks[i]);
     uMat.set_column_begin(ncol);
     uMat_vec.push_back(uMat);
   }
   assert(uMat_vec.size() == size_t(mLevel));
   assert(dMat_vec.size() == size_t(mLevel));
+
+  bMat_all = U;
+  bMat_all.set_column_size(nRhs);
+  uMat_all = U;
+  uMat_all.set_column_begin(nRhs);
+  uMat_all.set_column_size(column_begin(ranks.size())-nRhs);
+  if (copy) {
+    bMat_copy = U;
+    bMat_copy.set_column_begin(column_begin(ranks.size()));
+    bMat_copy.set_column_size(nRhs);
+  }
 }
 
 LMatrix& UTree::uMat_level(int i) {
@@ -124,8 +300,27 @@ LMatrix& UTree::leaf() {
   return U;
 }
 
+LMatrix& UTree::rhs_mat() {
+  return bMat_all;
+}
+
+LMatrix& UTree::uMat() {
+  return uMat_all;
+}
+
+LMatrix& UTree::rhs_copy() {
+  assert(copy);
+  return bMat_copy;
+}
+
 void UTree::clear(Context ctx, HighLevelRuntime* runtime) {
   U.clear(ctx, runtime);
+  if (saved)
+    uSaved.clear(ctx, runtime);
+  if (uSingle.num_partition() > 0)
+    uSingle.clear(ctx, runtime);
+  this->saved = false;
+  this->uSingle = LMatrix();
 }
 
 Matrix UTree::solution(Context ctx, HighLevelRuntime *runtime) {
@@ -146,8 +341,35 @@ Matrix UTree::solution(Context ctx, HighLevelRuntime *runtime) {
   return sln;
 }
 
-void VTree::init(const Matrix& VMat_) {
+void VTree::init(const Matrix& VMat_, const std::vector<int>& ranks_) {
   this->VMat  = VMat_;  
+  this->ranks = level_ranks(VMat, VMat.levels(), ranks_);
+  this->vcols = basis_columns(ranks, true);
+  this->bases.clear();
+  this->shared = true;
+}
+
+void VTree::init(const std::vector<Matrix>& bases_) {
+  assert(!bases_.empty() && bases_.size() <= MAX_TREE_LEVEL);
+  this->VMat  = bases_[0];
+  this->bases = bases_;
+  this->shared = false;
+  this->ranks.clear();
+  for (size_t i=0; i<bases.size(); i++) {
+    assert(bases[i].rows() == VMat.rows() && bases[i].cols() > 0);
+    ranks.push_back(bases[i].cols());
+  }
+  this->vcols = basis_columns(ranks, false);
+}
+
+void VTree::init(int nrow, const std::vector<int>& ranks_) {
+  assert(nrow>0);
+  assert(!ranks_.empty() && ranks_.size() <= MAX_TREE_LEVEL);
+  this->VMat  = Matrix(nrow, 1, false);
+  this->ranks = ranks_;
+  this->vcols = basis_columns(ranks, false);
+  this->bases.clear();
+  this->shared = false;
 }
 
 void VTree::init(int level, const Matrix& VMat_,
@@ -156,22 +378,30 @@ void VTree::init(int level, const Matrix& VMat_,
   assert( VMat_.rows() > 0 && VMat_.cols() > 0);
   this->mLevel = level;
   this->VMat   = VMat_;  
+  this->ranks  = level_ranks(VMat, mLevel, std::vector<int>());
+  this->vcols  = basis_columns(ranks, true);
+  this->bases.clear();
+  this->shared = true;
   // create region
   V.create(VMat.rows(), VMat.cols(), ctx, runtime);
 }
 
 void VTree::partition
-(int level, Context ctx, HighLevelRuntime *runtime) {
+(int level, Context ctx, HighLevelRuntime *runtime,
+ ScalarType type) {
   // make sure VMat is valid
   assert( VMat.rows() > 0 );
   assert( VMat.cols() > 0 );
   // create region
-  V.create(VMat.rows(), VMat.cols(), ctx, runtime);
+  int cols = VMat.cols();
+  if (!shared)
+    cols = vcols.back() + ranks.back();
+  V.create(VMat.rows(), cols, ctx, runtime, type);
   // create partition
   this->mLevel = level;
   V.partition(mLevel, ctx, runtime);
   // initialize region
-  V.init_data(VMat, ctx, runtime);
+  init_levels(ctx, runtime);
 }
 
 void VTree::horizontal_partition
@@ -179,7 +409,27 @@ void VTree::horizontal_partition
   // create partition
   V.partition(task_level, ctx, runtime);
   // initialize region
-  V.init_data(VMat, ctx, runtime);
+  init_levels(ctx, runtime);
+}
+
+void VTree::init_levels(Context ctx, HighLevelRuntime *runtime) {
+  if (shared) {
+    V.init_data(VMat, ctx, runtime);
+  } else if (!bases.empty()) {
+    for (size_t i=0; i<ranks.size(); i++)
+      V.init_data(vcols[i], vcols[i]+ranks[i], bases[i], ctx, runtime);
+  } else {
+    // written by a builder; every partition has the same
+    //  number of leaves
+    V.set_small_block_parts((1<<ranks.size()) / V.num_partition());
+  }
+  VMat_vec.clear();
+  for (size_t i=0; i<ranks.size(); i++) {
+    LMatrix VMat = V;
+    VMat.set_column_size(ranks[i]);
+    VMat.set_column_begin(vcols[i]);
+    VMat_vec.push_back(VMat);
+  }
 }
 
 LMatrix& VTree::leaf() {
@@ -187,28 +437,127 @@ LMatrix& VTree::leaf() {
 }
 
 LMatrix& VTree::level(int i) {
-  assert( 0 < i && i <= mLevel );
-  return V;
+  assert( 0 < i && i <= int(VMat_vec.size()) );
+  return VMat_vec[i-1];
 }
 
 LMatrix& VTree::level_new(int i) {
-  assert( 0 <= i && i < mLevel );
-  return V;
+  assert( 0 <= i && i < int(VMat_vec.size()) );
+  return VMat_vec[i];
+}
+
+const std::vector<int>& VTree::column_begin() const {
+  return vcols;
+}
+
+void VTree::keep_single(Context ctx, HighLevelRuntime *runtime) {
+  if (vSingle.num_partition() < 0) {
+    vSingle = LMatrix(V.rows(), V.cols(), mLevel, ctx, runtime,
+		      SCALAR_FLOAT);
+    vSingle.set_small_block_parts(V.small_block_parts());
+  }
+  LMatrix::convert(V, vSingle, ctx, runtime);
+}
+
+LMatrix& VTree::single_copy() {
+  assert(vSingle.num_partition() > 0);
+  return vSingle;
+}
+
+void VTree::resize
+(const std::vector<int>& ranks_, Context ctx, HighLevelRuntime *runtime) {
+  assert(ranks_.size() == ranks.size());
+  if (!shared && ranks_ == ranks) return;
+  LMatrix Vold = V;
+  std::vector<LMatrix> levels = VMat_vec;
+  this->ranks  = ranks_;
+  this->vcols  = basis_columns(ranks, false);
+  this->shared = false;
+  this->bases.clear();
+  V = LMatrix(Vold.rows(), vcols.back()+ranks.back(), mLevel, ctx, runtime);
+  for (size_t i=0; i<ranks.size(); i++) {
+    if (ranks[i] == 0) continue;
+    assert(ranks[i] <= levels[i].cols());
+    LMatrix src = levels[i];
+    src.set_column_size(ranks[i]);
+    LMatrix dst = V;
+    dst.set_column_begin(vcols[i]);
+    dst.set_column_size(ranks[i]);
+    LMatrix::add(1.0, src, 0.0, src, dst, ctx, runtime);
+  }
+  Vold.clear(ctx, runtime);
+  init_levels(ctx, runtime);
 }
 
 void VTree::clear(Context ctx, HighLevelRuntime* runtime) {
   V.clear(ctx, runtime);
+  if (vSingle.num_partition() > 0)
+    vSingle.clear(ctx, runtime);
+  this->vSingle = LMatrix();
+}
+
+// leaves are stored side by side in the dense block region,
+//  which is as wide as the largest one
+static int max_leaf_size(int nrow, int level) {
+  int nblk = pow(2, level);
+  int size = 0;
+  for (int i=0; i<nblk; i++)
+    size = std::max(size, block_begin(nrow, nblk, i+1) -
+		    block_begin(nrow, nblk, i));
+  return size;
 }
 
 void KTree::init
 (const Matrix& UMat_, const Matrix& VMat_,
- const Vector& DVec_) {
+ const Vector& DVec_, const std::vector<int>& ranks_) {
   this->UMat  = UMat_;
   this->VMat  = VMat_;
   this->DVec  = DVec_;
+  this->factored = false;
+  this->saved = false;
+  this->spd = false;
+  this->sqrtFactor = false;
+  this->dense = false;
+  this->generated = true;
   assert(UMat.rows() == VMat.rows());
   assert(UMat.cols() == VMat.cols());
   assert(UMat.rows() == DVec.rows());
+  this->ranks = level_ranks(UMat, UMat.levels(), ranks_);
+  this->vcols = basis_columns(ranks, true);
+  this->shared = true;
+}
+
+void KTree::init
+(const Matrix& KMat_, const Vector& DVec_,
+ const std::vector<int>& ranks_) {
+  this->KMat  = KMat_;
+  this->DVec  = DVec_;
+  this->factored = false;
+  this->saved = false;
+  this->spd = false;
+  this->sqrtFactor = false;
+  this->dense = true;
+  this->generated = true;
+  assert(KMat.rows() == DVec.rows());
+  assert(!ranks_.empty() && ranks_.size() <= MAX_TREE_LEVEL);
+  this->ranks = ranks_;
+  this->vcols = basis_columns(ranks, false);
+  this->shared = false;
+}
+
+void KTree::init(int nrow, const std::vector<int>& ranks_) {
+  assert(nrow>0);
+  assert(!ranks_.empty() && ranks_.size() <= MAX_TREE_LEVEL);
+  this->DVec  = Vector(nrow, false);
+  this->factored = false;
+  this->saved = false;
+  this->spd = false;
+  this->sqrtFactor = false;
+  this->dense = true;
+  this->generated = false;
+  this->ranks = ranks_;
+  this->vcols = basis_columns(ranks, false);
+  this->shared = false;
 }
 
 void KTree::init
@@ -218,30 +567,44 @@ void KTree::init
   this->UMat  = UMat_;
   this->VMat  = VMat_;
   this->DVec  = DVec_;
+  this->factored = false;
+  this->saved = false;
+  this->spd = false;
+  this->sqrtFactor = false;
+  this->dense = false;
+  this->generated = true;
   // check consistancy
   assert(UMat.rows() == VMat.rows());
   assert(UMat.cols() == VMat.cols());
   assert(UMat.rows() == DVec.rows());
+  this->ranks = level_ranks(UMat, UMat.levels(), std::vector<int>());
+  this->vcols = basis_columns(ranks, true);
+  this->shared = true;
   // create region
   int nrow = UMat.rows();
-  int nblk = pow(2, UMat.levels());
-  int ncol = UMat.rows() / nblk; // leaf size
-  K.create( nrow, ncol, ctx, runtime );
+  int ncol = max_leaf_size(nrow, UMat.levels());
+  K.create( nrow, ncol+1, ctx, runtime );
 }
 
 void KTree::partition
-(int level, Context ctx, HighLevelRuntime *runtime) {
+(int level, Context ctx, HighLevelRuntime *runtime,
+ ScalarType type) {
   // create region
   int nrow = DVec.rows();
-  int nblk = pow(2, UMat.levels());
-  int ncol = DVec.rows() / nblk;
+  int ncol = max_leaf_size(nrow, ranks.size());
   assert(ncol>0);
-  K.create( nrow, ncol, ctx, runtime );
+  assert(!dense || !generated || KMat.cols() >= ncol);
+  K.create( nrow, ncol+1, ctx, runtime, type );
   // partition region
   this->mLevel = level;
   K.partition(mLevel, ctx, runtime);
   // initialize region
-  K.init_dense_blocks(UMat, VMat, DVec, ctx, runtime, true /*wait*/);
+  if (!generated)
+    K.set_small_block_parts((1<<ranks.size()) / K.num_partition());
+  else if (dense)
+    K.init_dense_blocks(KMat, DVec, ctx, runtime, true /*wait*/);
+  else
+    K.init_dense_blocks(UMat, VMat, DVec, ctx, runtime, true /*wait*/);
 }
 
 void KTree::horizontal_partition
@@ -249,14 +612,181 @@ void KTree::horizontal_partition
   // partition region
   K.partition(task_level, ctx, runtime);
   // initialize region
-  K.init_dense_blocks(UMat, VMat, DVec, ctx, runtime);
+  if (dense)
+    K.init_dense_blocks(KMat, DVec, ctx, runtime);
+  else
+    K.init_dense_blocks(UMat, VMat, DVec, ctx, runtime);
+}
+
+void KTree::init_entries
+(int func, const LMatrix& perm, Context ctx, HighLevelRuntime *runtime) {
+  assert(!generated);
+  K.init_entry_blocks(func, perm, ctx, runtime);
+}
+
+void KTree::init_blocks
+(LMatrix& Y, Context ctx, HighLevelRuntime *runtime) {
+  assert(!generated && !factored);
+  LMatrix::peel(ranks.size(), 0, false, Y, K, 0, Y, ctx, runtime);
+}
+
+void KTree::multiply
+(char trans, double alpha, int nlevel, bool dense, LMatrix& U,
+ LMatrix& V, const std::vector<int>& ucols, const LMatrix& X, LMatrix& Y,
+ Context ctx, HighLevelRuntime *runtime) {
+  assert(!factored || saved);
+  assert(0 <= nlevel && mLevel+nlevel <= int(ranks.size()));
+  if (factored)
+    K0.multiply(trans, alpha, nlevel, dense, sigma, U, V, ranks, ucols,
+		vcols, X, Y, ctx, runtime);
+  else
+    K.multiply(trans, alpha, nlevel, dense, 0.0, U, V, ranks, ucols, vcols,
+	       X, Y, ctx, runtime);
 }
 
 void KTree::solve
 (LMatrix& U, LMatrix& V, Context ctx, HighLevelRuntime *runtime) {
-  K.solve(U, V, ctx, runtime);
+  K.solve(U, V, ranks, vcols, shared, ctx, runtime);
+}
+
+void KTree::solve_shifts
+(const LMatrix& b, LMatrix& W, LMatrix& V, const std::vector<double>& shifts,
+ Context ctx, HighLevelRuntime *runtime) {
+  assert(!factored);
+  K.solve_shifts(b, W, V, ranks, vcols, shared, shifts, ctx, runtime);
+}
+
+Future KTree::factor
+(LMatrix& U, LMatrix& V, Context ctx, HighLevelRuntime *runtime,
+ bool spd_, bool single, const std::vector<bool>& update) {
+  // every partition stores the node systems of its subtree,
+  //  2*rmax rows each for the largest rank below the partition
+  int rank  = 1;
+  for (size_t i=mLevel; i<ranks.size(); i++)
+    rank = std::max(rank, ranks[i]);
+  int nNode = std::max(V.small_block_parts()-1, 1);
+  int nPart = K.num_partition();
+  // S is kept from the factorization before shift()
+  if (!factored) {
+    assert(update.empty());
+    S.create( nPart*nNode*2*rank, 2*rank+1, ctx, runtime );
+    S.partition( mLevel, ctx, runtime );
+  }
+  assert(update.empty() || spd_ == spd);
+  set_factor_type(SCALAR_DOUBLE, ctx, runtime);
+  Future logdet = K.factor(U, V, S, ranks, vcols, shared, spd_,
+			   single, update, ctx, runtime);
+  this->factored = true;
+  this->spd = spd_;
+  return logdet;
+}
+
+Future KTree::factor_sqrt
+(LMatrix& U, Context ctx, HighLevelRuntime *runtime) {
+  assert(!factored && !saved);
+  // the node factors are stored like the node systems of factor()
+  int rank  = 1;
+  for (size_t i=mLevel; i<ranks.size(); i++)
+    rank = std::max(rank, ranks[i]);
+  int nPart = K.num_partition();
+  int nNode = std::max((1<<ranks.size())/nPart-1, 1);
+  S.create( nPart*nNode*2*rank, 2*rank+1, ctx, runtime );
+  S.partition( mLevel, ctx, runtime );
+  Future logdet = K.factor_sqrt(U, S, ranks, shared, ctx, runtime);
+  this->factored = true;
+  this->spd = true;
+  this->sqrtFactor = true;
+  return logdet;
+}
+
+void KTree::multiply_sqrt
+(char trans, const LMatrix& U, LMatrix& B, Context ctx,
+ HighLevelRuntime *runtime) {
+  assert(factored && sqrtFactor);
+  K.multiply_sqrt(trans, U, S, ranks, B, ctx, runtime);
+}
+
+void KTree::solve_factored
+(LMatrix& b, LMatrix& V, Context ctx, HighLevelRuntime *runtime,
+ bool trans) {
+  assert(factored && !spd);
+  K.solve(b, V, S, ranks, vcols, trans, ctx, runtime);
+}
+
+void KTree::solve_factored
+(LMatrix& b, int bcol, Context ctx, HighLevelRuntime *runtime) {
+  assert(factored && spd && !sqrtFactor);
+  K.solve_spd(b, S, ranks, bcol, ctx, runtime);
+}
+
+LMatrix KTree::inverse_diagonal
+(bool blocks, const LMatrix& U, const LMatrix& V, LMatrix& Z, int wcol,
+ Context ctx, HighLevelRuntime *runtime) {
+  assert(factored && !sqrtFactor);
+  set_factor_type(SCALAR_DOUBLE, ctx, runtime);
+  LMatrix X(K.rows(), blocks ? K.cols()-1 : 1, mLevel, ctx, runtime);
+  K.inverse_diagonal(U, V, S, Z, X, ranks, vcols, wcol, spd, ctx, runtime);
+  return X;
+}
+
+void KTree::set_rank_profile
+(const std::vector<int>& ranks_, const std::vector<int>& vcols_) {
+  assert(!factored);
+  assert(ranks_.size() == ranks.size() && vcols_.size() == ranks.size());
+  this->ranks = ranks_;
+  this->vcols = vcols_;
+  // the u columns are no longer copies of one basis
+  this->shared = false;
+}
+
+void KTree::save_blocks(Context ctx, HighLevelRuntime *runtime) {
+  assert(!saved && !factored);
+  LMatrix Kd = K;
+  Kd.set_column_size(K.cols()-1);
+  K0 = LMatrix(K.rows(), Kd.cols(), mLevel, ctx, runtime);
+  LMatrix::add(1.0, Kd, 0.0, Kd, K0, ctx, runtime);
+  this->saved = true;
+  this->sigma = 0.0;
+}
+
+void KTree::shift(double sigma_, Context ctx, HighLevelRuntime *runtime) {
+  if (!saved)
+    save_blocks(ctx, runtime);
+  set_factor_type(SCALAR_DOUBLE, ctx, runtime);
+  int nLeaf = (1<<ranks.size()) / K.num_partition();
+  K.shift_diagonal(sigma_, nLeaf, K0, ctx, runtime);
+  this->sigma = sigma_;
+}
+
+std::vector<bool> KTree::add_diagonal
+(const std::vector<int>& rows, const std::vector<double>& delta,
+ Context ctx, HighLevelRuntime *runtime) {
+  if (!saved)
+    save_blocks(ctx, runtime);
+  set_factor_type(SCALAR_DOUBLE, ctx, runtime);
+  int nLeaf = 1<<ranks.size();
+  std::vector<bool> update(nLeaf, false);
+  for (size_t k=0; k<rows.size(); k++)
+    update[block_index(K.rows(), nLeaf, rows[k])] = true;
+  K.add_diagonal(rows, delta, sigma, nLeaf/K.num_partition(), K0,
+		 ctx, runtime);
+  return update;
+}
+
+void KTree::set_factor_type
+(ScalarType type, Context ctx, HighLevelRuntime *runtime) {
+  K.set_scalar_type(type, ctx, runtime);
+  if (factored)
+    S.set_scalar_type(type, ctx, runtime);
 }
 
 void KTree::clear(Context ctx, HighLevelRuntime* runtime) {
   K.clear(ctx, runtime);
+  if (factored)
+    S.clear(ctx, runtime);
+  if (saved)
+    K0.clear(ctx, runtime);
+  this->factored = false;
+  this->saved = false;
+  this->sqrtFactor = false;
 }
@@ -1,5 +1,24 @@
 #include "utility.hpp"
 
+#include <vector>
+#include <string>
+
+static std::vector<EntryFunc>& entry_funcs() {
+  static std::vector<EntryFunc> funcs;
+  return funcs;
+}
+
+int register_entry_func(EntryFunc f) {
+  assert(f != NULL);
+  entry_funcs().push_back(f);
+  return entry_funcs().size()-1;
+}
+
+EntryFunc entry_func(int id) {
+  assert(0 <= id && id < int(entry_funcs().size()));
+  return entry_funcs()[id];
+}
+
 bool is_power_of_two(int x) {
   return (x > 0) && !(x & (x-1));
 }
@@ -26,33 +45,38 @@ double* region_pointer
 PtrMatrix get_raw_pointer
 (const PhysicalRegion &region, int rlo, int rhi, int clo, int chi,
  bool wait) {
+  return get_raw_pointer<double>(region, rlo, rhi, clo, chi);
+}
+
+PtrMatrix reduction_pointer
+(const PhysicalRegion &region, int rlo, int rhi, int clo, int chi) {
+  return reduction_pointer<double>(region, rlo, rhi, clo, chi);
+}
+
+template <typename T>
+PtrMatrixT<T> get_raw_pointer
+(const PhysicalRegion &region, int rlo, int rhi, int clo, int chi) {
   Rect<2> bounds, subrect;
   bounds.lo.x[0] = rlo;
   bounds.hi.x[0] = rhi-1;
   bounds.lo.x[1] = clo;
   bounds.hi.x[1] = chi-1;
   ByteOffset offsets[2];
-  //double *base = region.get_field_accessor(FIELDID_V).template typeify<double>().template raw_rect_ptr<2>(bounds, subrect, offsets);
-  double *base = region.get_field_accessor(FIELDID_V).typeify<double>().raw_rect_ptr<2>(bounds, subrect, offsets);
+  T *base = region.get_field_accessor(FIELDID_V).template typeify<T>().template raw_rect_ptr<2>(bounds, subrect, offsets);
 #if 0
   printf("ptr = %p (%d, %d)\n", base, offsets[0].offset, offsets[1].offset);
 #endif
 
-#if 0
-  if (wait) {
-    double *base = region.get_field_accessor(FIELDID_V).typeify<double>().raw_rect_ptr<2>(bounds, subrect, offsets);
-  }
-#endif
-
   assert(base);
   assert(subrect == bounds);
-  assert(offsets[0].offset == sizeof(double));
-  int ld = offsets[1].offset/sizeof(double);
+  assert(offsets[0].offset == sizeof(T));
+  int ld = offsets[1].offset/sizeof(T);
   assert(ld>=rhi-rlo);
-  return PtrMatrix(rhi-rlo, chi-clo, ld, base);
+  return PtrMatrixT<T>(rhi-rlo, chi-clo, ld, base);
 }
 
-PtrMatrix reduction_pointer
+template <typename T>
+PtrMatrixT<T> reduction_pointer
 (const PhysicalRegion &region, int rlo, int rhi, int clo, int chi) {
   Rect<2> bounds, subrect;
   bounds.lo.x[0] = rlo;
@@ -60,14 +84,56 @@ PtrMatrix reduction_pointer
   bounds.lo.x[1] = clo;
   bounds.hi.x[1] = chi-1;
   ByteOffset offsets[2];
-  //double *base = region.get_accessor().template typeify<double>().template raw_rect_ptr<2>(bounds, subrect, offsets);
-  double *base = region.get_accessor().typeify<double>().raw_rect_ptr<2>(bounds, subrect, offsets);
+  T *base = region.get_accessor().template typeify<T>().template raw_rect_ptr<2>(bounds, subrect, offsets);
   assert(subrect == bounds);
-  assert(offsets[0].offset == sizeof(double));
-  //assert(size_t(rhi-rlo) == offsets[1].offset/sizeof(double));
+  assert(offsets[0].offset == sizeof(T));
+  //assert(size_t(rhi-rlo) == offsets[1].offset/sizeof(T));
 #ifdef DEBUG_POINTERS
   printf("ptr = %p (%d, %d)\n", base, offsets[0].offset, offsets[1].offset);
 #endif
-  int ld = offsets[1].offset/sizeof(double);
-  return PtrMatrix(rhi-rlo, chi-clo, ld, base);
+  int ld = offsets[1].offset/sizeof(T);
+  return PtrMatrixT<T>(rhi-rlo, chi-clo, ld, base);
+}
+
+template PtrMatrixT<float> get_raw_pointer<float>
+(const PhysicalRegion &, int, int, int, int);
+template PtrMatrixT<double> get_raw_pointer<double>
+(const PhysicalRegion &, int, int, int, int);
+template PtrMatrixT<complex_float> get_raw_pointer<complex_float>
+(const PhysicalRegion &, int, int, int, int);
+template PtrMatrixT<complex_double> get_raw_pointer<complex_double>
+(const PhysicalRegion &, int, int, int, int);
+template PtrMatrixT<float> reduction_pointer<float>
+(const PhysicalRegion &, int, int, int, int);
+template PtrMatrixT<double> reduction_pointer<double>
+(const PhysicalRegion &, int, int, int, int);
+template PtrMatrixT<complex_float> reduction_pointer<complex_float>
+(const PhysicalRegion &, int, int, int, int);
+template PtrMatrixT<complex_double> reduction_pointer<complex_double>
+(const PhysicalRegion &, int, int, int, int);
+
+size_t scalar_size(ScalarType type) {
+  switch (type) {
+  case SCALAR_DOUBLE:         return sizeof(double);
+  case SCALAR_FLOAT:          return sizeof(float);
+  case SCALAR_COMPLEX_FLOAT:  return sizeof(complex_float);
+  case SCALAR_COMPLEX_DOUBLE: return sizeof(complex_double);
+  }
+  assert(false);
+  return 0;
+}
+
+const char* task_name(const char* name, ScalarType type) {
+  static const char* suffix[] = {"", "_float", "_complex_float",
+				 "_complex_double"};
+  if (type == SCALAR_DOUBLE)
+    return name;
+  std::string *full = new std::string(std::string(name) + suffix[type]);
+  return full->c_str();
+}
+
+Rect<2> region_bounds
+(const PhysicalRegion &region, Context ctx, HighLevelRuntime *runtime) {
+  IndexSpace is = region.get_logical_region().get_index_space();
+  return runtime->get_index_space_domain(ctx, is).get_rect<2>();
 }
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <math.h> // for fabs()
+#include <algorithm> // for std::max()
 
 // legion stuff
 #include "legion.h"
@@ -7,6 +8,7 @@ using namespace LegionRuntime::HighLevel;
 
 #include "matrix.hpp"  // for Matrix  class
 #include "hmatrix.hpp" // for HMatrix class
+#include "small_kernels.hpp"
 
 enum {
   TOP_LEVEL_TASK_ID = 0,
@@ -23,6 +25,48 @@ void test_two_level_reduce(Context, HighLevelRuntime*);
 void test_two_level_broadcast(Context, HighLevelRuntime*);
 void test_two_level_node_solve(Context, HighLevelRuntime*);
 void test_solver(int, int, int, Context, HighLevelRuntime*);
+void test_factor_solve(int, int, int, Context, HighLevelRuntime*);
+void test_multiple_rhs(int, int, int, Context, HighLevelRuntime*);
+void test_rank_profile(int, int, int, Context, HighLevelRuntime*);
+void test_uneven_size(int, int, int, Context, HighLevelRuntime*);
+void test_general_hodlr(int, int, int, Context, HighLevelRuntime*);
+void test_aca_build(int, int, int, Context, HighLevelRuntime*);
+void test_peeling(int, int, int, Context, HighLevelRuntime*);
+void test_spd_solver(int, int, int, Context, HighLevelRuntime*);
+void test_mixed_precision(int, int, int, Context, HighLevelRuntime*);
+void test_log_determinant(int, int, int, Context, HighLevelRuntime*);
+void test_multiply(int, int, int, Context, HighLevelRuntime*);
+void test_krylov(int, int, int, Context, HighLevelRuntime*);
+void test_transpose_solve(int, int, int, Context, HighLevelRuntime*);
+void test_shift(int, int, int, Context, HighLevelRuntime*);
+void test_multi_shift(int, int, int, Context, HighLevelRuntime*);
+void test_batch(int, int, int, Context, HighLevelRuntime*);
+void test_recompress(int, int, int, Context, HighLevelRuntime*);
+void test_cluster_order(int, int, int, Context, HighLevelRuntime*);
+void test_add_diagonal(int, int, int, Context, HighLevelRuntime*);
+void test_inverse_diagonal(int, int, int, Context, HighLevelRuntime*);
+void test_sqrt_factor(int, int, int, Context, HighLevelRuntime*);
+template <typename T> void test_scalar_type(const std::string&);
+template <typename T>
+void test_typed_solver(int, int, int, const std::string&, Context,
+		       HighLevelRuntime*);
+void test_small_kernels();
+
+// a smooth kernel with a dominant diagonal
+double kernel_entry(int i, int j);
+int    kernel_func;
+
+// the same kernel on points scattered over [0, 1) in the order
+//  of their indices, which needs a cluster order
+double scattered_point(int i);
+double scattered_entry(int i, int j);
+int    scattered_func;
+
+// black-box product with D + U * V' for the peeling and
+//  refinement tests
+void peel_matvec(char, const LMatrix&, LMatrix&, Context, HighLevelRuntime*);
+Matrix peel_U, peel_V;
+Vector peel_D;
 
 void top_level_task(const Task *task,
 		    const std::vector<PhysicalRegion> &regions,
@@ -64,6 +108,38 @@ void top_level_task(const Task *task,
   //test_lmatrix_init(ctx, runtime);
   
   test_solver(rank, treelvl, launchlvl, ctx, runtime);
+  test_factor_solve(rank, treelvl, launchlvl, ctx, runtime);
+  test_multiple_rhs(rank, treelvl, launchlvl, ctx, runtime);
+  test_rank_profile(rank, treelvl, launchlvl, ctx, runtime);
+  test_uneven_size(rank, treelvl, launchlvl, ctx, runtime);
+  test_general_hodlr(rank, treelvl, launchlvl, ctx, runtime);
+  test_aca_build(rank, treelvl, launchlvl, ctx, runtime);
+  test_peeling(rank, treelvl, launchlvl, ctx, runtime);
+  test_spd_solver(rank, treelvl, launchlvl, ctx, runtime);
+  test_mixed_precision(rank, treelvl, launchlvl, ctx, runtime);
+  test_log_determinant(rank, treelvl, launchlvl, ctx, runtime);
+  test_multiply(rank, treelvl, launchlvl, ctx, runtime);
+  test_krylov(rank, treelvl, launchlvl, ctx, runtime);
+  test_transpose_solve(rank, treelvl, launchlvl, ctx, runtime);
+  test_shift(rank, treelvl, launchlvl, ctx, runtime);
+  test_multi_shift(rank, treelvl, launchlvl, ctx, runtime);
+  test_batch(rank, treelvl, launchlvl, ctx, runtime);
+  test_recompress(rank, treelvl, launchlvl, ctx, runtime);
+  test_cluster_order(rank, treelvl, launchlvl, ctx, runtime);
+  test_add_diagonal(rank, treelvl, launchlvl, ctx, runtime);
+  test_inverse_diagonal(rank, treelvl, launchlvl, ctx, runtime);
+  test_sqrt_factor(rank, treelvl, launchlvl, ctx, runtime);
+  test_scalar_type<float>("float");
+  test_scalar_type<double>("double");
+  test_scalar_type<complex_float>("complex float");
+  test_scalar_type<complex_double>("complex double");
+  test_typed_solver<float>(rank, treelvl, launchlvl, "float", ctx, runtime);
+  test_typed_solver<double>(rank, treelvl, launchlvl, "double", ctx, runtime);
+  test_typed_solver<complex_float>(rank, treelvl, launchlvl, "complex float",
+				   ctx, runtime);
+  test_typed_solver<complex_double>(rank, treelvl, launchlvl,
+				    "complex double", ctx, runtime);
+  test_small_kernels();
     
   /*
   // ======= Problem configuration =======
@@ -122,6 +198,10 @@ int main(int argc, char *argv[], char *envp[]) {
   // register solver tasks
   register_solver_tasks();
 
+  // register entry functions
+  kernel_func = register_entry_func(kernel_entry);
+  scattered_func = register_entry_func(scattered_entry);
+
   // register mapper
   HighLevelRuntime::set_registration_callback(registration_callback);
 
@@ -659,3 +739,972 @@ void test_solver(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRun
 
   std::cout<<"Solver complete."<<std::endl;
 }
+
+// factor once and solve with several right hand sides
+void test_factor_solve(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    base = 2*rank; // leaf size
+  Matrix VMat(base, treelvl, rank); VMat.rand();
+  Matrix UMat(base, treelvl, rank); UMat.rand();
+  Vector DVec(base, treelvl);       DVec.rand(1e3);
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(UMat, VMat, DVec, ctx, runtime);
+  hMat.factor(ctx, runtime);
+
+  for (int itr=0; itr<3; itr++) {
+    Matrix Rhs(base, treelvl, 1); Rhs.rand();
+    hMat.solve(Rhs, ctx, runtime);
+    Matrix x = hMat.solution(ctx, runtime);
+    Matrix err = Rhs - ( UMat * (VMat.T() * x) + DVec.multiply(x) );
+    if (err.norm() / Rhs.norm() > 1e-10)
+      Error("factor/solve residual too large");
+  }
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for factor and solve passed!" << std::endl;
+}
+
+// one solve with a block of right hand sides
+void test_multiple_rhs(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    base = 2*rank; // leaf size
+  int    nRhs = 3*rank; // wider than the leaf
+  Matrix VMat(base, treelvl, rank); VMat.rand();
+  Matrix UMat(base, treelvl, rank); UMat.rand();
+  Vector DVec(base, treelvl);       DVec.rand(1e3);
+  Matrix Rhs (base, treelvl, nRhs); Rhs.rand();
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(UMat, VMat, DVec, ctx, runtime, nRhs);
+  hMat.factor(ctx, runtime);
+  hMat.solve(Rhs, ctx, runtime);
+  Matrix x = hMat.solution(ctx, runtime);
+  if (x.cols() != nRhs)
+    Error("wrong number of solution columns");
+  Matrix err = Rhs - ( UMat * (VMat.T() * x) + DVec.multiply(x) );
+  if (err.norm() / Rhs.norm() > 1e-10)
+    Error("multiple right hand sides residual too large");
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for multiple right hand sides passed!" << std::endl;
+}
+
+// the rank decreases towards the leaves; the off-diagonal
+//  blocks at depth k use the first ranks[k] columns of U and V
+void test_rank_profile(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    base = 2*rank; // leaf size
+  Matrix VMat(base, treelvl, rank); VMat.rand();
+  Matrix UMat(base, treelvl, rank); UMat.rand();
+  Vector DVec(base, treelvl);       DVec.rand(1e3);
+  Matrix Rhs (base, treelvl, 1);    Rhs.rand();
+  std::vector<int> ranks(treelvl);
+  for (int k=0; k<treelvl; k++)
+    ranks[k] = std::max(rank>>k, 1);
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(UMat, VMat, DVec, ctx, runtime, 1, ranks);
+  hMat.factor(ctx, runtime);
+  hMat.solve(Rhs, ctx, runtime);
+  Matrix x = hMat.solution(ctx, runtime);
+
+  // apply the matrix entry by entry
+  double err = 0.0;
+  for (int i=0; i<UMat.rows(); i++) {
+    double y = DVec[i]*x(i, 0);
+    for (int j=0; j<UMat.rows(); j++) {
+      // depth of the lowest common ancestor of i and j
+      int r = rank, diff = i/base ^ j/base;
+      for (int k=treelvl-1; diff>0; k--, diff>>=1)
+	r = ranks[k];
+      for (int l=0; l<r; l++)
+	y += UMat(i, l) * VMat(j, l) * x(j, 0);
+    }
+    err += (Rhs(i, 0)-y) * (Rhs(i, 0)-y);
+  }
+  if (sqrt(err) / Rhs.norm() > 1e-10)
+    Error("rank profile residual too large");
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for rank profile passed!" << std::endl;
+}
+
+// the problem size is not a multiple of the number of leaves,
+//  so every node splits its rows unevenly (see block_begin())
+void test_uneven_size(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    nLeaf = pow(2, treelvl);
+  int    N     = 2*rank*nLeaf + nLeaf/2 + 1;
+  Matrix VMat(N, rank); VMat.rand(nLeaf);
+  Matrix UMat(N, rank); UMat.rand(nLeaf);
+  Vector DVec(N);       DVec.rand(nLeaf, 1e3);
+  Matrix Rhs (N, 1);    Rhs.rand(nLeaf);
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(UMat, VMat, DVec, ctx, runtime);
+  hMat.factor(ctx, runtime);
+  hMat.solve(Rhs, ctx, runtime);
+  Matrix x = hMat.solution(ctx, runtime);
+  Matrix err = Rhs - ( UMat * (VMat.T() * x) + DVec.multiply(x) );
+  if (err.norm() / Rhs.norm() > 1e-10)
+    Error("uneven size residual too large");
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for uneven problem size passed!" << std::endl;
+}
+
+// independent bases at every depth and random dense leaves
+void test_general_hodlr(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    base = 2*rank; // leaf size
+  std::vector<Matrix> UMat, VMat;
+  for (int k=0; k<treelvl; k++) {
+    int r = std::max(rank>>(k%2), 1);
+    UMat.push_back(Matrix(base, treelvl, r)); UMat[k].rand();
+    VMat.push_back(Matrix(base, treelvl, r)); VMat[k].rand();
+  }
+  Matrix KMat(base, treelvl, base); KMat.rand();
+  Vector DVec(base, treelvl);       DVec.rand(1e3);
+  Matrix Rhs (base, treelvl, 1);    Rhs.rand();
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(UMat, VMat, KMat, DVec, ctx, runtime);
+  hMat.factor(ctx, runtime);
+  hMat.solve(Rhs, ctx, runtime);
+  Matrix x = hMat.solution(ctx, runtime);
+
+  // apply the matrix entry by entry
+  double err = 0.0;
+  for (int i=0; i<KMat.rows(); i++) {
+    double y = DVec[i]*x(i, 0);
+    for (int j=0; j<KMat.rows(); j++) {
+      if (i/base == j/base) {
+	y += KMat(i, j%base) * x(j, 0);
+	continue;
+      }
+      // depth of the lowest common ancestor of i and j
+      int k = treelvl-1, diff = (i/base ^ j/base) >> 1;
+      for (; diff>0; k--, diff>>=1);
+      for (int l=0; l<UMat[k].cols(); l++)
+	y += UMat[k](i, l) * VMat[k](j, l) * x(j, 0);
+    }
+    err += (Rhs(i, 0)-y) * (Rhs(i, 0)-y);
+  }
+  if (sqrt(err) / Rhs.norm() > 1e-10)
+    Error("general HODLR residual too large");
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for general HODLR matrix passed!" << std::endl;
+}
+
+double kernel_entry(int i, int j) {
+  return i == j ? 1e3 : 1.0 / (1.0 + fabs(double(i-j)));
+}
+
+// build from the entries by ACA and compare with the dense matrix
+void test_aca_build(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    base = 2*rank; // leaf size
+  int    N    = base*pow(2, treelvl);
+  double tol  = 1e-12;
+  Matrix Rhs(base, treelvl, 1); Rhs.rand();
+  std::vector<int> ranks(treelvl, rank);
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(kernel_func, N, ranks, tol, ctx, runtime);
+  hMat.factor(ctx, runtime);
+  hMat.solve(Rhs, ctx, runtime);
+  Matrix x = hMat.solution(ctx, runtime);
+
+  // apply the matrix entry by entry
+  double err = 0.0;
+  for (int i=0; i<N; i++) {
+    double y = 0.0;
+    for (int j=0; j<N; j++)
+      y += kernel_entry(i, j) * x(j, 0);
+    err += (Rhs(i, 0)-y) * (Rhs(i, 0)-y);
+  }
+  if (sqrt(err) / Rhs.norm() > 1e-8)
+    Error("ACA build residual too large");
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for ACA build passed!" << std::endl;
+}
+
+// Y = op(D + U * V') * X on the whole regions
+void peel_matvec(char trans, const LMatrix& X, LMatrix& Y, Context ctx, HighLevelRuntime *runtime) {
+
+  LogicalRegion xr = X.logical_region();
+  LogicalRegion yr = Y.logical_region();
+  RegionRequirement xreq(xr, READ_ONLY,  EXCLUSIVE, xr);
+  RegionRequirement yreq(yr, READ_WRITE, EXCLUSIVE, yr);
+  xreq.add_field(FIELDID_V);
+  yreq.add_field(FIELDID_V);
+  PhysicalRegion xreg = runtime->map_region(ctx, InlineLauncher(xreq));
+  PhysicalRegion yreg = runtime->map_region(ctx, InlineLauncher(yreq));
+  xreg.wait_until_valid();
+  yreg.wait_until_valid();
+
+  int N = X.rows(), m = X.cols();
+  PtrMatrix x = get_raw_pointer(xreg, 0, N, X.column_begin(), X.column_begin()+m);
+  PtrMatrix y = get_raw_pointer(yreg, 0, N, Y.column_begin(), Y.column_begin()+m);
+  const Matrix& L = (trans == 'n' ? peel_U : peel_V);
+  const Matrix& R = (trans == 'n' ? peel_V : peel_U);
+  std::vector<double> w(L.cols());
+  for (int j=0; j<m; j++) {
+    for (int l=0; l<L.cols(); l++) {
+      w[l] = 0.0;
+      for (int i=0; i<N; i++)
+	w[l] += R(i, l) * x(i, j);
+    }
+    for (int i=0; i<N; i++) {
+      y(i, j) = peel_D[i] * x(i, j);
+      for (int l=0; l<L.cols(); l++)
+	y(i, j) += L(i, l) * w[l];
+    }
+  }
+  runtime->unmap_region(ctx, xreg);
+  runtime->unmap_region(ctx, yreg);
+}
+
+// build from products with the matrix and its transpose only
+void test_peeling(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    nLeaf = pow(2, treelvl);
+  int    N     = 2*rank*nLeaf;
+  peel_U = Matrix(N, rank); peel_U.rand(nLeaf);
+  peel_V = Matrix(N, rank); peel_V.rand(nLeaf);
+  peel_D = Vector(N);       peel_D.rand(nLeaf, 1e3);
+  Matrix Rhs(N, 1);         Rhs.rand(nLeaf);
+  std::vector<int> ranks(treelvl, rank);
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(peel_matvec, N, ranks, ctx, runtime);
+  hMat.factor(ctx, runtime);
+  hMat.solve(Rhs, ctx, runtime);
+  Matrix x = hMat.solution(ctx, runtime);
+  Matrix err = Rhs - ( peel_U * (peel_V.T() * x) + peel_D.multiply(x) );
+  if (err.norm() / Rhs.norm() > 1e-8)
+    Error("peeling residual too large");
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for peeling build passed!" << std::endl;
+}
+
+// symmetric positive definite U * U' + D, solved without V
+void test_spd_solver(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    base = 2*rank; // leaf size
+  Matrix UMat(base, treelvl, rank); UMat.rand();
+  Vector DVec(base, treelvl);       DVec.rand(1e3);
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(UMat, DVec, ctx, runtime);
+  hMat.factor(ctx, runtime);
+
+  for (int itr=0; itr<2; itr++) {
+    Matrix Rhs(base, treelvl, 1); Rhs.rand();
+    hMat.solve(Rhs, ctx, runtime);
+    Matrix x = hMat.solution(ctx, runtime);
+    Matrix err = Rhs - ( UMat * (UMat.T() * x) + DVec.multiply(x) );
+    if (err.norm() / Rhs.norm() > 1e-10)
+      Error("symmetric positive definite residual too large");
+  }
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for symmetric positive definite solver passed!" << std::endl;
+}
+
+// single precision factors and refinement in double
+void test_mixed_precision(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    nLeaf = pow(2, treelvl);
+  int    N     = 2*rank*nLeaf;
+  peel_U = Matrix(N, rank); peel_U.rand(nLeaf);
+  peel_V = Matrix(N, rank); peel_V.rand(nLeaf);
+  peel_D = Vector(N);       peel_D.rand(nLeaf, 1e3);
+  Matrix Rhs(N, 1);         Rhs.rand(nLeaf);
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(peel_U, peel_V, peel_D, ctx, runtime);
+  hMat.factor(ctx, runtime, true /*single*/);
+  hMat.solve(Rhs, peel_matvec, 3, ctx, runtime);
+  Matrix x = hMat.solution(ctx, runtime);
+  Matrix err = Rhs - ( peel_U * (peel_V.T() * x) + peel_D.multiply(x) );
+  if (err.norm() / Rhs.norm() > 1e-10)
+    Error("mixed precision residual too large");
+  // the transpose solve moves the float factors back to double
+  hMat.solve_transpose(Rhs, ctx, runtime);
+  x = hMat.solution(ctx, runtime);
+  err = Rhs - ( peel_V * (peel_U.T() * x) + peel_D.multiply(x) );
+  if (err.norm() / Rhs.norm() > 1e-4)
+    Error("mixed precision transpose residual too large");
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for mixed precision refinement passed!" << std::endl;
+}
+
+// compare with the determinant lemma
+//  det(D + U*V') = det(D) * det(I + V'*inv(D)*U)
+void test_log_determinant(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    base = 2*rank; // leaf size
+  Matrix VMat(base, treelvl, rank); VMat.rand();
+  Matrix UMat(base, treelvl, rank); UMat.rand();
+  Vector DVec(base, treelvl);       DVec.rand(1e3);
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(UMat, VMat, DVec, ctx, runtime);
+  hMat.factor(ctx, runtime);
+  double logdet = hMat.log_determinant().get_result<double>();
+
+  double ref = 0.0;
+  for (int i=0; i<DVec.rows(); i++)
+    ref += log(fabs(DVec[i]));
+  Matrix C = Matrix::identity(rank);
+  for (int i=0; i<rank; i++)
+    for (int j=0; j<rank; j++)
+      for (int k=0; k<UMat.rows(); k++)
+	C(i, j) += VMat(k, i) * UMat(k, j) / DVec[k];
+  // LU with partial pivoting
+  for (int j=0; j<rank; j++) {
+    int p = j;
+    for (int i=j+1; i<rank; i++)
+      if (fabs(C(i, j)) > fabs(C(p, j))) p = i;
+    for (int k=j; k<rank; k++)
+      std::swap(C(j, k), C(p, k));
+    ref += log(fabs(C(j, j)));
+    for (int i=j+1; i<rank; i++) {
+      double l = C(i, j) / C(j, j);
+      for (int k=j+1; k<rank; k++)
+	C(i, k) -= l * C(j, k);
+    }
+  }
+  if (fabs(logdet - ref) > 1e-10 * fabs(ref))
+    Error("log-determinant is wrong");
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for log-determinant passed!" << std::endl;
+}
+
+// distributed product with the matrix and its transpose
+void test_multiply(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    base = 2*rank; // leaf size
+  int    nRhs = 2;
+  Matrix VMat(base, treelvl, rank); VMat.rand();
+  Matrix UMat(base, treelvl, rank); UMat.rand();
+  Vector DVec(base, treelvl);       DVec.rand(1e3);
+  Matrix XMat(base, treelvl, nRhs); XMat.rand();
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(UMat, VMat, DVec, ctx, runtime, nRhs);
+  int N = UMat.rows();
+  LMatrix X(N, nRhs, launchlvl, ctx, runtime);
+  LMatrix Y(N, nRhs, launchlvl, ctx, runtime);
+  X.init_data(XMat, ctx, runtime);
+
+  hMat.multiply('n', X, Y, ctx, runtime);
+  Matrix err = Y.to_matrix(ctx, runtime) -
+    ( UMat * (VMat.T() * XMat) + DVec.multiply(XMat) );
+  if (err.norm() / XMat.norm() > 1e-10)
+    Error("product is wrong");
+  hMat.multiply('t', X, Y, ctx, runtime);
+  err = Y.to_matrix(ctx, runtime) -
+    ( VMat * (UMat.T() * XMat) + DVec.multiply(XMat) );
+  if (err.norm() / XMat.norm() > 1e-10)
+    Error("transposed product is wrong");
+
+  // shift() keeps the unfactored data for the shifted product
+  double sigma = 25.0;
+  hMat.shift(sigma, ctx, runtime);
+  hMat.multiply('n', X, Y, ctx, runtime);
+  err = Y.to_matrix(ctx, runtime) -
+    ( UMat * (VMat.T() * XMat) + DVec.multiply(XMat) );
+  for (int j=0; j<nRhs; j++)
+    for (int i=0; i<XMat.rows(); i++)
+      err(i, j) -= sigma * XMat(i, j);
+  if (err.norm() / XMat.norm() > 1e-10)
+    Error("product after shift is wrong");
+
+  X.clear(ctx, runtime);
+  Y.clear(ctx, runtime);
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for distributed product passed!" << std::endl;
+}
+
+// CG and GMRES for D + U * V' with full rank, preconditioned
+//  by the same matrix with a fifth of the rank
+void test_krylov(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    nLeaf = pow(2, treelvl);
+  int    N     = 2*rank*nLeaf;
+  int    maxIt = 50;
+  double tol   = 1e-10;
+  peel_U = Matrix(N, rank); peel_U.rand(nLeaf);
+  peel_D = Vector(N);       peel_D.rand(nLeaf, 1e3);
+  Matrix Rhs(N, 1);         Rhs.rand(nLeaf);
+  std::vector<int> ranks(treelvl, std::max(rank/5, 1));
+
+  // symmetric positive definite U * U' + D
+  peel_V = peel_U;
+  HMatrix sMat(pow(2, launchlvl), launchlvl);
+  sMat.init(peel_U, peel_D, ctx, runtime, 1, ranks);
+  sMat.factor(ctx, runtime);
+  int nIt = sMat.cg(Rhs, peel_matvec, tol, maxIt, ctx, runtime);
+  Matrix x = sMat.solution(ctx, runtime);
+  Matrix err = Rhs - ( peel_U * (peel_V.T() * x) + peel_D.multiply(x) );
+  if (nIt >= maxIt || err.norm() / Rhs.norm() > 1e2*tol)
+    Error("preconditioned CG did not converge");
+  sMat.destroy(ctx, runtime);
+
+  // general U * V' + D
+  peel_V = Matrix(N, rank); peel_V.rand(nLeaf);
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(peel_U, peel_V, peel_D, ctx, runtime, 1, ranks);
+  hMat.factor(ctx, runtime);
+  nIt = hMat.gmres(Rhs, peel_matvec, tol, 10, maxIt, ctx, runtime);
+  x   = hMat.solution(ctx, runtime);
+  err = Rhs - ( peel_U * (peel_V.T() * x) + peel_D.multiply(x) );
+  if (nIt >= maxIt || err.norm() / Rhs.norm() > 1e2*tol)
+    Error("preconditioned GMRES did not converge");
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for Krylov solvers passed!" << std::endl;
+}
+
+// A'*x = b with the factors of A, mixed with solves of A*x = b
+void test_transpose_solve(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    base = 2*rank; // leaf size
+  Matrix VMat(base, treelvl, rank); VMat.rand();
+  Matrix UMat(base, treelvl, rank); UMat.rand();
+  Vector DVec(base, treelvl);       DVec.rand(1e3);
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(UMat, VMat, DVec, ctx, runtime);
+  hMat.factor(ctx, runtime);
+
+  for (int itr=0; itr<2; itr++) {
+    Matrix Rhs(base, treelvl, 1); Rhs.rand();
+    hMat.solve_transpose(Rhs, ctx, runtime);
+    Matrix x = hMat.solution(ctx, runtime);
+    Matrix err = Rhs - ( VMat * (UMat.T() * x) + DVec.multiply(x) );
+    if (err.norm() / Rhs.norm() > 1e-10)
+      Error("transposed solve residual too large");
+
+    hMat.solve(Rhs, ctx, runtime);
+    x   = hMat.solution(ctx, runtime);
+    err = Rhs - ( UMat * (VMat.T() * x) + DVec.multiply(x) );
+    if (err.norm() / Rhs.norm() > 1e-10)
+      Error("solve after the transposed solve is wrong");
+  }
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for transposed solve passed!" << std::endl;
+}
+
+// solve with D + U * V' + sigma*I for shifts that are factorized
+//  again from the kept blocks, against the dense product
+void test_shift(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    base = 2*rank; // leaf size
+  Matrix VMat(base, treelvl, rank); VMat.rand();
+  Matrix UMat(base, treelvl, rank); UMat.rand();
+  Vector DVec(base, treelvl);       DVec.rand(1e3);
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(UMat, VMat, DVec, ctx, runtime);
+
+  // the shifts do not add up
+  double sigma[] = {0.0, 25.0, -10.0, 25.0};
+  for (int itr=0; itr<4; itr++) {
+    hMat.shift(sigma[itr], ctx, runtime);
+    Matrix Rhs(base, treelvl, 1); Rhs.rand();
+    hMat.solve(Rhs, ctx, runtime);
+    Matrix x = hMat.solution(ctx, runtime);
+    Matrix err = Rhs - ( UMat * (VMat.T() * x) + DVec.multiply(x) );
+    for (int i=0; i<x.rows(); i++)
+      err(i, 0) -= sigma[itr] * x(i, 0);
+    if (err.norm() / Rhs.norm() > 1e-10)
+      Error("solve with a diagonal shift is wrong");
+  }
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for diagonal shift passed!" << std::endl;
+}
+
+void test_multi_shift(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    base = 2*rank; // leaf size
+  int    nRhs = 2;
+  Matrix VMat(base, treelvl, rank); VMat.rand();
+  Matrix UMat(base, treelvl, rank); UMat.rand();
+  Vector DVec(base, treelvl);       DVec.rand(1e3);
+  Matrix Rhs(base, treelvl, nRhs);  Rhs.rand();
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(UMat, VMat, DVec, ctx, runtime, nRhs);
+
+  std::vector<double> sigma;
+  for (int k=0; k<16; k++)
+    sigma.push_back(-200.0 + 37.5*k);
+  hMat.solve_shifts(Rhs, sigma, ctx, runtime);
+  for (size_t k=0; k<sigma.size(); k++) {
+    Matrix x = hMat.shift_solution(k, ctx, runtime);
+    Matrix err = Rhs - ( UMat * (VMat.T() * x) + DVec.multiply(x) );
+    for (int j=0; j<nRhs; j++)
+      for (int i=0; i<x.rows(); i++)
+	err(i, j) -= sigma[k] * x(i, j);
+    if (err.norm() / Rhs.norm() > 1e-10)
+      Error("solve with multiple shifts is wrong");
+  }
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for multiple shifts passed!" << std::endl;
+}
+
+// independent systems factorized and solved in one tree
+void test_batch(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    base = 2*rank; // leaf size
+  int    nSys = 4;
+  std::vector<Matrix> UMat, VMat, Rhs;
+  std::vector<Vector> DVec;
+  for (int s=0; s<nSys; s++) {
+    UMat.push_back(Matrix(base, treelvl, rank)); UMat[s].rand();
+    VMat.push_back(Matrix(base, treelvl, rank)); VMat[s].rand();
+    Rhs.push_back(Matrix(base, treelvl, 1));     Rhs[s].rand();
+    DVec.push_back(Vector(base, treelvl));       DVec[s].rand(1e3);
+  }
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init_batch(UMat, VMat, DVec, ctx, runtime);
+  hMat.factor(ctx, runtime);
+  hMat.solve(Matrix::stack(Rhs), ctx, runtime);
+  for (int s=0; s<nSys; s++) {
+    Matrix x = hMat.solution(s, ctx, runtime);
+    Matrix err = Rhs[s] - ( UMat[s] * (VMat[s].T() * x) + DVec[s].multiply(x) );
+    if (err.norm() / Rhs[s].norm() > 1e-10)
+      Error("batched solve residual too large");
+  }
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for batched systems passed!" << std::endl;
+}
+
+// the ACA build with overestimated ranks, truncated before factor()
+void test_recompress(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    base = 2*rank; // leaf size
+  int    N    = base*pow(2, treelvl);
+  double tol  = 1e-12;
+  Matrix Rhs(base, treelvl, 1); Rhs.rand();
+  std::vector<int> ranks(treelvl, rank);
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(kernel_func, N, ranks, tol, ctx, runtime);
+  hMat.recompress(tol, ctx, runtime);
+  // the smooth kernel needs fewer columns than rank at the tolerance
+  bool dropped = false;
+  for (int k=0; k<treelvl; k++) {
+    int r = hMat.rank_profile()[k];
+    if (r < 1 || r > rank)
+      Error("recompressed rank out of range");
+    dropped = dropped || r < rank;
+  }
+  if (!dropped)
+    Error("recompression kept all the columns");
+  hMat.factor(ctx, runtime);
+  hMat.solve(Rhs, ctx, runtime);
+  Matrix x = hMat.solution(ctx, runtime);
+
+  // apply the matrix entry by entry
+  double err = 0.0;
+  for (int i=0; i<N; i++) {
+    double y = 0.0;
+    for (int j=0; j<N; j++)
+      y += kernel_entry(i, j) * x(j, 0);
+    err += (Rhs(i, 0)-y) * (Rhs(i, 0)-y);
+  }
+  if (sqrt(err) / Rhs.norm() > 1e-8)
+    Error("recompressed residual too large");
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for rank recompression passed!" << std::endl;
+}
+
+double scattered_point(int i) {
+  return fmod(i * 0.6180339887498949, 1.0);
+}
+
+double scattered_entry(int i, int j) {
+  double d = fabs(scattered_point(i) - scattered_point(j));
+  return i == j ? 1e3 : 1.0 / (1.0 + 1e3*d);
+}
+
+// order the points, build from the entries in the cluster order
+//  and solve in the order of the points
+void test_cluster_order(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    base = 2*rank; // leaf size
+  int    N    = base*pow(2, treelvl);
+  int    nLeaf = pow(2, treelvl);
+  double tol  = 1e-12;
+  Matrix Rhs(base, treelvl, 1); Rhs.rand();
+  std::vector<int> ranks(treelvl, rank);
+  Matrix points(N, 1);
+  for (int i=0; i<N; i++)
+    points(i, 0) = scattered_point(i);
+
+  // a permutation, where every leaf is an interval and the
+  //  intervals are in order
+  std::vector<int> perm = cluster_order(points, treelvl);
+  std::vector<bool> seen(N, false);
+  for (int i=0; i<N; i++) {
+    if (perm[i] < 0 || perm[i] >= N || seen[perm[i]])
+      Error("cluster order is not a permutation");
+    seen[perm[i]] = true;
+  }
+  double prev = -1.0;
+  for (int l=0; l<nLeaf; l++) {
+    double lo = 1.0, hi = -1.0;
+    for (int i=block_begin(N, nLeaf, l); i<block_begin(N, nLeaf, l+1); i++) {
+      lo = std::min(lo, points(perm[i], 0));
+      hi = std::max(hi, points(perm[i], 0));
+    }
+    if (lo < prev)
+      Error("cluster order does not split the points");
+    prev = hi;
+  }
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.set_permutation(perm, ctx, runtime);
+  hMat.init(scattered_func, N, ranks, tol, ctx, runtime);
+  hMat.factor(ctx, runtime);
+  hMat.solve(Rhs, ctx, runtime);
+  Matrix x = hMat.solution(ctx, runtime);
+
+  // apply the matrix entry by entry in the order of the points
+  double err = 0.0;
+  for (int i=0; i<N; i++) {
+    double y = 0.0;
+    for (int j=0; j<N; j++)
+      y += scattered_entry(i, j) * x(j, 0);
+    err += (Rhs(i, 0)-y) * (Rhs(i, 0)-y);
+  }
+  if (sqrt(err) / Rhs.norm() > 1e-8)
+    Error("cluster order residual too large");
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for cluster order passed!" << std::endl;
+}
+
+void test_add_diagonal(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    base = 2*rank; // leaf size
+  Matrix VMat(base, treelvl, rank); VMat.rand();
+  Matrix UMat(base, treelvl, rank); UMat.rand();
+  Vector DVec(base, treelvl);       DVec.rand(1e3);
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(UMat, VMat, DVec, ctx, runtime);
+  // the first call factorizes all blocks
+  hMat.add_diagonal(std::vector<int>(), std::vector<double>(), ctx, runtime);
+
+  // rows in the first and the last leaf; the changes add up
+  int    N = DVec.rows();
+  int    rows[]  = {0, 3, N-1, 3};
+  double delta[] = {50.0, -20.0, 10.0, 5.0};
+  for (int itr=0; itr<2; itr++) {
+    std::vector<int>    r(rows+2*itr, rows+2*itr+2);
+    std::vector<double> d(delta+2*itr, delta+2*itr+2);
+    hMat.add_diagonal(r, d, ctx, runtime);
+    for (size_t k=0; k<r.size(); k++)
+      DVec[r[k]] += d[k];
+    Matrix Rhs(base, treelvl, 1); Rhs.rand();
+    hMat.solve(Rhs, ctx, runtime);
+    Matrix x = hMat.solution(ctx, runtime);
+    Matrix err = Rhs - ( UMat * (VMat.T() * x) + DVec.multiply(x) );
+    if (err.norm() / Rhs.norm() > 1e-10)
+      Error("solve after a diagonal update is wrong");
+  }
+
+  // the kept factors give the log-determinant of factorizing
+  //  all blocks again
+  double logdet = hMat.log_determinant().get_result<double>();
+  hMat.shift(0.0, ctx, runtime);
+  double ref = hMat.log_determinant().get_result<double>();
+  if (fabs(logdet - ref) > 1e-10 * fabs(ref))
+    Error("log-determinant after a diagonal update is wrong");
+  hMat.destroy(ctx, runtime);
+  std::cout << "Test for diagonal update passed!" << std::endl;
+}
+
+// the diagonal of the inverse and its leaf blocks against the
+//  dense inverse, for the general and the symmetric factors
+void test_inverse_diagonal(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    base = 2*rank; // leaf size
+  Matrix VMat(base, treelvl, rank); VMat.rand();
+  Matrix UMat(base, treelvl, rank); UMat.rand();
+  Vector DVec(base, treelvl);       DVec.rand(1e3);
+  int N     = DVec.rows();
+  int nLeaf = pow(2, treelvl);
+
+  for (int spd=0; spd<2; spd++) {
+    HMatrix hMat(pow(2, launchlvl), launchlvl);
+    if (spd)
+      hMat.init(UMat, DVec, ctx, runtime);
+    else
+      hMat.init(UMat, VMat, DVec, ctx, runtime);
+    hMat.factor(ctx, runtime);
+    Matrix A = UMat * (spd ? UMat.T() : VMat.T()) + DVec.to_diag_matrix();
+    Matrix Ainv = Matrix::identity(N);
+    A.solve(Ainv);
+
+    LMatrix X = hMat.inverse_diagonal(false, ctx, runtime);
+    Matrix diag = X.to_matrix(ctx, runtime);
+    X.clear(ctx, runtime);
+    LMatrix Y = hMat.inverse_diagonal(true, ctx, runtime);
+    Matrix blocks = Y.to_matrix(ctx, runtime);
+    Y.clear(ctx, runtime);
+    double err = 0.0, ref = 0.0;
+    for (int l=0; l<nLeaf; l++) {
+      int lo = block_begin(N, nLeaf, l);
+      int hi = block_begin(N, nLeaf, l+1);
+      for (int i=lo; i<hi; i++) {
+	err = std::max(err, fabs(diag(i, 0) - Ainv(i, i)));
+	for (int j=lo; j<hi; j++) {
+	  err = std::max(err, fabs(blocks(i, j-lo) - Ainv(i, j)));
+	  ref = std::max(ref, fabs(Ainv(i, j)));
+	}
+      }
+    }
+    if (err > 1e-10 * ref)
+      Error("diagonal of the inverse is wrong");
+    hMat.destroy(ctx, runtime);
+  }
+  std::cout << "Test for diagonal of the inverse passed!" << std::endl;
+}
+
+// W*(W'*x) against the product with D + U * U', and log|det| of
+//  W*W' against that of the symmetric factor()
+void test_sqrt_factor(int rank, int treelvl, int launchlvl, Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  int    base = 2*rank; // leaf size
+  int    nRhs = 2;
+  Matrix UMat(base, treelvl, rank); UMat.rand();
+  Vector DVec(base, treelvl);       DVec.rand(1e3);
+  Matrix XMat(base, treelvl, nRhs); XMat.rand();
+
+  HMatrix hMat(pow(2, launchlvl), launchlvl);
+  hMat.init(UMat, DVec, ctx, runtime);
+  hMat.factor_sqrt(ctx, runtime);
+  int N = UMat.rows();
+  LMatrix X(N, nRhs, launchlvl, ctx, runtime);
+  LMatrix Y(N, nRhs, launchlvl, ctx, runtime);
+  X.init_data(XMat, ctx, runtime);
+
+  hMat.multiply_sqrt('t', X, Y, ctx, runtime);
+  hMat.multiply_sqrt('n', Y, X, ctx, runtime);
+  Matrix err = X.to_matrix(ctx, runtime) -
+    ( UMat * (UMat.T() * XMat) + DVec.multiply(XMat) );
+  if (err.norm() / XMat.norm() > 1e-10)
+    Error("symmetric factor is wrong");
+  double logdet = hMat.log_determinant().get_result<double>();
+  X.clear(ctx, runtime);
+  Y.clear(ctx, runtime);
+  hMat.destroy(ctx, runtime);
+
+  HMatrix hRef(pow(2, launchlvl), launchlvl);
+  hRef.init(UMat, DVec, ctx, runtime);
+  hRef.factor(ctx, runtime);
+  double ref = hRef.log_determinant().get_result<double>();
+  if (fabs(logdet - ref) > 1e-10 * fabs(ref))
+    Error("log-determinant of the symmetric factor is wrong");
+  hRef.destroy(ctx, runtime);
+  std::cout << "Test for symmetric factor passed!" << std::endl;
+}
+
+// LU factorization and transposed solve of a diagonally dominant
+//  matrix with the kernels for the scalar type T
+template <typename T>
+void test_scalar_type(const std::string& name) {
+
+  int N = 64, nRhs = 2;
+  PtrMatrixT<T> A(N, N), LU(N, N), X(N, nRhs), B(N, nRhs);
+  A.rand(1);
+  for (int i=0; i<N; i++)
+    A(i, i) += T(N);
+  B.rand(2);
+  PtrMatrixT<T>::add(T(1.0), A, T(0.0), A, LU);
+  PtrMatrixT<T>::add(T(1.0), B, T(0.0), B, X);
+  T *ipiv = new T[N];
+  LU.factor(ipiv);
+  LU.solve(X, ipiv, 't');
+  delete[] ipiv;
+
+  // B = A'*X - B
+  A.set_trans('t');
+  PtrMatrixT<T>::gemm(T(1.0), A, X, T(-1.0), B);
+  typename PtrMatrixT<T>::real err = 0.0;
+  for (int j=0; j<nRhs; j++)
+    for (int i=0; i<N; i++)
+      err = std::max(err, scalar_traits<T>::abs(B(i, j)));
+  double eps = sizeof(typename PtrMatrixT<T>::real) == sizeof(float) ?
+    1e-4 : 1e-12;
+  if (err > eps)
+    Error(name + " kernels are wrong");
+  std::cout << "Test for " << name << " kernels passed!" << std::endl;
+}
+
+// the solve of test_solver() in regions of scalar type T; the
+//  tasks generate U, V, D and b from the seeds of every block,
+//  so the host does the same in type T for the residual
+template <typename T>
+void test_typed_solver(int rank, int treelvl, int launchlvl,
+		       const std::string& name,
+		       Context ctx, HighLevelRuntime *runtime) {
+
+  assert(treelvl >= launchlvl);
+  ScalarType type = scalar_type_of<T>::value;
+  int    base = 2*rank; // leaf size
+  Matrix VMat(base, treelvl, rank); VMat.rand();
+  Matrix UMat(base, treelvl, rank); UMat.rand();
+  Matrix Rhs(base, treelvl, 1);     Rhs.rand();
+  Vector DVec(base, treelvl);       DVec.rand(1e3);
+
+  UTree uTree; uTree.init( UMat );
+  VTree vTree; vTree.init( VMat );
+  KTree kTree; kTree.init( UMat, VMat, DVec );
+  uTree.partition( launchlvl, ctx, runtime, type );
+  vTree.partition( launchlvl, ctx, runtime, type );
+  kTree.partition( launchlvl, ctx, runtime, type );
+  uTree.init_rhs( Rhs, ctx, runtime );
+
+  kTree.solve( uTree.leaf(), vTree.leaf(), ctx, runtime );
+  for (int i=launchlvl; i>0; i--) {
+    LMatrix& V = vTree.level(i);
+    LMatrix& u = uTree.uMat_level(i);
+    LMatrix& d = uTree.dMat_level(i);
+    int rows = pow(2, i)*V.cols();
+    LMatrix VTu(rows, u.cols(), i-1, ctx, runtime, type);
+    LMatrix VTd(rows, d.cols(), i-1, ctx, runtime, type);
+    VTu.two_level_partition(ctx, runtime);
+    VTd.two_level_partition(ctx, runtime);
+    LMatrix::gemmRed('t', 'n', 1.0, V, u, 0.0, VTu, ctx, runtime );
+    LMatrix::gemmRed('t', 'n', 1.0, V, d, 0.0, VTd, ctx, runtime );
+    VTu.node_solve( VTd, ctx, runtime );
+    LMatrix::gemmBro('n', 'n', -1.0, u, VTd, 1.0, d, ctx, runtime );
+    VTu.clear(ctx, runtime);
+    VTd.clear(ctx, runtime);
+  }
+  int N = UMat.rows();
+  PtrMatrixT<T> x(N, 1);
+  uTree.rhs_mat().to_matrix(x, ctx, runtime);
+
+  PtrMatrixT<T> U(N, rank), V(N, rank), D(N, 1), b(N, 1);
+  int nBlk = UMat.num_partition();
+  for (int k=0; k<nBlk; k++) {
+    int lo = block_begin(N, nBlk, k);
+    int n  = block_begin(N, nBlk, k+1) - lo;
+    PtrMatrixT<T>(n, rank, N, U.pointer(lo, 0)).rand(UMat.rand_seed(k));
+    PtrMatrixT<T>(n, rank, N, V.pointer(lo, 0)).rand(VMat.rand_seed(k));
+    PtrMatrixT<T>(n, 1, N, D.pointer(lo, 0)).rand(DVec.rand_seed(k),
+						   DVec.offset());
+    PtrMatrixT<T>(n, 1, N, b.pointer(lo, 0)).rand(Rhs.rand_seed(k));
+  }
+  // r = b - (U*(V'*x) + D.*x)
+  PtrMatrixT<T> VTx(rank, 1), r(N, 1);
+  V.set_trans('t');
+  PtrMatrixT<T>::gemm(T(1.0), V, x, T(0.0), VTx);
+  PtrMatrixT<T>::add(T(1.0), b, T(0.0), b, r);
+  PtrMatrixT<T>::gemm(T(-1.0), U, VTx, T(1.0), r);
+  typename PtrMatrixT<T>::real err = 0.0, bnorm = 0.0;
+  for (int i=0; i<N; i++) {
+    r(i, 0) -= D(i, 0) * x(i, 0);
+    err   = std::max(err,   scalar_traits<T>::abs(r(i, 0)));
+    bnorm = std::max(bnorm, scalar_traits<T>::abs(b(i, 0)));
+  }
+  double eps = sizeof(typename PtrMatrixT<T>::real) == sizeof(float) ?
+    1e-4 : 1e-10;
+  if (err / bnorm > eps)
+    Error(name + " solver residual too large");
+  uTree.clear(ctx, runtime);
+  vTree.clear(ctx, runtime);
+  kTree.clear(ctx, runtime);
+  std::cout << "Test for the " << name << " solver passed!" << std::endl;
+}
+
+// compare the unrolled kernels with lapack, and mix the two
+//  since the factors are shared by both
+void test_small_kernels() {
+
+  int ranks[] = {1, 3, 8, 17, MAX_SMALL_RANK};
+  for (int k=0; k<5; k++) {
+    int r = ranks[k], N = r, nRhs = 3;
+    const SmallKernels *small = small_kernels(r);
+    assert(small != NULL);
+    PtrMatrix A(N, N), LU0(N, N), LU1(N, N);
+    PtrMatrix B(N, nRhs), X0(N, nRhs), X1(N, nRhs);
+    A.rand(k);
+    for (int i=0; i<N; i++)
+      A(i, i) += N;
+    B.rand(k+1);
+    PtrMatrix::add(1.0, A, 0.0, A, LU0);
+    PtrMatrix::add(1.0, A, 0.0, A, LU1);
+    double *ipiv0 = new double[N];
+    double *ipiv1 = new double[N];
+    double logdet0 = LU0.factor(ipiv0);
+    double logdet1 = small->getrf(LU1.pointer(), LU1.LD(), ipiv1);
+
+    double err = fabs(logdet0-logdet1);
+    for (int t=0; t<2; t++) {
+      char trans = t==0 ? 'n' : 't';
+      // lapack solve with the unrolled factors and vice versa
+      PtrMatrix::add(1.0, B, 0.0, B, X0);
+      PtrMatrix::add(1.0, B, 0.0, B, X1);
+      LU1.solve(X0, ipiv1, trans);
+      small->getrs(trans, LU0.pointer(), LU0.LD(), ipiv0, nRhs,
+		   X1.pointer(), X1.LD());
+      for (int j=0; j<nRhs; j++)
+	for (int i=0; i<N; i++)
+	  err = std::max(err, fabs(X0(i, j) - X1(i, j)));
+    }
+    delete[] ipiv0;
+    delete[] ipiv1;
+
+    // C = A'*B with the unrolled kernel, then B -= A*C
+    PtrMatrix C(r, nRhs), D(N, nRhs);
+    PtrMatrix::add(1.0, B, 0.0, B, D);
+    small->gemm_tn(N, nRhs, A.pointer(), A.LD(), B.pointer(), B.LD(),
+		   C.pointer(), C.LD());
+    small->gemm_nn_sub(N, nRhs, A.pointer(), A.LD(), C.pointer(), C.LD(),
+		       D.pointer(), D.LD());
+    PtrMatrix Ar(N, r, A.LD(), A.pointer());
+    Ar.set_trans('t');
+    PtrMatrix::gemm(-1.0, Ar, B, 1.0, C);
+    Ar.set_trans('n');
+    for (int j=0; j<nRhs; j++)
+      for (int i=0; i<r; i++)
+	err = std::max(err, fabs(C(i, j)));
+    small->gemm_tn(N, nRhs, A.pointer(), A.LD(), B.pointer(), B.LD(),
+		   C.pointer(), C.LD());
+    PtrMatrix::gemm(1.0, Ar, C, 1.0, D);
+    PtrMatrix::add(1.0, D, -1.0, B, D);
+    for (int j=0; j<nRhs; j++)
+      for (int i=0; i<N; i++)
+	err = std::max(err, fabs(D(i, j)));
+    if (err > 1e-10)
+      Error("small kernels are wrong");
+  }
+  if (small_kernels(MAX_SMALL_RANK+1) != NULL)
+    Error("small kernels beyond the maximum rank");
+  std::cout << "Test for small kernels passed!" << std::endl;
+}